@@ -2,6 +2,7 @@
 #ifndef DATA_VALUE_H_
 #define DATA_VALUE_H_
 
+#include "MacroString.h"
 #include "Util/string_view.h"
 
 #include <gsl/span>
@@ -37,7 +38,7 @@ struct DataValue {
 	boost::variant<
 		boost::blank,
 		int32_t,
-		std::string,
+		MacroString,
 		ArrayPtr,
 		ArrayIterator,
 		LibraryRoutine,
@@ -88,13 +89,19 @@ inline DataValue make_value(bool n) {
 
 inline DataValue make_value(view::string_view str) {
 	DataValue DV;
-	DV.value = str.to_string();
+	DV.value = MacroString(str);
 	return DV;
 }
 
 inline DataValue make_value(const QString &str) {
 	DataValue DV;
-	DV.value = str.toStdString();
+	DV.value = MacroString(str.toStdString());
+	return DV;
+}
+
+inline DataValue make_value(const MacroString &str) {
+	DataValue DV;
+	DV.value = str;
 	return DV;
 }
 
@@ -139,7 +146,11 @@ inline bool is_array(const DataValue &dv) {
 }
 
 inline std::string to_string(const DataValue &dv) {
-	return boost::get<std::string>(dv.value);
+	return boost::get<MacroString>(dv.value).str();
+}
+
+inline const MacroString &to_macro_string(const DataValue &dv) {
+	return boost::get<MacroString>(dv.value);
 }
 
 inline int to_integer(const DataValue &dv) {
@@ -0,0 +1,96 @@
+
+#ifndef MACRO_STRING_H_
+#define MACRO_STRING_H_
+
+#include "Util/string_view.h"
+
+#include <memory>
+#include <string>
+
+/*
+** The string values of macros. They never change once made, so they are
+** shared between the values which hold them, and pushing a string on the
+** stack or assigning it to a variable only copies a pointer.
+**
+** That alone would still leave building a string up a piece at a time
+** (out = out line "\n") copying the whole of it for every piece, so the
+** results of concatenation are kept in buffers which later concatenations
+** add to in place, as long as the string being added to is all of its buffer
+** so far. Every other string sharing the buffer only ever looks at the part of
+** it which it was made with, so none of them can tell, and building a string
+** takes linear time.
+**
+** Strings made in any other way (literals, results of library routines) are
+** never added to, the first concatenation copies them into a buffer of its
+** own.
+*/
+class MacroString {
+private:
+	struct Buffer {
+		std::string text;
+		bool        appendable;
+	};
+
+public:
+	MacroString() = default;
+
+	explicit MacroString(view::string_view str) : buffer_(std::make_shared<Buffer>(Buffer{str.to_string(), false})), size_(str.size()) {
+	}
+
+private:
+	MacroString(std::shared_ptr<Buffer> buffer, size_t size) : buffer_(std::move(buffer)), size_(size) {
+	}
+
+public:
+	/*
+	** NOTE: appending to a string which shares this one's buffer may move the
+	** buffer, so views shouldn't be kept across operations which make strings
+	*/
+	view::string_view view() const noexcept {
+		return buffer_ ? view::string_view(buffer_->text.data(), size_) : view::string_view();
+	}
+
+	std::string str() const {
+		return view().to_string();
+	}
+
+	size_t size() const noexcept {
+		return size_;
+	}
+
+public:
+	/*
+	** Returns this string followed by "str"
+	*/
+	MacroString append(view::string_view str) const {
+
+		if (buffer_ && buffer_->appendable && buffer_->text.size() == size_) {
+
+			// "str" could be a part of this very buffer, which is about to grow
+			const char *const data = buffer_->text.data();
+			if (str.data() >= data && str.data() < data + buffer_->text.size()) {
+				const std::string copy = str.to_string();
+				buffer_->text.append(copy);
+			} else {
+				buffer_->text.append(str.data(), str.size());
+			}
+
+			return MacroString(buffer_, buffer_->text.size());
+		}
+
+		auto buffer = std::make_shared<Buffer>();
+		buffer->appendable = true;
+		buffer->text.reserve(size_ + str.size());
+		buffer->text.append(view().data(), size_);
+		buffer->text.append(str.data(), str.size());
+
+		const size_t size = buffer->text.size();
+		return MacroString(std::move(buffer), size);
+	}
+
+private:
+	std::shared_ptr<Buffer> buffer_;
+	size_t                  size_ = 0;
+};
+
+#endif
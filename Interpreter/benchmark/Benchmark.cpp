@@ -0,0 +1,170 @@
+#include "interpret.h"
+#include "parse.h"
+
+#include <QString>
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+
+namespace {
+
+constexpr int Iterations = 10;
+
+struct Benchmark {
+	const char *name;
+	const char *source;
+	const char *expected;
+};
+
+/*
+** Macros which only use the language itself, since the built-in routines
+** live with the rest of the editor
+*/
+const Benchmark Benchmarks[] = {
+	{
+		"arithmetic",
+		"s = 0\n"
+		"for (i = 0; i < 300000; i++) {\n"
+		"    s = s + i * 3 % 7 - 1\n"
+		"}\n"
+		"return s\n",
+		"599997"
+	},
+	{
+		"conditions",
+		"n = 0\n"
+		"i = 0\n"
+		"while (i < 300000) {\n"
+		"    if (i % 3 == 0 && i >= 10)\n"
+		"        n++\n"
+		"    else\n"
+		"        n += 2\n"
+		"    i += 1\n"
+		"}\n"
+		"return n\n",
+		"500004"
+	},
+	{
+		"nested loops",
+		"n = 0\n"
+		"for (i = 0; i < 500; i++) {\n"
+		"    for (j = 0; j < 500; j++) {\n"
+		"        if (i != j)\n"
+		"            n = n + 1\n"
+		"    }\n"
+		"}\n"
+		"return n\n",
+		"249500"
+	},
+	{
+		"strings",
+		"s = \"\"\n"
+		"for (i = 0; i < 5000; i++) {\n"
+		"    s = s \"ab\" i\n"
+		"}\n"
+		"return s == s\n",
+		"1"
+	},
+	{
+		"building strings",
+		"a = \"\"\n"
+		"b = \"\"\n"
+		"for (i = 0; i < 40000; i++) {\n"
+		"    a = a \"line \" i \"\\n\"\n"
+		"    b = b \"line \"\n"
+		"    b = b i \"\\n\"\n"
+		"}\n"
+		"return a == b\n",
+		"1"
+	},
+	{
+		"arrays",
+		"for (i = 0; i < 50000; i++) {\n"
+		"    a[i] = i\n"
+		"}\n"
+		"t = 0\n"
+		"for (k in a) {\n"
+		"    t += a[k]\n"
+		"}\n"
+		"return t\n",
+		"1249975000"
+	},
+};
+
+/*
+** Runs "prog" to the end, the way smart indent macros are run, ignoring the
+** time limit
+*/
+std::string run(Program *prog) {
+
+	DataValue result;
+	QString message;
+	std::shared_ptr<MacroContext> continuation;
+
+	int status = executeMacro(nullptr, prog, {}, &result, continuation, &message);
+	while (status == MACRO_TIME_LIMIT) {
+		status = continueMacro(continuation, &result, &message);
+	}
+
+	if (status != MACRO_DONE) {
+		return "error: " + message.toStdString();
+	}
+
+	if (is_integer(result)) {
+		return std::to_string(to_integer(result));
+	}
+
+	if (is_string(result)) {
+		return to_string(result);
+	}
+
+	return "?";
+}
+
+}
+
+int main() {
+
+	InitMacroGlobals();
+
+	int failures = 0;
+
+	for (const Benchmark &benchmark : Benchmarks) {
+
+		QString message;
+		int stoppedAt;
+		Program *prog = CompileMacro(QString::fromLatin1(benchmark.source), &message, &stoppedAt);
+		if (!prog) {
+			printf("  %-16s %s at %d\n", benchmark.name, qPrintable(message), stoppedAt);
+			++failures;
+			continue;
+		}
+
+		double best = 0;
+		std::string result;
+
+		for (int i = 0; i < Iterations; ++i) {
+			const auto start = std::chrono::steady_clock::now();
+			result = run(prog);
+			const auto end = std::chrono::steady_clock::now();
+
+			const double ms = std::chrono::duration<double, std::milli>(end - start).count();
+			if (i == 0 || ms < best) {
+				best = ms;
+			}
+		}
+
+		if (result != benchmark.expected) {
+			printf("  %-16s %10.2f ms  (got %s, expected %s)\n", benchmark.name, best, result.c_str(), benchmark.expected);
+			++failures;
+		} else {
+			printf("  %-16s %10.2f ms\n", benchmark.name, best);
+		}
+
+		delete prog;
+	}
+
+	CleanupMacroGlobals();
+	return failures != 0;
+}
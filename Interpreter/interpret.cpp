@@ -1,8 +1,11 @@
 
 #include "interpret.h"
 #include "Util/utils.h"
+#include <gsl/gsl_util>
 #include <cmath>
 #include <cassert>
+#include <functional>
+#include <unordered_map>
 
 // This enables preemption, useful to disable it for debugging things
 #define ENABLE_PREEMPTION
@@ -45,8 +48,16 @@ const auto MacroTooLarge = QLatin1String("macro too large");
 // Global symbols and function definitions
 std::deque<Symbol *> GlobalSymList;
 
+/* The same symbols, hashed by name (the keys refer to the symbols' own names),
+   and the string constants among them, hashed by value. So that the parser
+   doesn't have to look through every builtin and every subroutine which has
+   been defined so far for each identifier it sees */
+std::unordered_map<view::string_view, Symbol *> GlobalSymTable;
+std::unordered_map<std::string, Symbol *>       StringConstTable;
+
 // Temporary global data for use while accumulating programs
 std::deque<Symbol *> LocalSymList;     // symbols local to the program
+std::unordered_map<view::string_view, Symbol *> LocalSymTable; // the same, by name
 Inst Prog[PROGRAM_SIZE];               // the program
 Inst *ProgP;                           // next free spot for code gen.
 Inst *LoopStack[LOOP_STACK_SIZE];      // addresses of break, cont stmts
@@ -57,6 +68,7 @@ MacroContext Context;
 
 const char *ErrMsg;                           // global for returning error messages from executing functions
 bool PreemptRequest;                    // passes preemption requests from called routines back up to the interpreter
+void (*RoutineHook)(LibraryRoutine);    // told about each library routine before it is called, and with nullptr when execution stops
 
 // Stack-> symN-sym0(FP), argArray, nArgs, oldFP, retPC, argN-arg1, next, ...
 constexpr int FP_ARG_ARRAY_CACHE_INDEX = -1;
@@ -144,6 +156,14 @@ static int beginArrayIter();
 static int arrayIter();
 static int inArray();
 static int deleteArrayElement();
+static int pushSymVal2();
+static int incrementSym();
+static int decrementSym();
+template <int (*Op)()>
+static int operateAndAssign();
+template <class Compare, int (*Op)()>
+static int compareAndBranchFalse();
+static void fuseInstructions(std::vector<Inst> &code);
 
 static ArrayIterator arrayIterateFirst(DataValue *theArray);
 static ArrayIterator arrayIterateNext(ArrayIterator iterator);
@@ -218,6 +238,54 @@ static const operation_type OpFns[N_OPS] = {
 	pushArgArray
 };
 
+/* The number of operands which follow each operation in the program, in the
+   same order as OpFns */
+static const int OpOperands[N_OPS] = {
+	0, // returnNoVal
+	0, // returnVal
+	1, // pushSymVal
+	0, // dupStack
+	0, // add
+	0, // subtract
+	0, // multiply
+	0, // divide
+	0, // modulo
+	0, // negate
+	0, // increment
+	0, // decrement
+	0, // gt
+	0, // lt
+	0, // ge
+	0, // le
+	0, // eq
+	0, // ne
+	0, // bitAnd
+	0, // bitOr
+	0, // logicalAnd
+	0, // logicalOr
+	0, // logicalNot
+	0, // power
+	0, // concat
+	1, // assign
+	2, // callSubroutine
+	0, // fetchRetVal
+	1, // branch
+	1, // branchTrue
+	1, // branchFalse
+	1, // branchNever
+	1, // arrayRef
+	1, // arrayAssign
+	1, // beginArrayIter
+	3, // arrayIter
+	0, // inArray
+	1, // deleteArrayElement
+	2, // pushArraySymVal
+	2, // arrayRefAndAssignSetup
+	0, // pushArgVal
+	0, // pushArgCount
+	0  // pushArgArray
+};
+
 
 
 /*
@@ -282,6 +350,9 @@ void InitMacroGlobals() {
  * @brief CleanupMacroGlobals
  */
 void CleanupMacroGlobals() {
+	GlobalSymTable.clear();
+	StringConstTable.clear();
+
 	for(Symbol *sym: GlobalSymList) {
 		delete sym;
 	}
@@ -301,6 +372,7 @@ void CleanupMacroGlobals() {
 */
 void BeginCreatingProgram() {
 	LocalSymList.clear();
+	LocalSymTable.clear();
 	ProgP        = Prog;
 	LoopStackPtr = LoopStack;
 }
@@ -317,6 +389,7 @@ Program *FinishCreatingProgram() {
 
 	newProg->localSymList = LocalSymList;
 	LocalSymList.clear();
+	LocalSymTable.clear();
 
 	int fpOffset = 0;
 
@@ -327,6 +400,8 @@ Program *FinishCreatingProgram() {
 	}
 
 	DISASM(newProg->code.data(), newProg->code.size());
+
+	fuseInstructions(newProg->code);
 	return newProg;
 }
 
@@ -529,6 +604,13 @@ int continueMacro(const std::shared_ptr<MacroContext> &continuation, DataValue *
 	MacroContext oldContext;
 	saveContext(&oldContext);
 
+	// however execution stops, the hook hears about it
+	auto _ = gsl::finally([]() {
+		if (RoutineHook) {
+			RoutineHook(nullptr);
+		}
+	});
+
 	Q_ASSERT(continuation);
 
 	/*
@@ -611,6 +693,17 @@ void preemptMacro() {
 	PreemptRequest = true;
 }
 
+/*
+** Set a function to be called with each library routine (built-in subroutine
+** or special variable) right before the interpreter calls it, and with nullptr
+** whenever the interpreter stops executing a macro, for whatever reason.
+** Lets the routines keep up state which must be settled before any other
+** routine runs, or control returns to the caller.
+*/
+void SetLibraryRoutineHook(void (*hook)(LibraryRoutine routine)) {
+	RoutineHook = hook;
+}
+
 /*
 ** Reset the return value for a subroutine which caused preemption (this is
 ** how to return a value from a routine which preempts instead of returning
@@ -664,11 +757,11 @@ Symbol *InstallIteratorSymbol() {
 */
 Symbol *LookupStringConstSymbol(view::string_view value) {
 
-	for(Symbol *s : GlobalSymList) {
-		if (s->type == CONST_SYM && is_string(s->value) && to_string(s->value) == value) {
-			return s;
-		}
+	auto it = StringConstTable.find(value.to_string());
+	if (it != StringConstTable.end()) {
+		return it->second;
 	}
+
 	return nullptr;
 }
 
@@ -702,16 +795,14 @@ Symbol *LookupSymbolEx(const QString &name) {
 
 Symbol *LookupSymbol(view::string_view name) {
 
-	for(Symbol *s : LocalSymList) {
-		if (s->name == name) {
-			return s;
-		}
+	auto local = LocalSymTable.find(name);
+	if (local != LocalSymTable.end()) {
+		return local->second;
 	}
 
-	for(Symbol *s : GlobalSymList) {
-		if (s->name == name) {
-			return s;
-		}
+	auto global = GlobalSymTable.find(name);
+	if (global != GlobalSymTable.end()) {
+		return global->second;
 	}
 
 	return nullptr;
@@ -728,10 +819,19 @@ Symbol *InstallSymbol(const std::string &name, SymTypes type, const DataValue &v
 
 	auto s = new Symbol { name, type, value };
 
+	/* A newer local shadows an older one of the same name, but an older
+	   global is found before a newer one, as when the lists were searched
+	   front to back */
 	if (type == LOCAL_SYM) {
 		LocalSymList.push_front(s);
+		LocalSymTable[s->name] = s;
 	} else {
 		GlobalSymList.push_back(s);
+		GlobalSymTable.emplace(s->name, s);
+
+		if (type == CONST_SYM && is_string(s->value)) {
+			StringConstTable.emplace(to_string(s->value), s);
+		}
 	}
 	return s;
 }
@@ -755,6 +855,20 @@ Symbol *PromoteToGlobal(Symbol *sym) {
 	// Remove sym from the local symbol list
 	LocalSymList.erase(std::remove(LocalSymList.begin(), LocalSymList.end(), sym), LocalSymList.end());
 
+	auto local = LocalSymTable.find(sym->name);
+	if (local != LocalSymTable.end() && local->second == sym) {
+		LocalSymTable.erase(local);
+
+		// an older local of the same name is no longer shadowed
+		auto older = std::find_if(LocalSymList.begin(), LocalSymList.end(), [sym](Symbol *s) {
+			return s->name == sym->name;
+		});
+
+		if (older != LocalSymList.end()) {
+			LocalSymTable[(*older)->name] = *older;
+		}
+	}
+
 	/* There are two scenarios which could make this check succeed:
 	   a) this sym is in the GlobalSymList as a LOCAL_SYM symbol
 	   b) there is another symbol as a non-LOCAL_SYM in the GlobalSymList
@@ -780,6 +894,7 @@ Symbol *PromoteToGlobal(Symbol *sym) {
 	sym->type = GLOBAL_SYM;
 
 	GlobalSymList.push_back(sym);
+	GlobalSymTable.emplace(sym->name, sym);
 
 	return sym;
 }
@@ -853,6 +968,10 @@ Symbol *PromoteToGlobal(Symbol *sym) {
 		int n2;                                                                \
 		DISASM_RT(PC - 1, 1);                                                  \
 		STACKDUMP(2, 3);                                                       \
+		if (int32_t *result = integerOperands(&n1, &n2)) {                     \
+			*result = n1 op n2;                                                \
+			return STAT_OK;                                                    \
+		}                                                                      \
 		POP_INT(n2);                                                           \
 		POP_INT(n1);                                                           \
 		PUSH_INT(n1 op n2);                                                    \
@@ -869,6 +988,33 @@ Symbol *PromoteToGlobal(Symbol *sym) {
 		return STAT_OK;                                                        \
 	} while(0)
 
+/*
+** The fast path for operations on two integers. If the top two values on the
+** stack are both integers, read them into "n1" (the lower one) and "n2", pop
+** the upper one, and return where the lower one is held, for the result to be
+** stored in its place without going through a DataValue. Otherwise leave the
+** stack alone and return nullptr, for the caller to pop them with the usual
+** conversions.
+*/
+static int32_t *integerOperands(int *n1, int *n2) {
+
+	if (Context.StackP - Context.Stack.get() < 2) {
+		return nullptr;
+	}
+
+	DataValue &v1 = Context.StackP[-2];
+	DataValue &v2 = Context.StackP[-1];
+
+	if (!is_integer(v1) || !is_integer(v2)) {
+		return nullptr;
+	}
+
+	*n1 = to_integer(v1);
+	*n2 = to_integer(v2);
+	--Context.StackP;
+	return boost::get<int32_t>(&v1.value);
+}
+
 /*
 ** copy a symbol's value onto the stack
 ** Before: Prog->  [Sym], next, ...
@@ -879,6 +1025,7 @@ Symbol *PromoteToGlobal(Symbol *sym) {
 static int pushSymVal() {
 
 	DataValue symVal;
+	const DataValue *value = &symVal; // so that variables are only copied once, onto the stack
 
 	DISASM_RT(PC - 1, 2);
 	STACKDUMP(0, 3);
@@ -886,9 +1033,9 @@ static int pushSymVal() {
 	Symbol *s = Context.PC++->sym;
 
 	if (s->type == LOCAL_SYM) {
-		symVal = FP_GET_SYM_VAL(Context.FrameP, s);
+		value = &FP_GET_SYM_VAL(Context.FrameP, s);
 	} else if (s->type == GLOBAL_SYM || s->type == CONST_SYM) {
-		symVal = s->value;
+		value = &s->value;
 	} else if (s->type == ARG_SYM) {
 		int nArgs = FP_GET_ARG_COUNT(Context.FrameP);
 		int argNum = to_integer(s->value);
@@ -898,21 +1045,25 @@ static int pushSymVal() {
 		if (argNum == N_ARGS_ARG_SYM) {
 			symVal = make_value(nArgs);
 		} else {
-			symVal = FP_GET_ARG_N(Context.FrameP, argNum);
+			value = &FP_GET_ARG_N(Context.FrameP, argNum);
 		}
 	} else if (s->type == PROC_VALUE_SYM) {
 
+		if (RoutineHook) {
+			RoutineHook(to_subroutine(s->value));
+		}
+
 		if (std::error_code ec = (to_subroutine(s->value))(Context.FocusDocument, {}, &symVal)) {
 			return execError(ec, s->name.c_str());
 		}
 	} else
 		return execError("reading non-variable: %s", s->name.c_str());
 
-	if (is_unset(symVal)) {
+	if (is_unset(*value)) {
 		return execError("variable not set: %s", s->name.c_str());
 	}
 
-	PUSH(symVal);
+	PUSH(*value);
 
 	return STAT_OK;
 }
@@ -1023,7 +1174,6 @@ static int pushArraySymVal() {
 static int assign() {
 
 	DataValue *dataPtr;
-	DataValue value;
 
 	DISASM_RT(PC - 1, 2);
 	STACKDUMP(1, 3);
@@ -1045,13 +1195,19 @@ static int assign() {
 		return execError("assignment to non-variable: %s", sym->name.c_str());
 	}
 
-	POP(value);
+	if (Context.StackP == Context.Stack.get()) {
+		return execError(StackUnderflowMsg);
+	}
+
+	/* the value is taken off the stack, so it can be swapped in rather than
+	   copied, leaving the old one's storage in the stack for reuse */
+	DataValue &value = *--Context.StackP;
 
 	if (is_array(value)) {
 		return ArrayCopy(dataPtr, &value);
 	}
 
-	*dataPtr = value;
+	std::swap(*dataPtr, value);
 	return STAT_OK;
 }
 
@@ -1140,6 +1296,11 @@ static int add() {
 		int n1;
 		int n2;
 
+		if (int32_t *result = integerOperands(&n1, &n2)) {
+			*result = n1 + n2;
+			return STAT_OK;
+		}
+
 		POP_INT(n2);
 		POP_INT(n1);
 		PUSH_INT(n1 + n2);
@@ -1208,6 +1369,11 @@ static int subtract() {
 		int n1;
 		int n2;
 
+		if (int32_t *result = integerOperands(&n1, &n2)) {
+			*result = n1 - n2;
+			return STAT_OK;
+		}
+
 		POP_INT(n2);
 		POP_INT(n1);
 		PUSH_INT(n1 - n2);
@@ -1234,6 +1400,14 @@ static int divide() {
 	DISASM_RT(PC - 1, 1);
 	STACKDUMP(2, 3);
 
+	if (int32_t *result = integerOperands(&n1, &n2)) {
+		if (n2 == 0) {
+			return execError("division by zero");
+		}
+		*result = n1 / n2;
+		return STAT_OK;
+	}
+
 	POP_INT(n2);
 	POP_INT(n1);
 	if (n2 == 0) {
@@ -1249,6 +1423,14 @@ static int modulo() {
 	DISASM_RT(PC - 1, 1);
 	STACKDUMP(2, 3);
 
+	if (int32_t *result = integerOperands(&n1, &n2)) {
+		if (n2 == 0) {
+			return execError("modulo by zero");
+		}
+		*result = n1 % n2;
+		return STAT_OK;
+	}
+
 	POP_INT(n2);
 	POP_INT(n1);
 	if (n2 == 0) {
@@ -1295,10 +1477,17 @@ static int le() {
 static int eq() {
 	DataValue v1;
 	DataValue v2;
+	int n1;
+	int n2;
 
 	DISASM_RT(PC - 1, 1);
 	STACKDUMP(2, 3);
 
+	if (int32_t *result = integerOperands(&n1, &n2)) {
+		*result = (n1 == n2);
+		return STAT_OK;
+	}
+
 	POP(v1);
 	POP(v2);
 
@@ -1307,9 +1496,8 @@ static int eq() {
 		auto n2 = to_integer(v2);
 		v1 = make_value(n1 == n2);
 	} else if (is_string(v1) && is_string(v2)) {
-		auto s1 = to_string(v1);
-		auto s2 = to_string(v2);
-		v1 = make_value(s1 == s2);
+		const bool equal = (to_macro_string(v1).view() == to_macro_string(v2).view());
+		v1 = make_value(equal);
 	} else if (is_string(v1) && is_integer(v2)) {
 		int number;
 		if (!StringToNum(to_string(v1), &number)) {
@@ -1528,24 +1716,46 @@ static int power() {
 	return errCheck("exponentiation");
 }
 
+/*
+** The string form of "dv", if it is a string or an integer
+*/
+static bool toMacroString(const DataValue &dv, MacroString *str) {
+	if (is_string(dv)) {
+		*str = to_macro_string(dv);
+	} else if (is_integer(dv)) {
+		*str = MacroString(std::to_string(to_integer(dv)));
+	} else {
+		return false;
+	}
+
+	return true;
+}
+
 /*
 ** concatenate two top items on the stack
 ** Before: TheStack-> str2, str1, next, ...
 ** After:  TheStack-> result, next, ...
+**
+** str1 is added to in place if it is the end of a string being built up,
+** rather than copied (see MacroString)
 */
 static int concat() {
-	std::string s1;
-	std::string s2;
+	MacroString s1;
+	MacroString s2;
 
 	DISASM_RT(PC - 1, 1);
 	STACKDUMP(2, 3);
 
-	POP_STRING(s2);
-	POP_STRING(s1);
+	if (Context.StackP - Context.Stack.get() < 2) {
+		return execError(StackUnderflowMsg);
+	}
 
-	std::string out = s1 + s2;
+	if (!toMacroString(Context.StackP[-1], &s2) || !toMacroString(Context.StackP[-2], &s1)) {
+		return execError(CantConvertArrayToString);
+	}
 
-	PUSH_STRING(out);
+	--Context.StackP;
+	Context.StackP[-1] = make_value(s1.append(s2.view()));
 	return STAT_OK;
 }
 
@@ -1586,6 +1796,10 @@ static int callSubroutine() {
 		// Call the function and check for preemption
 		PreemptRequest = false;
 
+		if (RoutineHook) {
+			RoutineHook(to_subroutine(sym->value));
+		}
+
 		if (std::error_code ec = to_subroutine(sym->value)(Context.FocusDocument, Arguments(Context.StackP, nArgs), &result)) {
 			return execError(ec, sym->name.c_str());
 		}
@@ -1771,6 +1985,257 @@ static int branchNever() {
 	return STAT_OK;
 }
 
+/*
+** Superinstructions: fuseInstructions puts these in place of the first
+** instruction of a common sequence, and they do the work of the whole
+** sequence with a single trip through the execution loop. The operands, and
+** the instructions after the first, stay where they were, so each of these
+** steps over the instructions it stands in for.
+*/
+
+/*
+** Two PUSH_SYMs in a row
+**
+** Before: Prog->  [sym1], PUSH_SYM, sym2, next, ...
+**         TheStack-> next, ...
+** After:  Prog->  sym1, PUSH_SYM, sym2, [next], ...
+**         TheStack-> [sym2Val], sym1Val, next, ...
+*/
+static int pushSymVal2() {
+
+	const int status = pushSymVal();
+	if (status != STAT_OK) {
+		return status;
+	}
+
+	++Context.PC;
+	return pushSymVal();
+}
+
+/*
+** Adds "delta" to the variable "sym" in place, if it holds an integer, as
+** PUSH_SYM sym, INCR/DECR, ASSIGN sym would do. Otherwise runs those
+** instructions one after the other, for their conversions and errors.
+**
+** Before: Prog->  [sym], INCR, ASSIGN, sym, next, ...
+** After:  Prog->  sym, INCR, ASSIGN, sym, [next], ...
+*/
+static int addToSym(int delta, int (*op)()) {
+
+	Symbol *sym = Context.PC->sym;
+
+	DataValue *dataPtr = nullptr;
+	if (sym->type == LOCAL_SYM) {
+		dataPtr = &FP_GET_SYM_VAL(Context.FrameP, sym);
+	} else if (sym->type == GLOBAL_SYM) {
+		dataPtr = &sym->value;
+	}
+
+	if (dataPtr && is_integer(*dataPtr)) {
+		*boost::get<int32_t>(&dataPtr->value) += delta;
+		Context.PC += 4;
+		return STAT_OK;
+	}
+
+	int status = pushSymVal();
+	if (status != STAT_OK) {
+		return status;
+	}
+
+	++Context.PC;
+	status = op();
+	if (status != STAT_OK) {
+		return status;
+	}
+
+	++Context.PC;
+	return assign();
+}
+
+static int incrementSym() {
+	return addToSym(1, increment);
+}
+
+static int decrementSym() {
+	return addToSym(-1, decrement);
+}
+
+/*
+** An operation, then ASSIGN of its result
+**
+** Before: Prog->  [ASSIGN], sym, next, ...
+** After:  Prog->  ASSIGN, sym, [next], ...
+*/
+template <int (*Op)()>
+static int operateAndAssign() {
+
+	const int status = Op();
+	if (status != STAT_OK) {
+		return status;
+	}
+
+	++Context.PC;
+	return assign();
+}
+
+/*
+** A comparison, then BRANCH_FALSE on its result. Two integers are compared
+** and branched on directly, without the result going through the stack.
+**
+** Before: Prog->  [BRANCH_FALSE], branchDest, next, ...
+** After:  either: Prog->  BRANCH_FALSE, branchDest, [next], ...
+** After:  or:     Prog->  BRANCH_FALSE, branchDest, next, ..., (branchdest)[next]
+*/
+template <class Compare, int (*Op)()>
+static int compareAndBranchFalse() {
+
+	int n1;
+	int n2;
+
+	if (integerOperands(&n1, &n2)) {
+		--Context.StackP;
+		++Context.PC;
+		Inst *addr = Context.PC + Context.PC->value;
+		Context.PC++;
+
+		if (!Compare()(n1, n2)) {
+			Context.PC = addr;
+		}
+
+		return STAT_OK;
+	}
+
+	const int status = Op();
+	if (status != STAT_OK) {
+		return status;
+	}
+
+	++Context.PC;
+	return branchFalse();
+}
+
+/*
+** Look for sequences of instructions in "code" which have a superinstruction,
+** and put the superinstruction in place of the first of them. A sequence is
+** left alone if something branches into the middle of it.
+*/
+static void fuseInstructions(std::vector<Inst> &code) {
+
+	auto opIndex = [](Inst inst) {
+		return static_cast<int>(std::find(std::begin(OpFns), std::end(OpFns), inst.func) - std::begin(OpFns));
+	};
+
+	// where each instruction starts, and which ones something branches to
+	std::vector<size_t> starts;
+	std::vector<int>    ops;
+	std::vector<bool>   targets(code.size() + 1, false);
+
+	auto addTarget = [&code, &targets](size_t operand) {
+		const int64_t to = static_cast<int64_t>(operand) + code[operand].value;
+		if (to >= 0 && to <= static_cast<int64_t>(code.size())) {
+			targets[static_cast<size_t>(to)] = true;
+		}
+	};
+
+	for (size_t i = 0; i < code.size(); ) {
+		const int op = opIndex(code[i]);
+		if (op == N_OPS) {
+			return;
+		}
+
+		switch(op) {
+		case OP_BRANCH:
+		case OP_BRANCH_TRUE:
+		case OP_BRANCH_FALSE:
+		case OP_BRANCH_NEVER:
+			addTarget(i + 1);
+			break;
+		case OP_ARRAY_ITER:
+			addTarget(i + 3);
+			break;
+		}
+
+		starts.push_back(i);
+		ops.push_back(op);
+		i += 1 + static_cast<size_t>(OpOperands[op]);
+	}
+
+	// can instructions n..n+count-1 be fused?
+	auto fusable = [&](size_t n, size_t count) {
+		if (n + count > ops.size()) {
+			return false;
+		}
+
+		for (size_t k = 1; k < count; ++k) {
+			if (targets[starts[n + k]]) {
+				return false;
+			}
+		}
+		return true;
+	};
+
+	auto comparisonFor = [](int op) -> int (*)() {
+		switch(op) {
+		case OP_GT: return compareAndBranchFalse<std::greater<int>,       gt>;
+		case OP_LT: return compareAndBranchFalse<std::less<int>,          lt>;
+		case OP_GE: return compareAndBranchFalse<std::greater_equal<int>, ge>;
+		case OP_LE: return compareAndBranchFalse<std::less_equal<int>,    le>;
+		case OP_EQ: return compareAndBranchFalse<std::equal_to<int>,      eq>;
+		case OP_NE: return compareAndBranchFalse<std::not_equal_to<int>,  ne>;
+		default:    return nullptr;
+		}
+	};
+
+	auto assignmentFor = [](int op) -> int (*)() {
+		switch(op) {
+		case OP_ADD:    return operateAndAssign<add>;
+		case OP_SUB:    return operateAndAssign<subtract>;
+		case OP_MUL:    return operateAndAssign<multiply>;
+		case OP_CONCAT: return operateAndAssign<concat>;
+		default:        return nullptr;
+		}
+	};
+
+	for (size_t n = 0; n < ops.size(); ) {
+
+		Inst &first = code[starts[n]];
+
+		// x++ and x-- as statements: PUSH_SYM x, INCR/DECR, ASSIGN x
+		if (fusable(n, 3) && ops[n] == OP_PUSH_SYM && (ops[n + 1] == OP_INCR || ops[n + 1] == OP_DECR) && ops[n + 2] == OP_ASSIGN && code[starts[n] + 1].sym == code[starts[n + 2] + 1].sym) {
+			first.func = (ops[n + 1] == OP_INCR) ? incrementSym : decrementSym;
+			n += 3;
+			continue;
+		}
+
+		// the operands of binary operations
+		if (fusable(n, 2) && ops[n] == OP_PUSH_SYM && ops[n + 1] == OP_PUSH_SYM) {
+			first.func = pushSymVal2;
+			n += 2;
+			continue;
+		}
+
+		// conditions of if, while and for
+		if (fusable(n, 2) && ops[n + 1] == OP_BRANCH_FALSE) {
+			if (auto func = comparisonFor(ops[n])) {
+				first.func = func;
+				n += 2;
+				continue;
+			}
+		}
+
+		// x = x + y and friends
+		if (fusable(n, 2) && ops[n + 1] == OP_ASSIGN) {
+			if (auto func = assignmentFor(ops[n])) {
+				first.func = func;
+				n += 2;
+				continue;
+			}
+		}
+
+		++n;
+	}
+}
+
 /*
 ** recursively copy(duplicate) the sparse array nodes of an array
 ** this does not duplicate the key/node data since they are never
@@ -1800,7 +2265,7 @@ static int makeArrayKeyFromArgs(int64_t nArgs, std::string *keyString, bool leav
 		if (is_integer(tmpVal)) {
 			str.append(std::to_string(to_integer(tmpVal)));
 		} else if (is_string(tmpVal)) {
-			auto s = to_string(tmpVal);
+			auto s = to_macro_string(tmpVal).view();
 			str.append(s.begin(), s.end());
 		} else {
 			return execError("can only index array with string or int.");
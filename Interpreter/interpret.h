@@ -167,6 +167,7 @@ int executeMacro(DocumentWidget *document, Program *prog, gsl::span<DataValue> a
 int continueMacro(const std::shared_ptr<MacroContext> &continuation, DataValue *result, QString *msg);
 void RunMacroAsSubrCall(Program *prog);
 void preemptMacro();
+void SetLibraryRoutineHook(void (*hook)(LibraryRoutine routine));
 
 Symbol *PromoteToGlobal(Symbol *sym);
 void ModifyReturnedValueEx(const std::shared_ptr<MacroContext> &context, const DataValue &dv);
@@ -3,6 +3,7 @@
 #include "Execute.h"
 #include "Constants.h"
 #include "Common.h"
+#include "Dfa.h"
 #include "Opcodes.h"
 #include "RegexError.h"
 #include "Regex.h"
@@ -12,6 +13,7 @@
 #include <cstring>
 #include <algorithm>
 #include <cassert>
+#include <climits>
 #include <QtGlobal>
 
 #ifdef Q_FALLTHROUGH
@@ -48,7 +50,7 @@ struct len_range {
 	int32_t upper;
 };
 
-uint8_t *chunk(int paren, int *flag_param, len_range &range_param);
+uint8_t *chunk(ParseContext &ctx, int paren, int *flag_param, len_range &range_param);
 
 const char Default_Meta_Char[] = "{.*+?[(|)^<>$";
 const char ASCII_Digits[] = "0123456789"; // Same for all locales.
@@ -57,9 +59,9 @@ const char ASCII_Digits[] = "0123456789"; // Same for all locales.
  * next_ptr - compute the address of a node's "NEXT" pointer.
  * Note: a simplified inline version is available via NEXT_PTR(),
  *----------------------------------------------------------------------*/
-uint8_t *next_ptr(uint8_t *ptr) noexcept {
+uint8_t *next_ptr(const ParseContext &ctx, uint8_t *ptr) noexcept {
 
-	if (pContext.FirstPass) {
+	if (ctx.FirstPass) {
 		return nullptr;
 	}
 
@@ -97,8 +99,8 @@ constexpr uint8_t PUT_OFFSET_R(T v) noexcept {
  * @param c
  * @return
  */
-bool isQuantifier(char ch) noexcept {
-	return ch == '*' || ch == '+' || ch == '?' || ch == pContext.Brace_Char;
+bool isQuantifier(const ParseContext &ctx, char ch) noexcept {
+	return ch == '*' || ch == '+' || ch == '?' || ch == ctx.Brace_Char;
 }
 
 /*--------------------------------------------------------------------*
@@ -107,51 +109,46 @@ bool isQuantifier(char ch) noexcept {
  * Generate character class sets using locale aware ANSI C functions.
  *
  *--------------------------------------------------------------------*/
-bool init_ansi_classes() noexcept {
+bool init_ansi_classes(ParseContext &ctx) noexcept {
 
-	static bool initialized = false;
+	// The sets live in the parse context, which every compile starts afresh.
+	constexpr int Underscore = '_';
+	constexpr int Newline    = '\n';
 
-	if (!initialized) {
-		initialized = true; // Only need to generate character sets once.
+	int word_count   = 0;
+	int letter_count = 0;
+	int space_count  = 0;
 
-		constexpr int Underscore = '_';
-		constexpr int Newline    = '\n';
-
-		int word_count   = 0;
-		int letter_count = 0;
-		int space_count  = 0;
-
-		for (int i = 1; i < UINT8_MAX; i++) {
-			if (safe_ctype<isalnum>(i) || i == Underscore) {
-				pContext.Word_Char[word_count++] = static_cast<char>(i);
-			}
+	for (int i = 1; i < UINT8_MAX; i++) {
+		if (safe_ctype<isalnum>(i) || i == Underscore) {
+			ctx.Word_Char[word_count++] = static_cast<char>(i);
+		}
 
-			if (safe_ctype<isalpha>(i)) {
-				pContext.Letter_Char[letter_count++] = static_cast<char>(i);
-			}
+		if (safe_ctype<isalpha>(i)) {
+			ctx.Letter_Char[letter_count++] = static_cast<char>(i);
+		}
 
-			/* Note: Whether or not newline is considered to be whitespace is
-			   handled by switches within the original regex and is thus omitted
-			   here. */
+		/* Note: Whether or not newline is considered to be whitespace is
+		   handled by switches within the original regex and is thus omitted
+		   here. */
 
-			if (safe_ctype<isspace>(i) && (i != Newline)) {
-				pContext.White_Space[space_count++] = static_cast<char>(i);
-			}
+		if (safe_ctype<isspace>(i) && (i != Newline)) {
+			ctx.White_Space[space_count++] = static_cast<char>(i);
+		}
 
-			/* Make sure arrays are big enough.  ("- 2" because of zero array
-			   origin and we need to leave room for the '\0' terminator.) */
+		/* Make sure arrays are big enough.  ("- 2" because of zero array
+		   origin and we need to leave room for the '\0' terminator.) */
 
-			if (word_count > (ALNUM_CHAR_SIZE - 2) || space_count > (WHITE_SPACE_SIZE - 2) || letter_count > (ALNUM_CHAR_SIZE - 2)) {
-				reg_error("internal error #9 'init_ansi_classes'");
-				return false;
-			}
+		if (word_count > (ALNUM_CHAR_SIZE - 2) || space_count > (WHITE_SPACE_SIZE - 2) || letter_count > (ALNUM_CHAR_SIZE - 2)) {
+			reg_error("internal error #9 'init_ansi_classes'");
+			return false;
 		}
-
-		pContext.Word_Char[word_count]     = '\0';
-		pContext.Letter_Char[letter_count] = '\0';
-		pContext.White_Space[space_count]  = '\0';
 	}
 
+	ctx.Word_Char[word_count]     = '\0';
+	ctx.Letter_Char[letter_count] = '\0';
+	ctx.White_Space[space_count]  = '\0';
+
 	return true;
 }
 
@@ -165,17 +162,17 @@ bool init_ansi_classes() noexcept {
  * Returns a pointer to the START of the emitted node.
  *----------------------------------------------------------------------*/
 template <class T>
-uint8_t *emit_node(T op_code) noexcept {
+uint8_t *emit_node(ParseContext &ctx, T op_code) noexcept {
 
-	if (pContext.FirstPass) {
-		pContext.Reg_Size += NODE_SIZE;
+	if (ctx.FirstPass) {
+		ctx.Reg_Size += NODE_SIZE;
 		return reinterpret_cast<uint8_t *>(1);
 	} else {
-		size_t end_offset = pContext.Code.size();
-		pContext.Code.push_back(static_cast<uint8_t>(op_code));
-		pContext.Code.push_back(0);
-		pContext.Code.push_back(0);
-		return &pContext.Code[end_offset];
+		size_t end_offset = ctx.Code.size();
+		ctx.Code.push_back(static_cast<uint8_t>(op_code));
+		ctx.Code.push_back(0);
+		ctx.Code.push_back(0);
+		return &ctx.Code[end_offset];
 	}
 }
 
@@ -185,12 +182,12 @@ uint8_t *emit_node(T op_code) noexcept {
  * Emit (if appropriate) a byte of code (usually part of an operand.)
  *----------------------------------------------------------------------*/
 template <class T>
-void emit_byte(T ch) noexcept {
+void emit_byte(ParseContext &ctx, T ch) noexcept {
 
-	if (pContext.FirstPass) {
-		pContext.Reg_Size++;
+	if (ctx.FirstPass) {
+		ctx.Reg_Size++;
 	} else {
-		pContext.Code.push_back(static_cast<uint8_t>(ch));
+		ctx.Code.push_back(static_cast<uint8_t>(ch));
 	}
 }
 
@@ -201,22 +198,22 @@ void emit_byte(T ch) noexcept {
  * class operand.)
  *----------------------------------------------------------------------*/
 template <class T>
-void emit_class_byte(T ch) noexcept {
+void emit_class_byte(ParseContext &ctx, T ch) noexcept {
 
-	if (pContext.FirstPass) {
-		pContext.Reg_Size++;
+	if (ctx.FirstPass) {
+		ctx.Reg_Size++;
 
-		if (pContext.Is_Case_Insensitive && safe_ctype<isalpha>(ch)) {
-			pContext.Reg_Size++;
+		if (ctx.Is_Case_Insensitive && safe_ctype<isalpha>(ch)) {
+			ctx.Reg_Size++;
 		}
 
-	} else if (pContext.Is_Case_Insensitive && safe_ctype<isalpha>(ch)) {
+	} else if (ctx.Is_Case_Insensitive && safe_ctype<isalpha>(ch)) {
 		/* For case insensitive character classes, emit both upper and lower
 		 * case versions of alphabetical characters. */
-		pContext.Code.push_back(static_cast<uint8_t>(safe_ctype<tolower>(ch)));
-		pContext.Code.push_back(static_cast<uint8_t>(safe_ctype<toupper>(ch)));
+		ctx.Code.push_back(static_cast<uint8_t>(safe_ctype<tolower>(ch)));
+		ctx.Code.push_back(static_cast<uint8_t>(safe_ctype<toupper>(ch)));
 	} else {
-		pContext.Code.push_back(static_cast<uint8_t>(ch));
+		ctx.Code.push_back(static_cast<uint8_t>(ch));
 	}
 }
 
@@ -226,41 +223,41 @@ void emit_class_byte(T ch) noexcept {
  * Emit nodes that need special processing.
  *----------------------------------------------------------------------*/
 template <class Ch>
-uint8_t *emit_special(Ch op_code, unsigned long test_val, size_t index) noexcept {
+uint8_t *emit_special(ParseContext &ctx, Ch op_code, unsigned long test_val, size_t index) noexcept {
 
-	if (pContext.FirstPass) {
+	if (ctx.FirstPass) {
 		switch (op_code) {
 		case POS_BEHIND_OPEN:
 		case NEG_BEHIND_OPEN:
-			pContext.Reg_Size += LENGTH_SIZE; // Length of the look-behind match
-			pContext.Reg_Size += NODE_SIZE;   // Make room for the node
+			ctx.Reg_Size += LENGTH_SIZE; // Length of the look-behind match
+			ctx.Reg_Size += NODE_SIZE;   // Make room for the node
 			break;
 
 		case TEST_COUNT:
-			pContext.Reg_Size += NEXT_PTR_SIZE; // Make room for a test value.
+			ctx.Reg_Size += NEXT_PTR_SIZE; // Make room for a test value.
 			NEDIT_FALLTHROUGH();
 		case INC_COUNT:
-			pContext.Reg_Size += INDEX_SIZE; // Make room for an index value.
+			ctx.Reg_Size += INDEX_SIZE; // Make room for an index value.
 			NEDIT_FALLTHROUGH();
 		default:
-			pContext.Reg_Size += NODE_SIZE; // Make room for the node.
+			ctx.Reg_Size += NODE_SIZE; // Make room for the node.
 		}
 
 		return reinterpret_cast<uint8_t *>(1);
 	} else {
-		uint8_t *ret_val = emit_node(op_code); // Return the address for start of node.
+		uint8_t *ret_val = emit_node(ctx, op_code); // Return the address for start of node.
 		if (op_code == INC_COUNT || op_code == TEST_COUNT) {
-			pContext.Code.push_back(static_cast<uint8_t>(index));
+			ctx.Code.push_back(static_cast<uint8_t>(index));
 
 			if (op_code == TEST_COUNT) {
-				pContext.Code.push_back(PUT_OFFSET_L(test_val));
-				pContext.Code.push_back(PUT_OFFSET_R(test_val));
+				ctx.Code.push_back(PUT_OFFSET_L(test_val));
+				ctx.Code.push_back(PUT_OFFSET_R(test_val));
 			}
 		} else if (op_code == POS_BEHIND_OPEN || op_code == NEG_BEHIND_OPEN) {
-			pContext.Code.push_back(PUT_OFFSET_L(test_val));
-			pContext.Code.push_back(PUT_OFFSET_R(test_val));
-			pContext.Code.push_back(PUT_OFFSET_L(test_val));
-			pContext.Code.push_back(PUT_OFFSET_R(test_val));
+			ctx.Code.push_back(PUT_OFFSET_L(test_val));
+			ctx.Code.push_back(PUT_OFFSET_R(test_val));
+			ctx.Code.push_back(PUT_OFFSET_L(test_val));
+			ctx.Code.push_back(PUT_OFFSET_R(test_val));
 		}
 		return ret_val;
 	}
@@ -269,16 +266,16 @@ uint8_t *emit_special(Ch op_code, unsigned long test_val, size_t index) noexcept
 /*----------------------------------------------------------------------*
  * tail - Set the next-pointer at the end of a node chain.
  *----------------------------------------------------------------------*/
-void tail(uint8_t *search_from, uint8_t *point_to) {
+void tail(ParseContext &ctx, uint8_t *search_from, uint8_t *point_to) {
 
-	if (pContext.FirstPass) {
+	if (ctx.FirstPass) {
 		return;
 	}
 
 	// Find the last node in the chain (node with a null NEXT pointer)
 	uint8_t *scan = search_from;
 
-	while(uint8_t *next = next_ptr(scan)) {
+	while(uint8_t *next = next_ptr(ctx, scan)) {
 		scan = next;
 	}
 
@@ -301,7 +298,7 @@ void tail(uint8_t *search_from, uint8_t *point_to) {
  * the operand. The parameter 'insert_pos' points to the location
  * where the new node is to be inserted.
  *----------------------------------------------------------------------*/
-uint8_t *insert(uint8_t op, uint8_t *insert_pos, unsigned long min, unsigned long max, size_t index) {
+uint8_t *insert(ParseContext &ctx, uint8_t op, uint8_t *insert_pos, unsigned long min, unsigned long max, size_t index) {
 
 	size_t insert_size = NODE_SIZE;
 
@@ -313,13 +310,13 @@ uint8_t *insert(uint8_t op, uint8_t *insert_pos, unsigned long min, unsigned lon
 		insert_size += INDEX_SIZE;
 	}
 
-	if (pContext.FirstPass) {
-		pContext.Reg_Size += insert_size;
+	if (ctx.FirstPass) {
+		ctx.Reg_Size += insert_size;
 		return reinterpret_cast<uint8_t *>(1);
 	}
 
 	// Where operand used to be.
-	const ptrdiff_t offset = insert_pos - pContext.Code.data();
+	const ptrdiff_t offset = insert_pos - ctx.Code.data();
 
 	// assemble the new node in place, then insert it
 	uint8_t new_node[32];
@@ -340,8 +337,8 @@ uint8_t *insert(uint8_t op, uint8_t *insert_pos, unsigned long min, unsigned lon
 		*ptr++ = index;
 	}
 
-	pContext.Code.insert(pContext.Code.begin() + offset, new_node, ptr);
-	return &pContext.Code[offset]; // Return a pointer to the start of the code moved.
+	ctx.Code.insert(ctx.Code.begin() + offset, new_node, ptr);
+	return &ctx.Code[offset]; // Return a pointer to the start of the code moved.
 }
 
 /*--------------------------------------------------------------------*
@@ -383,7 +380,7 @@ uint8_t *insert(uint8_t op, uint8_t *insert_pos, unsigned long min, unsigned lon
  *
  *--------------------------------------------------------------------*/
 template <ShortcutEscapeFlags Flags, class Ch>
-uint8_t *shortcut_escape(Ch ch, int *flag_param) {
+uint8_t *shortcut_escape(ParseContext &ctx, Ch ch, int *flag_param) {
 
 	static const char codes[] = "ByYdDlLsSwW";
 
@@ -409,39 +406,39 @@ uint8_t *shortcut_escape(Ch ch, int *flag_param) {
 		if (Flags == EMIT_CLASS_BYTES) {
 			clazz = ASCII_Digits;
 		} else if (Flags == EMIT_NODE) {
-			ret_val = (safe_ctype<islower>(ch) ? emit_node(DIGIT) : emit_node(NOT_DIGIT));
+			ret_val = (safe_ctype<islower>(ch) ? emit_node(ctx, DIGIT) : emit_node(ctx, NOT_DIGIT));
 		}
 		break;
 	case 'l':
 	case 'L':
 		if (Flags == EMIT_CLASS_BYTES) {
-			clazz = pContext.Letter_Char;
+			clazz = ctx.Letter_Char;
 		} else if (Flags == EMIT_NODE) {
-			ret_val = (safe_ctype<islower>(ch) ? emit_node(LETTER) : emit_node(NOT_LETTER));
+			ret_val = (safe_ctype<islower>(ch) ? emit_node(ctx, LETTER) : emit_node(ctx, NOT_LETTER));
 		}
 		break;
 	case 's':
 	case 'S':
 		if (Flags == EMIT_CLASS_BYTES) {
-			if (pContext.Match_Newline) {
-				emit_byte('\n');
+			if (ctx.Match_Newline) {
+				emit_byte(ctx, '\n');
 			}
 
-			clazz = pContext.White_Space;
+			clazz = ctx.White_Space;
 		} else if (Flags == EMIT_NODE) {
-			if (pContext.Match_Newline) {
-				ret_val = (safe_ctype<islower>(ch) ? emit_node(SPACE_NL) : emit_node(NOT_SPACE_NL));
+			if (ctx.Match_Newline) {
+				ret_val = (safe_ctype<islower>(ch) ? emit_node(ctx, SPACE_NL) : emit_node(ctx, NOT_SPACE_NL));
 			} else {
-				ret_val = (safe_ctype<islower>(ch) ? emit_node(SPACE) : emit_node(NOT_SPACE));
+				ret_val = (safe_ctype<islower>(ch) ? emit_node(ctx, SPACE) : emit_node(ctx, NOT_SPACE));
 			}
 		}
 		break;
 	case 'w':
 	case 'W':
 		if (Flags == EMIT_CLASS_BYTES) {
-			clazz = pContext.Word_Char;
+			clazz = ctx.Word_Char;
 		} else if (Flags == EMIT_NODE) {
-			ret_val = (safe_ctype<islower>(ch) ? emit_node(WORD_CHAR) : emit_node(NOT_WORD_CHAR));
+			ret_val = (safe_ctype<islower>(ch) ? emit_node(ctx, WORD_CHAR) : emit_node(ctx, NOT_WORD_CHAR));
 		}
 		break;
 
@@ -450,7 +447,7 @@ uint8_t *shortcut_escape(Ch ch, int *flag_param) {
 		 * table will be available for these nodes to use. */
 	case 'y':
 		if (Flags == EMIT_NODE) {
-			ret_val = emit_node(IS_DELIM);
+			ret_val = emit_node(ctx, IS_DELIM);
 		} else {
 			Raise<RegexError>("internal error #5 'shortcut_escape'");
 		}
@@ -458,14 +455,14 @@ uint8_t *shortcut_escape(Ch ch, int *flag_param) {
 
 	case 'Y':
 		if (Flags == EMIT_NODE) {
-			ret_val = emit_node(NOT_DELIM);
+			ret_val = emit_node(ctx, NOT_DELIM);
 		} else {
 			Raise<RegexError>("internal error #6 'shortcut_escape'");
 		}
 		break;
 	case 'B':
 		if (Flags == EMIT_NODE) {
-			ret_val = emit_node(NOT_BOUNDARY);
+			ret_val = emit_node(ctx, NOT_BOUNDARY);
 		} else {
 			Raise<RegexError>("internal error #7 'shortcut_escape'");
 		}
@@ -486,7 +483,7 @@ uint8_t *shortcut_escape(Ch ch, int *flag_param) {
 		// TODO(eteran): maybe emit the length of the string first
 		// so we don't have to depend on the NUL character during execution
 		while (*clazz != '\0') {
-			emit_byte(*clazz++);
+			emit_byte(ctx, *clazz++);
 		}
 	}
 
@@ -498,13 +495,13 @@ uint8_t *shortcut_escape(Ch ch, int *flag_param) {
  *
  * Perform a tail operation on (ptr + offset).
  *--------------------------------------------------------------------*/
-void offset_tail(uint8_t *ptr, int offset, uint8_t *val) {
+void offset_tail(ParseContext &ctx, uint8_t *ptr, int offset, uint8_t *val) {
 
-	if (pContext.FirstPass || !ptr) {
+	if (ctx.FirstPass || !ptr) {
 		return;
 	}
 
-	tail(ptr + offset, val);
+	tail(ctx, ptr + offset, val);
 }
 
 /*--------------------------------------------------------------------*
@@ -513,13 +510,13 @@ void offset_tail(uint8_t *ptr, int offset, uint8_t *val) {
  * Perform a tail operation on (ptr + offset) but only if 'ptr' is a
  * BRANCH node.
  *--------------------------------------------------------------------*/
-void branch_tail(uint8_t *ptr, int offset, uint8_t *val) {
+void branch_tail(ParseContext &ctx, uint8_t *ptr, int offset, uint8_t *val) {
 
-	if (pContext.FirstPass || !ptr || GET_OP_CODE(ptr) != BRANCH) {
+	if (ctx.FirstPass || !ptr || GET_OP_CODE(ptr) != BRANCH) {
 		return;
 	}
 
-	tail(ptr + offset, val);
+	tail(ctx, ptr + offset, val);
 }
 
 /*--------------------------------------------------------------------*
@@ -536,7 +533,7 @@ void branch_tail(uint8_t *ptr, int offset, uint8_t *val) {
  * text previously matched by another regex. *** IMPLEMENT LATER ***
  *--------------------------------------------------------------------*/
 template <ShortcutEscapeFlags Flags>
-uint8_t *back_ref(const char *ch, int *flag_param) {
+uint8_t *back_ref(ParseContext &ctx, const char *ch, int *flag_param) {
 
 	size_t c_offset = 0;
 	const bool is_cross_regex = false;
@@ -563,31 +560,31 @@ uint8_t *back_ref(const char *ch, int *flag_param) {
 	}
 
 	// Make sure parentheses for requested back-reference are complete.
-	if (!is_cross_regex && !pContext.Closed_Parens[paren_no]) {
+	if (!is_cross_regex && !ctx.Closed_Parens[paren_no]) {
 		Raise<RegexError>("\\%d is an illegal back reference", paren_no);
 	}
 
 	if (Flags == EMIT_NODE) {
 		if (is_cross_regex) {
-			++pContext.Reg_Parse; /* Skip past the '~' in a cross regex back
+			++ctx.Reg_Parse; /* Skip past the '~' in a cross regex back
 								   * reference. We only do this if we are emitting code. */
 
-			if (pContext.Is_Case_Insensitive) {
-				ret_val = emit_node(X_REGEX_BR_CI);
+			if (ctx.Is_Case_Insensitive) {
+				ret_val = emit_node(ctx, X_REGEX_BR_CI);
 			} else {
-				ret_val = emit_node(X_REGEX_BR);
+				ret_val = emit_node(ctx, X_REGEX_BR);
 			}
 		} else {
-			if (pContext.Is_Case_Insensitive) {
-				ret_val = emit_node(BACK_REF_CI);
+			if (ctx.Is_Case_Insensitive) {
+				ret_val = emit_node(ctx, BACK_REF_CI);
 			} else {
-				ret_val = emit_node(BACK_REF);
+				ret_val = emit_node(ctx, BACK_REF);
 			}
 		}
 
-		emit_byte(paren_no);
+		emit_byte(ctx, paren_no);
 
-		if (is_cross_regex || pContext.Paren_Has_Width[paren_no]) {
+		if (is_cross_regex || ctx.Paren_Has_Width[paren_no]) {
 			*flag_param |= HAS_WIDTH;
 		}
 	} else if (Flags == CHECK_ESCAPE) {
@@ -609,7 +606,7 @@ uint8_t *back_ref(const char *ch, int *flag_param) {
  * together so that it can turn them into a single EXACTLY node, which
  * is smaller to store and faster to run.
  *----------------------------------------------------------------------*/
-uint8_t *atom(int *flag_param, len_range &range_param) {
+uint8_t *atom(ParseContext &ctx, int *flag_param, len_range &range_param) {
 
 	uint8_t *ret_val;
 	uint8_t test;
@@ -626,51 +623,51 @@ uint8_t *atom(int *flag_param, len_range &range_param) {
 	   string)... period.  Handles multiple sequential comments,
 	   e.g. '(?# one)(?# two)...'  */
 
-	while (*pContext.Reg_Parse == '(' && pContext.Reg_Parse[1] == '?' && *(pContext.Reg_Parse + 2) == '#') {
+	while (*ctx.Reg_Parse == '(' && ctx.Reg_Parse[1] == '?' && *(ctx.Reg_Parse + 2) == '#') {
 
-		pContext.Reg_Parse += 3;
+		ctx.Reg_Parse += 3;
 
-		while (pContext.Reg_Parse != pContext.InputString.end() && *pContext.Reg_Parse != ')') {
-			++pContext.Reg_Parse;
+		while (ctx.Reg_Parse != ctx.InputString.end() && *ctx.Reg_Parse != ')') {
+			++ctx.Reg_Parse;
 		}
 
-		if (*pContext.Reg_Parse == ')') {
-			++pContext.Reg_Parse;
+		if (*ctx.Reg_Parse == ')') {
+			++ctx.Reg_Parse;
 		}
 
-		if (pContext.Reg_Parse == pContext.InputString.end() || *pContext.Reg_Parse == ')' || *pContext.Reg_Parse == '|') {
+		if (ctx.Reg_Parse == ctx.InputString.end() || *ctx.Reg_Parse == ')' || *ctx.Reg_Parse == '|') {
 			/* Hit end of regex string or end of parenthesized regex; have to
 			 return "something" (i.e. a NOTHING node) to avoid generating an
 			 error. */
 
-			ret_val = emit_node(NOTHING);
+			ret_val = emit_node(ctx, NOTHING);
 			return ret_val;
 		}
 	}
 
-	if(pContext.Reg_Parse == pContext.InputString.end()) {
+	if(ctx.Reg_Parse == ctx.InputString.end()) {
 		// Supposed to be caught earlier.
 		Raise<RegexError>("internal error #3, 'atom'");
 	}
 
-	switch (*pContext.Reg_Parse++) {
+	switch (*ctx.Reg_Parse++) {
 	case '^':
-		ret_val = emit_node(BOL);
+		ret_val = emit_node(ctx, BOL);
 		break;
 	case '$':
-		ret_val = emit_node(EOL);
+		ret_val = emit_node(ctx, EOL);
 		break;
 	case '<':
-		ret_val = emit_node(BOWORD);
+		ret_val = emit_node(ctx, BOWORD);
 		break;
 	case '>':
-		ret_val = emit_node(EOWORD);
+		ret_val = emit_node(ctx, EOWORD);
 		break;
 	case '.':
-		if (pContext.Match_Newline) {
-			ret_val = emit_node(EVERY);
+		if (ctx.Match_Newline) {
+			ret_val = emit_node(ctx, EVERY);
 		} else {
-			ret_val = emit_node(ANY);
+			ret_val = emit_node(ctx, ANY);
 		}
 
 		*flag_param |= (HAS_WIDTH | SIMPLE);
@@ -678,48 +675,48 @@ uint8_t *atom(int *flag_param, len_range &range_param) {
 		range_param.upper = 1;
 		break;
 	case '(':
-		if (*pContext.Reg_Parse == '?') { // Special parenthetical expression
-			++pContext.Reg_Parse;
+		if (*ctx.Reg_Parse == '?') { // Special parenthetical expression
+			++ctx.Reg_Parse;
 			range_local.lower = 0; // Make sure it is always used
 			range_local.upper = 0;
 
-			if (*pContext.Reg_Parse == ':') {
-				++pContext.Reg_Parse;
-				ret_val = chunk(NO_CAPTURE, &flags_local, range_local);
-			} else if (*pContext.Reg_Parse == '=') {
-				++pContext.Reg_Parse;
-				ret_val = chunk(POS_AHEAD_OPEN, &flags_local, range_local);
-			} else if (*pContext.Reg_Parse == '!') {
-				++pContext.Reg_Parse;
-				ret_val = chunk(NEG_AHEAD_OPEN, &flags_local, range_local);
-			} else if (*pContext.Reg_Parse == 'i') {
-				++pContext.Reg_Parse;
-				ret_val = chunk(INSENSITIVE, &flags_local, range_local);
-			} else if (*pContext.Reg_Parse == 'I') {
-				++pContext.Reg_Parse;
-				ret_val = chunk(SENSITIVE, &flags_local, range_local);
-			} else if (*pContext.Reg_Parse == 'n') {
-				++pContext.Reg_Parse;
-				ret_val = chunk(NEWLINE, &flags_local, range_local);
-			} else if (*pContext.Reg_Parse == 'N') {
-				++pContext.Reg_Parse;
-				ret_val = chunk(NO_NEWLINE, &flags_local, range_local);
-			} else if (*pContext.Reg_Parse == '<') {
-				++pContext.Reg_Parse;
-				if (*pContext.Reg_Parse == '=') {
-					++pContext.Reg_Parse;
-					ret_val = chunk(POS_BEHIND_OPEN, &flags_local, range_local);
-				} else if (*pContext.Reg_Parse == '!') {
-					++pContext.Reg_Parse;
-					ret_val = chunk(NEG_BEHIND_OPEN, &flags_local, range_local);
+			if (*ctx.Reg_Parse == ':') {
+				++ctx.Reg_Parse;
+				ret_val = chunk(ctx, NO_CAPTURE, &flags_local, range_local);
+			} else if (*ctx.Reg_Parse == '=') {
+				++ctx.Reg_Parse;
+				ret_val = chunk(ctx, POS_AHEAD_OPEN, &flags_local, range_local);
+			} else if (*ctx.Reg_Parse == '!') {
+				++ctx.Reg_Parse;
+				ret_val = chunk(ctx, NEG_AHEAD_OPEN, &flags_local, range_local);
+			} else if (*ctx.Reg_Parse == 'i') {
+				++ctx.Reg_Parse;
+				ret_val = chunk(ctx, INSENSITIVE, &flags_local, range_local);
+			} else if (*ctx.Reg_Parse == 'I') {
+				++ctx.Reg_Parse;
+				ret_val = chunk(ctx, SENSITIVE, &flags_local, range_local);
+			} else if (*ctx.Reg_Parse == 'n') {
+				++ctx.Reg_Parse;
+				ret_val = chunk(ctx, NEWLINE, &flags_local, range_local);
+			} else if (*ctx.Reg_Parse == 'N') {
+				++ctx.Reg_Parse;
+				ret_val = chunk(ctx, NO_NEWLINE, &flags_local, range_local);
+			} else if (*ctx.Reg_Parse == '<') {
+				++ctx.Reg_Parse;
+				if (*ctx.Reg_Parse == '=') {
+					++ctx.Reg_Parse;
+					ret_val = chunk(ctx, POS_BEHIND_OPEN, &flags_local, range_local);
+				} else if (*ctx.Reg_Parse == '!') {
+					++ctx.Reg_Parse;
+					ret_val = chunk(ctx, NEG_BEHIND_OPEN, &flags_local, range_local);
 				} else {
-					Raise<RegexError>("invalid look-behind syntax, \"(?<%c...)\"", *pContext.Reg_Parse);
+					Raise<RegexError>("invalid look-behind syntax, \"(?<%c...)\"", *ctx.Reg_Parse);
 				}
 			} else {
-				Raise<RegexError>("invalid grouping syntax, \"(?%c...)\"", *pContext.Reg_Parse);
+				Raise<RegexError>("invalid grouping syntax, \"(?%c...)\"", *ctx.Reg_Parse);
 			}
 		} else { // Normal capturing parentheses
-			ret_val = chunk(PAREN, &flags_local, range_local);
+			ret_val = chunk(ctx, PAREN, &flags_local, range_local);
 		}
 
 		if (!ret_val)
@@ -737,15 +734,15 @@ uint8_t *atom(int *flag_param, len_range &range_param) {
 	case '?':
 	case '+':
 	case '*':
-		Raise<RegexError>("%c follows nothing", pContext.Reg_Parse[-1]);
+		Raise<RegexError>("%c follows nothing", ctx.Reg_Parse[-1]);
 
 	case '{':
-		if (pContext.Enable_Counting_Quantifier) {
+		if (ctx.Enable_Counting_Quantifier) {
 			Raise<RegexError>("{m,n} follows nothing");
 		} else {
-			ret_val = emit_node(EXACTLY); // Treat braces as literals.
-			emit_byte('{');
-			emit_byte('\0');
+			ret_val = emit_node(ctx, EXACTLY); // Treat braces as literals.
+			emit_byte(ctx, '{');
+			emit_byte(ctx, '\0');
 			range_param.lower = 1;
 			range_param.upper = 1;
 		}
@@ -757,40 +754,40 @@ uint8_t *atom(int *flag_param, len_range &range_param) {
 
 		// Handle characters that can only occur at the start of a class.
 
-		if (*pContext.Reg_Parse == '^') { // Complement of range.
-			ret_val = emit_node(ANY_BUT);
-			++pContext.Reg_Parse;
+		if (*ctx.Reg_Parse == '^') { // Complement of range.
+			ret_val = emit_node(ctx, ANY_BUT);
+			++ctx.Reg_Parse;
 
 			/* All negated classes include newline unless escaped with
 			   a "(?n)" switch. */
 
-			if (!pContext.Match_Newline)
-				emit_byte('\n');
+			if (!ctx.Match_Newline)
+				emit_byte(ctx, '\n');
 		} else {
-			ret_val = emit_node(ANY_OF);
+			ret_val = emit_node(ctx, ANY_OF);
 		}
 
-		if (*pContext.Reg_Parse == ']' || *pContext.Reg_Parse == '-') {
+		if (*ctx.Reg_Parse == ']' || *ctx.Reg_Parse == '-') {
 			/* If '-' or ']' is the first character in a class,
 			   it is a literal character in the class. */
 
-			last_emit = static_cast<uint8_t>(*pContext.Reg_Parse);
-			emit_byte(*pContext.Reg_Parse);
-			++pContext.Reg_Parse;
+			last_emit = static_cast<uint8_t>(*ctx.Reg_Parse);
+			emit_byte(ctx, *ctx.Reg_Parse);
+			++ctx.Reg_Parse;
 		}
 
 		// Handle the rest of the class characters.
 
-		while (pContext.Reg_Parse != pContext.InputString.end() && *pContext.Reg_Parse != ']') {
-			if (*pContext.Reg_Parse == '-') { // Process a range, e.g [a-z].
-				++pContext.Reg_Parse;
+		while (ctx.Reg_Parse != ctx.InputString.end() && *ctx.Reg_Parse != ']') {
+			if (*ctx.Reg_Parse == '-') { // Process a range, e.g [a-z].
+				++ctx.Reg_Parse;
 
-				if (*pContext.Reg_Parse == ']' || pContext.Reg_Parse == pContext.InputString.end()) {
+				if (*ctx.Reg_Parse == ']' || ctx.Reg_Parse == ctx.InputString.end()) {
 					/* If '-' is the last character in a class it is a literal
 					   character.  If 'Reg_Parse' points to the end of the
 					   regex string, an error will be generated later. */
 
-					emit_byte('-');
+					emit_byte(ctx, '-');
 					last_emit = '-';
 				} else {
 					/* We must get the range starting character value from the
@@ -805,7 +802,7 @@ uint8_t *atom(int *flag_param, len_range &range_param) {
 					unsigned int last_value;
 					unsigned int second_value = static_cast<unsigned int>(last_emit) + 1;
 
-					if (*pContext.Reg_Parse == '\\') {
+					if (*ctx.Reg_Parse == '\\') {
 						/* Handle escaped characters within a class range.
 						   Specifically disallow shortcut escapes as the end of
 						   a class range.  To allow this would be ambiguous
@@ -813,22 +810,22 @@ uint8_t *atom(int *flag_param, len_range &range_param) {
 						   and it would not be clear which character of the
 						   class should be treated as the "last" character. */
 
-						++pContext.Reg_Parse;
+						++ctx.Reg_Parse;
 
-						if ((test = numeric_escape<uint8_t>(*pContext.Reg_Parse, &pContext.Reg_Parse))) {
+						if ((test = numeric_escape<uint8_t>(*ctx.Reg_Parse, &ctx.Reg_Parse))) {
 							last_value = test;
-						} else if ((test = literal_escape<uint8_t>(*pContext.Reg_Parse))) {
+						} else if ((test = literal_escape<uint8_t>(*ctx.Reg_Parse))) {
 							last_value = test;
-						} else if (shortcut_escape<CHECK_CLASS_ESCAPE>(*pContext.Reg_Parse, nullptr)) {
-							Raise<RegexError>("\\%c is not allowed as range operand", *pContext.Reg_Parse);
+						} else if (shortcut_escape<CHECK_CLASS_ESCAPE>(ctx, *ctx.Reg_Parse, nullptr)) {
+							Raise<RegexError>("\\%c is not allowed as range operand", *ctx.Reg_Parse);
 						} else {
-							Raise<RegexError>("\\%c is an invalid char class escape sequence", *pContext.Reg_Parse);
+							Raise<RegexError>("\\%c is an invalid char class escape sequence", *ctx.Reg_Parse);
 						}
 					} else {
-						last_value = U_CHAR_AT(pContext.Reg_Parse);
+						last_value = U_CHAR_AT(ctx.Reg_Parse);
 					}
 
-					if (pContext.Is_Case_Insensitive) {
+					if (ctx.Is_Case_Insensitive) {
 						second_value = static_cast<unsigned int>(safe_ctype<tolower>(second_value));
 						last_value   = static_cast<unsigned int>(safe_ctype<tolower>(last_value));
 					}
@@ -846,56 +843,56 @@ uint8_t *atom(int *flag_param, len_range &range_param) {
 					   was emitted by the previous iteration of while loop. */
 
 					for (; second_value <= last_value; second_value++) {
-						emit_class_byte(second_value);
+						emit_class_byte(ctx, second_value);
 					}
 
 					last_emit = static_cast<uint8_t>(last_value);
 
-					++pContext.Reg_Parse;
+					++ctx.Reg_Parse;
 
 				} // End class character range code.
-			} else if (*pContext.Reg_Parse == '\\') {
-				++pContext.Reg_Parse;
+			} else if (*ctx.Reg_Parse == '\\') {
+				++ctx.Reg_Parse;
 
-				if ((test = numeric_escape<uint8_t>(*pContext.Reg_Parse, &pContext.Reg_Parse)) != '\0') {
-					emit_class_byte(test);
+				if ((test = numeric_escape<uint8_t>(*ctx.Reg_Parse, &ctx.Reg_Parse)) != '\0') {
+					emit_class_byte(ctx, test);
 
 					last_emit = test;
-				} else if ((test = literal_escape<uint8_t>(*pContext.Reg_Parse)) != '\0') {
-					emit_byte(test);
+				} else if ((test = literal_escape<uint8_t>(*ctx.Reg_Parse)) != '\0') {
+					emit_byte(ctx, test);
 					last_emit = test;
-				} else if (shortcut_escape<CHECK_CLASS_ESCAPE>(*pContext.Reg_Parse, nullptr)) {
+				} else if (shortcut_escape<CHECK_CLASS_ESCAPE>(ctx, *ctx.Reg_Parse, nullptr)) {
 
-					if (pContext.Reg_Parse[1] == '-') {
+					if (ctx.Reg_Parse[1] == '-') {
 						/* Specifically disallow shortcut escapes as the start
 						   of a character class range (see comment above.) */
 
-						Raise<RegexError>("\\%c not allowed as range operand", *pContext.Reg_Parse);
+						Raise<RegexError>("\\%c not allowed as range operand", *ctx.Reg_Parse);
 					} else {
 						/* Emit the bytes that are part of the shortcut
 						   escape sequence's range (e.g. \d = 0123456789) */
 
-						shortcut_escape<EMIT_CLASS_BYTES>(*pContext.Reg_Parse, nullptr);
+						shortcut_escape<EMIT_CLASS_BYTES>(ctx, *ctx.Reg_Parse, nullptr);
 					}
 				} else {
-					Raise<RegexError>("\\%c is an invalid char class escape sequence", *pContext.Reg_Parse);
+					Raise<RegexError>("\\%c is an invalid char class escape sequence", *ctx.Reg_Parse);
 				}
 
-				++pContext.Reg_Parse;
+				++ctx.Reg_Parse;
 
 				// End of class escaped sequence code
 			} else {
-				emit_class_byte(*pContext.Reg_Parse); // Ordinary class character.
+				emit_class_byte(ctx, *ctx.Reg_Parse); // Ordinary class character.
 
-				last_emit = static_cast<uint8_t>(*pContext.Reg_Parse);
-				++pContext.Reg_Parse;
+				last_emit = static_cast<uint8_t>(*ctx.Reg_Parse);
+				++ctx.Reg_Parse;
 			}
-		} // End of while (Reg_Parse != Reg_Parse_End && *pContext.Reg_Parse != ']')
+		} // End of while (Reg_Parse != Reg_Parse_End && *ctx.Reg_Parse != ']')
 
-		if (*pContext.Reg_Parse != ']')
+		if (*ctx.Reg_Parse != ']')
 			Raise<RegexError>("missing right ']'");
 
-		emit_byte('\0');
+		emit_byte(ctx, '\0');
 
 		/* NOTE: it is impossible to specify an empty class.  This is
 		   because [] would be interpreted as "begin character class"
@@ -903,7 +900,7 @@ uint8_t *atom(int *flag_param, len_range &range_param) {
 		   delimiter (']').  Because of this, it is always safe to assume
 		   that a class HAS_WIDTH. */
 
-		++pContext.Reg_Parse;
+		++ctx.Reg_Parse;
 		*flag_param |= HAS_WIDTH | SIMPLE;
 		range_param.lower = 1;
 		range_param.upper = 1;
@@ -912,19 +909,19 @@ uint8_t *atom(int *flag_param, len_range &range_param) {
 	break; // End of character class code.
 
 	case '\\':
-		if ((ret_val = shortcut_escape<EMIT_NODE>(*pContext.Reg_Parse, flag_param))) {
+		if ((ret_val = shortcut_escape<EMIT_NODE>(ctx, *ctx.Reg_Parse, flag_param))) {
 
-			++pContext.Reg_Parse;
+			++ctx.Reg_Parse;
 			range_param.lower = 1;
 			range_param.upper = 1;
 			break;
 
-		} else if ((ret_val = back_ref<EMIT_NODE>(pContext.Reg_Parse, flag_param))) {
+		} else if ((ret_val = back_ref<EMIT_NODE>(ctx, ctx.Reg_Parse, flag_param))) {
 			/* Can't make any assumptions about a back-reference as to SIMPLE
 			   or HAS_WIDTH.  For example (^|<) is neither simple nor has
 			   width.  So we don't flip bits in flag_param here. */
 
-			++pContext.Reg_Parse;
+			++ctx.Reg_Parse;
 			// Back-references always have an unknown length
 			range_param.lower = -1;
 			range_param.upper = -1;
@@ -938,64 +935,64 @@ uint8_t *atom(int *flag_param, len_range &range_param) {
 		 * escapes. */
 		NEDIT_FALLTHROUGH();
 	default:
-		--pContext.Reg_Parse; /* If we fell through from the above code, we are now
+		--ctx.Reg_Parse; /* If we fell through from the above code, we are now
 							   * pointing at the back slash (\) character. */
 		{
 			const char *parse_save;
 			int len = 0;
 
-			if (pContext.Is_Case_Insensitive) {
-				ret_val = emit_node(SIMILAR);
+			if (ctx.Is_Case_Insensitive) {
+				ret_val = emit_node(ctx, SIMILAR);
 			} else {
-				ret_val = emit_node(EXACTLY);
+				ret_val = emit_node(ctx, EXACTLY);
 			}
 
 			/* Loop until we find a meta character, shortcut escape, back
 			 * reference, or end of regex string. */
 
-			for (; pContext.Reg_Parse != pContext.InputString.end() && !::strchr(pContext.Meta_Char, static_cast<int>(*pContext.Reg_Parse)); len++) {
+			for (; ctx.Reg_Parse != ctx.InputString.end() && !::strchr(ctx.Meta_Char, static_cast<int>(*ctx.Reg_Parse)); len++) {
 				/* Save where we are in case we have to back
 				   this character out. */
 
-				parse_save = pContext.Reg_Parse;
+				parse_save = ctx.Reg_Parse;
 
-				if (*pContext.Reg_Parse == '\\') {
-					++pContext.Reg_Parse; // Point to escaped character
+				if (*ctx.Reg_Parse == '\\') {
+					++ctx.Reg_Parse; // Point to escaped character
 
-					if ((test = numeric_escape<uint8_t>(*pContext.Reg_Parse, &pContext.Reg_Parse))) {
-						if (pContext.Is_Case_Insensitive) {
-							emit_byte(tolower(test));
+					if ((test = numeric_escape<uint8_t>(*ctx.Reg_Parse, &ctx.Reg_Parse))) {
+						if (ctx.Is_Case_Insensitive) {
+							emit_byte(ctx, tolower(test));
 						} else {
-							emit_byte(test);
+							emit_byte(ctx, test);
 						}
-					} else if ((test = literal_escape<uint8_t>(*pContext.Reg_Parse))) {
-						emit_byte(test);
-					} else if (back_ref<CHECK_ESCAPE>(pContext.Reg_Parse, nullptr)) {
+					} else if ((test = literal_escape<uint8_t>(*ctx.Reg_Parse))) {
+						emit_byte(ctx, test);
+					} else if (back_ref<CHECK_ESCAPE>(ctx, ctx.Reg_Parse, nullptr)) {
 						// Leave back reference for next 'atom' call
-						--pContext.Reg_Parse;
+						--ctx.Reg_Parse;
 						break;
-					} else if (shortcut_escape<CHECK_ESCAPE>(*pContext.Reg_Parse, nullptr)) {
+					} else if (shortcut_escape<CHECK_ESCAPE>(ctx, *ctx.Reg_Parse, nullptr)) {
 						// Leave shortcut escape for next 'atom' call
-						--pContext.Reg_Parse;
+						--ctx.Reg_Parse;
 						break;
 					} else {
 						/* None of the above calls generated an error message
 						   so generate our own here. */
 
-						Raise<RegexError>("\\%c is an invalid escape sequence", *pContext.Reg_Parse);
+						Raise<RegexError>("\\%c is an invalid escape sequence", *ctx.Reg_Parse);
 
 					}
 
-					++pContext.Reg_Parse;
+					++ctx.Reg_Parse;
 				} else {
 					// Ordinary character
-					if (pContext.Is_Case_Insensitive) {
-						emit_byte(tolower(*pContext.Reg_Parse));
+					if (ctx.Is_Case_Insensitive) {
+						emit_byte(ctx, tolower(*ctx.Reg_Parse));
 					} else {
-						emit_byte(*pContext.Reg_Parse);
+						emit_byte(ctx, *ctx.Reg_Parse);
 					}
 
-					++pContext.Reg_Parse;
+					++ctx.Reg_Parse;
 				}
 
 				/* If next regex token is a quantifier (?, +. *, or {m,n}) and
@@ -1005,13 +1002,13 @@ uint8_t *atom(int *flag_param, len_range &range_param) {
 				   have an EXACTLY node with an 'abc' operand followed by a STAR
 				   node followed by another EXACTLY node with a 'd' operand. */
 
-				if (isQuantifier(*pContext.Reg_Parse) && len > 0) {
-					pContext.Reg_Parse = parse_save; // Point to previous regex token.
+				if (isQuantifier(ctx, *ctx.Reg_Parse) && len > 0) {
+					ctx.Reg_Parse = parse_save; // Point to previous regex token.
 
-					if (pContext.FirstPass) {
-						pContext.Reg_Size--;
+					if (ctx.FirstPass) {
+						ctx.Reg_Size--;
 					} else {
-						pContext.Code.pop_back();
+						ctx.Code.pop_back();
 					}
 					break;
 				}
@@ -1028,7 +1025,7 @@ uint8_t *atom(int *flag_param, len_range &range_param) {
 			range_param.lower = len;
 			range_param.upper = len;
 
-			emit_byte('\0');
+			emit_byte(ctx, '\0');
 		}
 	}
 
@@ -1044,7 +1041,7 @@ uint8_t *atom(int *flag_param, len_range &range_param) {
  * body of the last branch. It might seem that this node could be
  * dispensed with entirely, but the endmarker role is not redundant.
  *----------------------------------------------------------------------*/
-uint8_t *piece(int *flag_param, len_range &range_param) {
+uint8_t *piece(ParseContext &ctx, int *flag_param, len_range &range_param) {
 
 	uint8_t *next;
 	uint32_t min_max[2] = {REG_ZERO, REG_INFINITY};
@@ -1056,20 +1053,20 @@ uint8_t *piece(int *flag_param, len_range &range_param) {
 	int digit_present[2] = {0, 0};
 	len_range range_local;
 
-	uint8_t *ret_val = atom(&flags_local, range_local);
+	uint8_t *ret_val = atom(ctx, &flags_local, range_local);
 
 	if (!ret_val)
 		return nullptr; // Something went wrong.
 
-	char op_code = *pContext.Reg_Parse;
+	char op_code = *ctx.Reg_Parse;
 
-	if (!isQuantifier(op_code)) {
+	if (!isQuantifier(ctx, op_code)) {
 		*flag_param = flags_local;
 		range_param = range_local;
 		return  ret_val;
 	} else if (op_code == '{') { // {n,m} quantifier present
 		brace_present++;
-		++pContext.Reg_Parse;
+		++ctx.Reg_Parse;
 
 		/* This code will allow specifying a counting range in any of the
 		   following forms:
@@ -1090,31 +1087,31 @@ uint8_t *piece(int *flag_param, len_range &range_param) {
 			   value for max and min of 65,535 is due to using 2 bytes to store
 			   each value in the compiled regex code. */
 
-			while (safe_ctype<isdigit>(*pContext.Reg_Parse)) {
+			while (safe_ctype<isdigit>(*ctx.Reg_Parse)) {
 				// (6553 * 10 + 6) > 65535 (16 bit max)
 
 				// NOTE(eteran): we're storing this into a 32-bit variable... so would be simpler
 				// to just convert the number using strtoul and just check if it's too large when
 				// we're done
 
-				if ((min_max[i] == 6553UL && (*pContext.Reg_Parse - '0') <= 5) || (min_max[i] <= 6552UL)) {
+				if ((min_max[i] == 6553UL && (*ctx.Reg_Parse - '0') <= 5) || (min_max[i] <= 6552UL)) {
 
-					min_max[i] = (min_max[i] * 10UL) + static_cast<uint32_t>(*pContext.Reg_Parse - '0');
-					++pContext.Reg_Parse;
+					min_max[i] = (min_max[i] * 10UL) + static_cast<uint32_t>(*ctx.Reg_Parse - '0');
+					++ctx.Reg_Parse;
 
 					digit_present[i]++;
 				} else {
 					if (i == 0) {
-						Raise<RegexError>("min operand of {%lu%c,???} > 65535", min_max[0], *pContext.Reg_Parse);
+						Raise<RegexError>("min operand of {%lu%c,???} > 65535", min_max[0], *ctx.Reg_Parse);
 					} else {
-						Raise<RegexError>("max operand of {%lu,%lu%c} > 65535", min_max[0], min_max[1], *pContext.Reg_Parse);
+						Raise<RegexError>("max operand of {%lu,%lu%c} > 65535", min_max[0], min_max[1], *ctx.Reg_Parse);
 					}
 				}
 			}
 
-			if (!comma_present && *pContext.Reg_Parse == ',') {
+			if (!comma_present && *ctx.Reg_Parse == ',') {
 				comma_present = true;
-				++pContext.Reg_Parse;
+				++ctx.Reg_Parse;
 			}
 		}
 
@@ -1140,7 +1137,7 @@ uint8_t *piece(int *flag_param, len_range &range_param) {
 		if (!comma_present)
 			min_max[1] = min_max[0]; // {x} means {x,x}
 
-		if (*pContext.Reg_Parse != '}') {
+		if (*ctx.Reg_Parse != '}') {
 			Raise<RegexError>("{m,n} specification missing right '}'");
 
 		} else if (min_max[1] != REG_INFINITY && min_max[0] > min_max[1]) {
@@ -1150,13 +1147,13 @@ uint8_t *piece(int *flag_param, len_range &range_param) {
 		}
 	}
 
-	++pContext.Reg_Parse;
+	++ctx.Reg_Parse;
 
 	// Check for a minimal matching (non-greedy or "lazy") specification.
 
-	if (*pContext.Reg_Parse == '?') {
+	if (*ctx.Reg_Parse == '?') {
 		lazy = true;
-		++pContext.Reg_Parse;
+		++ctx.Reg_Parse;
 	}
 
 	// Avoid overhead of counting if possible
@@ -1175,7 +1172,7 @@ uint8_t *piece(int *flag_param, len_range &range_param) {
 			*flag_param = flags_local;
 			range_param = range_local;
 			return ret_val;
-		} else if (pContext.Num_Braces > static_cast<int>(std::numeric_limits<uint8_t>::max())) {
+		} else if (ctx.Num_Braces > static_cast<int>(std::numeric_limits<uint8_t>::max())) {
 			Raise<RegexError>("number of {m,n} constructs > %d", UINT8_MAX);
 		}
 	}
@@ -1222,16 +1219,16 @@ uint8_t *piece(int *flag_param, len_range &range_param) {
 	 *---------------------------------------------------------------------*/
 
 	if (op_code == '*' && (flags_local & SIMPLE)) {
-		insert(lazy ? LAZY_STAR : STAR, ret_val, 0UL, 0UL, 0);
+		insert(ctx, lazy ? LAZY_STAR : STAR, ret_val, 0UL, 0UL, 0);
 
 	} else if (op_code == '+' && (flags_local & SIMPLE)) {
-		insert(lazy ? LAZY_PLUS : PLUS, ret_val, 0UL, 0UL, 0);
+		insert(ctx, lazy ? LAZY_PLUS : PLUS, ret_val, 0UL, 0UL, 0);
 
 	} else if (op_code == '?' && (flags_local & SIMPLE)) {
-		insert(lazy ? LAZY_QUESTION : QUESTION, ret_val, 0UL, 0UL, 0);
+		insert(ctx, lazy ? LAZY_QUESTION : QUESTION, ret_val, 0UL, 0UL, 0);
 
 	} else if (op_code == '{' && (flags_local & SIMPLE)) {
-		insert(lazy ? LAZY_BRACE : BRACE, ret_val, min_max[0], min_max[1], 0);
+		insert(ctx, lazy ? LAZY_BRACE : BRACE, ret_val, min_max[0], min_max[1], 0);
 
 	} else if ((op_code == '*' || op_code == '+') && lazy) {
 		/*  Node structure for (x)*?    Node structure for (x)+? construct.
@@ -1248,21 +1245,21 @@ uint8_t *piece(int *flag_param, len_range &range_param) {
 		 *
 		 */
 
-		tail(ret_val, emit_node(BACK));              // 1
-		insert(BRANCH, ret_val, 0UL, 0UL, 0);        // 2,4
-		insert(NOTHING, ret_val, 0UL, 0UL, 0);       // 3
+		tail(ctx, ret_val, emit_node(ctx, BACK));              // 1
+		insert(ctx, BRANCH, ret_val, 0UL, 0UL, 0);        // 2,4
+		insert(ctx, NOTHING, ret_val, 0UL, 0UL, 0);       // 3
 
-		next = emit_node(NOTHING);                   // 2,3
+		next = emit_node(ctx, NOTHING);                   // 2,3
 
-		offset_tail(ret_val, NODE_SIZE, next);        // 2
-		tail(ret_val, next);                          // 3
-		insert(BRANCH, ret_val, 0UL, 0UL, 0);         // 4,5
-		tail(ret_val, ret_val + (2 * NODE_SIZE));     // 4
-		offset_tail(ret_val, 3 * NODE_SIZE, ret_val); // 5
+		offset_tail(ctx, ret_val, NODE_SIZE, next);        // 2
+		tail(ctx, ret_val, next);                          // 3
+		insert(ctx, BRANCH, ret_val, 0UL, 0UL, 0);         // 4,5
+		tail(ctx, ret_val, ret_val + (2 * NODE_SIZE));     // 4
+		offset_tail(ctx, ret_val, 3 * NODE_SIZE, ret_val); // 5
 
 		if (op_code == '+') {
-			insert(NOTHING, ret_val, 0UL, 0UL, 0);    // 6
-			tail(ret_val, ret_val + (4 * NODE_SIZE)); // 6
+			insert(ctx, NOTHING, ret_val, 0UL, 0UL, 0);    // 6
+			tail(ctx, ret_val, ret_val + (4 * NODE_SIZE)); // 6
 		}
 	} else if (op_code == '*') {
 		/* Node structure for (x)* construct.
@@ -1273,11 +1270,11 @@ uint8_t *piece(int *flag_param, len_range &range_param) {
 		 *       \__3_______|  4
 		 */
 
-		insert(BRANCH, ret_val, 0UL, 0UL, 0);             // 1,3
-		offset_tail(ret_val, NODE_SIZE, emit_node(BACK)); // 2
-		offset_tail(ret_val, NODE_SIZE, ret_val);         // 1
-		tail(ret_val, emit_node(BRANCH));                 // 3
-		tail(ret_val, emit_node(NOTHING));                // 4
+		insert(ctx, BRANCH, ret_val, 0UL, 0UL, 0);             // 1,3
+		offset_tail(ctx, ret_val, NODE_SIZE, emit_node(ctx, BACK)); // 2
+		offset_tail(ctx, ret_val, NODE_SIZE, ret_val);         // 1
+		tail(ctx, ret_val, emit_node(ctx, BRANCH));                 // 3
+		tail(ctx, ret_val, emit_node(ctx, NOTHING));                // 4
 	} else if (op_code == '+') {
 		/* Node structure for (x)+ construct.
 		 *
@@ -1288,12 +1285,12 @@ uint8_t *piece(int *flag_param, len_range &range_param) {
 		 *          1     3    4
 		 */
 
-		next = emit_node(BRANCH); // 1
+		next = emit_node(ctx, BRANCH); // 1
 
-		tail(ret_val, next);               // 1
-		tail(emit_node(BACK), ret_val);    // 2
-		tail(next, emit_node(BRANCH));     // 3
-		tail(ret_val, emit_node(NOTHING)); // 4
+		tail(ctx, ret_val, next);               // 1
+		tail(ctx, emit_node(ctx, BACK), ret_val);    // 2
+		tail(ctx, next, emit_node(ctx, BRANCH));     // 3
+		tail(ctx, ret_val, emit_node(ctx, NOTHING)); // 4
 	} else if (op_code == '?' && lazy) {
 		/* Node structure for (x)?? construct.
 		 *       _4__        1_
@@ -1303,16 +1300,16 @@ uint8_t *piece(int *flag_param, len_range &range_param) {
 		 *          \_____3____|
 		 */
 
-		insert(BRANCH, ret_val, 0UL, 0UL, 0);  // 2,4
-		insert(NOTHING, ret_val, 0UL, 0UL, 0); // 3
+		insert(ctx, BRANCH, ret_val, 0UL, 0UL, 0);  // 2,4
+		insert(ctx, NOTHING, ret_val, 0UL, 0UL, 0); // 3
 
-		next = emit_node(NOTHING); // 1,2,3
+		next = emit_node(ctx, NOTHING); // 1,2,3
 
-		offset_tail(ret_val, 2 * NODE_SIZE, next);  // 1
-		offset_tail(ret_val, NODE_SIZE, next);      // 2
-		tail(ret_val, next);                        // 3
-		insert(BRANCH, ret_val, 0UL, 0UL, 0);       // 4
-		tail(ret_val, (ret_val + (2 * NODE_SIZE))); // 4
+		offset_tail(ctx, ret_val, 2 * NODE_SIZE, next);  // 1
+		offset_tail(ctx, ret_val, NODE_SIZE, next);      // 2
+		tail(ctx, ret_val, next);                        // 3
+		insert(ctx, BRANCH, ret_val, 0UL, 0UL, 0);       // 4
+		tail(ctx, ret_val, (ret_val + (2 * NODE_SIZE))); // 4
 
 	} else if (op_code == '?') {
 		/* Node structure for (x)? construct.
@@ -1322,13 +1319,13 @@ uint8_t *piece(int *flag_param, len_range &range_param) {
 		 *             \__3_|
 		 */
 
-		insert(BRANCH, ret_val, 0UL, 0UL, 0); // 1
-		tail(ret_val, emit_node(BRANCH));     // 1
+		insert(ctx, BRANCH, ret_val, 0UL, 0UL, 0); // 1
+		tail(ctx, ret_val, emit_node(ctx, BRANCH));     // 1
 
-		next = emit_node(NOTHING); // 2,3
+		next = emit_node(ctx, NOTHING); // 2,3
 
-		tail(ret_val, next);                   // 2
-		offset_tail(ret_val, NODE_SIZE, next); // 3
+		tail(ctx, ret_val, next);                   // 2
+		offset_tail(ctx, ret_val, NODE_SIZE, next); // 3
 	} else if (op_code == '{' && min_max[0] == min_max[1]) {
 		/* Node structure for (x){m}, (x){m}?, (x){m,m}, or (x){m,m}? constructs.
 		 * Note that minimal and maximal matching mean the same thing when we
@@ -1341,16 +1338,16 @@ uint8_t *piece(int *flag_param, len_range &range_param) {
 		 *     5              4
 		 */
 
-		tail(ret_val, emit_special(INC_COUNT, 0UL, pContext.Num_Braces));         // 1
-		tail(ret_val, emit_special(TEST_COUNT, min_max[0], pContext.Num_Braces)); // 2
-		tail(emit_node(BACK), ret_val);                                           // 3
-		tail(ret_val, emit_node(NOTHING));                                        // 4
+		tail(ctx, ret_val, emit_special(ctx, INC_COUNT, 0UL, ctx.Num_Braces));         // 1
+		tail(ctx, ret_val, emit_special(ctx, TEST_COUNT, min_max[0], ctx.Num_Braces)); // 2
+		tail(ctx, emit_node(ctx, BACK), ret_val);                                           // 3
+		tail(ctx, ret_val, emit_node(ctx, NOTHING));                                        // 4
 
-		next = insert(INIT_COUNT, ret_val, 0UL, 0UL, pContext.Num_Braces);        // 5
+		next = insert(ctx, INIT_COUNT, ret_val, 0UL, 0UL, ctx.Num_Braces);        // 5
 
-		tail(ret_val, next); // 5
+		tail(ctx, ret_val, next); // 5
 
-		pContext.Num_Braces++;
+		ctx.Num_Braces++;
 	} else if (op_code == '{' && lazy) {
 		if (min_max[0] == REG_ZERO && min_max[1] != REG_INFINITY) {
 			/* Node structure for (x){0,n}? or {,n}? construct.
@@ -1363,26 +1360,26 @@ uint8_t *piece(int *flag_param, len_range &range_param) {
 			 *            \______5____________|
 			 */
 
-			tail(ret_val, emit_special(INC_COUNT, 0UL, pContext.Num_Braces)); // 1
+			tail(ctx, ret_val, emit_special(ctx, INC_COUNT, 0UL, ctx.Num_Braces)); // 1
 
-			next = emit_special(TEST_COUNT, min_max[0], pContext.Num_Braces); // 2,7
+			next = emit_special(ctx, TEST_COUNT, min_max[0], ctx.Num_Braces); // 2,7
 
-			tail(ret_val, next);                                       // 2
-			insert(BRANCH,  ret_val, 0UL, 0UL, pContext.Num_Braces);   // 4,6
-			insert(NOTHING, ret_val, 0UL, 0UL, pContext.Num_Braces);   // 5
-			insert(BRANCH,  ret_val, 0UL, 0UL, pContext.Num_Braces);   // 3,4,8
-			tail(emit_node(BACK), ret_val);                            // 3
-			tail(ret_val, ret_val + (2 * NODE_SIZE));                  // 4
+			tail(ctx, ret_val, next);                                       // 2
+			insert(ctx, BRANCH,  ret_val, 0UL, 0UL, ctx.Num_Braces);   // 4,6
+			insert(ctx, NOTHING, ret_val, 0UL, 0UL, ctx.Num_Braces);   // 5
+			insert(ctx, BRANCH,  ret_val, 0UL, 0UL, ctx.Num_Braces);   // 3,4,8
+			tail(ctx, emit_node(ctx, BACK), ret_val);                            // 3
+			tail(ctx, ret_val, ret_val + (2 * NODE_SIZE));                  // 4
 
-			next = emit_node(NOTHING); // 5,6,7
+			next = emit_node(ctx, NOTHING); // 5,6,7
 
-			offset_tail(ret_val, NODE_SIZE, next);     // 5
-			offset_tail(ret_val, 2 * NODE_SIZE, next); // 6
-			offset_tail(ret_val, 3 * NODE_SIZE, next); // 7
+			offset_tail(ctx, ret_val, NODE_SIZE, next);     // 5
+			offset_tail(ctx, ret_val, 2 * NODE_SIZE, next); // 6
+			offset_tail(ctx, ret_val, 3 * NODE_SIZE, next); // 7
 
-			next = insert(INIT_COUNT, ret_val, 0UL, 0UL, pContext.Num_Braces); // 8
+			next = insert(ctx, INIT_COUNT, ret_val, 0UL, 0UL, ctx.Num_Braces); // 8
 
-			tail(ret_val, next); // 8
+			tail(ctx, ret_val, next); // 8
 
 		} else if (min_max[0] > REG_ZERO && min_max[1] == REG_INFINITY) {
 			/* Node structure for (x){m,}? construct.
@@ -1396,25 +1393,25 @@ uint8_t *piece(int *flag_param, len_range &range_param) {
 			 *            \_______6______________|
 			 */
 
-			tail(ret_val, emit_special(INC_COUNT, 0UL, pContext.Num_Braces)); // 1
+			tail(ctx, ret_val, emit_special(ctx, INC_COUNT, 0UL, ctx.Num_Braces)); // 1
 
-			next = emit_special(TEST_COUNT, min_max[0], pContext.Num_Braces); // 2,4
+			next = emit_special(ctx, TEST_COUNT, min_max[0], ctx.Num_Braces); // 2,4
 
-			tail(ret_val, next);                   // 2
-			tail(emit_node(BACK), ret_val);        // 3
-			tail(ret_val, emit_node(BACK));        // 4
-			insert(BRANCH,  ret_val, 0UL, 0UL, 0); // 5,7
-			insert(NOTHING, ret_val, 0UL, 0UL, 0); // 6
+			tail(ctx, ret_val, next);                   // 2
+			tail(ctx, emit_node(ctx, BACK), ret_val);        // 3
+			tail(ctx, ret_val, emit_node(ctx, BACK));        // 4
+			insert(ctx, BRANCH,  ret_val, 0UL, 0UL, 0); // 5,7
+			insert(ctx, NOTHING, ret_val, 0UL, 0UL, 0); // 6
 
-			next = emit_node(NOTHING); // 5,6
+			next = emit_node(ctx, NOTHING); // 5,6
 
-			offset_tail(ret_val, NODE_SIZE, next);                      // 5
-			tail(ret_val, next);                                        // 6
-			insert(BRANCH, ret_val, 0UL, 0UL, 0);                       // 7,8
-			tail(ret_val, ret_val + (2 * NODE_SIZE));                   // 7
-			offset_tail(ret_val, 3 * NODE_SIZE, ret_val);               // 8
-			insert(INIT_COUNT, ret_val, 0UL, 0UL, pContext.Num_Braces); // 9
-			tail(ret_val, ret_val + INDEX_SIZE + (4 * NODE_SIZE));      // 9
+			offset_tail(ctx, ret_val, NODE_SIZE, next);                      // 5
+			tail(ctx, ret_val, next);                                        // 6
+			insert(ctx, BRANCH, ret_val, 0UL, 0UL, 0);                       // 7,8
+			tail(ctx, ret_val, ret_val + (2 * NODE_SIZE));                   // 7
+			offset_tail(ctx, ret_val, 3 * NODE_SIZE, ret_val);               // 8
+			insert(ctx, INIT_COUNT, ret_val, 0UL, 0UL, ctx.Num_Braces); // 9
+			tail(ctx, ret_val, ret_val + INDEX_SIZE + (4 * NODE_SIZE));      // 9
 
 		} else {
 			/* Node structure for (x){m,n}? construct.
@@ -1429,32 +1426,32 @@ uint8_t *piece(int *flag_param, len_range &range_param) {
 			 *             \_______5_________________|
 			 */
 
-			tail(ret_val, emit_special(INC_COUNT, 0UL, pContext.Num_Braces)); // 1
+			tail(ctx, ret_val, emit_special(ctx, INC_COUNT, 0UL, ctx.Num_Braces)); // 1
 
-			next = emit_special(TEST_COUNT, min_max[1], pContext.Num_Braces); // 2,7
+			next = emit_special(ctx, TEST_COUNT, min_max[1], ctx.Num_Braces); // 2,7
 
-			tail(ret_val, next); // 2
+			tail(ctx, ret_val, next); // 2
 
-			next = emit_special(TEST_COUNT, min_max[0], pContext.Num_Braces); // 4
+			next = emit_special(ctx, TEST_COUNT, min_max[0], ctx.Num_Braces); // 4
 
-			tail(emit_node(BACK), ret_val);        // 3
-			tail(next, emit_node(BACK));           // 4
-			insert(BRANCH, ret_val, 0UL, 0UL, 0);  // 6,8
-			insert(NOTHING, ret_val, 0UL, 0UL, 0); // 5
-			insert(BRANCH, ret_val, 0UL, 0UL, 0);  // 8,9
+			tail(ctx, emit_node(ctx, BACK), ret_val);        // 3
+			tail(ctx, next, emit_node(ctx, BACK));           // 4
+			insert(ctx, BRANCH, ret_val, 0UL, 0UL, 0);  // 6,8
+			insert(ctx, NOTHING, ret_val, 0UL, 0UL, 0); // 5
+			insert(ctx, BRANCH, ret_val, 0UL, 0UL, 0);  // 8,9
 
-			next = emit_node(NOTHING); // 5,6,7
+			next = emit_node(ctx, NOTHING); // 5,6,7
 
-			offset_tail(ret_val, NODE_SIZE, next);                      // 5
-			offset_tail(ret_val, 2 * NODE_SIZE, next);                  // 6
-			offset_tail(ret_val, 3 * NODE_SIZE, next);                  // 7
-			tail(ret_val, ret_val + (2 * NODE_SIZE));                   // 8
-			offset_tail(next, -NODE_SIZE, ret_val);                     // 9
-			insert(INIT_COUNT, ret_val, 0UL, 0UL, pContext.Num_Braces); // 10
-			tail(ret_val, ret_val + INDEX_SIZE + (4 * NODE_SIZE));      // 10
+			offset_tail(ctx, ret_val, NODE_SIZE, next);                      // 5
+			offset_tail(ctx, ret_val, 2 * NODE_SIZE, next);                  // 6
+			offset_tail(ctx, ret_val, 3 * NODE_SIZE, next);                  // 7
+			tail(ctx, ret_val, ret_val + (2 * NODE_SIZE));                   // 8
+			offset_tail(ctx, next, -NODE_SIZE, ret_val);                     // 9
+			insert(ctx, INIT_COUNT, ret_val, 0UL, 0UL, ctx.Num_Braces); // 10
+			tail(ctx, ret_val, ret_val + INDEX_SIZE + (4 * NODE_SIZE));      // 10
 		}
 
-		pContext.Num_Braces++;
+		ctx.Num_Braces++;
 	} else if (op_code == '{') {
 		if (min_max[0] == REG_ZERO && min_max[1] != REG_INFINITY) {
 			/* Node structure for (x){0,n} or (x){,n} construct.
@@ -1467,23 +1464,23 @@ uint8_t *piece(int *flag_param, len_range &range_param) {
 			 *    7   \________4________|
 			 */
 
-			tail(ret_val, emit_special(INC_COUNT, 0UL, pContext.Num_Braces)); // 1
+			tail(ctx, ret_val, emit_special(ctx, INC_COUNT, 0UL, ctx.Num_Braces)); // 1
 
-			next = emit_special(TEST_COUNT, min_max[1], pContext.Num_Braces); // 2,6
+			next = emit_special(ctx, TEST_COUNT, min_max[1], ctx.Num_Braces); // 2,6
 
-			tail(ret_val, next);                  // 2
-			insert(BRANCH, ret_val, 0UL, 0UL, 0); // 3,4,7
-			tail(emit_node(BACK), ret_val);       // 3
+			tail(ctx, ret_val, next);                  // 2
+			insert(ctx, BRANCH, ret_val, 0UL, 0UL, 0); // 3,4,7
+			tail(ctx, emit_node(ctx, BACK), ret_val);       // 3
 
-			next = emit_node(BRANCH); // 4,5
+			next = emit_node(ctx, BRANCH); // 4,5
 
-			tail(ret_val, next);                   // 4
-			tail(next, emit_node(NOTHING));        // 5,6
-			offset_tail(ret_val, NODE_SIZE, next); // 6
+			tail(ctx, ret_val, next);                   // 4
+			tail(ctx, next, emit_node(ctx, NOTHING));        // 5,6
+			offset_tail(ctx, ret_val, NODE_SIZE, next); // 6
 
-			next = insert(INIT_COUNT, ret_val, 0UL, 0UL, pContext.Num_Braces); // 7
+			next = insert(ctx, INIT_COUNT, ret_val, 0UL, 0UL, ctx.Num_Braces); // 7
 
-			tail(ret_val, next); // 7
+			tail(ctx, ret_val, next); // 7
 
 		} else if (min_max[0] > REG_ZERO && min_max[1] == REG_INFINITY) {
 			/* Node structure for (x){m,} construct.
@@ -1496,24 +1493,24 @@ uint8_t *piece(int *flag_param, len_range &range_param) {
 			 *        \__________6__________|
 			 */
 
-			tail(ret_val, emit_special(INC_COUNT, 0UL, pContext.Num_Braces)); // 1
+			tail(ctx, ret_val, emit_special(ctx, INC_COUNT, 0UL, ctx.Num_Braces)); // 1
 
-			next = emit_special(TEST_COUNT, min_max[0], pContext.Num_Braces); // 2
+			next = emit_special(ctx, TEST_COUNT, min_max[0], ctx.Num_Braces); // 2
 
-			tail(ret_val, next);                  // 2
-			tail(emit_node(BACK), ret_val);       // 3
-			insert(BRANCH, ret_val, 0UL, 0UL, 0); // 4,6
+			tail(ctx, ret_val, next);                  // 2
+			tail(ctx, emit_node(ctx, BACK), ret_val);       // 3
+			insert(ctx, BRANCH, ret_val, 0UL, 0UL, 0); // 4,6
 
-			next = emit_node(BACK); // 4
+			next = emit_node(ctx, BACK); // 4
 
-			tail(next, ret_val);                   // 4
-			offset_tail(ret_val, NODE_SIZE, next); // 5
-			tail(ret_val, emit_node(BRANCH));      // 6
-			tail(ret_val, emit_node(NOTHING));     // 7
+			tail(ctx, next, ret_val);                   // 4
+			offset_tail(ctx, ret_val, NODE_SIZE, next); // 5
+			tail(ctx, ret_val, emit_node(ctx, BRANCH));      // 6
+			tail(ctx, ret_val, emit_node(ctx, NOTHING));     // 7
 
-			insert(INIT_COUNT, ret_val, 0UL, 0UL, pContext.Num_Braces); // 8
+			insert(ctx, INIT_COUNT, ret_val, 0UL, 0UL, ctx.Num_Braces); // 8
 
-			tail(ret_val, ret_val + INDEX_SIZE + (2 * NODE_SIZE)); // 8
+			tail(ctx, ret_val, ret_val + INDEX_SIZE + (2 * NODE_SIZE)); // 8
 
 		} else {
 			/* Node structure for (x){m,n} construct.
@@ -1527,33 +1524,33 @@ uint8_t *piece(int *flag_param, len_range &range_param) {
 			 *         \_________5_____________|
 			 */
 
-			tail(ret_val, emit_special(INC_COUNT, 0UL, pContext.Num_Braces)); // 1
+			tail(ctx, ret_val, emit_special(ctx, INC_COUNT, 0UL, ctx.Num_Braces)); // 1
 
-			next = emit_special(TEST_COUNT, min_max[1], pContext.Num_Braces); // 2,4
+			next = emit_special(ctx, TEST_COUNT, min_max[1], ctx.Num_Braces); // 2,4
 
-			tail(ret_val, next); // 2
+			tail(ctx, ret_val, next); // 2
 
-			next = emit_special(TEST_COUNT, min_max[0], pContext.Num_Braces); // 4
+			next = emit_special(ctx, TEST_COUNT, min_max[0], ctx.Num_Braces); // 4
 
-			tail(emit_node(BACK), ret_val);       // 3
-			tail(next, emit_node(BACK));          // 4
-			insert(BRANCH, ret_val, 0UL, 0UL, 0); // 5,6
+			tail(ctx, emit_node(ctx, BACK), ret_val);       // 3
+			tail(ctx, next, emit_node(ctx, BACK));          // 4
+			insert(ctx, BRANCH, ret_val, 0UL, 0UL, 0); // 5,6
 
-			next = emit_node(BRANCH); // 5,8
+			next = emit_node(ctx, BRANCH); // 5,8
 
-			tail(ret_val, next);                    // 5
-			offset_tail(next, -NODE_SIZE, ret_val); // 6
+			tail(ctx, ret_val, next);                    // 5
+			offset_tail(ctx, next, -NODE_SIZE, ret_val); // 6
 
-			next = emit_node(NOTHING); // 7,8
+			next = emit_node(ctx, NOTHING); // 7,8
 
-			offset_tail(ret_val, NODE_SIZE, next); // 7
+			offset_tail(ctx, ret_val, NODE_SIZE, next); // 7
 
-			offset_tail(next, -NODE_SIZE, next);                        // 8
-			insert(INIT_COUNT, ret_val, 0UL, 0UL, pContext.Num_Braces); // 9
-			tail(ret_val, ret_val + INDEX_SIZE + (2 * NODE_SIZE));      // 9
+			offset_tail(ctx, next, -NODE_SIZE, next);                        // 8
+			insert(ctx, INIT_COUNT, ret_val, 0UL, 0UL, ctx.Num_Braces); // 9
+			tail(ctx, ret_val, ret_val + INDEX_SIZE + (2 * NODE_SIZE));      // 9
 		}
 
-		pContext.Num_Braces++;
+		ctx.Num_Braces++;
 	} else {
 		/* We get here if the IS_QUANTIFIER macro is not coordinated properly
 		   with this function. */
@@ -1561,11 +1558,11 @@ uint8_t *piece(int *flag_param, len_range &range_param) {
 		Raise<RegexError>("internal error #2, 'piece'");
 	}
 
-	if (isQuantifier(*pContext.Reg_Parse)) {
+	if (isQuantifier(ctx, *ctx.Reg_Parse)) {
 		if (op_code == '{') {
-			Raise<RegexError>("nested quantifiers, {m,n}%c", *pContext.Reg_Parse);
+			Raise<RegexError>("nested quantifiers, {m,n}%c", *ctx.Reg_Parse);
 		} else {
-			Raise<RegexError>("nested quantifiers, %c%c", op_code, *pContext.Reg_Parse);
+			Raise<RegexError>("nested quantifiers, %c%c", op_code, *ctx.Reg_Parse);
 		}
 	}
 
@@ -1578,7 +1575,7 @@ uint8_t *piece(int *flag_param, len_range &range_param) {
  * Processes one alternative of an '|' operator.  Connects the NEXT
  * pointers of each regex atom together sequentialy.
  *----------------------------------------------------------------------*/
-uint8_t *alternative(int *flag_param, len_range &range_param) {
+uint8_t *alternative(ParseContext &ctx, int *flag_param, len_range &range_param) {
 
 	uint8_t *ret_val;
 	uint8_t *chain;
@@ -1590,14 +1587,14 @@ uint8_t *alternative(int *flag_param, len_range &range_param) {
 	range_param.lower = 0; // Idem
 	range_param.upper = 0;
 
-	ret_val = emit_node(BRANCH);
+	ret_val = emit_node(ctx, BRANCH);
 	chain = nullptr;
 
 	/* Loop until we hit the start of the next alternative, the end of this set
 	   of alternatives (end of parentheses), or the end of the regex. */
 
-	while (*pContext.Reg_Parse != '|' && *pContext.Reg_Parse != ')' && pContext.Reg_Parse != pContext.InputString.end()) {
-		latest = piece(&flags_local, range_local);
+	while (*ctx.Reg_Parse != '|' && *ctx.Reg_Parse != ')' && ctx.Reg_Parse != ctx.InputString.end()) {
+		latest = piece(ctx, &flags_local, range_local);
 
 		if(!latest)
 			return nullptr; // Something went wrong.
@@ -1613,14 +1610,14 @@ uint8_t *alternative(int *flag_param, len_range &range_param) {
 		}
 
 		if (chain) { // Connect the regex atoms together sequentialy.
-			tail(chain, latest);
+			tail(ctx, chain, latest);
 		}
 
 		chain = latest;
 	}
 
 	if(!chain) { // Loop ran zero times.
-		emit_node(NOTHING);
+		emit_node(ctx, NOTHING);
 	}
 
 	return ret_val;
@@ -1637,7 +1634,7 @@ uint8_t *alternative(int *flag_param, len_range &range_param) {
  * expression is a trifle forced, but the need to tie the tails of the  *
  * branches to what follows makes it hard to avoid.                     *
  *----------------------------------------------------------------------*/
-uint8_t *chunk(int paren, int *flag_param, len_range &range_param) {
+uint8_t *chunk(ParseContext &ctx, int paren, int *flag_param, len_range &range_param) {
 
 	uint8_t *ret_val = nullptr;
 	uint8_t *ender = nullptr;
@@ -1645,8 +1642,8 @@ uint8_t *chunk(int paren, int *flag_param, len_range &range_param) {
 	int flags_local;
 	bool first = true;
 	int zero_width;
-	const bool old_sensitive = pContext.Is_Case_Insensitive;
-	const bool old_newline   = pContext.Match_Newline;
+	const bool old_sensitive = ctx.Is_Case_Insensitive;
+	const bool old_newline   = ctx.Match_Newline;
 
 	len_range range_local;
 	bool look_only = false;
@@ -1658,36 +1655,36 @@ uint8_t *chunk(int paren, int *flag_param, len_range &range_param) {
 	// Make an OPEN node, if parenthesized.
 
 	if (paren == PAREN) {
-		if (pContext.Total_Paren >= NSUBEXP) {
+		if (ctx.Total_Paren >= NSUBEXP) {
 			Raise<RegexError>("number of ()'s > %d", static_cast<int>(NSUBEXP));
 		}
 
-		this_paren = pContext.Total_Paren;
-		pContext.Total_Paren++;
-		ret_val = emit_node(OPEN + this_paren);
+		this_paren = ctx.Total_Paren;
+		ctx.Total_Paren++;
+		ret_val = emit_node(ctx, OPEN + this_paren);
 	} else if (paren == POS_AHEAD_OPEN || paren == NEG_AHEAD_OPEN) {
 		*flag_param = WORST; // Look ahead is zero width.
 		look_only = true;
-		ret_val = emit_node(paren);
+		ret_val = emit_node(ctx, paren);
 	} else if (paren == POS_BEHIND_OPEN || paren == NEG_BEHIND_OPEN) {
 		*flag_param = WORST; // Look behind is zero width.
 		look_only = true;
 		// We'll overwrite the zero length later on, so we save the ptr
-		ret_val = emit_special(paren, 0, 0);
+		ret_val = emit_special(ctx, paren, 0, 0);
 		emit_look_behind_bounds = ret_val + NODE_SIZE;
 	} else if (paren == INSENSITIVE) {
-		pContext.Is_Case_Insensitive = true;
+		ctx.Is_Case_Insensitive = true;
 	} else if (paren == SENSITIVE) {
-		pContext.Is_Case_Insensitive = false;
+		ctx.Is_Case_Insensitive = false;
 	} else if (paren == NEWLINE) {
-		pContext.Match_Newline = true;
+		ctx.Match_Newline = true;
 	} else if (paren == NO_NEWLINE) {
-		pContext.Match_Newline = false;
+		ctx.Match_Newline = false;
 	}
 
 	// Pick up the branches, linking them together.
 	do {
-		uint8_t *const this_branch = alternative(&flags_local, range_local);
+		uint8_t *const this_branch = alternative(ctx, &flags_local, range_local);
 		if (!this_branch) {
 			return nullptr;
 		}
@@ -1712,7 +1709,7 @@ uint8_t *chunk(int paren, int *flag_param, len_range &range_param) {
 			}
 		}
 
-		tail(ret_val, this_branch); // Connect BRANCH -> BRANCH.
+		tail(ctx, ret_val, this_branch); // Connect BRANCH -> BRANCH.
 
 		/* If any alternative could be zero width, consider the whole
 		   parenthisized thing to be zero width. */
@@ -1722,39 +1719,39 @@ uint8_t *chunk(int paren, int *flag_param, len_range &range_param) {
 
 		// Are there more alternatives to process?
 
-		if (*pContext.Reg_Parse != '|')
+		if (*ctx.Reg_Parse != '|')
 			break;
 
-		++pContext.Reg_Parse;
+		++ctx.Reg_Parse;
 	} while (true);
 
 	// Make a closing node, and hook it on the end.
 
 	if (paren == PAREN) {
-		ender = emit_node(CLOSE + this_paren);
+		ender = emit_node(ctx, CLOSE + this_paren);
 	} else if (paren == NO_PAREN) {
-		ender = emit_node(END);
+		ender = emit_node(ctx, END);
 	} else if (paren == POS_AHEAD_OPEN || paren == NEG_AHEAD_OPEN) {
-		ender = emit_node(LOOK_AHEAD_CLOSE);
+		ender = emit_node(ctx, LOOK_AHEAD_CLOSE);
 	} else if (paren == POS_BEHIND_OPEN || paren == NEG_BEHIND_OPEN) {
-		ender = emit_node(LOOK_BEHIND_CLOSE);
+		ender = emit_node(ctx, LOOK_BEHIND_CLOSE);
 	} else {
-		ender = emit_node(NOTHING);
+		ender = emit_node(ctx, NOTHING);
 	}
 
-	tail(ret_val, ender);
+	tail(ctx, ret_val, ender);
 
 	// Hook the tails of the branch alternatives to the closing node.
-	for (uint8_t *this_branch = ret_val; this_branch != nullptr; this_branch = next_ptr(this_branch)) {
-		branch_tail(this_branch, NODE_SIZE, ender);
+	for (uint8_t *this_branch = ret_val; this_branch != nullptr; this_branch = next_ptr(ctx, this_branch)) {
+		branch_tail(ctx, this_branch, NODE_SIZE, ender);
 	}
 
 	// Check for proper termination.
 
-	if (paren != NO_PAREN && *pContext.Reg_Parse++ != ')') {
+	if (paren != NO_PAREN && *ctx.Reg_Parse++ != ')') {
 		Raise<RegexError>("missing right parenthesis ')'");
-	} else if (paren == NO_PAREN && pContext.Reg_Parse != pContext.InputString.end()) {
-		if (*pContext.Reg_Parse == ')') {
+	} else if (paren == NO_PAREN && ctx.Reg_Parse != ctx.InputString.end()) {
+		if (*ctx.Reg_Parse == ')') {
 			Raise<RegexError>("missing left parenthesis '('");
 		} else {
 			Raise<RegexError>("junk on end"); // "Can't happen" - NOTREACHED
@@ -1771,7 +1768,12 @@ uint8_t *chunk(int paren, int *flag_param, len_range &range_param) {
 			Raise<RegexError>("max. look-behind size is too large (>65535)");
 		}
 
-		if (!pContext.FirstPass) {
+		/* Look-behinds nested in each other (or in look-aheads) can reach back
+		   no further than all of them together, plus the character in front
+		   of each for the boundary tests */
+		ctx.Look_Behind_Size += static_cast<size_t>(range_param.upper) + 1;
+
+		if (!ctx.FirstPass) {
 			*emit_look_behind_bounds++ = PUT_OFFSET_L(range_param.lower);
 			*emit_look_behind_bounds++ = PUT_OFFSET_R(range_param.lower);
 			*emit_look_behind_bounds++ = PUT_OFFSET_L(range_param.upper);
@@ -1790,25 +1792,25 @@ uint8_t *chunk(int paren, int *flag_param, len_range &range_param) {
 	/* Set a bit in Closed_Parens to let future calls to function 'back_ref'
 	   know that we have closed this set of parentheses. */
 
-	if (paren == PAREN && this_paren < pContext.Closed_Parens.size()) {
-		pContext.Closed_Parens[this_paren] = true;
+	if (paren == PAREN && this_paren < ctx.Closed_Parens.size()) {
+		ctx.Closed_Parens[this_paren] = true;
 
 		/* Determine if a parenthesized expression is modified by a quantifier
 		   that can have zero width. */
 
-		if (*pContext.Reg_Parse == '?' || *pContext.Reg_Parse == '*') {
+		if (*ctx.Reg_Parse == '?' || *ctx.Reg_Parse == '*') {
 			zero_width++;
-		} else if (*pContext.Reg_Parse == '{' && pContext.Brace_Char == '{') {
-			if (pContext.Reg_Parse[1] == ',' || pContext.Reg_Parse[1] == '}') {
+		} else if (*ctx.Reg_Parse == '{' && ctx.Brace_Char == '{') {
+			if (ctx.Reg_Parse[1] == ',' || ctx.Reg_Parse[1] == '}') {
 				zero_width++;
-			} else if (pContext.Reg_Parse[1] == '0') {
+			} else if (ctx.Reg_Parse[1] == '0') {
 				int i = 2;
 
-				while (pContext.Reg_Parse[i] == '0') {
+				while (ctx.Reg_Parse[i] == '0') {
 					i++;
 				}
 
-				if (pContext.Reg_Parse[i] == ',') {
+				if (ctx.Reg_Parse[i] == ',') {
 					zero_width++;
 				}
 			}
@@ -1821,16 +1823,171 @@ uint8_t *chunk(int paren, int *flag_param, len_range &range_param) {
 	   (*) or question (?) quantifiers to be aplied to a back-reference that
 	   refers to this set of parentheses. */
 
-	if ((*flag_param & HAS_WIDTH) && paren == PAREN && !zero_width && this_paren < pContext.Paren_Has_Width.size()) {
-		pContext.Paren_Has_Width[this_paren] = true;
+	if ((*flag_param & HAS_WIDTH) && paren == PAREN && !zero_width && this_paren < ctx.Paren_Has_Width.size()) {
+		ctx.Paren_Has_Width[this_paren] = true;
 	}
 
-	pContext.Is_Case_Insensitive = old_sensitive;
-	pContext.Match_Newline       = old_newline;
+	ctx.Is_Case_Insensitive = old_sensitive;
+	ctx.Match_Newline       = old_newline;
 
 	return ret_val;
 }
 
+struct literal {
+	std::string text;
+	bool caseless = false;
+};
+
+/*----------------------------------------------------------------------*
+ * literal_foldable
+ *
+ * Is comparing the ASCII lower case form of a character with 'ch' the
+ * same as the 'tolower' comparison a SIMILAR node makes in the current
+ * locale? Only such characters can be searched for with
+ * 'Kernels::FindStringCaseless'.
+ *----------------------------------------------------------------------*/
+bool literal_foldable(uint8_t ch) {
+
+	if (ch == '\0' || ch >= 0x80) {
+		return false;
+	}
+
+	const int upper = (ch >= 'a' && ch <= 'z') ? ch - 'a' + 'A' : ch;
+
+	for (int c = CHAR_MIN; c <= CHAR_MAX; ++c) {
+		if ((tolower(c) == ch) != (c == ch || c == upper)) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/*----------------------------------------------------------------------*
+ * find_literals
+ *
+ * Finds the text every match must begin with, and the longest piece of
+ * text every match must contain, by following the nodes which every
+ * path through the program has to pass. Alternation, quantifiers and
+ * anything else which consumes a variable amount of text ends a run of
+ * literal text; back references, look-around and {m,n} counters end the
+ * search altogether.
+ *----------------------------------------------------------------------*/
+void find_literals(const ParseContext &ctx, uint8_t *scan, literal *prefix, literal *required) {
+
+	literal run;
+	bool at_start = true;
+
+	auto finish_run = [&]() {
+		if (at_start) {
+			*prefix  = run;
+			at_start = false;
+		}
+
+		if (run.text.size() > required->text.size()) {
+			*required = run;
+		}
+
+		run = literal();
+	};
+
+	while (scan != nullptr) {
+		const uint8_t op = GET_OP_CODE(scan);
+
+		switch (op) {
+		case END:
+			scan = nullptr;
+			break;
+
+		case EXACTLY:
+		case SIMILAR:
+			for (uint8_t *ch = OPERAND(scan); *ch != '\0'; ++ch) {
+				const bool caseless = (op == SIMILAR);
+
+				if (!run.text.empty() && run.caseless != caseless) {
+					finish_run();
+				}
+
+				if (caseless && !literal_foldable(*ch)) {
+					finish_run();
+					continue;
+				}
+
+				run.caseless = caseless;
+				run.text.push_back(static_cast<char>(*ch));
+			}
+
+			scan = next_ptr(ctx, scan);
+			break;
+
+		case BRANCH: {
+			uint8_t *next = next_ptr(ctx, scan);
+			if (next != nullptr && GET_OP_CODE(next) != BRANCH) {
+				// Only one alternative, every match goes through it.
+				scan = OPERAND(scan);
+				break;
+			}
+
+			finish_run();
+			while (next != nullptr && GET_OP_CODE(next) == BRANCH) {
+				next = next_ptr(ctx, next);
+			}
+
+			scan = next;
+			break;
+		}
+
+		case NOTHING:
+		case BOL:
+		case EOL:
+		case BOWORD:
+		case EOWORD:
+		case NOT_BOUNDARY:
+			// Zero width, doesn't interrupt the text.
+			scan = next_ptr(ctx, scan);
+			break;
+
+		case ANY:
+		case EVERY:
+		case ANY_OF:
+		case ANY_BUT:
+		case IS_DELIM:
+		case NOT_DELIM:
+		case WORD_CHAR:
+		case NOT_WORD_CHAR:
+		case DIGIT:
+		case NOT_DIGIT:
+		case SPACE:
+		case SPACE_NL:
+		case NOT_SPACE:
+		case NOT_SPACE_NL:
+		case LETTER:
+		case NOT_LETTER:
+		case STAR:
+		case LAZY_STAR:
+		case PLUS:
+		case LAZY_PLUS:
+		case QUESTION:
+		case LAZY_QUESTION:
+		case BRACE:
+		case LAZY_BRACE:
+			finish_run();
+			scan = next_ptr(ctx, scan);
+			break;
+
+		default:
+			if ((op > OPEN && op < OPEN + NSUBEXP) || (op > CLOSE && op < CLOSE + NSUBEXP)) {
+				scan = next_ptr(ctx, scan);
+			} else {
+				scan = nullptr;
+			}
+			break;
+		}
+	}
+
+	finish_run();
+}
+
 }
 
 /*----------------------------------------------------------------------*
@@ -1850,26 +2007,27 @@ uint8_t *chunk(int paren, int *flag_param, len_range &range_param) {
 Regex::Regex(view::string_view exp, int defaultFlags) {
 
 	Regex *const re = this;
+	ParseContext ctx;
 
 	int flags_local;
 	len_range range_local;
 
-	if (pContext.Enable_Counting_Quantifier) {
-		pContext.Brace_Char = '{';
-		pContext.Meta_Char = &Default_Meta_Char[0];
+	if (ctx.Enable_Counting_Quantifier) {
+		ctx.Brace_Char = '{';
+		ctx.Meta_Char = &Default_Meta_Char[0];
 	} else {
-		pContext.Brace_Char = '*';                  // Bypass the '{' in
-		pContext.Meta_Char = &Default_Meta_Char[1]; // Default_Meta_Char
+		ctx.Brace_Char = '*';                  // Bypass the '{' in
+		ctx.Meta_Char = &Default_Meta_Char[1]; // Default_Meta_Char
 	}
 
 	// Initialize arrays used by function 'shortcut_escape'.
-	if (!init_ansi_classes()) {
+	if (!init_ansi_classes(ctx)) {
 		Raise<RegexError>("internal error #1, 'CompileRE'");
 	}
 
-	pContext.FirstPass = true;
-	pContext.Reg_Size = 0UL;
-	pContext.Code.clear();
+	ctx.FirstPass = true;
+	ctx.Reg_Size = 0UL;
+	ctx.Code.clear();
 
 	/* We can't allocate space until we know how big the compiled form will be,
 	   but we can't compile it (and thus know how big it is) until we've got a
@@ -1892,30 +2050,31 @@ Regex::Regex(view::string_view exp, int defaultFlags) {
 		 *    Match_Newline:       Newlines are NOT matched by default
 		 *                         in character classes
 		 */
-		pContext.Is_Case_Insensitive = ((defaultFlags & REDFLT_CASE_INSENSITIVE) ? true : false);
+		ctx.Is_Case_Insensitive = ((defaultFlags & REDFLT_CASE_INSENSITIVE) ? true : false);
 #if 0 // Currently not used. Uncomment if needed.
-		pContext.Match_Newline       = ((defaultFlags & REDFLT_MATCH_NEWLINE)    ? true : false);
+		ctx.Match_Newline       = ((defaultFlags & REDFLT_MATCH_NEWLINE)    ? true : false);
 #else
-		pContext.Match_Newline       = false;
+		ctx.Match_Newline       = false;
 #endif
 
-		pContext.Reg_Parse       = exp.begin();
-		pContext.InputString     = exp;
-		pContext.Total_Paren     = 1;
-		pContext.Num_Braces      = 0;
-		pContext.Closed_Parens   = 0;
-		pContext.Paren_Has_Width = 0;
+		ctx.Reg_Parse       = exp.begin();
+		ctx.InputString     = exp;
+		ctx.Total_Paren     = 1;
+		ctx.Num_Braces      = 0;
+		ctx.Look_Behind_Size = 0;
+		ctx.Closed_Parens   = 0;
+		ctx.Paren_Has_Width = 0;
 
-		emit_byte(MAGIC);
-		emit_byte('%'); // Placeholder for num of capturing parentheses.
-		emit_byte('%'); // Placeholder for num of general {m,n} constructs.
+		emit_byte(ctx, MAGIC);
+		emit_byte(ctx, '%'); // Placeholder for num of capturing parentheses.
+		emit_byte(ctx, '%'); // Placeholder for num of general {m,n} constructs.
 
-		if (!chunk(NO_PAREN, &flags_local, range_local)) {
+		if (!chunk(ctx, NO_PAREN, &flags_local, range_local)) {
 			Raise<RegexError>("internal error #10, 'CompileRE'");
 		}
 
 		if (pass == 1) {
-			if (pContext.Reg_Size >= MAX_COMPILED_SIZE) {
+			if (ctx.Reg_Size >= MAX_COMPILED_SIZE) {
 				/* Too big for NEXT pointers NEXT_PTR_SIZE bytes long to span.
 				   This is a real issue since the first BRANCH node usually points
 				   to the end of the compiled regex code. */
@@ -1924,18 +2083,21 @@ Regex::Regex(view::string_view exp, int defaultFlags) {
 			}
 
 			// NOTE(eteran): For now, we NEED this to avoid issues regarding holding pointers to reallocated space
-			pContext.Code.reserve(pContext.Reg_Size);
-			pContext.FirstPass = false;
+			ctx.Code.reserve(ctx.Reg_Size);
+			ctx.FirstPass = false;
 		}
 	}
 
-	pContext.Code[1] = static_cast<uint8_t>(pContext.Total_Paren - 1);
-	pContext.Code[2] = static_cast<uint8_t>(pContext.Num_Braces);
+	ctx.Code[1] = static_cast<uint8_t>(ctx.Total_Paren - 1);
+	ctx.Code[2] = static_cast<uint8_t>(ctx.Num_Braces);
 
-	assert(pContext.Code.size() == pContext.Reg_Size);
+	assert(ctx.Code.size() == ctx.Reg_Size);
 
 	// move over what we compiled
-	re->program = std::move(pContext.Code);
+	re->program = std::move(ctx.Code);
+
+	// The boundary tests at the start of a match also look at the character before it
+	re->look_behind = ctx.Look_Behind_Size + 1;
 
 	/*----------------------------------------*
 	 * Dig out information for optimizations. *
@@ -1944,7 +2106,7 @@ Regex::Regex(view::string_view exp, int defaultFlags) {
 	// First BRANCH.
 	uint8_t *scan = (&re->program[0] + REGEX_START_OFFSET);
 
-	if (GET_OP_CODE(next_ptr(scan)) == END) { // Only one top-level choice.
+	if (GET_OP_CODE(next_ptr(ctx, scan)) == END) { // Only one top-level choice.
 		scan = OPERAND(scan);
 
 		// Starting-point info.
@@ -1963,4 +2125,17 @@ Regex::Regex(view::string_view exp, int defaultFlags) {
 			re->anchor++;
 		}
 	}
+
+	// Literal text to look for before trying to match.
+	literal prefix;
+	literal required;
+	find_literals(ctx, &re->program[0] + REGEX_START_OFFSET, &prefix, &required);
+
+	re->prefix            = std::move(prefix.text);
+	re->prefix_caseless   = prefix.caseless;
+	re->required          = std::move(required.text);
+	re->required_caseless = required.caseless;
+
+	// Programs which are purely regular can find where their matches start with a DFA.
+	re->dfa = Dfa::compile(&re->program[0], re->prefix, re->prefix_caseless);
 }
@@ -13,7 +13,8 @@ class Regex;
 constexpr int WHITE_SPACE_SIZE = 16;
 constexpr int ALNUM_CHAR_SIZE  = 256;
 
-// Global work variables for 'CompileRE'.
+// Work variables for 'CompileRE'. Each compile has its own set, which is passed
+// to everything it uses to parse the regex.
 struct ParseContext {
 	view::string_view::iterator Reg_Parse;                         // Input scan ptr (scans user's regex)
 	view::string_view           InputString;
@@ -22,6 +23,7 @@ struct ParseContext {
 	size_t                      Reg_Size;                          // Size of compiled regex code.
 	size_t                      Total_Paren;                       // Parentheses, (),  counter.
 	size_t                      Num_Braces;                        // Number of general {m,n} constructs. {m,n} quantifiers of SIMPLE atoms are not included in this count.
+	size_t                      Look_Behind_Size;                  // How far all the look-behinds together may look back
 	std::bitset<64>             Closed_Parens;                     // Bit flags indicating () closure.
 	std::bitset<64>             Paren_Has_Width;                   // Bit flags indicating ()'s that are known to not match the empty string
 	bool                        FirstPass;
@@ -34,6 +36,4 @@ struct ParseContext {
 	char                        Brace_Char;
 };
 
-extern ParseContext pContext;
-
 #endif
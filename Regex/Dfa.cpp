@@ -0,0 +1,1002 @@
+
+#include "Dfa.h"
+#include "Common.h"
+#include "Constants.h"
+#include "Execute.h"
+#include "Opcodes.h"
+#include "Util/Kernels.h"
+#include "Util/utils.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <limits>
+
+namespace {
+
+// Kinds of NFA edges
+constexpr uint8_t EPSILON_EDGE = 0;
+constexpr uint8_t ASSERT_EDGE  = 1;
+constexpr uint8_t CHAR_EDGE    = 2;
+
+// Kinds of character sets, the last two depend on the word delimiters in use
+constexpr uint8_t FIXED_SET         = 0;
+constexpr uint8_t DELIMITER_SET     = 1;
+constexpr uint8_t NOT_DELIMITER_SET = 2;
+
+/* State flags. The low two bits describe the character on the side of the
+ * current position which has already been scanned (the previous character
+ * when running forward, the next one when running backward) */
+constexpr uint8_t NEWLINE   = 0x01;
+constexpr uint8_t DELIMITER = 0x02;
+constexpr uint8_t MATCHED   = 0x04; // a match has been seen, stop looking for new ones
+constexpr uint8_t SEARCHING = 0x08; // a match may start at the current position
+
+// Larger {m,n} counts than this are left to the backtracking matcher
+constexpr uint32_t MAX_UNROLLED_COUNT = 1000;
+constexpr size_t MAX_NFA_NODES        = 0x4000;
+
+// Memory allowed for the states of each direction, and how often it may be reclaimed per search
+constexpr size_t DFA_CACHE_SIZE = 0x100000;
+constexpr int MAX_CACHE_FLUSHES = 4;
+
+/**
+ * @brief next_node
+ * @param ptr
+ * @return the node following "ptr", like NEXT_PTR in Execute.cpp
+ */
+uint8_t *next_node(uint8_t *ptr) noexcept {
+
+	const uint16_t offset = GET_OFFSET(ptr);
+
+	if (offset == 0) {
+		return nullptr;
+	}
+
+	if (GET_OP_CODE(ptr) == BACK) {
+		return ptr - offset;
+	}
+
+	return ptr + offset;
+}
+
+/**
+ * @brief isDelimiter
+ * @param table
+ * @param ch
+ * @return
+ *
+ * Same test as isDelimiter in Execute.cpp, including its treatment of
+ * characters which are negative when char is signed
+ */
+bool isDelimiter(const std::bitset<256> &table, char ch) noexcept {
+	auto n = static_cast<unsigned int>(ch);
+	if (n < table.size()) {
+		return table[n];
+	}
+
+	return false;
+}
+
+/*----------------------------------------------------------------------*
+ * matchesSimple
+ *
+ * Does the SIMPLE node "op" match "ch"? This asks exactly the question
+ * 'match' (or 'greedy', if "in_greedy" is true) asks of the input, so the
+ * DFA and the backtracking matcher never disagree about a character.
+ *----------------------------------------------------------------------*/
+bool matchesSimple(uint8_t op, uint8_t *operand, char ch, bool in_greedy) {
+	switch (op) {
+	case ANY:
+		return ch != '\n';
+	case EVERY:
+		return true;
+	case EXACTLY:
+		return *operand == ch;
+	case SIMILAR:
+		if (in_greedy) {
+			return *operand == safe_ctype<tolower>(ch);
+		}
+		return tolower(ch) == *operand;
+	case ANY_OF:
+		return ::strchr(reinterpret_cast<char *>(operand), ch) != nullptr;
+	case ANY_BUT:
+		return ::strchr(reinterpret_cast<char *>(operand), ch) == nullptr;
+	case WORD_CHAR:
+		return safe_ctype<isalnum>(ch) || ch == '_';
+	case NOT_WORD_CHAR:
+		return !safe_ctype<isalnum>(ch) && ch != '_' && ch != '\n';
+	case DIGIT:
+		return safe_ctype<isdigit>(ch);
+	case NOT_DIGIT:
+		return !safe_ctype<isdigit>(ch) && ch != '\n';
+	case SPACE:
+		return safe_ctype<isspace>(ch) && ch != '\n';
+	case SPACE_NL:
+		return safe_ctype<isspace>(ch);
+	case NOT_SPACE:
+		return !safe_ctype<isspace>(ch);
+	case NOT_SPACE_NL:
+		return !safe_ctype<isspace>(ch) || ch == '\n';
+	case LETTER:
+		return safe_ctype<isalpha>(ch);
+	case NOT_LETTER:
+		return !safe_ctype<isalpha>(ch) && ch != '\n';
+	default:
+		return false;
+	}
+}
+
+/**
+ * @brief isSimple
+ * @param op
+ * @return true if "op" consumes exactly one character
+ */
+bool isSimple(uint8_t op) noexcept {
+	switch (op) {
+	case ANY:
+	case EVERY:
+	case EXACTLY:
+	case SIMILAR:
+	case ANY_OF:
+	case ANY_BUT:
+	case IS_DELIM:
+	case NOT_DELIM:
+	case WORD_CHAR:
+	case NOT_WORD_CHAR:
+	case DIGIT:
+	case NOT_DIGIT:
+	case SPACE:
+	case SPACE_NL:
+	case NOT_SPACE:
+	case NOT_SPACE_NL:
+	case LETTER:
+	case NOT_LETTER:
+		return true;
+	default:
+		return false;
+	}
+}
+
+/**
+ * @brief holds
+ * @param op
+ * @param context
+ * @return does the zero width assertion "op" hold at a position described by
+ * "context" (the flags of the previous character in the low two bits, those of
+ * the next character in the two above them)?
+ */
+bool holds(uint8_t op, unsigned int context) noexcept {
+
+	const bool prev_is_delim    = context & DELIMITER;
+	const bool current_is_delim = (context >> 2) & DELIMITER;
+
+	switch (op) {
+	case BOL:
+		return context & NEWLINE;
+	case EOL:
+		return (context >> 2) & NEWLINE;
+	case BOWORD:
+		return prev_is_delim && !current_is_delim;
+	case EOWORD:
+		return !prev_is_delim && current_is_delim;
+	case NOT_BOUNDARY:
+		return prev_is_delim == current_is_delim;
+	default:
+		return false;
+	}
+}
+
+/**
+ * @brief makeContext
+ * @param prev
+ * @param next
+ * @return
+ */
+unsigned int makeContext(uint8_t prev, uint8_t next) noexcept {
+	return (prev & (NEWLINE | DELIMITER)) | ((next & (NEWLINE | DELIMITER)) << 2);
+}
+
+}
+
+/**
+ * @brief Dfa::compile
+ * @param program
+ * @param prefix          Text every match begins with, may be empty
+ * @param prefix_caseless Whether "prefix" is matched ignoring case
+ * @return a DFA for "program", or nullptr if it uses constructs the DFA can't
+ * handle
+ */
+std::unique_ptr<Dfa> Dfa::compile(uint8_t *program, const std::string &prefix, bool prefix_caseless) {
+
+	auto dfa = std::make_unique<Dfa>();
+	if (!dfa->build(program)) {
+		return nullptr;
+	}
+
+	dfa->reverse();
+	dfa->forward_.leftmost = true;
+	dfa->marks_.resize(dfa->forward_.nfa.nodes.size());
+	dfa->prefix_         = prefix;
+	dfa->prefixCaseless_ = prefix_caseless;
+	return dfa;
+}
+
+/**
+ * @brief Dfa::newNode
+ * @return
+ */
+int Dfa::newNode() {
+	forward_.nfa.nodes.emplace_back();
+	return static_cast<int>(forward_.nfa.nodes.size() - 1);
+}
+
+/**
+ * @brief Dfa::addEdge
+ * @param from
+ * @param type
+ * @param op
+ * @param set
+ * @param target
+ */
+void Dfa::addEdge(int from, uint8_t type, uint8_t op, uint16_t set, int target) {
+	forward_.nfa.nodes[static_cast<size_t>(from)].edges.push_back(Edge{type, op, set, target});
+}
+
+/**
+ * @brief Dfa::addSet
+ * @param bits
+ * @param type
+ * @param set
+ * @return
+ */
+bool Dfa::addSet(const std::bitset<256> &bits, uint8_t type, uint16_t *set) {
+
+	for (size_t i = 0; i < sets_.size(); ++i) {
+		if (sets_[i].type == type && sets_[i].bits == bits) {
+			*set = static_cast<uint16_t>(i);
+			return true;
+		}
+	}
+
+	if (sets_.size() > std::numeric_limits<uint16_t>::max()) {
+		return false;
+	}
+
+	*set = static_cast<uint16_t>(sets_.size());
+	sets_.push_back(CharacterSet{bits, type});
+	return true;
+}
+
+/*----------------------------------------------------------------------*
+ * build
+ *
+ * Translate the compiled regex into a Thompson NFA. Every node of the
+ * program becomes an NFA node (plus a few more for strings and counted
+ * quantifiers), BRANCH, BACK, NOTHING and the parentheses become epsilon
+ * edges. Returns false if the program contains anything which is not
+ * regular.
+ *----------------------------------------------------------------------*/
+bool Dfa::build(uint8_t *program) {
+
+	std::map<uint8_t *, int> ids;
+	std::vector<uint8_t *> pending;
+
+	auto nodeFor = [&](uint8_t *scan) {
+		auto it = ids.find(scan);
+		if (it != ids.end()) {
+			return it->second;
+		}
+
+		const int id = newNode();
+		ids.emplace(scan, id);
+		pending.push_back(scan);
+		return id;
+	};
+
+	auto simpleSet = [this](uint8_t *atom, bool in_greedy, uint16_t *set) {
+		const uint8_t op = GET_OP_CODE(atom);
+
+		if (op == IS_DELIM || op == NOT_DELIM) {
+			return addSet(std::bitset<256>(), op == IS_DELIM ? DELIMITER_SET : NOT_DELIMITER_SET, set);
+		}
+
+		std::bitset<256> bits;
+		for (size_t c = 0; c < bits.size(); ++c) {
+			bits[c] = matchesSimple(op, OPERAND(atom), static_cast<char>(c), in_greedy);
+		}
+
+		return addSet(bits, FIXED_SET, set);
+	};
+
+	forward_.nfa.start = nodeFor(program + REGEX_START_OFFSET);
+
+	while (!pending.empty()) {
+
+		if (forward_.nfa.nodes.size() > MAX_NFA_NODES) {
+			return false;
+		}
+
+		uint8_t *scan = pending.back();
+		pending.pop_back();
+
+		const int id     = ids[scan];
+		const uint8_t op = GET_OP_CODE(scan);
+		uint8_t *next    = next_node(scan);
+
+		if (next == nullptr && op != END) {
+			return false;
+		}
+
+		switch (op) {
+		case END:
+			forward_.nfa.nodes[static_cast<size_t>(id)].accept = true;
+			break;
+
+		case BOL:
+		case EOL:
+		case BOWORD:
+		case EOWORD:
+		case NOT_BOUNDARY:
+			addEdge(id, ASSERT_EDGE, op, 0, nodeFor(next));
+			break;
+
+		case EXACTLY:
+		case SIMILAR: {
+			/* 'match' compares the first character of an EXACTLY string the
+			   same way 'greedy' does, and the rest with strncmp */
+			uint8_t *operand = OPERAND(scan);
+			const size_t length = ::strlen(reinterpret_cast<char *>(operand));
+			const int last = nodeFor(next);
+
+			int from = id;
+			for (size_t i = 0; i < length; ++i) {
+				std::bitset<256> bits;
+				for (size_t c = 0; c < bits.size(); ++c) {
+					const auto ch = static_cast<char>(c);
+					if (op == SIMILAR) {
+						bits[c] = tolower(ch) == operand[i];
+					} else if (i == 0) {
+						bits[c] = *operand == ch;
+					} else {
+						bits[c] = c == operand[i];
+					}
+				}
+
+				uint16_t set;
+				if (!addSet(bits, FIXED_SET, &set)) {
+					return false;
+				}
+
+				const int to = (i + 1 == length) ? last : newNode();
+				addEdge(from, CHAR_EDGE, 0, set, to);
+				from = to;
+			}
+
+			if (length == 0) {
+				addEdge(id, EPSILON_EDGE, 0, 0, last);
+			}
+			break;
+		}
+
+		case ANY_OF:
+		case ANY_BUT:
+		case ANY:
+		case EVERY:
+		case DIGIT:
+		case NOT_DIGIT:
+		case LETTER:
+		case NOT_LETTER:
+		case SPACE:
+		case SPACE_NL:
+		case NOT_SPACE:
+		case NOT_SPACE_NL:
+		case WORD_CHAR:
+		case NOT_WORD_CHAR:
+		case IS_DELIM:
+		case NOT_DELIM: {
+			uint16_t set;
+			if (!simpleSet(scan, false, &set)) {
+				return false;
+			}
+
+			addEdge(id, CHAR_EDGE, 0, set, nodeFor(next));
+			break;
+		}
+
+		case NOTHING:
+		case BACK:
+			addEdge(id, EPSILON_EDGE, 0, 0, nodeFor(next));
+			break;
+
+		case BRANCH:
+			if (GET_OP_CODE(next) != BRANCH) {
+				addEdge(id, EPSILON_EDGE, 0, 0, nodeFor(OPERAND(scan)));
+			} else {
+				for (uint8_t *branch = scan; branch != nullptr && GET_OP_CODE(branch) == BRANCH; branch = next_node(branch)) {
+					addEdge(id, EPSILON_EDGE, 0, 0, nodeFor(OPERAND(branch)));
+				}
+			}
+			break;
+
+		case STAR:
+		case LAZY_STAR:
+		case PLUS:
+		case LAZY_PLUS:
+		case QUESTION:
+		case LAZY_QUESTION:
+		case BRACE:
+		case LAZY_BRACE: {
+			uint32_t min;
+			uint32_t max;
+			uint8_t *atom = OPERAND(scan);
+
+			switch (op) {
+			case STAR:
+			case LAZY_STAR:
+				min = REG_ZERO;
+				max = std::numeric_limits<uint32_t>::max();
+				break;
+			case PLUS:
+			case LAZY_PLUS:
+				min = REG_ONE;
+				max = std::numeric_limits<uint32_t>::max();
+				break;
+			case QUESTION:
+			case LAZY_QUESTION:
+				min = REG_ZERO;
+				max = REG_ONE;
+				break;
+			default:
+				min = static_cast<uint32_t>(GET_OFFSET(scan + NEXT_PTR_SIZE));
+				max = static_cast<uint32_t>(GET_OFFSET(scan + (2 * NEXT_PTR_SIZE)));
+
+				if (max <= REG_INFINITY) {
+					max = std::numeric_limits<uint32_t>::max();
+				}
+
+				atom = OPERAND(scan + (2 * NEXT_PTR_SIZE));
+				break;
+			}
+
+			const bool unbounded = (max == std::numeric_limits<uint32_t>::max());
+
+			uint16_t set;
+			if (!isSimple(GET_OP_CODE(atom)) || min > MAX_UNROLLED_COUNT || (!unbounded && max > MAX_UNROLLED_COUNT) || !simpleSet(atom, true, &set)) {
+				return false;
+			}
+
+			// a count range which can never be satisfied leaves the node without any way out
+			if (min > max) {
+				break;
+			}
+
+			const int last = nodeFor(next);
+
+			int from = id;
+			for (uint32_t i = 0; i < min; ++i) {
+				const int to = newNode();
+				addEdge(from, CHAR_EDGE, 0, set, to);
+				from = to;
+			}
+
+			if (unbounded) {
+				addEdge(from, CHAR_EDGE, 0, set, from);
+			} else {
+				for (uint32_t i = min; i < max; ++i) {
+					const int to = newNode();
+					addEdge(from, CHAR_EDGE, 0, set, to);
+					addEdge(from, EPSILON_EDGE, 0, 0, last);
+					from = to;
+				}
+			}
+
+			addEdge(from, EPSILON_EDGE, 0, 0, last);
+			break;
+		}
+
+		default:
+			if ((op > OPEN && op < OPEN + NSUBEXP) || (op > CLOSE && op < CLOSE + NSUBEXP)) {
+				addEdge(id, EPSILON_EDGE, 0, 0, nodeFor(next));
+				break;
+			}
+
+			// back references, look-around and {m,n} counters
+			return false;
+		}
+	}
+
+	return forward_.nfa.nodes.size() <= MAX_NFA_NODES;
+}
+
+/**
+ * @brief Dfa::reverse
+ *
+ * Build the NFA for matching the same language from right to left, it is used
+ * to find where the match found by the forward NFA begins
+ */
+void Dfa::reverse() {
+
+	const Nfa &nfa = forward_.nfa;
+	Nfa &rev       = reverse_.nfa;
+
+	rev.nodes.resize(nfa.nodes.size());
+
+	for (size_t i = 0; i < nfa.nodes.size(); ++i) {
+		for (const Edge &edge : nfa.nodes[i].edges) {
+			rev.nodes[static_cast<size_t>(edge.target)].edges.push_back(Edge{edge.type, edge.op, edge.set, static_cast<int>(i)});
+		}
+
+		if (nfa.nodes[i].accept) {
+			rev.start = static_cast<int>(i);
+		}
+	}
+
+	rev.nodes[static_cast<size_t>(nfa.start)].accept = true;
+}
+
+/**
+ * @brief Dfa::prepare
+ *
+ * Work out the character sets and byte classes for the word delimiters of
+ * the search "ctx" is for, dropping all of the states if they have changed since the last
+ * search
+ */
+void Dfa::prepare(const ExecuteContext &ctx) {
+
+	if (prepared_ && delimiters_ == ctx.Current_Delimiters) {
+		return;
+	}
+
+	prepared_   = true;
+	delimiters_ = ctx.Current_Delimiters;
+
+	for (size_t c = 0; c < byteFlags_.size(); ++c) {
+		const auto ch = static_cast<char>(c);
+		byteFlags_[c] = static_cast<uint8_t>((ch == '\n' ? NEWLINE : 0) | (isDelimiter(delimiters_, ch) ? DELIMITER : 0));
+	}
+
+	members_.clear();
+	for (const CharacterSet &set : sets_) {
+		std::bitset<256> bits = set.bits;
+		if (set.type != FIXED_SET) {
+			for (size_t c = 0; c < bits.size(); ++c) {
+				bits[c] = isDelimiter(delimiters_, static_cast<char>(c)) == (set.type == DELIMITER_SET);
+			}
+		}
+		members_.push_back(bits);
+	}
+
+	/* Bytes which no set and no assertion can tell apart share a class, so
+	   the states only need a transition for each class */
+	std::array<int, 256> classes;
+	for (size_t c = 0; c < classes.size(); ++c) {
+		classes[c] = byteFlags_[c];
+	}
+
+	for (const std::bitset<256> &bits : members_) {
+		std::map<std::pair<int, bool>, int> refined;
+		for (size_t c = 0; c < classes.size(); ++c) {
+			auto it = refined.emplace(std::make_pair(classes[c], static_cast<bool>(bits[c])), static_cast<int>(refined.size())).first;
+			classes[c] = it->second;
+		}
+	}
+
+	std::map<int, uint8_t> numbering;
+	representatives_.clear();
+	for (size_t c = 0; c < classes.size(); ++c) {
+		auto it = numbering.find(classes[c]);
+		if (it == numbering.end()) {
+			it = numbering.emplace(classes[c], static_cast<uint8_t>(representatives_.size())).first;
+			representatives_.push_back(static_cast<uint8_t>(c));
+		}
+		classes_[c] = it->second;
+	}
+
+	for (Automaton *a : {&forward_, &reverse_}) {
+		a->states.clear();
+		a->transitions.clear();
+		a->index.clear();
+		a->memory = 0;
+	}
+}
+
+/*----------------------------------------------------------------------*
+ * closure
+ *
+ * Collect every NFA node reachable from "threads" without consuming a
+ * character, at a position described by "context", into 'closure_'. The
+ * order of "threads" is kept. For the forward automaton a new thread is
+ * started after the others if "search" is set, and collection stops at the
+ * first accepting node, since nothing of lower priority can be part of the
+ * leftmost match.
+ *----------------------------------------------------------------------*/
+void Dfa::closure(const Automaton &a, const std::vector<int> &threads, bool search, unsigned int context, bool *accepted) {
+
+	closure_.clear();
+	*accepted = false;
+
+	if (++generation_ == 0) {
+		std::fill(marks_.begin(), marks_.end(), 0);
+		generation_ = 1;
+	}
+
+	auto visit = [&](int root) {
+		stack_.clear();
+		stack_.push_back(root);
+
+		while (!stack_.empty()) {
+			const int n = stack_.back();
+			stack_.pop_back();
+
+			if (marks_[static_cast<size_t>(n)] == generation_) {
+				continue;
+			}
+
+			marks_[static_cast<size_t>(n)] = generation_;
+
+			const Node &node = a.nfa.nodes[static_cast<size_t>(n)];
+			if (node.accept) {
+				*accepted = true;
+				if (a.leftmost) {
+					return true;
+				}
+			}
+
+			closure_.push_back(n);
+
+			for (auto it = node.edges.rbegin(); it != node.edges.rend(); ++it) {
+				if (it->type == EPSILON_EDGE || (it->type == ASSERT_EDGE && holds(it->op, context))) {
+					stack_.push_back(it->target);
+				}
+			}
+		}
+
+		return false;
+	};
+
+	for (int thread : threads) {
+		if (visit(thread)) {
+			return;
+		}
+	}
+
+	if (search) {
+		visit(a.nfa.start);
+	}
+}
+
+/**
+ * @brief Dfa::step
+ * @param a
+ * @param byte
+ * @param threads
+ *
+ * Advance the nodes collected by 'closure' over "byte"
+ */
+void Dfa::step(const Automaton &a, uint8_t byte, std::vector<int> *threads) {
+
+	if (++generation_ == 0) {
+		std::fill(marks_.begin(), marks_.end(), 0);
+		generation_ = 1;
+	}
+
+	for (int n : closure_) {
+		for (const Edge &edge : a.nfa.nodes[static_cast<size_t>(n)].edges) {
+			if (edge.type == CHAR_EDGE && members_[edge.set][byte] && marks_[static_cast<size_t>(edge.target)] != generation_) {
+				marks_[static_cast<size_t>(edge.target)] = generation_;
+				threads->push_back(edge.target);
+			}
+		}
+	}
+}
+
+/**
+ * @brief Dfa::insert
+ * @param a
+ * @param threads
+ * @param flags
+ * @return the index of the state, or -1 if the cache had to be emptied too
+ * many times during this search
+ */
+int Dfa::insert(Automaton &a, std::vector<int> threads, uint8_t flags) {
+
+	auto key = std::make_pair(flags, std::move(threads));
+
+	auto it = a.index.find(key);
+	if (it != a.index.end()) {
+		return it->second;
+	}
+
+	// the thread list is stored twice, once in the state and once in the index
+	const size_t size = sizeof(State) + 2 * key.second.size() * sizeof(int) + representatives_.size() * sizeof(int) + 64;
+
+	if (a.memory + size > DFA_CACHE_SIZE) {
+		if (++a.flushes > MAX_CACHE_FLUSHES) {
+			return -1;
+		}
+
+		a.states.clear();
+		a.transitions.clear();
+		a.index.clear();
+		a.memory = 0;
+	}
+
+	const auto id = static_cast<int>(a.states.size());
+	a.states.push_back(State{key.second, flags});
+	a.transitions.resize(a.transitions.size() + representatives_.size(), -1);
+	a.index.emplace(std::move(key), id);
+	a.memory += size;
+	return id;
+}
+
+/**
+ * @brief Dfa::transition
+ * @param a
+ * @param s
+ * @param cls
+ * @return the state reached from "s" over a byte of class "cls", shifted left
+ * by one with the low bit set if "s" accepts before the byte, or -1 if the
+ * DFA has given up
+ */
+int Dfa::transition(Automaton &a, int s, int cls) {
+
+	const uint8_t byte  = representatives_[static_cast<size_t>(cls)];
+	const uint8_t flags = a.states[static_cast<size_t>(s)].flags;
+
+	const unsigned int context = a.leftmost ? makeContext(flags, byteFlags_[byte]) : makeContext(byteFlags_[byte], flags);
+
+	bool accepted;
+	closure(a, a.states[static_cast<size_t>(s)].threads, flags & SEARCHING, context, &accepted);
+
+	std::vector<int> threads;
+	step(a, byte, &threads);
+
+	auto nextFlags = byteFlags_[byte];
+	if (a.leftmost) {
+		if (accepted || (flags & MATCHED)) {
+			nextFlags |= MATCHED;
+		} else {
+			nextFlags |= (flags & SEARCHING);
+		}
+	}
+
+	const int flushes = a.flushes;
+	const int target  = insert(a, std::move(threads), nextFlags);
+	if (target < 0) {
+		return -1;
+	}
+
+	const int next = (target << 1) | (accepted ? 1 : 0);
+
+	// a flush has thrown away the state we came from
+	if (a.flushes == flushes) {
+		a.transitions[static_cast<size_t>(s) * representatives_.size() + static_cast<size_t>(cls)] = next;
+	}
+
+	return next;
+}
+
+/**
+ * @brief Dfa::setSearching
+ * @param a
+ * @param s
+ * @param searching
+ * @return the state like "s", but which does or doesn't start new matches
+ */
+int Dfa::setSearching(Automaton &a, int s, bool searching) {
+
+	const State &state = a.states[static_cast<size_t>(s)];
+
+	auto flags = static_cast<uint8_t>(state.flags & ~SEARCHING);
+	if (searching && !(state.flags & MATCHED)) {
+		flags |= SEARCHING;
+	}
+
+	if (flags == state.flags) {
+		return s;
+	}
+
+	return insert(a, state.threads, flags);
+}
+
+/**
+ * @brief Dfa::accepts
+ * @param a
+ * @param s
+ * @param context
+ * @return does state "s" accept at a position described by "context"?
+ */
+bool Dfa::accepts(const Automaton &a, int s, unsigned int context) {
+	bool accepted;
+	const State &state = a.states[static_cast<size_t>(s)];
+	closure(a, state.threads, state.flags & SEARCHING, context, &accepted);
+	return accepted;
+}
+
+/*----------------------------------------------------------------------*
+ * search
+ *
+ * Find where the leftmost match in the text begins and ends. Matches may
+ * begin anywhere in [start, limit), and at "limit" as well if
+ * "start_at_limit" is set; they may not extend past "end_of_string". The
+ * rest of the matching context (the characters around the text and the word
+ * delimiters) comes from "ctx", "start" may be anywhere at or after the
+ * beginning of the string.
+ *
+ * This scans forward to where a match which begins leftmost ends, then
+ * backward from there to the leftmost position that match can begin at.
+ * Threads are kept in the backtracker's order of preference, so the end is
+ * the one the backtracker will find for that match too. Reaching the end of
+ * the string is noted in "ctx", since more text could change the
+ * answer.
+ *----------------------------------------------------------------------*/
+Dfa::Result Dfa::search(ExecuteContext &ctx, const char *start, const char *limit, bool start_at_limit, const char *end_of_string, const char **match_start, const char **match_end) {
+
+	prepare(ctx);
+
+	forward_.flushes = 0;
+	reverse_.flushes = 0;
+
+	auto startAllowed = [limit, start_at_limit](const char *p) {
+		return p < limit || (p == limit && start_at_limit);
+	};
+
+	// a search which begins part way into the string sees the character before it
+	uint8_t startFlags;
+	if (start == ctx.Start_Of_String) {
+		startFlags = static_cast<uint8_t>((ctx.Prev_Is_BOL ? NEWLINE : 0) | (ctx.Prev_Is_Delim ? DELIMITER : 0));
+	} else {
+		startFlags = byteFlags_[static_cast<uint8_t>(start[-1])];
+	}
+
+	auto endFlags = static_cast<uint8_t>(ctx.Succ_Is_Delim ? DELIMITER : 0);
+	if (ctx.Succ_Is_EOL || (end_of_string < ctx.Real_End_Of_String && *end_of_string == '\n')) {
+		endFlags |= NEWLINE;
+	}
+
+	// Forward, to the end of the leftmost match.
+	const size_t classCount = representatives_.size();
+	const char *leftmost_end   = nullptr;
+	const char *p           = start;
+
+	int s = insert(forward_, {}, static_cast<uint8_t>(startFlags | (startAllowed(start) ? SEARCHING : 0)));
+	if (s < 0) {
+		return Result::GaveUp;
+	}
+
+	/* Before "limit" every state starts new matches until one is found, so
+	   the scan can only run out of threads after that */
+	for (; p < limit; ++p) {
+
+		/* With nothing under way, the next match can't begin before the
+		   next occurrence of the prefix */
+		if (!prefix_.empty() && !leftmost_end && forward_.states[static_cast<size_t>(s)].threads.empty()) {
+			const char *next = prefixCaseless_ ? Kernels::FindStringCaseless(p, end_of_string, prefix_) : Kernels::FindString(p, end_of_string, prefix_);
+			if (!next) {
+				ctx.Hit_End = true;
+			}
+
+			if (next != p) {
+				p = (next != nullptr && next < limit) ? next : limit;
+
+				s = insert(forward_, {}, static_cast<uint8_t>(byteFlags_[static_cast<uint8_t>(p[-1])] | SEARCHING));
+				if (s < 0) {
+					return Result::GaveUp;
+				}
+
+				if (p == limit) {
+					break;
+				}
+			}
+		}
+
+		const size_t cls = classes_[static_cast<uint8_t>(*p)];
+
+		int next = forward_.transitions[static_cast<size_t>(s) * classCount + cls];
+		if (next < 0) {
+			next = transition(forward_, s, static_cast<int>(cls));
+			if (next < 0) {
+				return Result::GaveUp;
+			}
+		}
+
+		s = next >> 1;
+
+		if (next & 1) {
+			leftmost_end = p;
+		}
+
+		if (leftmost_end && forward_.states[static_cast<size_t>(s)].threads.empty()) {
+			break;
+		}
+	}
+
+	for (;; ++p) {
+		s = setSearching(forward_, s, startAllowed(p));
+		if (s < 0) {
+			return Result::GaveUp;
+		}
+
+		const State &state = forward_.states[static_cast<size_t>(s)];
+		if (state.threads.empty() && !(state.flags & SEARCHING)) {
+			break;
+		}
+
+		if (p == end_of_string) {
+			ctx.Hit_End = true;
+			if (accepts(forward_, s, makeContext(state.flags, endFlags))) {
+				leftmost_end = p;
+			}
+			break;
+		}
+
+		const size_t cls = classes_[static_cast<uint8_t>(*p)];
+
+		int next = forward_.transitions[static_cast<size_t>(s) * classCount + cls];
+		if (next < 0) {
+			next = transition(forward_, s, static_cast<int>(cls));
+			if (next < 0) {
+				return Result::GaveUp;
+			}
+		}
+
+		if (next & 1) {
+			leftmost_end = p;
+		}
+
+		s = next >> 1;
+	}
+
+	if (!leftmost_end) {
+		return Result::NoMatch;
+	}
+
+	// Backward, to the leftmost position that match can begin at.
+	const char *found = nullptr;
+	p = leftmost_end;
+
+	int r = insert(reverse_, {reverse_.nfa.start}, (leftmost_end == end_of_string) ? endFlags : byteFlags_[static_cast<uint8_t>(*leftmost_end)]);
+	if (r < 0) {
+		return Result::GaveUp;
+	}
+
+	for (;; --p) {
+		const State &state = reverse_.states[static_cast<size_t>(r)];
+		if (state.threads.empty()) {
+			break;
+		}
+
+		if (p == start) {
+			if (startAllowed(p) && accepts(reverse_, r, makeContext(startFlags, state.flags))) {
+				found = p;
+			}
+			break;
+		}
+
+		const size_t cls = classes_[static_cast<uint8_t>(p[-1])];
+
+		int next = reverse_.transitions[static_cast<size_t>(r) * classCount + cls];
+		if (next < 0) {
+			next = transition(reverse_, r, static_cast<int>(cls));
+			if (next < 0) {
+				return Result::GaveUp;
+			}
+		}
+
+		if ((next & 1) && startAllowed(p)) {
+			found = p;
+		}
+
+		r = next >> 1;
+	}
+
+	// shouldn't happen, but the backtracking matcher has the final say
+	if (!found) {
+		return Result::GaveUp;
+	}
+
+	*match_start = found;
+	*match_end   = leftmost_end;
+	return Result::Match;
+}
@@ -0,0 +1,123 @@
+
+#ifndef DFA_H_
+#define DFA_H_
+
+#include <array>
+#include <bitset>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+struct ExecuteContext;
+
+/* A lazily built DFA which lets 'ExecRE' find where the leftmost match of a
+ * regex begins and ends in time linear in the length of the text.
+ *
+ * Only programs made of characters, classes, simple quantifiers, alternation,
+ * capturing parentheses and the zero width assertions are handled. Back
+ * references, look-around and general {m,n} counting are not regular, for
+ * those 'compile' returns nullptr and the backtracking matcher is used alone.
+ *
+ * The DFA does not know about captured text, so the backtracking matcher
+ * still has to run over the match to fill in the parentheses. 'ExecRE' keeps
+ * it inside the bounds the DFA found and remembers which nodes it has already
+ * failed at each position (while that table stays small), so the run takes
+ * time polynomial in the length of the match rather than exponential.
+ *
+ * States are built on demand and kept in a cache of bounded size, if a search
+ * keeps running out of room the DFA gives up and the caller falls back to the
+ * unbounded backtracker. */
+class Dfa {
+public:
+	enum class Result {
+		NoMatch,
+		Match,
+		GaveUp
+	};
+
+public:
+	static std::unique_ptr<Dfa> compile(uint8_t *program, const std::string &prefix, bool prefix_caseless);
+
+public:
+	Result search(ExecuteContext &ctx, const char *start, const char *limit, bool start_at_limit, const char *end_of_string, const char **match_start, const char **match_end);
+
+private:
+	struct Edge {
+		uint8_t type;     // EPSILON_EDGE, ASSERT_EDGE or CHAR_EDGE
+		uint8_t op;       // Opcode of the assertion for ASSERT_EDGE
+		uint16_t set;     // Index into 'sets_' for CHAR_EDGE
+		int target;
+	};
+
+	struct Node {
+		std::vector<Edge> edges;
+		bool accept = false;
+	};
+
+	struct Nfa {
+		std::vector<Node> nodes;
+		int start = 0;
+	};
+
+	struct CharacterSet {
+		std::bitset<256> bits;
+		uint8_t type;     // FIXED_SET, DELIMITER_SET or NOT_DELIMITER_SET
+	};
+
+	struct State {
+		std::vector<int> threads; // NFA nodes, highest priority first
+		uint8_t flags;
+	};
+
+	struct Automaton {
+		Nfa nfa;
+		bool leftmost = false;
+		std::vector<State> states;
+		std::vector<int> transitions; // For each state and byte class: (state << 1) | accepted, or -1 if not built yet
+		std::map<std::pair<uint8_t, std::vector<int>>, int> index;
+		size_t memory = 0;
+		int flushes   = 0;
+	};
+
+private:
+	bool build(uint8_t *program);
+	void reverse();
+	int newNode();
+	void addEdge(int from, uint8_t type, uint8_t op, uint16_t set, int target);
+	bool addSet(const std::bitset<256> &bits, uint8_t type, uint16_t *set);
+	void prepare(const ExecuteContext &ctx);
+	void closure(const Automaton &a, const std::vector<int> &threads, bool search, unsigned int context, bool *accepted);
+	void step(const Automaton &a, uint8_t byte, std::vector<int> *threads);
+	int insert(Automaton &a, std::vector<int> threads, uint8_t flags);
+	int transition(Automaton &a, int s, int cls);
+	int setSearching(Automaton &a, int s, bool searching);
+	bool accepts(const Automaton &a, int s, unsigned int context);
+
+private:
+	Automaton forward_;
+	Automaton reverse_;
+	std::vector<CharacterSet> sets_;
+
+	// Skipped to whenever no match is under way
+	std::string prefix_;
+	bool prefixCaseless_ = false;
+
+	// Derived from the word delimiters the states were built for
+	bool prepared_ = false;
+	std::bitset<256> delimiters_;
+	std::vector<std::bitset<256>> members_;
+	std::array<uint8_t, 256> classes_;
+	std::array<uint8_t, 256> byteFlags_;
+	std::vector<uint8_t> representatives_;
+
+	// Scratch space for building states
+	std::vector<int> stack_;
+	std::vector<int> closure_;
+	std::vector<uint32_t> marks_;
+	uint32_t generation_ = 0;
+};
+
+#endif
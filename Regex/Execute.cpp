@@ -2,10 +2,12 @@
 #include "Execute.h"
 #include "Common.h"
 #include "Compile.h"
+#include "Dfa.h"
 #include "Constants.h"
 #include "Opcodes.h"
 #include "RegexError.h"
 #include "Regex.h"
+#include "Util/Kernels.h"
 #include "Util/utils.h"
 
 #include <cassert>
@@ -32,8 +34,11 @@
 
 namespace {
 
-bool match(uint8_t *prog, size_t *branch_index_param);
-bool attempt(Regex *prog, const char *string);
+// Largest table of (node, position) pairs kept while confirming a DFA match
+constexpr size_t MAX_VISITED_BITS = 0x2000000;
+
+bool match(ExecuteContext &ctx, uint8_t *prog, size_t *branch_index_param);
+bool attempt(ExecuteContext &ctx, Regex *prog, const char *string);
 
 /* The next_ptr () function can consume up to 30% of the time during matching
    because it is called an immense number of times (an average of 25
@@ -67,19 +72,39 @@ FORCE_INLINE uint8_t *NEXT_PTR(uint8_t *ptr) {
  * @param ptr
  * @return
  */
-FORCE_INLINE bool AT_END_OF_STRING(const char *ptr) noexcept {
+FORCE_INLINE bool AT_END_OF_STRING(ExecuteContext &ctx, const char *ptr) noexcept {
 
-	if(eContext.End_Of_String != nullptr && ptr >= eContext.End_Of_String) {
+	if(ptr >= ctx.Real_End_Of_String) {
+		ctx.Hit_End = true;
 		return true;
 	}
 
-	if(ptr >= eContext.Real_End_Of_String) {
+	if(ctx.End_Of_String != nullptr && ptr >= ctx.End_Of_String) {
 		return true;
 	}
 
 	return false;
 }
 
+/**
+ * @brief find_literal
+ * @param first
+ * @param last
+ * @param text
+ * @param caseless
+ * @return the first occurrence of "text" in [first, last), or nullptr
+ */
+const char *find_literal(ExecuteContext &ctx, const char *first, const char *last, const std::string &text, bool caseless) noexcept {
+	const char *found = caseless ? Kernels::FindStringCaseless(first, last, text) : Kernels::FindString(first, last, text);
+
+	// an occurrence may run on past the end of the string
+	if (!found && last >= ctx.Real_End_Of_String) {
+		ctx.Hit_End = true;
+	}
+
+	return found;
+}
+
 /**
  * @brief getLower
  * @param p
@@ -103,10 +128,10 @@ FORCE_INLINE uint16_t getUpper(uint8_t *p) noexcept {
  * @param ch
  * @return
  */
-bool isDelimiter(int ch) noexcept {
+bool isDelimiter(const ExecuteContext &ctx, int ch) noexcept {
 	auto n = static_cast<unsigned int>(ch);
-	if(n < eContext.Current_Delimiters.size()) {
-		return eContext.Current_Delimiters[n];
+	if(n < ctx.Current_Delimiters.size()) {
+		return ctx.Current_Delimiters[n];
 	}
 
 	return false;
@@ -125,11 +150,11 @@ bool isDelimiter(int ch) noexcept {
  *
  * Returns the actual number of matches.
  *----------------------------------------------------------------------*/
-uint32_t greedy(uint8_t *p, uint32_t max) {
+uint32_t greedy(ExecuteContext &ctx, uint8_t *p, uint32_t max) {
 
 	uint32_t count = REG_ZERO;
 
-	const char *input_str = eContext.Reg_Input;
+	const char *input_str = ctx.Reg_Input;
 	uint8_t *operand = OPERAND(p); // Literal char or start of class characters.
 	uint32_t max_cmp = (max > 0) ? max : std::numeric_limits<uint32_t>::max();
 
@@ -138,7 +163,7 @@ uint32_t greedy(uint8_t *p, uint32_t max) {
 		/* Race to the end of the line or string. Dot DOESN'T match
 		   newline. */
 
-		while (count < max_cmp && !AT_END_OF_STRING(input_str) && *input_str != '\n') {
+		while (count < max_cmp && !AT_END_OF_STRING(ctx, input_str) && *input_str != '\n') {
 			count++;
 			input_str++;
 		}
@@ -148,7 +173,7 @@ uint32_t greedy(uint8_t *p, uint32_t max) {
 	case EVERY:
 		// Race to the end of the line or string. Dot DOES match newline.
 
-		while (count < max_cmp && !AT_END_OF_STRING(input_str)) {
+		while (count < max_cmp && !AT_END_OF_STRING(ctx, input_str)) {
 			count++;
 			input_str++;
 		}
@@ -156,7 +181,7 @@ uint32_t greedy(uint8_t *p, uint32_t max) {
 		break;
 
 	case EXACTLY: // Count occurrences of single character operand.
-		while (count < max_cmp && !AT_END_OF_STRING(input_str) && *operand == *input_str) {
+		while (count < max_cmp && !AT_END_OF_STRING(ctx, input_str) && *operand == *input_str) {
 			count++;
 			input_str++;
 		}
@@ -164,7 +189,7 @@ uint32_t greedy(uint8_t *p, uint32_t max) {
 		break;
 
 	case SIMILAR: // Case insensitive version of EXACTLY
-		while (count < max_cmp && !AT_END_OF_STRING(input_str) && *operand == safe_ctype<tolower>(*input_str)) {
+		while (count < max_cmp && !AT_END_OF_STRING(ctx, input_str) && *operand == safe_ctype<tolower>(*input_str)) {
 			count++;
 			input_str++;
 		}
@@ -172,7 +197,7 @@ uint32_t greedy(uint8_t *p, uint32_t max) {
 		break;
 
 	case ANY_OF: // [...] character class.
-		while (count < max_cmp && !AT_END_OF_STRING(input_str) && ::strchr(reinterpret_cast<char *>(operand), *input_str) != nullptr) {
+		while (count < max_cmp && !AT_END_OF_STRING(ctx, input_str) && ::strchr(reinterpret_cast<char *>(operand), *input_str) != nullptr) {
 
 			count++;
 			input_str++;
@@ -184,7 +209,7 @@ uint32_t greedy(uint8_t *p, uint32_t max) {
 					 match newline (\n added usually to operand at compile
 					 time.) */
 
-		while (count < max_cmp && !AT_END_OF_STRING(input_str) && ::strchr(reinterpret_cast<char *>(operand), *input_str) == nullptr) {
+		while (count < max_cmp && !AT_END_OF_STRING(ctx, input_str) && ::strchr(reinterpret_cast<char *>(operand), *input_str) == nullptr) {
 
 			count++;
 			input_str++;
@@ -195,7 +220,7 @@ uint32_t greedy(uint8_t *p, uint32_t max) {
 	case IS_DELIM: /* \y (not a word delimiter char)
 					   NOTE: '\n' and '\0' are always word delimiters. */
 
-		while (count < max_cmp && !AT_END_OF_STRING(input_str) && isDelimiter(*input_str)) {
+		while (count < max_cmp && !AT_END_OF_STRING(ctx, input_str) && isDelimiter(ctx, *input_str)) {
 			count++;
 			input_str++;
 		}
@@ -205,7 +230,7 @@ uint32_t greedy(uint8_t *p, uint32_t max) {
 	case NOT_DELIM: /* \Y (not a word delimiter char)
 					   NOTE: '\n' and '\0' are always word delimiters. */
 
-		while (count < max_cmp && !AT_END_OF_STRING(input_str) && !isDelimiter(*input_str)) {
+		while (count < max_cmp && !AT_END_OF_STRING(ctx, input_str) && !isDelimiter(ctx, *input_str)) {
 			count++;
 			input_str++;
 		}
@@ -213,7 +238,7 @@ uint32_t greedy(uint8_t *p, uint32_t max) {
 		break;
 
 	case WORD_CHAR: // \w (word character, alpha-numeric or underscore)
-		while (count < max_cmp && !AT_END_OF_STRING(input_str) && (safe_ctype<isalnum>(*input_str) || *input_str == '_')) {
+		while (count < max_cmp && !AT_END_OF_STRING(ctx, input_str) && (safe_ctype<isalnum>(*input_str) || *input_str == '_')) {
 
 			count++;
 			input_str++;
@@ -222,7 +247,7 @@ uint32_t greedy(uint8_t *p, uint32_t max) {
 		break;
 
 	case NOT_WORD_CHAR: // \W (NOT a word character)
-		while (count < max_cmp && !AT_END_OF_STRING(input_str) && !safe_ctype<isalnum>(*input_str) && *input_str != '_' && *input_str != '\n') {
+		while (count < max_cmp && !AT_END_OF_STRING(ctx, input_str) && !safe_ctype<isalnum>(*input_str) && *input_str != '_' && *input_str != '\n') {
 
 			count++;
 			input_str++;
@@ -231,7 +256,7 @@ uint32_t greedy(uint8_t *p, uint32_t max) {
 		break;
 
 	case DIGIT: // same as [0123456789]
-		while (count < max_cmp && !AT_END_OF_STRING(input_str) && safe_ctype<isdigit>(*input_str)) {
+		while (count < max_cmp && !AT_END_OF_STRING(ctx, input_str) && safe_ctype<isdigit>(*input_str)) {
 			count++;
 			input_str++;
 		}
@@ -239,7 +264,7 @@ uint32_t greedy(uint8_t *p, uint32_t max) {
 		break;
 
 	case NOT_DIGIT: // same as [^0123456789]
-		while (count < max_cmp && !AT_END_OF_STRING(input_str) && !safe_ctype<isdigit>(*input_str) && *input_str != '\n') {
+		while (count < max_cmp && !AT_END_OF_STRING(ctx, input_str) && !safe_ctype<isdigit>(*input_str) && *input_str != '\n') {
 
 			count++;
 			input_str++;
@@ -248,7 +273,7 @@ uint32_t greedy(uint8_t *p, uint32_t max) {
 		break;
 
 	case SPACE: // same as [ \t\r\f\v]-- doesn't match newline.
-		while (count < max_cmp && !AT_END_OF_STRING(input_str) && safe_ctype<isspace>(*input_str) && *input_str != '\n') {
+		while (count < max_cmp && !AT_END_OF_STRING(ctx, input_str) && safe_ctype<isspace>(*input_str) && *input_str != '\n') {
 
 			count++;
 			input_str++;
@@ -257,7 +282,7 @@ uint32_t greedy(uint8_t *p, uint32_t max) {
 		break;
 
 	case SPACE_NL: // same as [\n \t\r\f\v]-- matches newline.
-		while (count < max_cmp && !AT_END_OF_STRING(input_str) && safe_ctype<isspace>(*input_str)) {
+		while (count < max_cmp && !AT_END_OF_STRING(ctx, input_str) && safe_ctype<isspace>(*input_str)) {
 
 			count++;
 			input_str++;
@@ -266,7 +291,7 @@ uint32_t greedy(uint8_t *p, uint32_t max) {
 		break;
 
 	case NOT_SPACE: // same as [^\n \t\r\f\v]-- doesn't match newline.
-		while (count < max_cmp && !AT_END_OF_STRING(input_str) && !safe_ctype<isspace>(*input_str)) {
+		while (count < max_cmp && !AT_END_OF_STRING(ctx, input_str) && !safe_ctype<isspace>(*input_str)) {
 
 			count++;
 			input_str++;
@@ -275,7 +300,7 @@ uint32_t greedy(uint8_t *p, uint32_t max) {
 		break;
 
 	case NOT_SPACE_NL: // same as [^ \t\r\f\v]-- matches newline.
-		while (count < max_cmp && !AT_END_OF_STRING(input_str) && (!safe_ctype<isspace>(*input_str) || *input_str == '\n')) {
+		while (count < max_cmp && !AT_END_OF_STRING(ctx, input_str) && (!safe_ctype<isspace>(*input_str) || *input_str == '\n')) {
 
 			count++;
 			input_str++;
@@ -284,7 +309,7 @@ uint32_t greedy(uint8_t *p, uint32_t max) {
 		break;
 
 	case LETTER: // same as [a-zA-Z]
-		while (count < max_cmp && !AT_END_OF_STRING(input_str) && safe_ctype<isalpha>(*input_str)) {
+		while (count < max_cmp && !AT_END_OF_STRING(ctx, input_str) && safe_ctype<isalpha>(*input_str)) {
 
 			count++;
 			input_str++;
@@ -293,7 +318,7 @@ uint32_t greedy(uint8_t *p, uint32_t max) {
 		break;
 
 	case NOT_LETTER: // same as [^a-zA-Z]
-		while (count < max_cmp && !AT_END_OF_STRING(input_str) && !safe_ctype<isalpha>(*input_str) && *input_str != '\n') {
+		while (count < max_cmp && !AT_END_OF_STRING(ctx, input_str) && !safe_ctype<isalpha>(*input_str) && *input_str != '\n') {
 
 			count++;
 			input_str++;
@@ -312,7 +337,7 @@ uint32_t greedy(uint8_t *p, uint32_t max) {
 
 	// Point to character just after last matched character.
 
-	eContext.Reg_Input = input_str;
+	ctx.Reg_Input = input_str;
 
 	return count;
 }
@@ -329,28 +354,50 @@ uint32_t greedy(uint8_t *p, uint32_t max) {
  *----------------------------------------------------------------------*/
 #define MATCH_RETURN(X)             \
 	do {                            \
-		--eContext.Recursion_Count; \
+		--ctx.Recursion_Count; \
 	    return (X);                 \
 	} while(0)
 
 #define CHECK_RECURSION_LIMIT()                \
 	do {                                       \
-		if (eContext.Recursion_Limit_Exceeded) \
+		if (ctx.Recursion_Limit_Exceeded) \
 	        MATCH_RETURN(false);               \
 	} while(0)
 
 
-bool match(uint8_t *prog, size_t *branch_index_param) {
+bool match(ExecuteContext &ctx, uint8_t *prog, size_t *branch_index_param) {
 
 	uint8_t *next;          // Next node.
 
-	if (++eContext.Recursion_Count > REGEX_RECURSION_LIMIT) {
-		if (!eContext.Recursion_Limit_Exceeded) // Prevent duplicate errors
+	if (++ctx.Recursion_Count > REGEX_RECURSION_LIMIT) {
+		if (!ctx.Recursion_Limit_Exceeded) // Prevent duplicate errors
 			reg_error("recursion limit exceeded, please respecify expression");
-		eContext.Recursion_Limit_Exceeded = true;
+		ctx.Recursion_Limit_Exceeded = true;
 		MATCH_RETURN(false);
 	}
 
+	/* When confirming a match the DFA found, nothing past its end can be part
+	   of it, and without back references a node which failed at a position
+	   once will fail there every time */
+	if (ctx.Match_End) {
+		if (ctx.Reg_Input > ctx.Match_End) {
+			MATCH_RETURN(false);
+		}
+
+		if (ctx.Visited) {
+			const auto width = static_cast<size_t>(ctx.Match_End - ctx.Match_Begin) + 1;
+			const auto bit   = static_cast<size_t>(prog - ctx.Program) * width + static_cast<size_t>(ctx.Reg_Input - ctx.Match_Begin);
+
+			uint64_t &word      = ctx.Visited[bit / 64];
+			const uint64_t mask = uint64_t(1) << (bit % 64);
+			if (word & mask) {
+				MATCH_RETURN(false);
+			}
+
+			word |= mask;
+		}
+	}
+
 	// Current node.
 	uint8_t *scan = prog;
 
@@ -367,9 +414,9 @@ bool match(uint8_t *prog, size_t *branch_index_param) {
 				size_t branch_index_local = 0;
 
 				do {
-					save = eContext.Reg_Input;
+					save = ctx.Reg_Input;
 
-					if (match(OPERAND(scan), nullptr)) {
+					if (match(ctx, OPERAND(scan), nullptr)) {
 						if (branch_index_param)
 							*branch_index_param = branch_index_local;
 						MATCH_RETURN(true);
@@ -379,7 +426,7 @@ bool match(uint8_t *prog, size_t *branch_index_param) {
 
 					++branch_index_local;
 
-					eContext.Reg_Input = save; // Backtrack.
+					ctx.Reg_Input = save; // Backtrack.
 					scan = NEXT_PTR(scan);
 				} while (scan != nullptr && GET_OP_CODE(scan) == BRANCH);
 
@@ -393,22 +440,27 @@ bool match(uint8_t *prog, size_t *branch_index_param) {
 			uint8_t *opnd = OPERAND(scan);
 
 			// Inline the first character, for speed.
-			if (AT_END_OF_STRING(eContext.Reg_Input) || *opnd != *eContext.Reg_Input) {
+			if (AT_END_OF_STRING(ctx, ctx.Reg_Input) || *opnd != *ctx.Reg_Input) {
 				MATCH_RETURN(false);
 			}
 
 			const auto str = reinterpret_cast<const char *>(opnd);
 			const size_t len = strlen(str);
 
-			if (eContext.End_Of_String != nullptr && eContext.Reg_Input + len > eContext.End_Of_String) {
+			if (ctx.Reg_Input + len > ctx.Real_End_Of_String) {
+				ctx.Hit_End = true;
 				MATCH_RETURN(false);
 			}
 
-			if (len > 1 && strncmp(str, eContext.Reg_Input, len) != 0) {
+			if (ctx.End_Of_String != nullptr && ctx.Reg_Input + len > ctx.End_Of_String) {
 				MATCH_RETURN(false);
 			}
 
-			eContext.Reg_Input += len;
+			if (len > 1 && strncmp(str, ctx.Reg_Input, len) != 0) {
+				MATCH_RETURN(false);
+			}
+
+			ctx.Reg_Input += len;
 		}
 
 		break;
@@ -420,7 +472,7 @@ bool match(uint8_t *prog, size_t *branch_index_param) {
 			/* Note: the SIMILAR operand was converted to lower case during
 			   regex compile. */
 			while ((test = *opnd++) != '\0') {
-				if (AT_END_OF_STRING(eContext.Reg_Input) || tolower(*eContext.Reg_Input++) != test) {
+				if (AT_END_OF_STRING(ctx, ctx.Reg_Input) || tolower(*ctx.Reg_Input++) != test) {
 					MATCH_RETURN(false);
 				}
 			}
@@ -429,17 +481,17 @@ bool match(uint8_t *prog, size_t *branch_index_param) {
 		break;
 
 		case BOL: // '^' (beginning of line anchor)
-			if (eContext.Reg_Input == eContext.Start_Of_String) {
-				if (eContext.Prev_Is_BOL)
+			if (ctx.Reg_Input == ctx.Start_Of_String) {
+				if (ctx.Prev_Is_BOL)
 					break;
-			} else if (eContext.Reg_Input[-1] == '\n') {
+			} else if (ctx.Reg_Input[-1] == '\n') {
 				break;
 			}
 
 			MATCH_RETURN(false);
 
 		case EOL: // '$' anchor matches end of line and end of string
-			if ((AT_END_OF_STRING(eContext.Reg_Input) && eContext.Succ_Is_EOL) || *eContext.Reg_Input == '\n') {
+			if ((AT_END_OF_STRING(ctx, ctx.Reg_Input) && ctx.Succ_Is_EOL) || *ctx.Reg_Input == '\n') {
 				break;
 			}
 
@@ -450,17 +502,17 @@ bool match(uint8_t *prog, size_t *branch_index_param) {
 						and the preceding character is. */
 			{
 				bool prev_is_delim;
-				if (eContext.Reg_Input == eContext.Start_Of_String) {
-					prev_is_delim = eContext.Prev_Is_Delim;
+				if (ctx.Reg_Input == ctx.Start_Of_String) {
+					prev_is_delim = ctx.Prev_Is_Delim;
 				} else {
-					prev_is_delim = isDelimiter(eContext.Reg_Input[-1]);
+					prev_is_delim = isDelimiter(ctx, ctx.Reg_Input[-1]);
 				}
 				if (prev_is_delim) {
 					int current_is_delim;
-					if (AT_END_OF_STRING(eContext.Reg_Input)) {
-						current_is_delim = eContext.Succ_Is_Delim;
+					if (AT_END_OF_STRING(ctx, ctx.Reg_Input)) {
+						current_is_delim = ctx.Succ_Is_Delim;
 					} else {
-						current_is_delim = isDelimiter(*eContext.Reg_Input);
+						current_is_delim = isDelimiter(ctx, *ctx.Reg_Input);
 					}
 					if (!current_is_delim)
 						break;
@@ -474,17 +526,17 @@ bool match(uint8_t *prog, size_t *branch_index_param) {
 					and the preceding character is not. */
 			{
 				bool prev_is_delim;
-				if (eContext.Reg_Input == eContext.Start_Of_String) {
-					prev_is_delim = eContext.Prev_Is_Delim;
+				if (ctx.Reg_Input == ctx.Start_Of_String) {
+					prev_is_delim = ctx.Prev_Is_Delim;
 				} else {
-					prev_is_delim = isDelimiter(eContext.Reg_Input[-1]);
+					prev_is_delim = isDelimiter(ctx, ctx.Reg_Input[-1]);
 				}
 				if (!prev_is_delim) {
 					int current_is_delim;
-					if (AT_END_OF_STRING(eContext.Reg_Input)) {
-						current_is_delim = eContext.Succ_Is_Delim;
+					if (AT_END_OF_STRING(ctx, ctx.Reg_Input)) {
+						current_is_delim = ctx.Succ_Is_Delim;
 					} else {
-						current_is_delim = isDelimiter(*eContext.Reg_Input);
+						current_is_delim = isDelimiter(ctx, *ctx.Reg_Input);
 					}
 					if (current_is_delim)
 						break;
@@ -497,15 +549,15 @@ bool match(uint8_t *prog, size_t *branch_index_param) {
 		{
 			int prev_is_delim;
 			int current_is_delim;
-			if (eContext.Reg_Input == eContext.Start_Of_String) {
-				prev_is_delim = eContext.Prev_Is_Delim;
+			if (ctx.Reg_Input == ctx.Start_Of_String) {
+				prev_is_delim = ctx.Prev_Is_Delim;
 			} else {
-				prev_is_delim = isDelimiter(eContext.Reg_Input[-1]);
+				prev_is_delim = isDelimiter(ctx, ctx.Reg_Input[-1]);
 			}
-			if (AT_END_OF_STRING(eContext.Reg_Input)) {
-				current_is_delim = eContext.Succ_Is_Delim;
+			if (AT_END_OF_STRING(ctx, ctx.Reg_Input)) {
+				current_is_delim = ctx.Succ_Is_Delim;
 			} else {
-				current_is_delim = isDelimiter(*eContext.Reg_Input);
+				current_is_delim = isDelimiter(ctx, *ctx.Reg_Input);
 			}
 			if (!(prev_is_delim ^ current_is_delim))
 				break;
@@ -514,130 +566,130 @@ bool match(uint8_t *prog, size_t *branch_index_param) {
 			MATCH_RETURN(false);
 
 		case IS_DELIM: // \y (A word delimiter character.)
-			if (!AT_END_OF_STRING(eContext.Reg_Input) && isDelimiter(*eContext.Reg_Input)) {
-				eContext.Reg_Input++;
+			if (!AT_END_OF_STRING(ctx, ctx.Reg_Input) && isDelimiter(ctx, *ctx.Reg_Input)) {
+				ctx.Reg_Input++;
 				break;
 			}
 
 			MATCH_RETURN(false);
 
 		case NOT_DELIM: // \Y (NOT a word delimiter character.)
-			if (!AT_END_OF_STRING(eContext.Reg_Input) && !isDelimiter(*eContext.Reg_Input)) {
-				eContext.Reg_Input++;
+			if (!AT_END_OF_STRING(ctx, ctx.Reg_Input) && !isDelimiter(ctx, *ctx.Reg_Input)) {
+				ctx.Reg_Input++;
 				break;
 			}
 
 			MATCH_RETURN(false);
 
 		case WORD_CHAR: // \w (word character; alpha-numeric or underscore)
-			if (!AT_END_OF_STRING(eContext.Reg_Input) && (safe_ctype<isalnum>(*eContext.Reg_Input) || *eContext.Reg_Input == '_')) {
-				eContext.Reg_Input++;
+			if (!AT_END_OF_STRING(ctx, ctx.Reg_Input) && (safe_ctype<isalnum>(*ctx.Reg_Input) || *ctx.Reg_Input == '_')) {
+				ctx.Reg_Input++;
 				break;
 			}
 
 			MATCH_RETURN(false);
 
 		case NOT_WORD_CHAR: // \W (NOT a word character)
-			if (AT_END_OF_STRING(eContext.Reg_Input) || safe_ctype<isalnum>(*eContext.Reg_Input) || *eContext.Reg_Input == '_' || *eContext.Reg_Input == '\n')
+			if (AT_END_OF_STRING(ctx, ctx.Reg_Input) || safe_ctype<isalnum>(*ctx.Reg_Input) || *ctx.Reg_Input == '_' || *ctx.Reg_Input == '\n')
 				MATCH_RETURN(false);
 
-			eContext.Reg_Input++;
+			ctx.Reg_Input++;
 			break;
 
 		case ANY: // '.' (matches any character EXCEPT newline)
-			if (AT_END_OF_STRING(eContext.Reg_Input) || *eContext.Reg_Input == '\n')
+			if (AT_END_OF_STRING(ctx, ctx.Reg_Input) || *ctx.Reg_Input == '\n')
 				MATCH_RETURN(false);
 
-			eContext.Reg_Input++;
+			ctx.Reg_Input++;
 			break;
 
 		case EVERY: // '.' (matches any character INCLUDING newline)
-			if (AT_END_OF_STRING(eContext.Reg_Input))
+			if (AT_END_OF_STRING(ctx, ctx.Reg_Input))
 				MATCH_RETURN(false);
 
-			eContext.Reg_Input++;
+			ctx.Reg_Input++;
 			break;
 
 		case DIGIT: // \d, same as [0123456789]
-			if (AT_END_OF_STRING(eContext.Reg_Input) || !safe_ctype<isdigit>(*eContext.Reg_Input))
+			if (AT_END_OF_STRING(ctx, ctx.Reg_Input) || !safe_ctype<isdigit>(*ctx.Reg_Input))
 				MATCH_RETURN(false);
 
-			eContext.Reg_Input++;
+			ctx.Reg_Input++;
 			break;
 
 		case NOT_DIGIT: // \D, same as [^0123456789]
-			if (AT_END_OF_STRING(eContext.Reg_Input) || safe_ctype<isdigit>(*eContext.Reg_Input) || *eContext.Reg_Input == '\n')
+			if (AT_END_OF_STRING(ctx, ctx.Reg_Input) || safe_ctype<isdigit>(*ctx.Reg_Input) || *ctx.Reg_Input == '\n')
 				MATCH_RETURN(false);
 
-			eContext.Reg_Input++;
+			ctx.Reg_Input++;
 			break;
 
 		case LETTER: // \l, same as [a-zA-Z]
-			if (AT_END_OF_STRING(eContext.Reg_Input) || !safe_ctype<isalpha>(*eContext.Reg_Input))
+			if (AT_END_OF_STRING(ctx, ctx.Reg_Input) || !safe_ctype<isalpha>(*ctx.Reg_Input))
 				MATCH_RETURN(false);
 
-			eContext.Reg_Input++;
+			ctx.Reg_Input++;
 			break;
 
 		case NOT_LETTER: // \L, same as [^0123456789]
-			if (AT_END_OF_STRING(eContext.Reg_Input) || safe_ctype<isalpha>(*eContext.Reg_Input) || *eContext.Reg_Input == '\n')
+			if (AT_END_OF_STRING(ctx, ctx.Reg_Input) || safe_ctype<isalpha>(*ctx.Reg_Input) || *ctx.Reg_Input == '\n')
 				MATCH_RETURN(false);
 
-			eContext.Reg_Input++;
+			ctx.Reg_Input++;
 			break;
 
 		case SPACE: // \s, same as [ \t\r\f\v]
-			if (AT_END_OF_STRING(eContext.Reg_Input) || !safe_ctype<isspace>(*eContext.Reg_Input) || *eContext.Reg_Input == '\n')
+			if (AT_END_OF_STRING(ctx, ctx.Reg_Input) || !safe_ctype<isspace>(*ctx.Reg_Input) || *ctx.Reg_Input == '\n')
 				MATCH_RETURN(false);
 
-			eContext.Reg_Input++;
+			ctx.Reg_Input++;
 			break;
 
 		case SPACE_NL: // \s, same as [\n \t\r\f\v]
-			if (AT_END_OF_STRING(eContext.Reg_Input) || !safe_ctype<isspace>(*eContext.Reg_Input))
+			if (AT_END_OF_STRING(ctx, ctx.Reg_Input) || !safe_ctype<isspace>(*ctx.Reg_Input))
 				MATCH_RETURN(false);
 
-			eContext.Reg_Input++;
+			ctx.Reg_Input++;
 			break;
 
 		case NOT_SPACE: // \S, same as [^\n \t\r\f\v]
-			if (AT_END_OF_STRING(eContext.Reg_Input) || safe_ctype<isspace>(*eContext.Reg_Input))
+			if (AT_END_OF_STRING(ctx, ctx.Reg_Input) || safe_ctype<isspace>(*ctx.Reg_Input))
 				MATCH_RETURN(false);
 
-			eContext.Reg_Input++;
+			ctx.Reg_Input++;
 			break;
 
 		case NOT_SPACE_NL: // \S, same as [^ \t\r\f\v]
-			if (AT_END_OF_STRING(eContext.Reg_Input) || (safe_ctype<isspace>(*eContext.Reg_Input) && *eContext.Reg_Input != '\n'))
+			if (AT_END_OF_STRING(ctx, ctx.Reg_Input) || (safe_ctype<isspace>(*ctx.Reg_Input) && *ctx.Reg_Input != '\n'))
 				MATCH_RETURN(false);
 
-			eContext.Reg_Input++;
+			ctx.Reg_Input++;
 			break;
 
 		case ANY_OF: // [...] character class.
-			if (AT_END_OF_STRING(eContext.Reg_Input))
+			if (AT_END_OF_STRING(ctx, ctx.Reg_Input))
 				MATCH_RETURN(false); /* Needed because strchr () considers \0
 										as a member of the character set. */
 
-			if (::strchr(reinterpret_cast<char *>(OPERAND(scan)), *eContext.Reg_Input) == nullptr) {
+			if (::strchr(reinterpret_cast<char *>(OPERAND(scan)), *ctx.Reg_Input) == nullptr) {
 				MATCH_RETURN(false);
 			}
 
-			eContext.Reg_Input++;
+			ctx.Reg_Input++;
 			break;
 
 		case ANY_BUT: /* [^...] Negated character class-- does NOT normally
 					  match newline (\n added usually to operand at compile
 					  time.) */
 
-			if (AT_END_OF_STRING(eContext.Reg_Input))
+			if (AT_END_OF_STRING(ctx, ctx.Reg_Input))
 				MATCH_RETURN(false); // See comment for ANY_OF.
 
-			if (::strchr(reinterpret_cast<char *>(OPERAND(scan)), *eContext.Reg_Input) != nullptr) {
+			if (::strchr(reinterpret_cast<char *>(OPERAND(scan)), *ctx.Reg_Input) != nullptr) {
 				MATCH_RETURN(false);
 			}
 
-			eContext.Reg_Input++;
+			ctx.Reg_Input++;
 			break;
 
 		case NOTHING:
@@ -711,19 +763,27 @@ bool match(uint8_t *prog, size_t *branch_index_param) {
 				next_op = OPERAND(scan + (2 * NEXT_PTR_SIZE));
 			}
 
-			save = eContext.Reg_Input;
+			if (ctx.Match_End) {
+				if (ctx.Reg_Input > ctx.Match_End) {
+					MATCH_RETURN(false);
+				}
+
+				max = static_cast<uint32_t>(std::min<size_t>(max, static_cast<size_t>(ctx.Match_End - ctx.Reg_Input)));
+			}
+
+			save = ctx.Reg_Input;
 
 			if (lazy) {
 				if (min > REG_ZERO) {
-					num_matched = greedy(next_op, min);
+					num_matched = greedy(ctx, next_op, min);
 				}
 			} else {
-				num_matched = greedy(next_op, max);
+				num_matched = greedy(ctx, next_op, max);
 			}
 
 			while (min <= num_matched && num_matched <= max) {
-				if (next_char == '\0' || (!AT_END_OF_STRING(eContext.Reg_Input) && next_char == *eContext.Reg_Input)) {
-					if (match(next, nullptr))
+				if (next_char == '\0' || (!AT_END_OF_STRING(ctx, ctx.Reg_Input) && next_char == *ctx.Reg_Input)) {
+					if (match(ctx, next, nullptr))
 						MATCH_RETURN(true);
 
 					CHECK_RECURSION_LIMIT();
@@ -732,7 +792,10 @@ bool match(uint8_t *prog, size_t *branch_index_param) {
 				// Couldn't or didn't match.
 
 				if (lazy) {
-					if (!greedy(next_op, 1))
+					// The failed match may have moved the input, inch forward from where we were.
+					ctx.Reg_Input = save + num_matched;
+
+					if (!greedy(ctx, next_op, 1))
 						MATCH_RETURN(false);
 
 					num_matched++; // Inch forward.
@@ -742,7 +805,7 @@ bool match(uint8_t *prog, size_t *branch_index_param) {
 					break;
 				}
 
-				eContext.Reg_Input = save + num_matched;
+				ctx.Reg_Input = save + num_matched;
 			}
 
 			MATCH_RETURN(false);
@@ -751,23 +814,23 @@ bool match(uint8_t *prog, size_t *branch_index_param) {
 		break;
 
 		case END:
-			if (eContext.Extent_Ptr_FW == nullptr || (eContext.Reg_Input - eContext.Extent_Ptr_FW) > 0) {
-				eContext.Extent_Ptr_FW = eContext.Reg_Input;
+			if (ctx.Extent_Ptr_FW == nullptr || (ctx.Reg_Input - ctx.Extent_Ptr_FW) > 0) {
+				ctx.Extent_Ptr_FW = ctx.Reg_Input;
 			}
 
 			MATCH_RETURN(true); // Success!
 			break;
 
 		case INIT_COUNT:
-			eContext.BraceCounts[*OPERAND(scan)] = REG_ZERO;
+			ctx.BraceCounts[*OPERAND(scan)] = REG_ZERO;
 			break;
 
 		case INC_COUNT:
-			eContext.BraceCounts[*OPERAND(scan)]++;
+			ctx.BraceCounts[*OPERAND(scan)]++;
 			break;
 
 		case TEST_COUNT:
-			if (eContext.BraceCounts[*OPERAND(scan)] < static_cast<uint32_t>(GET_OFFSET(scan + NEXT_PTR_SIZE + INDEX_SIZE))) {
+			if (ctx.BraceCounts[*OPERAND(scan)] < static_cast<uint32_t>(GET_OFFSET(scan + NEXT_PTR_SIZE + INDEX_SIZE))) {
 				next = scan + NODE_SIZE + INDEX_SIZE + NEXT_PTR_SIZE;
 			}
 			break;
@@ -785,15 +848,15 @@ bool match(uint8_t *prog, size_t *branch_index_param) {
 
 #ifdef ENABLE_CROSS_REGEX_BACKREF
 				if (GET_OP_CODE (scan) == X_REGEX_BR || GET_OP_CODE (scan) == X_REGEX_BR_CI) {
-				   if (eContext.Cross_Regex_Backref == nullptr)
+				   if (ctx.Cross_Regex_Backref == nullptr)
 					   MATCH_RETURN (0);
 
-				   captured = eContext.Cross_Regex_Backref->startp [paren_no];
-				   finish   = eContext.Cross_Regex_Backref->endp   [paren_no];
+				   captured = ctx.Cross_Regex_Backref->startp [paren_no];
+				   finish   = ctx.Cross_Regex_Backref->endp   [paren_no];
 				} else {
 #endif
-					captured = eContext.Back_Ref_Start[paren_no];
-					finish   = eContext.Back_Ref_End[paren_no];
+					captured = ctx.Back_Ref_Start[paren_no];
+					finish   = ctx.Back_Ref_End[paren_no];
 #ifdef ENABLE_CROSS_REGEX_BACKREF
 				}
 #endif
@@ -808,13 +871,13 @@ bool match(uint8_t *prog, size_t *branch_index_param) {
 					if (GET_OP_CODE(scan) == BACK_REF_CI) {
 #endif
 						while (captured < finish) {
-							if (AT_END_OF_STRING(eContext.Reg_Input) || tolower(*captured++) != safe_ctype<tolower>(*eContext.Reg_Input++)) {
+							if (AT_END_OF_STRING(ctx, ctx.Reg_Input) || tolower(*captured++) != safe_ctype<tolower>(*ctx.Reg_Input++)) {
 								MATCH_RETURN(false);
 							}
 						}
 					} else {
 						while (captured < finish) {
-							if (AT_END_OF_STRING(eContext.Reg_Input) || *captured++ != *eContext.Reg_Input++)
+							if (AT_END_OF_STRING(ctx, ctx.Reg_Input) || *captured++ != *ctx.Reg_Input++)
 								MATCH_RETURN(false);
 						}
 					}
@@ -828,14 +891,14 @@ bool match(uint8_t *prog, size_t *branch_index_param) {
 		case POS_AHEAD_OPEN:
 		case NEG_AHEAD_OPEN: {
 
-			const char *save = eContext.Reg_Input;
+			const char *save = ctx.Reg_Input;
 
 			/* Temporarily ignore the logical end of the string, to allow
 			   lookahead past the end. */
-			const char *saved_end = eContext.End_Of_String;
-			eContext.End_Of_String = nullptr;
+			const char *saved_end = ctx.End_Of_String;
+			ctx.End_Of_String = nullptr;
 
-			bool answer = match(next, nullptr); // Does the look-ahead regex match?
+			bool answer = match(ctx, next, nullptr); // Does the look-ahead regex match?
 
 			CHECK_RECURSION_LIMIT();
 
@@ -848,12 +911,12 @@ bool match(uint8_t *prog, size_t *branch_index_param) {
 				   may need more text than it matches to accomplish a
 				   re-match. */
 
-				if (eContext.Extent_Ptr_FW == nullptr || (eContext.Reg_Input - eContext.Extent_Ptr_FW) > 0) {
-					eContext.Extent_Ptr_FW = eContext.Reg_Input;
+				if (ctx.Extent_Ptr_FW == nullptr || (ctx.Reg_Input - ctx.Extent_Ptr_FW) > 0) {
+					ctx.Extent_Ptr_FW = ctx.Reg_Input;
 				}
 
-				eContext.Reg_Input = save;          // Backtrack to look-ahead start.
-				eContext.End_Of_String = saved_end; // Restore logical end.
+				ctx.Reg_Input = save;          // Backtrack to look-ahead start.
+				ctx.End_Of_String = saved_end; // Restore logical end.
 
 				/* Jump to the node just after the (?=...) or (?!...)
 				   Construct. */
@@ -864,8 +927,8 @@ bool match(uint8_t *prog, size_t *branch_index_param) {
 					next = NEXT_PTR(next);
 				next = NEXT_PTR(next); // Skip the LOOK_AHEAD_CLOSE
 			} else {
-				eContext.Reg_Input = save;          // Backtrack to look-ahead start.
-				eContext.End_Of_String = saved_end; // Restore logical end.
+				ctx.Reg_Input = save;          // Backtrack to look-ahead start.
+				ctx.End_Of_String = saved_end; // Restore logical end.
 
 				MATCH_RETURN(false);
 			}
@@ -879,13 +942,13 @@ bool match(uint8_t *prog, size_t *branch_index_param) {
 			bool found = false;
 			const char *saved_end;
 
-			save = eContext.Reg_Input;
-			saved_end = eContext.End_Of_String;
+			save = ctx.Reg_Input;
+			saved_end = ctx.End_Of_String;
 
 			/* Prevent overshoot (greedy matching could end past the
 			   current position) by tightening the matching boundary.
 			   Lookahead inside lookbehind can still cross that boundary. */
-			eContext.End_Of_String = eContext.Reg_Input;
+			ctx.End_Of_String = ctx.Reg_Input;
 
 			uint16_t lower = getLower(scan);
 			uint16_t upper = getUpper(scan);
@@ -896,20 +959,20 @@ bool match(uint8_t *prog, size_t *branch_index_param) {
 			   is not constant: we have to make sure the expression doesn't
 			   match for _any_ of the starting positions. */
 			for (uint32_t offset = lower; offset <= upper; ++offset) {
-				eContext.Reg_Input = save - offset;
+				ctx.Reg_Input = save - offset;
 
-				if (eContext.Reg_Input < eContext.Look_Behind_To) {
+				if (ctx.Reg_Input < ctx.Look_Behind_To) {
 					// No need to look any further
 					break;
 				}
 
-				int answer = match(next, nullptr); // Does the look-behind regex match?
+				int answer = match(ctx, next, nullptr); // Does the look-behind regex match?
 
 				CHECK_RECURSION_LIMIT();
 
 				/* The match must have ended at the current position;
 				   otherwise it is invalid */
-				if (answer && eContext.Reg_Input == save) {
+				if (answer && ctx.Reg_Input == save) {
 					// It matched, exactly far enough
 					found = true;
 
@@ -921,8 +984,8 @@ bool match(uint8_t *prog, size_t *branch_index_param) {
 					   leading look-behind may need more text than it matches
 					   to accomplish a re-match. */
 
-					if (eContext.Extent_Ptr_BW == nullptr || (eContext.Extent_Ptr_BW - (save - offset)) > 0) {
-						eContext.Extent_Ptr_BW = save - offset;
+					if (ctx.Extent_Ptr_BW == nullptr || (ctx.Extent_Ptr_BW - (save - offset)) > 0) {
+						ctx.Extent_Ptr_BW = save - offset;
 					}
 
 					break;
@@ -930,8 +993,8 @@ bool match(uint8_t *prog, size_t *branch_index_param) {
 			}
 
 			// Always restore the position and the logical string end.
-			eContext.Reg_Input = save;
-			eContext.End_Of_String = saved_end;
+			ctx.Reg_Input = save;
+			ctx.End_Of_String = saved_end;
 
 			if ((GET_OP_CODE(scan) == POS_BEHIND_OPEN) ? found : !found) {
 				/* The look-behind matches, so we must jump to the next
@@ -959,19 +1022,19 @@ bool match(uint8_t *prog, size_t *branch_index_param) {
 			if ((GET_OP_CODE(scan) > OPEN) && (GET_OP_CODE(scan) < OPEN + NSUBEXP)) {
 
 				uint8_t no = GET_OP_CODE(scan) - OPEN;
-				const char *save = eContext.Reg_Input;
+				const char *save = ctx.Reg_Input;
 
 				if (no < 10) {
-					eContext.Back_Ref_Start[no] = save;
-					eContext.Back_Ref_End[no] = nullptr;
+					ctx.Back_Ref_Start[no] = save;
+					ctx.Back_Ref_End[no] = nullptr;
 				}
 
-				if (match(next, nullptr)) {
+				if (match(ctx, next, nullptr)) {
 					/* Do not set 'Start_Ptr_Ptr' if some later invocation (think
 					   recursion) of the same parentheses already has. */
 
-					if (eContext.Start_Ptr_Ptr[no] == nullptr) {
-						eContext.Start_Ptr_Ptr[no] = save;
+					if (ctx.Start_Ptr_Ptr[no] == nullptr) {
+						ctx.Start_Ptr_Ptr[no] = save;
 					}
 
 					MATCH_RETURN(true);
@@ -981,17 +1044,17 @@ bool match(uint8_t *prog, size_t *branch_index_param) {
 			} else if ((GET_OP_CODE(scan) > CLOSE) && (GET_OP_CODE(scan) < CLOSE + NSUBEXP)) {
 
 				uint8_t no       = GET_OP_CODE(scan) - CLOSE;
-				const char *save = eContext.Reg_Input;
+				const char *save = ctx.Reg_Input;
 
 				if (no < 10)
-					eContext.Back_Ref_End[no] = save;
+					ctx.Back_Ref_End[no] = save;
 
-				if (match(next, nullptr)) {
+				if (match(ctx, next, nullptr)) {
 					/* Do not set 'End_Ptr_Ptr' if some later invocation of the
 					   same parentheses already has. */
 
-					if (eContext.End_Ptr_Ptr[no] == nullptr) {
-						eContext.End_Ptr_Ptr[no] = save;
+					if (ctx.End_Ptr_Ptr[no] == nullptr) {
+						ctx.End_Ptr_Ptr[no] = save;
 					}
 
 					MATCH_RETURN(true);
@@ -1021,29 +1084,29 @@ bool match(uint8_t *prog, size_t *branch_index_param) {
 /*----------------------------------------------------------------------*
  * attempt - try match at specific point, returns: false failure, true success
  *----------------------------------------------------------------------*/
-bool attempt(Regex *prog, const char *string) {
+bool attempt(ExecuteContext &ctx, Regex *prog, const char *string) {
 
 	size_t branch_index = 0; // Must be set to zero !
 
-	eContext.Reg_Input     = string;
-	eContext.Start_Ptr_Ptr = prog->startp.begin();
-	eContext.End_Ptr_Ptr   = prog->endp.begin();
+	ctx.Reg_Input     = string;
+	ctx.Start_Ptr_Ptr = prog->startp.begin();
+	ctx.End_Ptr_Ptr   = prog->endp.begin();
 
 	// Reset the recursion counter.
-	eContext.Recursion_Count = 0;
+	ctx.Recursion_Count = 0;
 
 	// Overhead due to capturing parentheses.
-	eContext.Extent_Ptr_BW = string;
-	eContext.Extent_Ptr_FW = nullptr;
+	ctx.Extent_Ptr_BW = string;
+	ctx.Extent_Ptr_FW = nullptr;
 
-	std::fill_n(prog->startp.begin(), pContext.Total_Paren + 1, nullptr);
-	std::fill_n(prog->endp.begin(),   pContext.Total_Paren + 1, nullptr);
+	std::fill_n(prog->startp.begin(), ctx.Total_Paren + 1, nullptr);
+	std::fill_n(prog->endp.begin(),   ctx.Total_Paren + 1, nullptr);
 
-	if (match((&prog->program[0] + REGEX_START_OFFSET), &branch_index)) {
+	if (match(ctx, (&prog->program[0] + REGEX_START_OFFSET), &branch_index)) {
 		prog->startp[0]  = string;
-		prog->endp[0]    = eContext.Reg_Input;     // <-- One char AFTER
-		prog->extentpBW  = eContext.Extent_Ptr_BW; //     matched string!
-		prog->extentpFW  = eContext.Extent_Ptr_FW;
+		prog->endp[0]    = ctx.Reg_Input;     // <-- One char AFTER
+		prog->extentpBW  = ctx.Extent_Ptr_BW; //     matched string!
+		prog->extentpFW  = ctx.Extent_Ptr_FW;
 		prog->top_branch = branch_index;
 
 		return true;
@@ -1052,6 +1115,32 @@ bool attempt(Regex *prog, const char *string) {
 	return false;
 }
 
+/*----------------------------------------------------------------------*
+ * attemptWithin - try the match the DFA found from "first" to "last",
+ * returns: false failure, true success
+ *----------------------------------------------------------------------*/
+bool attemptWithin(ExecuteContext &ctx, Regex *prog, const char *first, const char *last) {
+
+	ctx.Match_Begin = first;
+	ctx.Match_End   = last;
+
+	const size_t bits = prog->program.size() * (static_cast<size_t>(last - first) + 1);
+	if (bits <= MAX_VISITED_BITS) {
+		prog->visited.assign((bits + 63) / 64, 0);
+		ctx.Program = &prog->program[0];
+		ctx.Visited = prog->visited.data();
+	}
+
+	const bool found = attempt(ctx, prog, first);
+
+	ctx.Program     = nullptr;
+	ctx.Match_Begin = nullptr;
+	ctx.Match_End   = nullptr;
+	ctx.Visited     = nullptr;
+
+	return found;
+}
+
 }
 
 /*
@@ -1105,6 +1194,7 @@ look_behind_to start             end           match_to
 bool Regex::ExecRE(const char *start, const char *end, bool reverse, int prev_char, int succ_char, const char *delimiters, const char *look_behind_to, const char *match_to, const char *string_end) {
 
 	Regex *const re = this;
+	ExecuteContext ctx;
 
 	// Check validity of program.
 	if (U_CHAR_AT(&re->program[0]) != MAGIC) {
@@ -1116,14 +1206,15 @@ bool Regex::ExecRE(const char *start, const char *end, bool reverse, int prev_ch
 	bool ret_val = false;
 
 	// If caller has supplied delimiters, make a delimiter table
-	eContext.Current_Delimiters = delimiters ? Regex::makeDelimiterTable(delimiters) : Regex::Default_Delimiters;
+	ctx.Current_Delimiters = delimiters ? Regex::makeDelimiterTable(delimiters) : Regex::DefaultDelimiterTable();
 
 	// Remember the logical and physical end of the string.
-	eContext.End_Of_String      = match_to;
-	eContext.Real_End_Of_String = string_end;
+	ctx.End_Of_String      = match_to;
+	ctx.Real_End_Of_String = string_end;
+	ctx.Hit_End            = false;
 
 	if (!end && reverse) {
-		for (end = start; !AT_END_OF_STRING(end); end++) {
+		for (end = start; !AT_END_OF_STRING(ctx, end); end++) {
 		}
 		succ_char = '\n';
 	} else if(!end) {
@@ -1131,24 +1222,22 @@ bool Regex::ExecRE(const char *start, const char *end, bool reverse, int prev_ch
 	}
 
 	// Remember the beginning of the string for matching BOL
-	eContext.Start_Of_String = start;
-	eContext.Look_Behind_To  = (look_behind_to ? look_behind_to : start);
+	ctx.Start_Of_String = start;
+	ctx.Look_Behind_To  = (look_behind_to ? look_behind_to : start);
 
-	eContext.Prev_Is_BOL   = (prev_char == '\n') || (prev_char == -1);
-	eContext.Succ_Is_EOL   = (succ_char == '\n') || (succ_char == -1);
-	eContext.Prev_Is_Delim = (prev_char == -1) || eContext.Current_Delimiters[static_cast<uint8_t>(prev_char)];
-	eContext.Succ_Is_Delim = (succ_char == -1) || eContext.Current_Delimiters[static_cast<uint8_t>(succ_char)];
+	ctx.Prev_Is_BOL   = (prev_char == '\n') || (prev_char == -1);
+	ctx.Succ_Is_EOL   = (succ_char == '\n') || (succ_char == -1);
+	ctx.Prev_Is_Delim = (prev_char == -1) || ctx.Current_Delimiters[static_cast<uint8_t>(prev_char)];
+	ctx.Succ_Is_Delim = (succ_char == -1) || ctx.Current_Delimiters[static_cast<uint8_t>(succ_char)];
 
-	pContext.Total_Paren = re->program[1];
-	pContext.Num_Braces  = re->program[2];
+	ctx.Total_Paren = re->program[1];
+	ctx.Num_Braces  = re->program[2];
 
 	// Reset the recursion detection flag
-	eContext.Recursion_Limit_Exceeded = false;
+	ctx.Recursion_Limit_Exceeded = false;
 
-	// Allocate memory for {m,n} construct counting variables if need be.
-	if (pContext.Num_Braces > 0) {
-		eContext.BraceCounts = std::make_unique<uint32_t[]>(pContext.Num_Braces);
-	}
+	// Reset the {m,n} construct counting variables.
+	std::fill_n(ctx.BraceCounts.begin(), ctx.Num_Braces, 0);
 
 	/* Initialize the first nine (9) capturing parentheses start and end
 	   pointers to point to the start of the search string.  This is to prevent
@@ -1158,8 +1247,10 @@ bool Regex::ExecRE(const char *start, const char *end, bool reverse, int prev_ch
 	std::fill_n(re->startp.begin(), 9, start);
 	std::fill_n(re->endp.begin(),   9, start);
 
-	auto checked_return = [](bool value) {
-		if (eContext.Recursion_Limit_Exceeded) {
+	auto checked_return = [re, &ctx](bool value) {
+		re->hit_end = ctx.Hit_End;
+
+		if (ctx.Recursion_Limit_Exceeded) {
 			return false;
 		}
 
@@ -1167,17 +1258,75 @@ bool Regex::ExecRE(const char *start, const char *end, bool reverse, int prev_ch
 	};
 
 	if (!reverse) { // Forward Search
+
+		/* Matches may start anywhere before "limit", and at "limit" itself
+		   only where the loops below would try it. */
+		const char *first = start;
+
+		const char *end_of_string = ctx.Real_End_Of_String;
+		if (ctx.End_Of_String != nullptr && ctx.End_Of_String < end_of_string) {
+			end_of_string = ctx.End_Of_String;
+		}
+
+		const char *limit = (end != nullptr && end < end_of_string) ? end : end_of_string;
+
+		// Without the text every match contains, there's nothing to find.
+		if (!re->required.empty() && re->required != re->prefix && !find_literal(ctx, start, end_of_string, re->required, re->required_caseless)) {
+			return checked_return(false);
+		}
+
+		// Nor can the leftmost match begin before the text every match begins with.
+		if (!re->prefix.empty()) {
+			first = find_literal(ctx, start, end_of_string, re->prefix, re->prefix_caseless);
+			if (!first || first > limit || (first == limit && !re->anchor)) {
+				return checked_return(false);
+			}
+		}
+
+		/* Let the DFA (if the regex has one) find where the leftmost match
+		   starts and ends, or tell us that there isn't one at all, without
+		   trying to match at each position in between. The backtracker then
+		   only has to fill in the parentheses of that one match. */
+		if (re->dfa && end_of_string - first > 1) {
+			bool start_at_limit;
+			if (re->anchor) {
+				start_at_limit = (limit == start || limit[-1] == '\n');
+			} else if (re->match_start != '\0') {
+				start_at_limit = false;
+			} else {
+				start_at_limit = (limit == end_of_string && end != end_of_string);
+			}
+
+			const char *from = first;
+			const char *last = nullptr;
+			switch (re->dfa->search(ctx, from, limit, start_at_limit, end_of_string, &first, &last)) {
+			case Dfa::Result::NoMatch:
+				return checked_return(false);
+			case Dfa::Result::Match:
+				if (attemptWithin(ctx, re, first, last)) {
+					ret_val = true;
+					return checked_return(ret_val);
+				}
+
+				// shouldn't happen, but let the loops below try it unbounded
+				break;
+			case Dfa::Result::GaveUp:
+				first = from;
+				break;
+			}
+		}
+
 		if (re->anchor) {
 			// Search is anchored at BOL
-			if (attempt(re, start)) {
+			if (first == start && attempt(ctx, re, start)) {
 				ret_val = true;
 				return checked_return(ret_val);
 			}
 
-			for (str = start; !AT_END_OF_STRING(str) && str != end && !eContext.Recursion_Limit_Exceeded; str++) {
+			for (str = (first == start) ? start : first - 1; !AT_END_OF_STRING(ctx, str) && str != end && !ctx.Recursion_Limit_Exceeded; str++) {
 
 				if (*str == '\n') {
-					if (attempt(re, str + 1)) {
+					if (attempt(ctx, re, str + 1)) {
 						ret_val = true;
 						break;
 					}
@@ -1186,12 +1335,24 @@ bool Regex::ExecRE(const char *start, const char *end, bool reverse, int prev_ch
 
 			return checked_return(ret_val);
 
+		} else if (!re->prefix.empty()) {
+			// We know what text the match must start with.
+			for (str = first; str != nullptr && str < limit && !ctx.Recursion_Limit_Exceeded; str = find_literal(ctx, str + 1, end_of_string, re->prefix, re->prefix_caseless)) {
+
+				if (attempt(ctx, re, str)) {
+					ret_val = true;
+					break;
+				}
+			}
+
+			return checked_return(ret_val);
+
 		} else if (re->match_start != '\0') {
 			// We know what char match must start with.
-			for (str = start; !AT_END_OF_STRING(str) && str != end && !eContext.Recursion_Limit_Exceeded; str++) {
+			for (str = first; !AT_END_OF_STRING(ctx, str) && str != end && !ctx.Recursion_Limit_Exceeded; str++) {
 
 				if (*str == static_cast<uint8_t>(re->match_start)) {
-					if (attempt(re, str)) {
+					if (attempt(ctx, re, str)) {
 						ret_val = true;
 						break;
 					}
@@ -1201,17 +1362,17 @@ bool Regex::ExecRE(const char *start, const char *end, bool reverse, int prev_ch
 			return checked_return(ret_val);
 		} else {
 			// General case
-			for (str = start; !AT_END_OF_STRING(str) && str != end && !eContext.Recursion_Limit_Exceeded; str++) {
+			for (str = first; !AT_END_OF_STRING(ctx, str) && str != end && !ctx.Recursion_Limit_Exceeded; str++) {
 
-				if (attempt(re, str)) {
+				if (attempt(ctx, re, str)) {
 					ret_val = true;
 					break;
 				}
 			}
 
 			// Beware of a single $ matching \0
-			if (!eContext.Recursion_Limit_Exceeded && !ret_val && AT_END_OF_STRING(str) && str != end) {
-				if (attempt(re, str)) {
+			if (!ctx.Recursion_Limit_Exceeded && !ret_val && AT_END_OF_STRING(ctx, str) && str != end) {
+				if (attempt(ctx, re, str)) {
 					ret_val = true;
 				}
 			}
@@ -1221,32 +1382,42 @@ bool Regex::ExecRE(const char *start, const char *end, bool reverse, int prev_ch
 	} else { // Search reverse, same as forward, but loops run backward
 
 		// Make sure that we don't start matching beyond the logical end
-		if (eContext.End_Of_String != nullptr && end > eContext.End_Of_String) {
-			end = eContext.End_Of_String;
+		if (ctx.End_Of_String != nullptr && end > ctx.End_Of_String) {
+			end = ctx.End_Of_String;
+		}
+
+		// Without the text every match contains, there's nothing to find.
+		const char *end_of_string = ctx.Real_End_Of_String;
+		if (ctx.End_Of_String != nullptr && ctx.End_Of_String < end_of_string) {
+			end_of_string = ctx.End_Of_String;
+		}
+
+		if (!re->required.empty() && !find_literal(ctx, start, end_of_string, re->required, re->required_caseless)) {
+			return checked_return(false);
 		}
 
 		if (re->anchor) {
 			// Search is anchored at BOL
-			for (str = (end - 1); str >= start && !eContext.Recursion_Limit_Exceeded; str--) {
+			for (str = (end - 1); str >= start && !ctx.Recursion_Limit_Exceeded; str--) {
 				if (*str == '\n') {
-					if (attempt(re, str + 1)) {
+					if (attempt(ctx, re, str + 1)) {
 						ret_val = true;
 						return checked_return(ret_val);
 					}
 				}
 			}
 
-			if (!eContext.Recursion_Limit_Exceeded && attempt(re, start)) {
+			if (!ctx.Recursion_Limit_Exceeded && attempt(ctx, re, start)) {
 				ret_val = true;
 				return checked_return(ret_val);
 			}
 
 			return checked_return(ret_val);
 		} else if (re->match_start != '\0') {
-			// We know what char match must start with.
-			for (str = end; str >= start && !eContext.Recursion_Limit_Exceeded; str--) {
-				if (*str == static_cast<uint8_t>(re->match_start)) {
-					if (attempt(re, str)) {
+			// We know what char match must start with (and there's none to read at the very end).
+			for (str = end; str >= start && !ctx.Recursion_Limit_Exceeded; str--) {
+				if (str != ctx.Real_End_Of_String && *str == static_cast<uint8_t>(re->match_start)) {
+					if (attempt(ctx, re, str)) {
 						ret_val = true;
 						break;
 					}
@@ -1256,8 +1427,8 @@ bool Regex::ExecRE(const char *start, const char *end, bool reverse, int prev_ch
 			return checked_return(ret_val);
 		} else {
 			// General case
-			for (str = end; str >= start && !eContext.Recursion_Limit_Exceeded; str--) {
-				if (attempt(re, str)) {
+			for (str = end; str >= start && !ctx.Recursion_Limit_Exceeded; str--) {
+				if (attempt(ctx, re, str)) {
 					ret_val = true;
 					break;
 				}
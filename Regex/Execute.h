@@ -7,44 +7,49 @@
 #include <cstdint>
 #include <array>
 #include <bitset>
-#include <memory>
 
 // #define ENABLE_CROSS_REGEX_BACKREF
 
 class Regex;
 
-// Global work variables for 'ExecRE'.
+/* Work variables for 'ExecRE'. Each call has its own set, which is passed to
+ * everything it uses to match, so different Regex objects may be matched on
+ * different threads at the same time. */
 
 template <size_t N>
 using array_iterator = typename std::array<const char *, N>::iterator;
 
 struct ExecuteContext {
-	std::unique_ptr<uint32_t[]> BraceCounts;     // Define a pointer to an array to hold general (...){m,n} counts.
-	const char *Reg_Input;                       // String-input pointer.
-	const char *Start_Of_String;                 // Beginning of input, for ^ and < checks.
-	const char *End_Of_String;                   // Logical end of input
-	const char *Real_End_Of_String;              // Point that the string truly ends and we may not pass safely
-	const char *Look_Behind_To;                  // Position till were look behind can safely check back
-	array_iterator<NSUBEXP> Start_Ptr_Ptr;       // Pointer to 'startp' array.
-	array_iterator<NSUBEXP> End_Ptr_Ptr;         // Ditto for 'endp'.
-	const char *Extent_Ptr_FW;                   // Forward extent pointer
-	const char *Extent_Ptr_BW;                   // Backward extent pointer
-	std::array<const char *, 10> Back_Ref_Start; // Back_Ref_Start [0] and
-	std::array<const char *, 10> Back_Ref_End;   // Back_Ref_End [0] are not used. This simplifies indexing.
-	int Recursion_Count;                         // Recursion counter
+	std::array<uint32_t, UINT8_MAX + 1> BraceCounts;      // Counts for general (...){m,n} constructs, indexed by brace number (only the first Num_Braces are set)
+	const char *Reg_Input          = nullptr;             // String-input pointer.
+	const char *Start_Of_String    = nullptr;             // Beginning of input, for ^ and < checks.
+	const char *End_Of_String      = nullptr;             // Logical end of input
+	const char *Real_End_Of_String = nullptr;             // Point that the string truly ends and we may not pass safely
+	const char *Look_Behind_To     = nullptr;             // Position till were look behind can safely check back
+	array_iterator<NSUBEXP> Start_Ptr_Ptr = nullptr;      // Pointer to 'startp' array.
+	array_iterator<NSUBEXP> End_Ptr_Ptr   = nullptr;      // Ditto for 'endp'.
+	const char *Extent_Ptr_FW      = nullptr;             // Forward extent pointer
+	const char *Extent_Ptr_BW      = nullptr;             // Backward extent pointer
+	std::array<const char *, 10> Back_Ref_Start = {};     // Back_Ref_Start [0] and
+	std::array<const char *, 10> Back_Ref_End   = {};     // Back_Ref_End [0] are not used. This simplifies indexing.
+	size_t Total_Paren             = 0;                   // Number of capturing parentheses in the program being run
+	size_t Num_Braces              = 0;                   // Number of general {m,n} constructs in the program being run
+	int Recursion_Count            = 0;                   // Recursion counter
+	const uint8_t *Program         = nullptr;             // Program being run, while 'Visited' is in use
+	const char *Match_Begin        = nullptr;             // Bounds of the match the DFA found, if set
+	const char *Match_End          = nullptr;             // the backtracker is not allowed past them
+	uint64_t *Visited              = nullptr;             // Nodes already failed at each position of the match, if kept
 
 #ifdef ENABLE_CROSS_REGEX_BACKREF
-	Regex *Cross_Regex_Backref;
+	Regex *Cross_Regex_Backref     = nullptr;
 #endif
-	bool Prev_Is_BOL;
-	bool Succ_Is_EOL;
-	bool Prev_Is_Delim;
-	bool Succ_Is_Delim;
-	bool Recursion_Limit_Exceeded;                // Recursion limit exceeded flag
-	std::bitset<256> Current_Delimiters;          // Current delimiter table
+	bool Prev_Is_BOL               = false;
+	bool Succ_Is_EOL               = false;
+	bool Prev_Is_Delim             = false;
+	bool Succ_Is_Delim             = false;
+	bool Recursion_Limit_Exceeded  = false;               // Recursion limit exceeded flag
+	bool Hit_End                   = false;               // Matching looked for text past the physical end of the string
+	std::bitset<256> Current_Delimiters;                  // Current delimiter table
 };
 
-
-extern ExecuteContext eContext;
-
 #endif
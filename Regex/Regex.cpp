@@ -79,15 +79,19 @@
 
 #include "Regex.h"
 #include "Compile.h"
+#include "Dfa.h"
 #include "Execute.h"
 
 #include <cassert>
+#include <mutex>
+
+namespace {
 
 // Default table for determining whether a character is a word delimiter.
-std::bitset<256> Regex::Default_Delimiters;
+std::mutex DefaultDelimitersMutex;
+std::bitset<256> DefaultDelimiters;
 
-ExecuteContext eContext;
-ParseContext pContext;
+}
 
 
 /* The "internal use only" fields in `Regex.h' are present to pass info from
@@ -111,6 +115,11 @@ ParseContext pContext;
  * but allows patterns to get big without disasters. */
 
 
+/**
+ * @brief Regex::~Regex
+ */
+Regex::~Regex() noexcept = default;
+
 /**
  * @brief Regex::execute
  * @param string
@@ -198,7 +207,21 @@ bool Regex::execute(view::string_view string, size_t offset, size_t end_offset,
  * Builds a default delimiter table that persists across 'ExecRE' calls.
  *----------------------------------------------------------------------*/
 void Regex::SetDefaultWordDelimiters(view::string_view delimiters) {
-	Default_Delimiters = makeDelimiterTable(delimiters);
+	const std::bitset<256> table = makeDelimiterTable(delimiters);
+
+	std::lock_guard<std::mutex> lock(DefaultDelimitersMutex);
+	DefaultDelimiters = table;
+}
+
+/*----------------------------------------------------------------------*
+ * DefaultDelimiterTable
+ *
+ * A copy of the table set by 'SetDefaultWordDelimiters', which may be
+ * changed by another thread at any time.
+ *----------------------------------------------------------------------*/
+std::bitset<256> Regex::DefaultDelimiterTable() {
+	std::lock_guard<std::mutex> lock(DefaultDelimitersMutex);
+	return DefaultDelimiters;
 }
 
 /*----------------------------------------------------------------------*
@@ -10,8 +10,10 @@
 #include <cstdint>
 #include <bitset>
 #include <memory>
+#include <string>
 #include <vector>
 
+class Dfa;
 
 /* Flags for CompileRE default settings (Markus Schwarzenberg) */
 enum RE_DEFAULT_FLAG {
@@ -20,13 +22,17 @@ enum RE_DEFAULT_FLAG {
 	/* REDFLT_MATCH_NEWLINE = 2    Currently not used. */
 };
 
-
+/* Compiling and matching keep their working state in a context of their own
+ * for each call, so separate Regex objects can be compiled and run on
+ * different threads at the same time. A single Regex holds the results of its
+ * last match (and a cache of DFA states, and scratch space for matching), so
+ * it must only be used by one thread at a time. */
 class Regex {
 public:
 	Regex(view::string_view exp, int defaultFlags);
 	Regex(const Regex &)            = delete;
 	Regex& operator=(const Regex &) = delete;
-	~Regex() noexcept               = default;
+	~Regex() noexcept;
 
 public:
 	/**
@@ -119,12 +125,20 @@ public:
 	const char *extentpBW       = nullptr;         /* Points to the maximum extent of text scanned by ExecRE in front of the string to achieve a match (needed because of positive look-behind.) */
 	const char *extentpFW       = nullptr;         /* Points to the maximum extent of text scanned by ExecRE to achieve a match (needed because of positive look-ahead.) */
 	size_t top_branch           = 0;               /* Zero-based index of the top branch that matches. Used by syntax highlighting only. */
+	bool hit_end                = false;           /* Whether the last match looked for text past the end of the string, so more text could have changed the result. */
+	size_t look_behind          = 0;               /* How far in front of where a match starts the regex may look at the text (for look-behind, and the boundary tests.) */
 	char match_start            = '\0';            /* Internal use only. */
 	char anchor                 = '\0';            /* Internal use only. */
+	bool prefix_caseless        = false;           /* Internal use only. */
+	bool required_caseless      = false;           /* Internal use only. */
+	std::string prefix;                            /* Internal use only. Text every match begins with */
+	std::string required;                          /* Internal use only. Longest text every match contains */
 	std::vector<uint8_t> program;
+	std::unique_ptr<Dfa> dfa;                      /* Internal use only. nullptr if the program can't be run as a DFA */
+	std::vector<uint64_t> visited;                 /* Internal use only. Kept between calls to 'ExecRE' to save allocating it each time */
 
 public:
-	static std::bitset<256> Default_Delimiters;
+	static std::bitset<256> DefaultDelimiterTable();
 	static std::bitset<256> makeDelimiterTable(view::string_view delimiters);
 };
 
@@ -0,0 +1,123 @@
+#include "Regex.h"
+#include <atomic>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+struct Test {
+	const char *input;
+	int flags;
+	const char *delimiters;
+};
+
+constexpr int ThreadCount = 8;
+constexpr int Iterations  = 20;
+
+const char DefaultDelimiters[] = ".,/\\`'!|@#%^&*()-=+{}[]\":;<>?";
+
+// A mix of programs which need the DFA, the backtracker, counters, back references and look-around
+const Test tests[] = {
+	{ R"(<(if|else|while|for|return)>)",             REDFLT_STANDARD,         nullptr },
+	{ R"("([^"\\]|\\.)*")",                           REDFLT_STANDARD,         nullptr },
+	{ R"([0-9]+\.[0-9]*)",                            REDFLT_STANDARD,         nullptr },
+	{ R"(foo.*bar)",                                  REDFLT_CASE_INSENSITIVE, nullptr },
+	{ R"((\w+)\s+\1)",                                REDFLT_STANDARD,         nullptr },
+	{ R"((ab|cd){2,3}x)",                             REDFLT_STANDARD,         nullptr },
+	{ R"((?<=#)\w+(?=\())",                           REDFLT_STANDARD,         nullptr },
+	{ R"(<\w+>)",                                     REDFLT_STANDARD,         ".,;" },
+	{ R"(^\s*(//|#).*$)",                             REDFLT_STANDARD,         nullptr },
+	{ R"((x+x+)+y)",                                  REDFLT_STANDARD,         nullptr },
+};
+
+std::string makeText() {
+	std::string text;
+	for (int i = 0; i < 200; ++i) {
+		text += "if (value_" + std::to_string(i) + " == 3.14) return \"a \\\"quoted\\\" string\";\n";
+		text += "  // FOO then some Bar, word word repeated\n";
+		text += "#define(x) abcdabx cdabcdx xxxxxxxxxxxxxxxxxxxxy\n";
+		text += "else while.for;return,done\n";
+	}
+	return text;
+}
+
+/*
+** Every match of "re" in "text", as offsets of the whole match and the
+** first few captures
+*/
+std::vector<long> allMatches(Regex &re, const std::string &text, const char *delimiters) {
+
+	std::vector<long> result;
+	size_t offset = 0;
+
+	while (offset <= text.size() && re.execute(text, offset, delimiters)) {
+		for (int i = 0; i < 3; ++i) {
+			result.push_back(re.startp[i] ? re.startp[i] - text.data() : -1);
+			result.push_back(re.endp[i]   ? re.endp[i]   - text.data() : -1);
+		}
+
+		const auto end = static_cast<size_t>(re.endp[0] - text.data());
+		offset = (end > offset) ? end : offset + 1;
+	}
+
+	return result;
+}
+
+}
+
+int main() {
+
+	const std::string text = makeText();
+
+	Regex::SetDefaultWordDelimiters(DefaultDelimiters);
+
+	std::vector<std::vector<long>> expected;
+	for (const Test &t : tests) {
+		Regex re(t.input, t.flags);
+		expected.push_back(allMatches(re, text, t.delimiters));
+	}
+
+	std::atomic<int> failures(0);
+	std::atomic<bool> running(true);
+	std::vector<std::thread> threads;
+
+	for (int n = 0; n < ThreadCount; ++n) {
+		threads.emplace_back([&]() {
+			for (int i = 0; i < Iterations; ++i) {
+				for (size_t j = 0; j < sizeof(tests) / sizeof(tests[0]); ++j) {
+					Regex re(tests[j].input, tests[j].flags);
+					if (allMatches(re, text, tests[j].delimiters) != expected[j]) {
+						if (failures++ == 0) {
+							std::cerr << "ERROR    : " << tests[j].input << '\n';
+						}
+					}
+				}
+			}
+		});
+	}
+
+	// The default delimiters may be set while other threads are matching
+	std::thread writer([&]() {
+		while (running) {
+			Regex::SetDefaultWordDelimiters(DefaultDelimiters);
+		}
+	});
+
+	for (std::thread &thread : threads) {
+		thread.join();
+	}
+
+	running = false;
+	writer.join();
+
+	if (failures != 0) {
+		std::cerr << "FAILURES : " << failures << '\n';
+		return -1;
+	}
+
+	std::cout << "SUCCESS\n";
+
+	return 0;
+}
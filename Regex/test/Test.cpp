@@ -1,5 +1,7 @@
 
 #include "Regex.h"
+#include "Dfa.h"
+#include <algorithm>
 #include <iostream>
 
 struct Test {
@@ -10,7 +12,7 @@ struct Test {
 int main() {
 
 	// This is every regex that my copy of nedit uses for highlighting, so hope this is a fairly robust and complete test
-	static const Test tests[694] = {
+	static const Test tests[] = {
 		{ R"((?:")|(?:-?(0|[1-9][0-9]*)(\.[0-9]+)?([eE][+-]?[0-9]+)?)|(?:[\[\{\]\}]))",  R"(\x9c\x03\x00\x22\x00\x0e\x22\x00\x08\x07\x00\x05\x22\x00\x21\x00\xae\x22\x00\x9a\x22\x00\x94\x1b\x00\x08\x07\x00\x00\x2d\x00\x32\x00\x03\x22\x00\x08\x07\x00\x26\x30\x00\x22\x00\x21\x09\x00\x0d\x31\x32\x33\x34\x35\x36\x37\x38\x39\x00\x19\x00\x11\x09\x00\x00\x30\x31\x32\x33\x34\x35\x36\x37\x38\x39\x00\x64\x00\x03\x22\x00\x22\x33\x00\x03\x22\x00\x19\x07\x00\x05\x2e\x00\x1d\x00\x11\x09\x00\x00\x30\x31\x32\x33\x34\x35\x36\x37\x38\x39\x00\x65\x00\x06\x22\x00\x03\x21\x00\x03\x22\x00\x2c\x34\x00\x03\x22\x00\x23\x09\x00\x06\x65\x45\x00\x1b\x00\x09\x09\x00\x00\x2b\x2d\x00\x1d\x00\x11\x09\x00\x00\x30\x31\x32\x33\x34\x35\x36\x37\x38\x39\x00\x66\x00\x06\x22\x00\x03\x21\x00\x03\x21\x00\x14\x22\x00\x11\x22\x00\x0b\x09\x00\x08\x5b\x7b\x5d\x7d\x00\x21\x00\x03\x01\x00\x00)" },
 		{ R"(-?(0|[1-9][0-9]*)(\.[0-9]+)?([eE][+-]?[0-9]+)?)",  R"(\x9c\x03\x00\x22\x00\x94\x1b\x00\x08\x07\x00\x00\x2d\x00\x32\x00\x03\x22\x00\x08\x07\x00\x26\x30\x00\x22\x00\x21\x09\x00\x0d\x31\x32\x33\x34\x35\x36\x37\x38\x39\x00\x19\x00\x11\x09\x00\x00\x30\x31\x32\x33\x34\x35\x36\x37\x38\x39\x00\x64\x00\x03\x22\x00\x22\x33\x00\x03\x22\x00\x19\x07\x00\x05\x2e\x00\x1d\x00\x11\x09\x00\x00\x30\x31\x32\x33\x34\x35\x36\x37\x38\x39\x00\x65\x00\x06\x22\x00\x03\x21\x00\x03\x22\x00\x2c\x34\x00\x03\x22\x00\x23\x09\x00\x06\x65\x45\x00\x1b\x00\x09\x09\x00\x00\x2b\x2d\x00\x1d\x00\x11\x09\x00\x00\x30\x31\x32\x33\x34\x35\x36\x37\x38\x39\x00\x66\x00\x06\x22\x00\x03\x21\x00\x03\x01\x00\x00)" },
 		{ R"(\\([ -~\0200-\0377]|[\l\d]{1,6}\s?))",  R"(\x9c\x01\x00\x22\x01\x46\x07\x00\x05\x5c\x00\x32\x00\x03\x22\x00\xe6\x09\x01\x35\x20\x21\x22\x23\x24\x25\x26\x27\x28\x29\x2a\x2b\x2c\x2d\x2e\x2f\x30\x31\x32\x33\x34\x35\x36\x37\x38\x39\x3a\x3b\x3c\x3d\x3e\x3f\x40\x41\x42\x43\x44\x45\x46\x47\x48\x49\x4a\x4b\x4c\x4d\x4e\x4f\x50\x51\x52\x53\x54\x55\x56\x57\x58\x59\x5a\x5b\x5c\x5d\x5e\x5f\x60\x61\x62\x63\x64\x65\x66\x67\x68\x69\x6a\x6b\x6c\x6d\x6e\x6f\x70\x71\x72\x73\x74\x75\x76\x77\x78\x79\x7a\x7b\x7c\x7d\x7e\x80\x81\x82\x83\x84\x85\x86\x87\x88\x89\x8a\x8b\x8c\x8d\x8e\x8f\x90\x91\x92\x93\x94\x95\x96\x97\x98\x99\x9a\x9b\x9c\x9d\x9e\x9f\xa0\xa1\xa2\xa3\xa4\xa5\xa6\xa7\xa8\xa9\xaa\xab\xac\xad\xae\xaf\xb0\xb1\xb2\xb3\xb4\xb5\xb6\xb7\xb8\xb9\xba\xbb\xbc\xbd\xbe\xbf\xc0\xc1\xc2\xc3\xc4\xc5\xc6\xc7\xc8\xc9\xca\xcb\xcc\xcd\xce\xcf\xd0\xd1\xd2\xd3\xd4\xd5\xd6\xd7\xd8\xd9\xda\xdb\xdc\xdd\xde\xdf\xe0\xe1\xe2\xe3\xe4\xe5\xe6\xe7\xe8\xe9\xea\xeb\xec\xed\xee\xef\xf0\xf1\xf2\xf3\xf4\xf5\xf6\xf7\xf8\xf9\xfa\xfb\xfc\xfd\xfe\xff\x00\x22\x00\x52\x1f\x00\x49\x00\x01\x00\x06\x09\x00\x00\x41\x42\x43\x44\x45\x46\x47\x48\x49\x4a\x4b\x4c\x4d\x4e\x4f\x50\x51\x52\x53\x54\x55\x56\x57\x58\x59\x5a\x61\x62\x63\x64\x65\x66\x67\x68\x69\x6a\x6b\x6c\x6d\x6e\x6f\x70\x71\x72\x73\x74\x75\x76\x77\x78\x79\x7a\x30\x31\x32\x33\x34\x35\x36\x37\x38\x39\x00\x1b\x00\x06\x11\x00\x00\x64\x00\x03\x01\x00\x00)" },
@@ -742,6 +744,126 @@ int main() {
 		}
 	}
 
+	/* Searching from an offset must give the same match when the text starts
+	   only "look_behind" characters before that offset */
+	static const view::string_view windowed[] = {
+		R"((?<=ab)c)",
+		R"((?<=a(?<=ba))c)",
+		R"((?<=(?<=x)a.)b)",
+		R"((?<!a)b)",
+		R"(\<c)",
+		R"(^c)",
+	};
+
+	const std::string text = "xbabc ab\nbac xabab c\nxac";
+
+	for(view::string_view input : windowed) {
+		for(size_t offset = 0; offset <= text.size(); ++offset) {
+			Regex whole(input, REDFLT_STANDARD);
+			Regex window(input, REDFLT_STANDARD);
+
+			const size_t first = offset - std::min(offset, window.look_behind);
+			const view::string_view string = view::string_view(text).substr(first);
+
+			const bool foundWhole  = whole.execute(text, offset, nullptr, false);
+			const bool foundWindow = window.execute(string, offset - first, string.size(), (offset == 0) ? -1 : text[offset - 1], -1, nullptr, false);
+
+			if(foundWhole != foundWindow || (foundWhole && whole.startp[0] - text.data() != static_cast<ptrdiff_t>(first) + (window.startp[0] - string.data()))) {
+				std::cerr << "ERROR    : " << input.to_string() << " from " << offset << '\n';
+				return -1;
+			}
+		}
+	}
+
+	/* The DFA only decides where a search starts, so a regex must match
+	   exactly the same text with it as the backtracker finds on its own */
+	static const view::string_view regular[] = {
+		R"(ab|b)",
+		R"([ab]*b)",
+		R"((?:ab)+c?)",
+		R"(a.*?b)",
+		R"(\<b\w*)",
+		R"(\ba|c\B)",
+		R"(^x|c$)",
+		R"((?i[AB]+C))",
+		R"(\s+\S)",
+		R"(a?b?c)",
+		R"([^a\n]+)",
+		R"((a|ab)(c|bab))",
+	};
+
+	const std::string haystack = "xbabc ab\nbac xabab c\nxac aabbcc Abc";
+
+	for(view::string_view input : regular) {
+		Regex withDfa(input, REDFLT_STANDARD);
+		Regex without(input, REDFLT_STANDARD);
+
+		if(!withDfa.dfa) {
+			std::cerr << "ERROR    : " << input.to_string() << " has no DFA\n";
+			return -1;
+		}
+
+		without.dfa = nullptr;
+
+		for(size_t offset = 0; offset <= haystack.size(); ++offset) {
+			const bool foundDfa     = withDfa.execute(haystack, offset, nullptr, false);
+			const bool foundWithout = without.execute(haystack, offset, nullptr, false);
+
+			if(foundDfa != foundWithout || (foundDfa && (withDfa.startp[0] != without.startp[0] || withDfa.endp[0] != without.endp[0]))) {
+				std::cerr << "ERROR    : " << input.to_string() << " from " << offset << " differs with the DFA\n";
+				return -1;
+			}
+		}
+	}
+
+	/* Once the DFA has found a match, filling in its parentheses must not
+	   backtrack exponentially. Without a bound on the backtracker this takes
+	   hours */
+	{
+		Regex re(R"((x+x+)+y|x+z)", REDFLT_STANDARD);
+		const std::string string = std::string(64, 'x') + 'z';
+
+		if(!re.dfa || !re.execute(string) || re.startp[0] != string.data() || re.endp[0] != string.data() + string.size() || re.startp[1] != nullptr) {
+			std::cerr << "ERROR    : (x+x+)+y|x+z did not match the whole string\n";
+			return -1;
+		}
+	}
+
+	/* Lazy quantifiers must carry on from where they were when the rest of
+	   the regex fails to match, not from wherever that attempt got to. The
+	   DFA would hide that, so these are run with the backtracker alone */
+	struct Match {
+		view::string_view input;
+		view::string_view string;
+		int start; // -1 for no match
+		int end;
+	};
+
+	static const Match lazy[] = {
+		{ R"((?i[ab]*?ba+?))", "AAAcbA",   4,  6 },
+		{ R"([ab]*?[b]a+?)",   "aaacba",   4,  6 },
+		{ R"([ab]*?ba+?)",     "xbA",     -1, -1 },
+		{ R"([ab]*?ba+?)",     "xbab",     1,  3 },
+		{ R"((?:ab)*?abc)",    "ababac",  -1, -1 },
+		{ R"((?:ab)*?abc)",    "xababc",   1,  6 },
+		{ R"(a.*?b)",          "aXbYb",    0,  3 },
+		{ R"(\d+?\.\d)",       "12x3.4",   3,  6 },
+	};
+
+	for(const Match &m : lazy) {
+		Regex re(m.input, REDFLT_STANDARD);
+		re.dfa = nullptr;
+
+		const bool found = re.execute(m.string);
+		const int start  = found ? static_cast<int>(re.startp[0] - m.string.data()) : -1;
+		const int end    = found ? static_cast<int>(re.endp[0]   - m.string.data()) : -1;
+
+		if(start != m.start || end != m.end) {
+			std::cerr << "ERROR    : " << m.input.to_string() << " on \"" << m.string.to_string() << "\" matched " << start << ".." << end << '\n';
+			return -1;
+		}
+	}
+
 	std::cout << "SUCCESS\n";
 
 	return 0;
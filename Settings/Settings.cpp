@@ -111,6 +111,9 @@ bool Settings::stickyCaseSenseButton;
 bool Settings::typingHidesPointer;
 bool Settings::undoModifiesSelection;
 int Settings::autoScrollVPadding;
+int Settings::mapFileThreshold;
+int Settings::undoMemoryLimit;
+bool Settings::compressUndo;
 int Settings::maxPrevOpenFiles;
 TruncSubstitution Settings::truncSubstitution;
 QString Settings::backlightCharTypes;
@@ -239,6 +242,9 @@ void Settings::loadPreferences() {
 	includePaths                      = settings.value(tr("nedit.includePaths"),                  DEFAULT_INCLUDE_PATHS).toStringList();
 	serverName                        = settings.value(tr("nedit.serverName"),                    QString()).toString();
 	maxPrevOpenFiles                  = settings.value(tr("nedit.maxPrevOpenFiles"),              30).toInt();
+	mapFileThreshold                  = settings.value(tr("nedit.mapFileThreshold"),              0).toInt();
+	undoMemoryLimit                   = settings.value(tr("nedit.undoMemoryLimit"),               64).toInt();
+	compressUndo                      = settings.value(tr("nedit.compressUndo"),                  true).toBool();
 	smartTags                         = settings.value(tr("nedit.smartTags"),                     true).toBool();
 	typingHidesPointer                = settings.value(tr("nedit.typingHidesPointer"),            false).toBool();
 	alwaysCheckRelativeTagsSpecs      = settings.value(tr("nedit.alwaysCheckRelativeTagsSpecs"),  true).toBool();
@@ -326,6 +332,9 @@ void Settings::importSettings(const QString &filename) {
 	includePaths                      = settings.value(tr("nedit.includePaths"),                  includePaths).toStringList();
 	serverName                        = settings.value(tr("nedit.serverName"),                    serverName).toString();
 	maxPrevOpenFiles                  = settings.value(tr("nedit.maxPrevOpenFiles"),              maxPrevOpenFiles).toInt();
+	mapFileThreshold                  = settings.value(tr("nedit.mapFileThreshold"),              mapFileThreshold).toInt();
+	undoMemoryLimit                   = settings.value(tr("nedit.undoMemoryLimit"),               undoMemoryLimit).toInt();
+	compressUndo                      = settings.value(tr("nedit.compressUndo"),                  compressUndo).toBool();
 	smartTags                         = settings.value(tr("nedit.smartTags"),                     smartTags).toBool();
 	typingHidesPointer                = settings.value(tr("nedit.typingHidesPointer"),            typingHidesPointer).toBool();
 	alwaysCheckRelativeTagsSpecs      = settings.value(tr("nedit.alwaysCheckRelativeTagsSpecs"),  alwaysCheckRelativeTagsSpecs).toBool();
@@ -408,6 +417,9 @@ bool Settings::savePreferences() {
 	settings.setValue(tr("nedit.includePaths"), includePaths);
 	settings.setValue(tr("nedit.serverName"), serverName);
 	settings.setValue(tr("nedit.maxPrevOpenFiles"), maxPrevOpenFiles);
+	settings.setValue(tr("nedit.mapFileThreshold"), mapFileThreshold);
+	settings.setValue(tr("nedit.undoMemoryLimit"), undoMemoryLimit);
+	settings.setValue(tr("nedit.compressUndo"), compressUndo);
 	settings.setValue(tr("nedit.smartTags"), smartTags);
 	settings.setValue(tr("nedit.typingHidesPointer"), typingHidesPointer);
 	settings.setValue(tr("nedit.autoWrapPastedText"), autoWrapPastedText);
@@ -112,6 +112,9 @@ public:
 	static bool typingHidesPointer;
 	static bool undoModifiesSelection;
 	static int autoScrollVPadding;
+	static int mapFileThreshold;
+	static int undoMemoryLimit;
+	static bool compressUndo;
 	static int maxPrevOpenFiles;
 	static TruncSubstitution truncSubstitution;
 	static QString backlightCharTypes;
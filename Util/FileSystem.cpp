@@ -2,12 +2,15 @@
 #include "Util/FileSystem.h"
 #include "Util/ClearCase.h"
 #include "Util/FileFormats.h"
+#include "Util/Kernels.h"
 
+#include <cstring>
 #include <fstream>
 #include <iostream>
 #include <iterator>
 
 #include <QDir>
+#include <QFile>
 #include <QFileInfo>
 #include <QString>
 
@@ -123,17 +126,20 @@ FileFormats FormatOfFile(view::string_view text) {
 	size_t nNewlines = 0;
 	size_t nReturns = 0;
 
-	for (auto it = text.begin(); it != text.end() && it < text.begin() + FORMAT_SAMPLE_CHARS; ++it) {
+	const char *const begin = text.data();
+	const char *const end   = begin + std::min<size_t>(text.size(), FORMAT_SAMPLE_CHARS);
+
+	for (const char *it = begin; (it = Kernels::FindFirstOf(it, end, "\n\r")); ++it) {
 		if (*it == '\n') {
 			nNewlines++;
-			if (it == text.begin() || *std::prev(it) != '\r') {
+			if (it == begin || it[-1] != '\r') {
 				return FileFormats::Unix;
 			}
 
 			if (nNewlines >= FORMAT_SAMPLE_LINES) {
 				return FileFormats::Dos;
 			}
-		} else if (*it == '\r') {
+		} else {
 			nReturns++;
 		}
 	}
@@ -157,25 +163,20 @@ FileFormats FormatOfFile(view::string_view text) {
 void ConvertToDos(std::string &text) {
 
 	// How long a string will we need?
-	size_t outLength = 0;
-	for (char ch : text) {
-		if (ch == '\n') {
-			outLength++;
-		}
-		outLength++;
-	}
+	const char *const end = text.data() + text.size();
+	const size_t outLength = text.size() + Kernels::CountCharacter(text.data(), end, '\n');
 
 	std::string outString;
 	outString.reserve(outLength);
-	auto outPtr = std::back_inserter(outString);
 
-	for (char ch : text) {
-		if (ch == '\n') {
-			*outPtr++ = '\r';
-		}
-		*outPtr++ = ch;
+	const char *run = text.data();
+	while (const char *nl = Kernels::FindCharacter(run, end, '\n')) {
+		outString.append(run, nl);
+		outString.append("\r\n");
+		run = nl + 1;
 	}
 
+	outString.append(run, end);
 	text = std::move(outString);
 }
 
@@ -218,32 +219,80 @@ void ConvertFromDos(std::string &text) {
  * @param pendingCR
  */
 void ConvertFromDos(std::string &text, char *pendingCR) {
+	text.resize(ConvertFromDos(&text[0], text.size(), pendingCR));
+}
+
+/**
+ * @brief ConvertFromDos
+ * @param text
+ * @param length
+ * @param pendingCR
+ * @return the new length of "text"
+ *
+ * The in-place conversion which the other versions are built on. Rather than
+ * looking at every character, this searches for each '\r' and moves the text
+ * between them down in bulk.
+ */
+size_t ConvertFromDos(char *text, size_t length, char *pendingCR) {
+
+	Q_ASSERT(text || length == 0);
 
 	if (pendingCR) {
 		*pendingCR = '\0';
 	}
 
-	auto out = text.begin();
-	auto it  = text.begin();
-
-	while (it != text.end()) {
-		if (*it == '\r') {
-			auto next = std::next(it);
-			if (next != text.end()) {
-				if (*next == '\n') {
-					++it;
-				}
-			} else {
-				if (pendingCR) {
-					*pendingCR = *it;
-					break;
-				}
+	char *out             = text;
+	const char *run       = text; // start of the text not yet moved to "out"
+	const char *const end = text + length;
+
+	for (const char *cr = text; (cr = Kernels::FindCharacter(cr, end, '\r')); ++cr) {
+		if (cr == end - 1) {
+			if (pendingCR) {
+				*pendingCR = *cr;
+				std::memmove(out, run, static_cast<size_t>(cr - run));
+				return static_cast<size_t>(out + (cr - run) - text);
 			}
+		} else if (cr[1] == '\n') {
+			// drop the '\r' of a "\r\n" pair
+			std::memmove(out, run, static_cast<size_t>(cr - run));
+			out += cr - run;
+			run  = cr + 1;
 		}
-		*out++ = *it++;
 	}
 
-	text.erase(out, text.end());
+	std::memmove(out, run, static_cast<size_t>(end - run));
+	return static_cast<size_t>(out + (end - run) - text);
+}
+
+/*
+** Map the whole of a file into memory copy-on-write, and return its size in
+** "size". Returns nullptr if the file is empty or couldn't be mapped. The
+** mapping stays valid for as long as any copy of the returned pointer exists.
+**
+** Other programs may still change the file while it is mapped, which shows
+** through the pages that haven't been written to, and reading a page which
+** another program truncated off the file raises SIGBUS. So callers have to
+** check that the file is unchanged before each use of the mapping, or copy
+** what they need out of it right away.
+*/
+std::shared_ptr<const char> MapFile(const QString &fileName, int64_t *size) {
+
+	auto file = std::make_shared<QFile>(fileName);
+	if (!file->open(QIODevice::ReadOnly) || file->size() == 0) {
+		return nullptr;
+	}
+
+	const int64_t fileSize = file->size();
+
+	uchar *memory = file->map(0, fileSize, QFileDevice::MapPrivateOption);
+	if (!memory) {
+		return nullptr;
+	}
+
+	*size = fileSize;
+
+	// the QFile owns the mapping, and unmaps it when it is destroyed
+	return std::shared_ptr<const char>(file, reinterpret_cast<const char *>(memory));
 }
 
 /*
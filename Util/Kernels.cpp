@@ -0,0 +1,527 @@
+
+#include "Util/Kernels.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define KERNELS_X86
+#include <immintrin.h>
+#endif
+
+namespace {
+
+/* The vector kernels handle sets of up to this many characters, larger sets
+ * (which are rare, word delimiter lists for example) use a lookup table */
+constexpr size_t MaxVectorSet = 4;
+
+struct Implementation {
+	Kernels::InstructionSet isa;
+	size_t (*count)(const char *first, const char *last, char ch);
+	const char *(*findFirstOf)(const char *first, const char *last, const char *set, size_t n);
+	const char *(*findLastOf)(const char *first, const char *last, const char *set, size_t n);
+	const char *(*findString)(const char *first, const char *last, const char *needle, size_t n, bool caseless);
+};
+
+bool inSet(char ch, const char *set, size_t n) {
+	return std::find(set, set + n, ch) != set + n;
+}
+
+char foldCase(char ch) {
+	return (ch >= 'A' && ch <= 'Z') ? static_cast<char>(ch - 'A' + 'a') : ch;
+}
+
+/* OR'ing a character with this mask maps upper case ASCII letters onto lower
+ * case ones without making anything else look like "ch" */
+char foldMask(char ch, bool caseless) {
+	return (caseless && ch >= 'a' && ch <= 'z') ? 0x20 : 0x00;
+}
+
+bool equalAt(const char *text, const char *needle, size_t n, bool caseless) {
+	if (!caseless) {
+		return std::memcmp(text, needle, n) == 0;
+	}
+
+	for (size_t i = 0; i < n; ++i) {
+		if (foldCase(text[i]) != needle[i]) {
+			return false;
+		}
+	}
+	return true;
+}
+
+/*
+** Portable fall backs, also used for the unaligned tails of the vector
+** versions
+*/
+size_t countScalar(const char *first, const char *last, char ch) {
+	return static_cast<size_t>(std::count(first, last, ch));
+}
+
+const char *findFirstOfScalar(const char *first, const char *last, const char *set, size_t n) {
+	for (; first != last; ++first) {
+		if (inSet(*first, set, n)) {
+			return first;
+		}
+	}
+	return nullptr;
+}
+
+const char *findLastOfScalar(const char *first, const char *last, const char *set, size_t n) {
+	while (last != first) {
+		--last;
+		if (inSet(*last, set, n)) {
+			return last;
+		}
+	}
+	return nullptr;
+}
+
+const char *findStringScalar(const char *first, const char *last, const char *needle, size_t n, bool caseless) {
+	if (static_cast<size_t>(last - first) < n) {
+		return nullptr;
+	}
+
+	for (const char *const end = last - n + 1; first != end; ++first) {
+		if (equalAt(first, needle, n, caseless)) {
+			return first;
+		}
+	}
+	return nullptr;
+}
+
+#ifdef KERNELS_X86
+
+int lowestBit(unsigned int mask) {
+	return __builtin_ctz(mask);
+}
+
+int highestBit(unsigned int mask) {
+	return 31 - __builtin_clz(mask);
+}
+
+/*
+** SSE2
+*/
+__attribute__((target("sse2")))
+__m128i matchSSE2(__m128i v, const __m128i needles[MaxVectorSet]) {
+	__m128i m = _mm_cmpeq_epi8(v, needles[0]);
+	m = _mm_or_si128(m, _mm_cmpeq_epi8(v, needles[1]));
+	m = _mm_or_si128(m, _mm_cmpeq_epi8(v, needles[2]));
+	m = _mm_or_si128(m, _mm_cmpeq_epi8(v, needles[3]));
+	return m;
+}
+
+__attribute__((target("sse2")))
+void needlesSSE2(const char *set, size_t n, __m128i needles[MaxVectorSet]) {
+	// unused slots repeat the last character, which doesn't change the result
+	for (size_t i = 0; i < MaxVectorSet; ++i) {
+		needles[i] = _mm_set1_epi8(set[std::min(i, n - 1)]);
+	}
+}
+
+__attribute__((target("sse2")))
+size_t countSSE2(const char *first, const char *last, char ch) {
+
+	const __m128i needle = _mm_set1_epi8(ch);
+	const __m128i zero   = _mm_setzero_si128();
+	size_t count = 0;
+
+	while (last - first >= 16) {
+		// each byte lane counts up to 255 matches before it must be summed
+		const auto blocks = std::min<ptrdiff_t>((last - first) / 16, 255);
+
+		__m128i acc = zero;
+		for (ptrdiff_t i = 0; i < blocks; ++i) {
+			const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(first));
+			acc = _mm_sub_epi8(acc, _mm_cmpeq_epi8(v, needle));
+			first += 16;
+		}
+
+		const __m128i sums = _mm_sad_epu8(acc, zero);
+		count += static_cast<size_t>(_mm_cvtsi128_si32(sums) + _mm_extract_epi16(sums, 4));
+	}
+
+	return count + countScalar(first, last, ch);
+}
+
+__attribute__((target("sse2")))
+const char *findFirstOfSSE2(const char *first, const char *last, const char *set, size_t n) {
+
+	__m128i needles[MaxVectorSet];
+	needlesSSE2(set, n, needles);
+
+	while (last - first >= 16) {
+		const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(first));
+		if (const auto mask = static_cast<unsigned int>(_mm_movemask_epi8(matchSSE2(v, needles)))) {
+			return first + lowestBit(mask);
+		}
+		first += 16;
+	}
+
+	return findFirstOfScalar(first, last, set, n);
+}
+
+__attribute__((target("sse2")))
+const char *findLastOfSSE2(const char *first, const char *last, const char *set, size_t n) {
+
+	__m128i needles[MaxVectorSet];
+	needlesSSE2(set, n, needles);
+
+	while (last - first >= 16) {
+		last -= 16;
+		const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(last));
+		if (const auto mask = static_cast<unsigned int>(_mm_movemask_epi8(matchSSE2(v, needles)))) {
+			return last + highestBit(mask);
+		}
+	}
+
+	return findLastOfScalar(first, last, set, n);
+}
+
+/* Candidates are the positions where both the first and the last character of
+ * the needle line up, only those are compared in full */
+__attribute__((target("sse2")))
+const char *findStringSSE2(const char *first, const char *last, const char *needle, size_t n, bool caseless) {
+
+	const size_t tail = n - 1;
+	const __m128i head     = _mm_set1_epi8(needle[0]);
+	const __m128i headMask = _mm_set1_epi8(foldMask(needle[0], caseless));
+	const __m128i end      = _mm_set1_epi8(needle[tail]);
+	const __m128i endMask  = _mm_set1_epi8(foldMask(needle[tail], caseless));
+
+	while (static_cast<size_t>(last - first) >= 16 + tail) {
+		const __m128i a = _mm_or_si128(_mm_loadu_si128(reinterpret_cast<const __m128i *>(first)), headMask);
+		const __m128i b = _mm_or_si128(_mm_loadu_si128(reinterpret_cast<const __m128i *>(first + tail)), endMask);
+
+		auto mask = static_cast<unsigned int>(_mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(a, head), _mm_cmpeq_epi8(b, end))));
+		while (mask != 0) {
+			const char *candidate = first + lowestBit(mask);
+			if (equalAt(candidate, needle, n, caseless)) {
+				return candidate;
+			}
+			mask &= mask - 1;
+		}
+		first += 16;
+	}
+
+	return findStringScalar(first, last, needle, n, caseless);
+}
+
+/*
+** AVX2
+*/
+__attribute__((target("avx2")))
+__m256i matchAVX2(__m256i v, const __m256i needles[MaxVectorSet]) {
+	__m256i m = _mm256_cmpeq_epi8(v, needles[0]);
+	m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, needles[1]));
+	m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, needles[2]));
+	m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, needles[3]));
+	return m;
+}
+
+__attribute__((target("avx2")))
+void needlesAVX2(const char *set, size_t n, __m256i needles[MaxVectorSet]) {
+	for (size_t i = 0; i < MaxVectorSet; ++i) {
+		needles[i] = _mm256_set1_epi8(set[std::min(i, n - 1)]);
+	}
+}
+
+__attribute__((target("avx2")))
+size_t countAVX2(const char *first, const char *last, char ch) {
+
+	const __m256i needle = _mm256_set1_epi8(ch);
+	const __m256i zero   = _mm256_setzero_si256();
+	size_t count = 0;
+
+	while (last - first >= 32) {
+		const auto blocks = std::min<ptrdiff_t>((last - first) / 32, 255);
+
+		__m256i acc = zero;
+		for (ptrdiff_t i = 0; i < blocks; ++i) {
+			const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(first));
+			acc = _mm256_sub_epi8(acc, _mm256_cmpeq_epi8(v, needle));
+			first += 32;
+		}
+
+		uint64_t sums[4];
+		_mm256_storeu_si256(reinterpret_cast<__m256i *>(sums), _mm256_sad_epu8(acc, zero));
+		count += static_cast<size_t>(sums[0] + sums[1] + sums[2] + sums[3]);
+	}
+
+	return count + countSSE2(first, last, ch);
+}
+
+__attribute__((target("avx2")))
+const char *findFirstOfAVX2(const char *first, const char *last, const char *set, size_t n) {
+
+	__m256i needles[MaxVectorSet];
+	needlesAVX2(set, n, needles);
+
+	while (last - first >= 32) {
+		const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(first));
+		if (const auto mask = static_cast<unsigned int>(_mm256_movemask_epi8(matchAVX2(v, needles)))) {
+			return first + lowestBit(mask);
+		}
+		first += 32;
+	}
+
+	return findFirstOfSSE2(first, last, set, n);
+}
+
+__attribute__((target("avx2")))
+const char *findLastOfAVX2(const char *first, const char *last, const char *set, size_t n) {
+
+	__m256i needles[MaxVectorSet];
+	needlesAVX2(set, n, needles);
+
+	while (last - first >= 32) {
+		last -= 32;
+		const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(last));
+		if (const auto mask = static_cast<unsigned int>(_mm256_movemask_epi8(matchAVX2(v, needles)))) {
+			return last + highestBit(mask);
+		}
+	}
+
+	return findLastOfSSE2(first, last, set, n);
+}
+
+__attribute__((target("avx2")))
+const char *findStringAVX2(const char *first, const char *last, const char *needle, size_t n, bool caseless) {
+
+	const size_t tail = n - 1;
+	const __m256i head     = _mm256_set1_epi8(needle[0]);
+	const __m256i headMask = _mm256_set1_epi8(foldMask(needle[0], caseless));
+	const __m256i end      = _mm256_set1_epi8(needle[tail]);
+	const __m256i endMask  = _mm256_set1_epi8(foldMask(needle[tail], caseless));
+
+	while (static_cast<size_t>(last - first) >= 32 + tail) {
+		const __m256i a = _mm256_or_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(first)), headMask);
+		const __m256i b = _mm256_or_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(first + tail)), endMask);
+
+		auto mask = static_cast<unsigned int>(_mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(a, head), _mm256_cmpeq_epi8(b, end))));
+		while (mask != 0) {
+			const char *candidate = first + lowestBit(mask);
+			if (equalAt(candidate, needle, n, caseless)) {
+				return candidate;
+			}
+			mask &= mask - 1;
+		}
+		first += 32;
+	}
+
+	return findStringSSE2(first, last, needle, n, caseless);
+}
+
+#endif
+
+const Implementation ScalarImplementation = { Kernels::InstructionSet::Scalar, countScalar, findFirstOfScalar, findLastOfScalar, findStringScalar };
+#ifdef KERNELS_X86
+const Implementation SSE2Implementation   = { Kernels::InstructionSet::SSE2,   countSSE2,   findFirstOfSSE2,   findLastOfSSE2,   findStringSSE2   };
+const Implementation AVX2Implementation   = { Kernels::InstructionSet::AVX2,   countAVX2,   findFirstOfAVX2,   findLastOfAVX2,   findStringAVX2   };
+#endif
+
+/**
+ * @brief bestImplementation
+ * @return the fastest implementation this CPU can run
+ */
+const Implementation *bestImplementation() {
+#ifdef KERNELS_X86
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2")) {
+		return &AVX2Implementation;
+	}
+
+	if (__builtin_cpu_supports("sse2")) {
+		return &SSE2Implementation;
+	}
+#endif
+	return &ScalarImplementation;
+}
+
+const Implementation *&currentImplementation() {
+	static const Implementation *impl = bestImplementation();
+	return impl;
+}
+
+}
+
+namespace Kernels {
+
+/**
+ * @brief CountCharacter
+ * @param first
+ * @param last
+ * @param ch
+ * @return the number of times "ch" appears in [first, last)
+ */
+size_t CountCharacter(const char *first, const char *last, char ch) noexcept {
+	return currentImplementation()->count(first, last, ch);
+}
+
+/**
+ * @brief FindCharacter
+ * @param first
+ * @param last
+ * @param ch
+ * @return the first occurance of "ch" in [first, last)
+ */
+const char *FindCharacter(const char *first, const char *last, char ch) noexcept {
+	if (first == last) {
+		return nullptr;
+	}
+	return currentImplementation()->findFirstOf(first, last, &ch, 1);
+}
+
+/**
+ * @brief FindLastCharacter
+ * @param first
+ * @param last
+ * @param ch
+ * @return the last occurance of "ch" in [first, last)
+ */
+const char *FindLastCharacter(const char *first, const char *last, char ch) noexcept {
+	if (first == last) {
+		return nullptr;
+	}
+	return currentImplementation()->findLastOf(first, last, &ch, 1);
+}
+
+/**
+ * @brief FindFirstOf
+ * @param first
+ * @param last
+ * @param chars
+ * @return the first character in [first, last) which is one of "chars"
+ */
+const char *FindFirstOf(const char *first, const char *last, view::string_view chars) noexcept {
+
+	if (first == last || chars.empty()) {
+		return nullptr;
+	}
+
+	if (chars.size() <= MaxVectorSet) {
+		return currentImplementation()->findFirstOf(first, last, chars.data(), chars.size());
+	}
+
+	bool table[256] = {};
+	for (char ch : chars) {
+		table[static_cast<unsigned char>(ch)] = true;
+	}
+
+	for (; first != last; ++first) {
+		if (table[static_cast<unsigned char>(*first)]) {
+			return first;
+		}
+	}
+
+	return nullptr;
+}
+
+/**
+ * @brief FindLastOf
+ * @param first
+ * @param last
+ * @param chars
+ * @return the last character in [first, last) which is one of "chars"
+ */
+const char *FindLastOf(const char *first, const char *last, view::string_view chars) noexcept {
+
+	if (first == last || chars.empty()) {
+		return nullptr;
+	}
+
+	if (chars.size() <= MaxVectorSet) {
+		return currentImplementation()->findLastOf(first, last, chars.data(), chars.size());
+	}
+
+	bool table[256] = {};
+	for (char ch : chars) {
+		table[static_cast<unsigned char>(ch)] = true;
+	}
+
+	while (last != first) {
+		--last;
+		if (table[static_cast<unsigned char>(*last)]) {
+			return last;
+		}
+	}
+
+	return nullptr;
+}
+
+/**
+ * @brief FindString
+ * @param first
+ * @param last
+ * @param needle
+ * @return the first occurance of "needle" in [first, last)
+ */
+const char *FindString(const char *first, const char *last, view::string_view needle) noexcept {
+	if (needle.empty()) {
+		return first;
+	}
+	return currentImplementation()->findString(first, last, needle.data(), needle.size(), false);
+}
+
+/**
+ * @brief FindStringCaseless
+ * @param first
+ * @param last
+ * @param needle
+ * @return the first occurance of "needle" in [first, last), ignoring the case
+ * of ASCII letters. "needle" must already be in lower case
+ */
+const char *FindStringCaseless(const char *first, const char *last, view::string_view needle) noexcept {
+	if (needle.empty()) {
+		return first;
+	}
+	return currentImplementation()->findString(first, last, needle.data(), needle.size(), true);
+}
+
+/**
+ * @brief ActiveInstructionSet
+ * @return
+ */
+InstructionSet ActiveInstructionSet() noexcept {
+	return currentImplementation()->isa;
+}
+
+/**
+ * @brief SetInstructionSet
+ * @param isa
+ * @return false if this CPU cannot run the requested kernels
+ *
+ * Overrides the automatic choice, this is intended for benchmarking and testing
+ */
+bool SetInstructionSet(InstructionSet isa) noexcept {
+
+	switch (isa) {
+	case InstructionSet::Scalar:
+		currentImplementation() = &ScalarImplementation;
+		return true;
+#ifdef KERNELS_X86
+	case InstructionSet::SSE2:
+		if (__builtin_cpu_supports("sse2")) {
+			currentImplementation() = &SSE2Implementation;
+			return true;
+		}
+		return false;
+	case InstructionSet::AVX2:
+		if (__builtin_cpu_supports("avx2")) {
+			currentImplementation() = &AVX2Implementation;
+			return true;
+		}
+		return false;
+#else
+	case InstructionSet::SSE2:
+	case InstructionSet::AVX2:
+		return false;
+#endif
+	}
+
+	return false;
+}
+
+}
@@ -0,0 +1,130 @@
+#include "Util/FileSystem.h"
+#include "Util/Kernels.h"
+
+#include <chrono>
+#include <cstdio>
+#include <random>
+#include <string>
+
+namespace {
+
+constexpr size_t TextSize   = 64 * 1024 * 1024;
+constexpr int    Iterations = 10;
+
+/*
+** Something resembling source code, lines of a random length up to 120
+** characters
+*/
+std::string makeText(size_t size, bool dos) {
+
+	std::mt19937 rng(42);
+	std::string text;
+	text.reserve(size + 128);
+
+	while (text.size() < size) {
+		const size_t length = rng() % 120;
+		for (size_t i = 0; i < length; ++i) {
+			text.push_back(static_cast<char>(' ' + rng() % 95));
+		}
+
+		if (dos) {
+			text.push_back('\r');
+		}
+		text.push_back('\n');
+	}
+
+	return text;
+}
+
+/*
+** Runs "func" a few times and reports the best throughput
+*/
+template <class Func>
+void measure(const char *name, size_t bytes, Func func) {
+
+	double best = 0;
+	size_t result = 0;
+
+	for (int i = 0; i < Iterations; ++i) {
+		const auto start = std::chrono::steady_clock::now();
+		result = func();
+		const auto end = std::chrono::steady_clock::now();
+
+		const double seconds = std::chrono::duration<double>(end - start).count();
+		best = std::max(best, static_cast<double>(bytes) / seconds / (1024 * 1024));
+	}
+
+	printf("  %-24s %10.0f MiB/s  (%zu)\n", name, best, result);
+}
+
+const char *isaName(Kernels::InstructionSet isa) {
+	switch (isa) {
+	case Kernels::InstructionSet::Scalar:
+		return "Scalar";
+	case Kernels::InstructionSet::SSE2:
+		return "SSE2";
+	case Kernels::InstructionSet::AVX2:
+		return "AVX2";
+	}
+
+	return "Unknown";
+}
+
+}
+
+int main() {
+
+	const std::string unixText = makeText(TextSize, false);
+	const std::string dosText  = makeText(TextSize, true);
+
+	const char *const first = unixText.data();
+	const char *const last  = first + unixText.size();
+
+	for (Kernels::InstructionSet isa : {Kernels::InstructionSet::Scalar, Kernels::InstructionSet::SSE2, Kernels::InstructionSet::AVX2}) {
+
+		if (!Kernels::SetInstructionSet(isa)) {
+			printf("%s: not supported\n", isaName(isa));
+			continue;
+		}
+
+		printf("%s:\n", isaName(isa));
+
+		measure("CountCharacter", unixText.size(), [&]() {
+			return Kernels::CountCharacter(first, last, '\n');
+		});
+
+		measure("FindCharacter (lines)", unixText.size(), [&]() {
+			size_t lines = 0;
+			for (const char *p = first; (p = Kernels::FindCharacter(p, last, '\n')); ++p) {
+				++lines;
+			}
+			return lines;
+		});
+
+		measure("FindLastCharacter", unixText.size(), [&]() {
+			const char *p = Kernels::FindLastCharacter(first, last, '\x01');
+			return static_cast<size_t>(p ? p - first : 0);
+		});
+
+		measure("FindFirstOf (3 chars)", unixText.size(), [&]() {
+			const char *p = Kernels::FindFirstOf(first, last, "\x01\x02\x03");
+			return static_cast<size_t>(p ? p - first : 0);
+		});
+
+		measure("FindString", unixText.size(), [&]() {
+			const char *p = Kernels::FindString(first, last, "needle");
+			return static_cast<size_t>(p ? p - first : 0);
+		});
+
+		measure("FindStringCaseless", unixText.size(), [&]() {
+			const char *p = Kernels::FindStringCaseless(first, last, "needle");
+			return static_cast<size_t>(p ? p - first : 0);
+		});
+
+		measure("ConvertFromDos", dosText.size(), [&]() {
+			std::string copy = dosText;
+			ConvertFromDos(copy);
+			return copy.size();
+		});
+	}
+}
@@ -2,6 +2,7 @@
 #ifndef UTIL_FILESYSTEM_H_
 #define UTIL_FILESYSTEM_H_
 
+#include <memory>
 #include <string>
 #include "string_view.h"
 #include <QtGlobal>
@@ -15,6 +16,7 @@ QString GetTrailingPathComponents(const QString &path, int noOfComponents);
 QString NormalizePathname(const QString &pathname);
 QString ReadAnyTextFile(const QString &fileName, bool forceNL);
 bool parseFilename(const QString &fullname, QString *filename, QString *pathname);
+std::shared_ptr<const char> MapFile(const QString &fileName, int64_t *size);
 
 // std::string based convesions
 void ConvertToMac(std::string &text);
@@ -22,6 +24,7 @@ void ConvertToDos(std::string &text);
 void ConvertFromMac(std::string &text);
 void ConvertFromDos(std::string &text);
 void ConvertFromDos(std::string &text, char *pendingCR);
+size_t ConvertFromDos(char *text, size_t length, char *pendingCR);
 
 template <class Integer>
 using IsInteger = typename std::enable_if<std::is_integral<Integer>::value>::type;
@@ -58,31 +61,7 @@ template <class Length, class = IsInteger<Length>>
 void ConvertFromDos(char *text, Length *length, char *pendingCR) {
 
 	Q_ASSERT(text);
-	char *out       = text;
-	const char *in  = text;
-	const char *end = text + *length;
-
-	if (pendingCR) {
-		*pendingCR = '\0';
-	}
-
-	while (in < end) {
-		if (*in == '\r') {
-			if (in < end - 1) {
-				if (in[1] == '\n') {
-					++in;
-				}
-			} else {
-				if (pendingCR) {
-					*pendingCR = *in;
-					break;
-				}
-			}
-		}
-		*out++ = *in++;
-	}
-
-	*length = static_cast<Length>(out - text);
+	*length = static_cast<Length>(ConvertFromDos(text, static_cast<size_t>(*length), pendingCR));
 }
 
 #endif
@@ -0,0 +1,36 @@
+
+#ifndef UTIL_KERNELS_H_
+#define UTIL_KERNELS_H_
+
+#include "string_view.h"
+#include <cstddef>
+
+/*
+** Vectorized versions of the character scanning loops which dominate file
+** loading, line counting and searching. On x86 the best implementation the
+** CPU supports (AVX2, SSE2, or plain C++) is chosen at run time.
+**
+** The Find routines return nullptr when there is no match.
+*/
+namespace Kernels {
+
+enum class InstructionSet {
+	Scalar,
+	SSE2,
+	AVX2
+};
+
+size_t CountCharacter(const char *first, const char *last, char ch) noexcept;
+const char *FindCharacter(const char *first, const char *last, char ch) noexcept;
+const char *FindLastCharacter(const char *first, const char *last, char ch) noexcept;
+const char *FindFirstOf(const char *first, const char *last, view::string_view chars) noexcept;
+const char *FindLastOf(const char *first, const char *last, view::string_view chars) noexcept;
+const char *FindString(const char *first, const char *last, view::string_view needle) noexcept;
+const char *FindStringCaseless(const char *first, const char *last, view::string_view needle) noexcept;
+
+InstructionSet ActiveInstructionSet() noexcept;
+bool SetInstructionSet(InstructionSet isa) noexcept;
+
+}
+
+#endif
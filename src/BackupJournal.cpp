@@ -0,0 +1,380 @@
+
+#include "BackupJournal.h"
+
+#include <QFile>
+#include <QFileInfo>
+#include <qplatformdefs.h>
+
+#include <cerrno>
+
+namespace {
+
+constexpr char JournalMagic[] = "NEDIT-NG JOURNAL 2";
+
+/*
+** Split the next line (without its newline) off of the front of "data",
+** returns false if there is no complete line left
+*/
+bool nextLine(view::string_view *data, std::string *line) {
+
+	const size_t n = data->find('\n');
+	if (n == view::string_view::npos) {
+		return false;
+	}
+
+	line->assign(data->data(), n);
+	data->remove_prefix(n + 1);
+	return true;
+}
+
+}
+
+/**
+ * @brief BackupJournal::BackupJournal
+ * @param filename
+ */
+BackupJournal::BackupJournal(const QString &filename) : filename_(filename) {
+	worker_ = std::thread([this]() { run(); });
+}
+
+/**
+ * @brief BackupJournal::~BackupJournal
+ *
+ * Writes out anything still queued before returning, the file is left in
+ * place
+ */
+BackupJournal::~BackupJournal() noexcept {
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		stopping_ = true;
+	}
+
+	cond_.notify_one();
+	worker_.join();
+
+	if (fp_) {
+		::fclose(fp_);
+	}
+}
+
+/**
+ * @brief BackupJournal::restart
+ * @param fileSize
+ * @param fileTime
+ * @param fileHash
+ *
+ * Discard the journal and begin a new one, for a document whose text is that
+ * of its file, which has the given size and modification time. "fileHash" is
+ * the 'Hash' of the contents the document was read from (or saved as), or 0
+ * if they aren't known
+ */
+void BackupJournal::restart(int64_t fileSize, time_t fileTime, uint64_t fileHash) {
+	size_ = 0;
+	push(Command{Command::Start, fileSize, static_cast<int64_t>(fileTime), std::string(), fileHash});
+}
+
+/**
+ * @brief BackupJournal::restart
+ * @param text
+ *
+ * Discard the journal and begin a new one from a snapshot of the document
+ */
+void BackupJournal::restart(std::string text) {
+	size_ = static_cast<int64_t>(text.size());
+	push(Command{Command::Start, -1, 0, std::string()});
+	push(Command{Command::Snapshot, 0, 0, std::move(text)});
+}
+
+/**
+ * @brief BackupJournal::resume
+ *
+ * Continue the journal which is already on disk, after it has been replayed
+ * into the document
+ */
+void BackupJournal::resume() {
+	size_ = QFileInfo(filename_).size();
+	push(Command{Command::Open, 0, 0, std::string()});
+}
+
+/**
+ * @brief BackupJournal::append
+ * @param pos
+ * @param nDeleted
+ * @param text
+ *
+ * Record that "nDeleted" characters at "pos" were replaced by "text"
+ */
+void BackupJournal::append(int64_t pos, int64_t nDeleted, std::string text) {
+	size_ += static_cast<int64_t>(text.size());
+	push(Command{Command::Edit, pos, nDeleted, std::move(text)});
+}
+
+/**
+ * @brief BackupJournal::flush
+ *
+ * Have the worker write out everything recorded so far, without waiting for
+ * it to do so
+ */
+void BackupJournal::flush() {
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		flushRequested_ = true;
+	}
+
+	cond_.notify_one();
+}
+
+/**
+ * @brief BackupJournal::error
+ * @return the errno of the first write which failed, or 0. Once a write has
+ * failed, nothing more is written
+ */
+int BackupJournal::error() const {
+	return error_;
+}
+
+/**
+ * @brief BackupJournal::size
+ * @return the number of bytes of text recorded since the journal was started,
+ * which tells the owner when it is worth compacting it with a snapshot
+ */
+int64_t BackupJournal::size() const {
+	return size_;
+}
+
+/**
+ * @brief BackupJournal::push
+ * @param command
+ */
+void BackupJournal::push(Command &&command) {
+	std::lock_guard<std::mutex> lock(mutex_);
+	pending_.push_back(std::move(command));
+}
+
+/**
+ * @brief BackupJournal::run
+ *
+ * The worker, writes out the queued commands whenever a flush is requested
+ */
+void BackupJournal::run() {
+
+	std::unique_lock<std::mutex> lock(mutex_);
+
+	for (;;) {
+		cond_.wait(lock, [this]() { return flushRequested_ || stopping_; });
+
+		std::deque<Command> commands;
+		commands.swap(pending_);
+		flushRequested_ = false;
+		const bool stopping = stopping_;
+
+		lock.unlock();
+
+		for (const Command &command : commands) {
+			if (error_ != 0) {
+				break;
+			}
+			write(command);
+		}
+
+		if (fp_ && error_ == 0) {
+			if (::fflush(fp_) != 0) {
+				error_ = errno;
+			}
+#ifdef Q_OS_UNIX
+			else {
+				::fsync(QT_FILENO(fp_));
+			}
+#endif
+		}
+
+		lock.lock();
+
+		if (stopping) {
+			break;
+		}
+	}
+}
+
+/**
+ * @brief BackupJournal::write
+ * @param command
+ */
+void BackupJournal::write(const Command &command) {
+
+	switch (command.type) {
+	case Command::Start:
+	{
+		if (fp_) {
+			::fclose(fp_);
+			fp_ = nullptr;
+		}
+
+		QFile::remove(filename_);
+
+		/* set more restrictive permissions (using default permissions was
+		   somewhat of a security hole, because permissions were independent
+		   of those of the original file being edited */
+#ifdef Q_OS_WIN
+		int fd = QT_OPEN(filename_.toUtf8().data(), QT_OPEN_CREAT | O_EXCL | QT_OPEN_WRONLY, _S_IREAD | _S_IWRITE);
+#else
+		int fd = QT_OPEN(filename_.toUtf8().data(), QT_OPEN_CREAT | O_EXCL | QT_OPEN_WRONLY, S_IRUSR | S_IWUSR);
+#endif
+		if (fd < 0 || (fp_ = ::fdopen(fd, "wb")) == nullptr) {
+			error_ = errno;
+			return;
+		}
+
+		::fprintf(fp_, "%s %lld %lld %llx\n", JournalMagic, static_cast<long long>(command.a), static_cast<long long>(command.b), static_cast<unsigned long long>(command.hash));
+		break;
+	}
+	case Command::Open:
+		if (fp_) {
+			::fclose(fp_);
+		}
+
+		if ((fp_ = ::fopen(filename_.toUtf8().data(), "ab")) == nullptr) {
+			error_ = errno;
+			return;
+		}
+		break;
+	case Command::Snapshot:
+		if (!fp_) {
+			return;
+		}
+
+		::fprintf(fp_, "S %llu\n", static_cast<unsigned long long>(command.text.size()));
+		::fwrite(command.text.data(), 1, command.text.size(), fp_);
+		break;
+	case Command::Edit:
+		if (!fp_) {
+			return;
+		}
+
+		::fprintf(fp_, "E %lld %lld %llu\n", static_cast<long long>(command.a), static_cast<long long>(command.b), static_cast<unsigned long long>(command.text.size()));
+		::fwrite(command.text.data(), 1, command.text.size(), fp_);
+		break;
+	}
+
+	if (::ferror(fp_)) {
+		error_ = errno;
+	}
+}
+
+/**
+ * @brief BackupJournal::Hash
+ * @param data
+ * @param hash
+ * @return a 64-bit FNV-1a hash of "data", continuing from "hash" so that text
+ * can be hashed a piece at a time. Lets a journal be matched to its file
+ * after the file has been touched without being changed
+ */
+uint64_t BackupJournal::Hash(view::string_view data, uint64_t hash) {
+
+	for (char ch : data) {
+		hash ^= static_cast<uint8_t>(ch);
+		hash *= 0x100000001b3ull;
+	}
+
+	return hash;
+}
+
+/**
+ * @brief BackupJournal::Replay
+ * @param filename
+ * @param fileSize
+ * @param fileTime
+ * @param fileHash
+ * @param length
+ * @param snapshot
+ * @param edit
+ * @return Valid if "filename" holds a journal with at least one record which
+ * applies to a document read from a file with the given size, modification
+ * time and 'Hash' of its contents, and holding "length" characters. If so,
+ * its records are passed to "snapshot" and "edit" in order, either of which
+ * may be empty to only check the journal. A journal made when the file had a
+ * different modification time still applies if its contents are the same.
+ */
+BackupJournal::Status BackupJournal::Replay(const QString &filename, int64_t fileSize, time_t fileTime, uint64_t fileHash, int64_t length, const SnapshotCallback &snapshot, const EditCallback &edit) {
+
+	QFile file(filename);
+	if (!file.open(QIODevice::ReadOnly) || file.size() == 0) {
+		return Status::Missing;
+	}
+
+	uchar *memory = file.map(0, file.size());
+	if (!memory) {
+		return Status::Rejected;
+	}
+
+	auto data = view::string_view(reinterpret_cast<const char *>(memory), static_cast<size_t>(file.size()));
+
+	std::string line;
+	if (!nextLine(&data, &line) || line.compare(0, sizeof(JournalMagic) - 1, JournalMagic) != 0) {
+		return Status::Rejected;
+	}
+
+	long long baseSize;
+	long long baseTime;
+	unsigned long long baseHash;
+	if (std::sscanf(line.c_str() + sizeof(JournalMagic) - 1, "%lld %lld %llx", &baseSize, &baseTime, &baseHash) != 3) {
+		return Status::Rejected;
+	}
+
+	// a journal which starts with a snapshot applies to any file
+	if (baseSize != -1) {
+		if (baseSize != fileSize) {
+			return Status::Rejected;
+		}
+
+		if (baseTime != static_cast<long long>(fileTime) && (baseHash == 0 || baseHash != fileHash)) {
+			return Status::Rejected;
+		}
+	}
+
+	size_t records = 0;
+
+	while (nextLine(&data, &line)) {
+		long long pos;
+		long long nDeleted;
+		unsigned long long n;
+
+		if (std::sscanf(line.c_str(), "S %llu", &n) == 1) {
+			if (n > data.size()) {
+				break;
+			}
+
+			if (snapshot) {
+				snapshot(data.substr(0, n));
+			}
+
+			length = static_cast<int64_t>(n);
+		} else if (std::sscanf(line.c_str(), "E %lld %lld %llu", &pos, &nDeleted, &n) == 3) {
+			if (n > data.size()) {
+				break;
+			}
+
+			// a journal which isn't based on a file must start with a snapshot
+			if (baseSize == -1 && records == 0) {
+				return Status::Rejected;
+			}
+
+			if (pos < 0 || nDeleted < 0 || pos + nDeleted > length) {
+				return Status::Rejected;
+			}
+
+			if (edit) {
+				edit(pos, nDeleted, data.substr(0, n));
+			}
+
+			length += static_cast<int64_t>(n) - nDeleted;
+		} else {
+			break;
+		}
+
+		data.remove_prefix(n);
+		++records;
+	}
+
+	return (records != 0) ? Status::Valid : Status::Missing;
+}
@@ -0,0 +1,101 @@
+
+#ifndef BACKUP_JOURNAL_H_
+#define BACKUP_JOURNAL_H_
+
+#include "Util/string_view.h"
+
+#include <QString>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <ctime>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+
+/*
+** An append-only journal of the edits made to a document, kept as its
+** incremental backup file. A journal starts either from the file the document
+** was read from, identified by its size, modification time and a hash of the
+** contents that were read, or from a snapshot of the text. Every edit is then
+** recorded as the range of text it replaced and the text which replaced it.
+**
+** Records are queued by the GUI thread and written out by a worker thread,
+** so keeping the backup up to date never waits for the disk. A record which
+** was only partly written when the program died is ignored on recovery, so a
+** journal always describes some earlier state of the document.
+*/
+class BackupJournal {
+public:
+	enum class Status {
+		Missing,  // there is no journal, or nothing has been recorded in it
+		Rejected, // it is damaged, or was made for some other version of the file
+		Valid
+	};
+
+public:
+	using SnapshotCallback = std::function<void(view::string_view text)>;
+	using EditCallback     = std::function<void(int64_t pos, int64_t nDeleted, view::string_view text)>;
+
+public:
+	explicit BackupJournal(const QString &filename);
+	BackupJournal(const BackupJournal &)            = delete;
+	BackupJournal &operator=(const BackupJournal &) = delete;
+	~BackupJournal() noexcept;
+
+public:
+	void append(int64_t pos, int64_t nDeleted, std::string text);
+	void flush();
+	void restart(int64_t fileSize, time_t fileTime, uint64_t fileHash);
+	void restart(std::string text);
+	void resume();
+
+public:
+	int error() const;
+	int64_t size() const;
+
+public:
+	static Status Replay(const QString &filename, int64_t fileSize, time_t fileTime, uint64_t fileHash, int64_t length, const SnapshotCallback &snapshot, const EditCallback &edit);
+	static uint64_t Hash(view::string_view data, uint64_t hash = 0xcbf29ce484222325ull);
+
+private:
+	struct Command {
+		enum Type {
+			Start,
+			Open,
+			Snapshot,
+			Edit
+		};
+
+		Type type;
+		int64_t a;
+		int64_t b;
+		std::string text;
+		uint64_t hash = 0;
+	};
+
+private:
+	void push(Command &&command);
+	void run();
+	void write(const Command &command);
+
+private:
+	QString filename_;
+	FILE *fp_     = nullptr; // only touched by the worker
+	int64_t size_ = 0;       // bytes recorded since the journal was last started
+
+	std::atomic<int> error_{0};
+
+	std::mutex mutex_;
+	std::condition_variable cond_;
+	std::deque<Command> pending_;
+	bool flushRequested_ = false;
+	bool stopping_       = false;
+	std::thread worker_;
+};
+
+#endif
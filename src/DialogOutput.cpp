@@ -1,6 +1,8 @@
 
 #include "DialogOutput.h"
 
+#include <QTextCursor>
+
 /**
  * @brief DialogOutput::DialogOutput
  * @param parent
@@ -17,3 +19,16 @@ DialogOutput::DialogOutput(QWidget *parent, Qt::WindowFlags f) : Dialog(parent,
 void DialogOutput::setText(const QString &text) {
 	ui.plainTextEdit->setPlainText(text);
 }
+
+/**
+ * @brief DialogOutput::appendText
+ * @param text
+ *
+ * Add "text" to the end of what is already shown, as is (unlike
+ * QPlainTextEdit::appendPlainText, it doesn't start a new paragraph)
+ */
+void DialogOutput::appendText(const QString &text) {
+	QTextCursor cursor(ui.plainTextEdit->document());
+	cursor.movePosition(QTextCursor::End);
+	cursor.insertText(text);
+}
@@ -0,0 +1,247 @@
+
+#include "DocumentSaver.h"
+#include "BackupJournal.h"
+#include "Util/Kernels.h"
+
+#include <QFileInfo>
+#include <qplatformdefs.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+namespace {
+
+// how much of the text is converted and written at a time
+constexpr size_t ChunkSize = 1024 * 1024;
+
+/*
+** Write all of "size" bytes at "data" to "fd", returns false (with errno
+** set) on failure
+*/
+bool writeAll(int fd, const char *data, size_t size) {
+
+	while (size != 0) {
+		const auto n = QT_WRITE(fd, data, size);
+		if (n < 0) {
+			if (errno == EINTR) {
+				continue;
+			}
+			return false;
+		}
+
+		data += n;
+		size -= static_cast<size_t>(n);
+	}
+
+	return true;
+}
+
+}
+
+/**
+ * @brief DocumentSaver::DocumentSaver
+ * @param filename
+ * @param text
+ * @param format
+ * @param parent
+ */
+DocumentSaver::DocumentSaver(const QString &filename, text_snapshot<char> text, FileFormats format, QObject *parent) : QThread(parent), filename_(filename), text_(std::move(text)), format_(format) {
+}
+
+/**
+ * @brief DocumentSaver::opened
+ * @return false if the file couldn't be created at all, as opposed to
+ * failing while it was written
+ */
+bool DocumentSaver::opened() const {
+	return opened_;
+}
+
+/**
+ * @brief DocumentSaver::error
+ * @return the errno of the step which failed, or 0 if the text was saved
+ */
+int DocumentSaver::error() const {
+	return error_;
+}
+
+/**
+ * @brief DocumentSaver::hash
+ * @return the BackupJournal::Hash of the file's new contents, once the text
+ * has been saved
+ */
+uint64_t DocumentSaver::hash() const {
+	return hash_;
+}
+
+/**
+ * @brief DocumentSaver::run
+ */
+void DocumentSaver::run() {
+
+	// replace the file a symbolic link points to, rather than the link
+	const QFileInfo info(filename_);
+	const QByteArray path = info.exists() ? info.canonicalFilePath().toUtf8() : filename_.toUtf8();
+
+	if (!tryReplacing(path)) {
+		writeInPlace(path);
+	}
+
+	// the snapshot isn't needed any more, don't hold on to it until we are deleted
+	text_.clear();
+}
+
+/**
+ * @brief DocumentSaver::tryReplacing
+ * @param path
+ * @return false if the file should be written in place instead, otherwise
+ * the outcome is in error_
+ */
+bool DocumentSaver::tryReplacing(const QByteArray &path) {
+#ifdef Q_OS_UNIX
+	QT_STATBUF statbuf;
+	if (QT_STAT(path.data(), &statbuf) != 0 || !S_ISREG(statbuf.st_mode) || statbuf.st_nlink != 1) {
+		return false;
+	}
+
+	const QFileInfo info(QString::fromUtf8(path));
+	QByteArray temp = QString(QLatin1String("%1/.%2.XXXXXX")).arg(info.absolutePath(), info.fileName()).toUtf8();
+
+	const int fd = ::mkstemp(temp.data());
+	if (fd < 0) {
+		return false;
+	}
+
+	// the replacement must end up with the permissions and owner of the original
+	if (::fchmod(fd, statbuf.st_mode & 07777) != 0 || ((statbuf.st_uid != ::geteuid() || statbuf.st_gid != ::getegid()) && ::fchown(fd, statbuf.st_uid, statbuf.st_gid) != 0)) {
+		QT_CLOSE(fd);
+		::unlink(temp.data());
+		return false;
+	}
+
+	opened_ = true;
+
+	bool written = writeText(fd) && ::fsync(fd) == 0;
+	if (!written) {
+		error_ = errno;
+	}
+
+	if (QT_CLOSE(fd) != 0 && written) {
+		error_  = errno;
+		written = false;
+	}
+
+	if (written && ::rename(temp.data(), path.data()) != 0) {
+		error_  = errno;
+		written = false;
+	}
+
+	if (!written) {
+		::unlink(temp.data());
+	}
+
+	return true;
+#else
+	Q_UNUSED(path);
+	return false;
+#endif
+}
+
+/**
+ * @brief DocumentSaver::writeInPlace
+ * @param path
+ */
+void DocumentSaver::writeInPlace(const QByteArray &path) {
+
+	const int fd = QT_OPEN(path.data(), QT_OPEN_CREAT | QT_OPEN_WRONLY | QT_OPEN_TRUNC, 0666);
+	if (fd < 0) {
+		error_ = errno;
+		return;
+	}
+
+	opened_ = true;
+
+	bool written = writeText(fd);
+#ifdef Q_OS_UNIX
+	written = written && ::fsync(fd) == 0;
+#endif
+	if (!written) {
+		error_ = errno;
+	}
+
+	if (QT_CLOSE(fd) != 0 && written) {
+		error_ = errno;
+	}
+}
+
+/**
+ * @brief DocumentSaver::writeText
+ * @param fd
+ * @return false (with errno set) if the text couldn't be written
+ */
+bool DocumentSaver::writeText(int fd) {
+
+	bool written = true;
+	hash_        = BackupJournal::Hash(view::string_view());
+
+	text_.for_each_span([this, fd, &written](view::string_view span) {
+		written = writeSpan(fd, span.data(), span.data() + span.size());
+		return written;
+	});
+
+	return written;
+}
+
+/**
+ * @brief DocumentSaver::writeSpan
+ * @param fd
+ * @param first
+ * @param end
+ * @return false (with errno set) if the text couldn't be written
+ *
+ * Writes one span of the snapshot a chunk at a time, converting the line
+ * endings for DOS and Macintosh format files on the way
+ */
+bool DocumentSaver::writeSpan(int fd, const char *first, const char *end) {
+
+	std::string chunk;
+
+	while (first != end) {
+		const char *last = first + std::min(ChunkSize, static_cast<size_t>(end - first));
+
+		switch (format_) {
+		case FileFormats::Unix:
+			if (!writeAll(fd, first, static_cast<size_t>(last - first))) {
+				return false;
+			}
+			hash_ = BackupJournal::Hash(view::string_view(first, static_cast<size_t>(last - first)), hash_);
+			first = last;
+			continue;
+		case FileFormats::Dos:
+			chunk.clear();
+			while (const char *nl = Kernels::FindCharacter(first, last, '\n')) {
+				chunk.append(first, nl);
+				chunk.append("\r\n");
+				first = nl + 1;
+			}
+			chunk.append(first, last);
+			break;
+		case FileFormats::Mac:
+			chunk.assign(first, last);
+			std::replace(chunk.begin(), chunk.end(), '\n', '\r');
+			break;
+		}
+
+		if (!writeAll(fd, chunk.data(), chunk.size())) {
+			return false;
+		}
+		hash_ = BackupJournal::Hash(chunk, hash_);
+
+		first = last;
+	}
+
+	return true;
+}
@@ -0,0 +1,55 @@
+
+#ifndef DOCUMENT_SAVER_H_
+#define DOCUMENT_SAVER_H_
+
+#include "text_snapshot.h"
+#include "Util/FileFormats.h"
+
+#include <QByteArray>
+#include <QString>
+#include <QThread>
+
+#include <cstdint>
+
+/*
+** Writes a snapshot of a document's text to its file on a thread of its own,
+** so that the user can keep on editing while a large file is being saved.
+** Line endings are converted to the file's format a chunk at a time, rather
+** than in a second copy of the whole text.
+**
+** Where possible the text goes to a temporary file next to the original,
+** which is synced and then renamed over it, so the file on disk is always
+** either the old or the new version. Files which that would detach from
+** other links, or whose owner can't be kept, are overwritten in place.
+*/
+class DocumentSaver : public QThread {
+	Q_OBJECT
+
+public:
+	DocumentSaver(const QString &filename, text_snapshot<char> text, FileFormats format, QObject *parent = nullptr);
+	~DocumentSaver() override = default;
+
+public:
+	bool opened() const;
+	int error() const;
+	uint64_t hash() const;
+
+protected:
+	void run() override;
+
+private:
+	bool tryReplacing(const QByteArray &path);
+	void writeInPlace(const QByteArray &path);
+	bool writeText(int fd);
+	bool writeSpan(int fd, const char *first, const char *end);
+
+private:
+	QString filename_;
+	text_snapshot<char> text_;
+	FileFormats format_;
+	bool opened_   = false; // the file (or its replacement) could be created
+	int error_     = 0;     // errno of the step which failed, or 0
+	uint64_t hash_ = 0;     // BackupJournal::Hash of the bytes written
+};
+
+#endif
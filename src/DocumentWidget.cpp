@@ -1,17 +1,20 @@
 
 #include "DocumentWidget.h"
+#include "BackupJournal.h"
 #include "CommandRecorder.h"
 #include "DialogDuplicateTags.h"
 #include "DialogMoveDocument.h"
 #include "DialogOutput.h"
 #include "DialogPrint.h"
 #include "DialogReplace.h"
+#include "DocumentSaver.h"
 #include "DragEndEvent.h"
 #include "EditFlags.h"
 #include "Font.h"
 #include "FontType.h"
 #include "Highlight.h"
 #include "HighlightData.h"
+#include "HighlightParser.h"
 #include "HighlightStyle.h"
 #include "MainWindow.h"
 #include "PatternSet.h"
@@ -23,6 +26,7 @@
 #include "SmartIndentEntry.h"
 #include "SmartIndentEvent.h"
 #include "Style.h"
+#include "StyleBuffer.h"
 #include "TextArea.h"
 #include "TextBuffer.h"
 #include "WindowHighlightData.h"
@@ -47,12 +51,14 @@
 #include <QRadioButton>
 #include <QSplitter>
 #include <QTemporaryFile>
+#include <QTextCodec>
 #include <QTimer>
 #include <QButtonGroup>
 #include <QScrollBar>
 #include <qplatformdefs.h>
 
 #include <chrono>
+#include <cstring>
 
 // NOTE(eteran): generally, this class reaches out to MainWindow FAR too much
 // it would be better to create some fundamental signals that MainWindow could
@@ -62,16 +68,23 @@
 /* data attached to window during shell command execution with information for
  * controling and communicating with the process */
 struct ShellCommandData {
-	QTimer        bannerTimer;
-	QByteArray    standardError;
-	QByteArray    standardOutput;
-	QProcess *    process;
-	TextArea *    area;
-	TextCursor    leftPos;
-	TextCursor    rightPos;
-	CommandSource source;
-	int           flags;
-	bool          bannerIsUp;
+	QTimer                        bannerTimer;
+	QByteArray                    standardError;
+	std::string                   standardOutput; // output saved up so far (ACCUMULATE), already converted from the locale's encoding
+	std::string                   input;          // text to feed to the process
+	size_t                        inputOffset;    // how much of it has been written so far
+	std::unique_ptr<QTextDecoder> decoder;        // converts the output, which may arrive split mid-character
+	QPointer<DialogOutput>        dialog;         // where output goes as it arrives, for OUTPUT_TO_DIALOG
+	QProcess *                    process;
+	QPointer<TextArea>            area;
+	QPointer<DocumentWidget>      target;         // the document whose buffer holds area's text
+	TextCursor                    leftPos;
+	TextCursor                    rightPos;
+	CommandSource                 source;
+	int                           flags;
+	bool                          bannerIsUp;
+	bool                          outputInserted; // some output has replaced leftPos..rightPos, which now spans it
+	uint64_t                      undoRecord;     // serial of the undo record the output is in, 0 until there is one
 };
 
 DocumentWidget *DocumentWidget::LastCreated;
@@ -84,6 +97,9 @@ constexpr int MAX_PANES = 6;
 // how long to wait (msec) before putting up Shell Command Executing... banner
 constexpr int BANNER_WAIT_TIME = 6000;
 
+// how long editing has to pause for before undo records are compressed
+constexpr int UNDO_COMPRESS_DELAY = 1000;
+
 // flags for issueCommand
 enum {
 	ACCUMULATE        = 1,
@@ -91,9 +107,13 @@ enum {
 	REPLACE_SELECTION = 4,
 	RELOAD_FILE_AFTER = 8,
 	OUTPUT_TO_DIALOG  = 16,
-	OUTPUT_TO_STRING  = 32
+	OUTPUT_TO_STRING  = 32,
+	SELECT_OUTPUT     = 64
 };
 
+// how much of a shell command's input is handed to the process at a time
+constexpr size_t ShellInputChunkSize = 64 * 1024;
+
 struct CharMatchTable {
 	char      ch;
 	char      match;
@@ -215,6 +235,28 @@ void maintainPosition(TextCursor &position, TextCursor modPos, int64_t nInserted
 	}
 }
 
+/*
+** Does a shell command issued with "flags" insert its output in the text
+** widget piece by piece, as it arrives?
+*/
+bool insertsOutputIncrementally(int flags) {
+	return !(flags & (ACCUMULATE | OUTPUT_TO_DIALOG | OUTPUT_TO_STRING));
+}
+
+/*
+** Keep the range which a shell command's output is going to in step with
+** modifications made to the buffer while the command runs
+*/
+void shellOutputModifiedCB(TextCursor pos, int64_t nInserted, int64_t nDeleted, int64_t nRestyled, view::string_view deletedText, void *user) {
+
+	Q_UNUSED(nRestyled);
+	Q_UNUSED(deletedText);
+
+	auto cmdData = static_cast<ShellCommandData *>(user);
+	maintainPosition(cmdData->leftPos,  pos, nInserted, nDeleted);
+	maintainPosition(cmdData->rightPos, pos, nInserted, nDeleted);
+}
+
 /*
 ** Update a selection across buffer modifications specified by
 ** "pos", "nDeleted", and "nInserted".
@@ -468,6 +510,26 @@ DocumentWidget::DocumentWidget(const QString &name, QWidget *parent, Qt::WindowF
 		eraseFlash();
 	});
 
+	highlightTimer_ = new QTimer(this);
+	highlightTimer_->setInterval(0);
+
+	connect(highlightTimer_, &QTimer::timeout, this, [this]() {
+		highlightInBackground();
+	});
+
+	undoCompressTimer_ = new QTimer(this);
+	undoCompressTimer_->setSingleShot(true);
+
+	connect(undoCompressTimer_, &QTimer::timeout, this, [this]() {
+		const bool undoLeft = undo_.compressPending();
+		const bool redoLeft = redo_.compressPending();
+
+		// each call does a bounded amount, carry on once events have been handled
+		if (undoLeft || redoLeft) {
+			undoCompressTimer_->start(0);
+		}
+	});
+
 	auto area = createTextArea(buffer_);
 
 	buffer_->BufAddModifyCB(modifiedCB, this);
@@ -487,6 +549,11 @@ DocumentWidget::DocumentWidget(const QString &name, QWidget *parent, Qt::WindowF
  */
 DocumentWidget::~DocumentWidget() noexcept {
 
+	// a save which is still being written needs the snapshot we gave it
+	if (saver_) {
+		saver_->wait();
+	}
+
 	// first delete all of the text area's so that they can properly
 	// remove themselves from the buffer's callbacks
 	const std::vector<TextArea *> textAreas = textPanes();
@@ -913,11 +980,18 @@ void DocumentWidget::modifiedCallback(TextCursor pos, int64_t nInserted, int64_t
 		   characters and editing operations for triggering autosave */
 		saveUndoInformation(pos, nInserted, nDeleted, deletedText);
 
-		// Trigger automatic backup if operation or character limits reached
-		if (autoSave_ && (autoSaveCharCount_ > AutoSaveCharLimit || autoSaveOpCount_ > AutoSaveOpLimit)) {
-			WriteBackupFile();
-			autoSaveCharCount_ = 0;
-			autoSaveOpCount_   = 0;
+		/* Record the change in the backup journal, and have it written out if
+		   operation or character limits reached */
+		if (autoSave_) {
+			journalModification(pos, nInserted, nDeleted);
+
+			if (autoSaveCharCount_ > AutoSaveCharLimit || autoSaveOpCount_ > AutoSaveOpLimit) {
+				WriteBackupFile();
+				autoSaveCharCount_ = 0;
+				autoSaveOpCount_   = 0;
+			}
+		} else {
+			journal_ = nullptr;
 		}
 
 		// Indicate that the window has now been modified
@@ -1325,6 +1399,7 @@ void DocumentWidget::stopHighlighting() {
 	}
 
 	// Free and remove the highlight data from the window
+	stopBackgroundParse();
 	highlightData_ = nullptr;
 
 	/* Remove and detach style buffer and style table from all text
@@ -1434,14 +1509,26 @@ void DocumentWidget::saveUndoInformation(TextCursor pos, int64_t nInserted, int6
 
 	const UndoTypes oldType = (!currentUndo || isUndo) ? UNDO_NOOP : currentUndo->type;
 
+	/* shell command output is inserted a piece at a time as it arrives, each
+	   piece continues the output's record, so that the whole of the output is
+	   undone at once. That is, as long as the record is still the most recent
+	   one, otherwise the piece starts a new record for the output to go in */
+	if (fileChanged_ && outputRecord_ && !isUndo && currentUndo && currentUndo->serial == *outputRecord_ && nDeleted == 0 && pos == currentUndo->endPos) {
+		currentUndo->endPos += nInserted;
+		++autoSaveOpCount_;
+		return;
+	}
+
 	/*
 	** Check for continuations of single character operations.  These are
 	** accumulated so a whole insertion or deletion can be undone, rather
 	** than just the last character that the user typed.  If the document
 	** is currently in an unmodified state, don't accumulate operations
 	** across the save, so the user can undo back to the unmodified state.
+	** The ranges changed by an edit group, and shell command output, always
+	** get records of their own.
 	*/
-	if (fileChanged_) {
+	if (fileChanged_ && !reportingGroup_ && !outputRecord_) {
 
 		// normal sequential character insertion
 		if (((oldType == ONE_CHAR_INSERT || oldType == ONE_CHAR_REPLACE) && newType == ONE_CHAR_INSERT) && (pos == currentUndo->endPos)) {
@@ -1452,7 +1539,7 @@ void DocumentWidget::saveUndoInformation(TextCursor pos, int64_t nInserted, int6
 
 		// overstrike mode replacement
 		if ((oldType == ONE_CHAR_REPLACE && newType == ONE_CHAR_REPLACE) && (pos == currentUndo->endPos)) {
-			appendDeletedText(deletedText, nDeleted, Direction::Forward);
+			appendDeletedText(deletedText, Direction::Forward);
 			++currentUndo->endPos;
 			++autoSaveCharCount_;
 			return;
@@ -1460,13 +1547,13 @@ void DocumentWidget::saveUndoInformation(TextCursor pos, int64_t nInserted, int6
 
 		// forward delete
 		if ((oldType == ONE_CHAR_DELETE && newType == ONE_CHAR_DELETE) && (pos == currentUndo->startPos)) {
-			appendDeletedText(deletedText, nDeleted, Direction::Forward);
+			appendDeletedText(deletedText, Direction::Forward);
 			return;
 		}
 
 		// reverse delete
 		if ((oldType == ONE_CHAR_DELETE && newType == ONE_CHAR_DELETE) && (pos == currentUndo->startPos - 1)) {
-			appendDeletedText(deletedText, nDeleted, Direction::Backward);
+			appendDeletedText(deletedText, Direction::Backward);
 			--currentUndo->startPos;
 			--currentUndo->endPos;
 			return;
@@ -1479,9 +1566,9 @@ void DocumentWidget::saveUndoInformation(TextCursor pos, int64_t nInserted, int6
 	*/
 	UndoInfo undo(newType, pos, pos + nInserted);
 
-	// if text was deleted, save it
-	if (nDeleted > 0) {
-		undo.oldText = deletedText.to_string();
+	// if text was deleted, it is saved along with the record
+	if (nDeleted == 0) {
+		deletedText = view::string_view();
 	}
 
 	// increment the operation count for the autosave feature
@@ -1501,13 +1588,25 @@ void DocumentWidget::saveUndoInformation(TextCursor pos, int64_t nInserted, int6
 		}
 	}
 
+	// the records made for the ranges changed by one edit group are undone together
+	const bool joinGroup = reportingGroup_ && groupRecorded_;
+	groupRecorded_ = reportingGroup_;
+
 	/* Add the new record to the undo list unless saveUndoInformation is
 	   saving information generated by an Undo operation itself, in
 	   which case, add the new record to the redo list. */
 	if (isUndo) {
-		addRedoItem(std::move(undo));
+		undo.joined = joinGroup;
+		addRedoItem(std::move(undo), deletedText);
 	} else {
-		addUndoItem(std::move(undo));
+		// join up the records made by the edit groups of a single macro
+		undo.joined = joinGroup || (editGroupMacro_ && undoMacro_.lock() == editGroupMacro_);
+		undoMacro_  = editGroupMacro_;
+		addUndoItem(std::move(undo), deletedText);
+
+		if (outputRecord_) {
+			*outputRecord_ = undo_.front().serial;
+		}
 	}
 }
 
@@ -1535,52 +1634,51 @@ void DocumentWidget::clearRedoList() {
 ** for continuing of a string of one character deletes or replaces, but will
 ** work with more than one character.
 */
-void DocumentWidget::appendDeletedText(view::string_view deletedText, int64_t deletedLen, Direction direction) {
-	UndoInfo &undo = undo_.front();
-
-	// re-allocate, adding space for the new character(s)
-	std::string comboText;
-	comboText.reserve(undo.oldText.size() + static_cast<size_t>(deletedLen));
-
-	// copy the new character and the already deleted text to the new memory
-	if (direction == Direction::Forward) {
-		comboText.append(undo.oldText);
-		comboText.append(deletedText.begin(), deletedText.end());
-	} else {
-		comboText.append(deletedText.begin(), deletedText.end());
-		comboText.append(undo.oldText);
-	}
-
-	// replace the old saved text and attach the new
-	undo.oldText = std::move(comboText);
+void DocumentWidget::appendDeletedText(view::string_view deletedText, Direction direction) {
+	undo_.appendText(deletedText, direction);
 }
 
 /*
-** Add an undo record to the this's undo
-** list if the item pushes the undo operation or character counts past the
-** limits, trim the undo list to an acceptable length.
+** Add an undo record to the this's undo list, restoring "oldText".  If the
+** item pushes the undo list past its memory limit, trim the oldest records
+** off of it.
 */
-void DocumentWidget::addUndoItem(UndoInfo &&undo) {
+void DocumentWidget::addUndoItem(UndoInfo &&undo, view::string_view oldText) {
 
-	undo_.emplace_front(std::move(undo));
+	undo.serial = ++undoSerial_;
+	undo_.push_front(std::move(undo), oldText);
 
-	// Trim the list if it exceeds any of the limits
-	if (undo_.size() > UNDO_OP_LIMIT) {
-		trimUndoList(UNDO_OP_TRIMTO);
-	}
+	// Trim the list if it exceeds the limit
+	trimUndoList(static_cast<size_t>(Preferences::GetPrefUndoMemoryLimit()) * 1024 * 1024);
 
+	scheduleUndoCompression();
 	Q_EMIT canUndoChanged(!undo_.empty());
 }
 
 /*
 ** Add an item (already allocated by the caller) to the this's redo list.
 */
-void DocumentWidget::addRedoItem(UndoInfo &&redo) {
+void DocumentWidget::addRedoItem(UndoInfo &&redo, view::string_view oldText) {
 
-	redo_.emplace_front(std::move(redo));
+	redo_.push_front(std::move(redo), oldText);
+	scheduleUndoCompression();
 	Q_EMIT canRedoChanged(!redo_.empty());
 }
 
+/*
+** Compressing the text of older undo and redo records means rewriting the
+** recent part of their logs, so rather than doing it on every edit, it is
+** put off until there has been a pause in editing
+*/
+void DocumentWidget::scheduleUndoCompression() {
+
+	if (!Preferences::GetPrefCompressUndo() || !(undo_.hasPending() || redo_.hasPending())) {
+		return;
+	}
+
+	undoCompressTimer_->start(UNDO_COMPRESS_DELAY);
+}
+
 /*
 ** Pop the current undo record from the undo list
 */
@@ -1609,26 +1707,44 @@ void DocumentWidget::removeRedoItem() {
 
 
 /*
-** Trim records off of the END of the undo list to reduce it to length
-** maxLength
+** Trim records off of the END of the undo list until it takes up no more than
+** maxBytes, the most recent record is always kept
+*/
+void DocumentWidget::trimUndoList(size_t maxBytes) {
+	undo_.trim(maxBytes);
+}
+
+/*
+** Open an edit group on the buffer (see BufBeginEditGroup), modifications
+** made until endEditGroup is called are undone in a single step
 */
-void DocumentWidget::trimUndoList(size_t maxLength) {
+void DocumentWidget::beginEditGroup() {
+	buffer_->BufBeginEditGroup();
+}
 
-	if (undo_.empty()) {
-		return;
-	}
+/*
+** End an edit group opened by beginEditGroup. If it was opened by "macro",
+** its undo record is undone along with any made by that macro's earlier
+** groups, so the whole of what a macro did is undone in one step.
+*/
+void DocumentWidget::endEditGroup(const std::shared_ptr<MacroCommandData> &macro) {
 
-	auto it = undo_.begin();
-	size_t i = 1;
+	editGroupMacro_ = macro;
+	commitEditGroup();
+	editGroupMacro_ = nullptr;
+}
 
-	// Find last item on the list to leave intact
-	while(it != undo_.end() && i < maxLength) {
-		++it;
-		++i;
-	}
+/*
+** End an edit group on the buffer. Each of the ranges it changed is reported
+** on its own, the undo (or redo) records they make are joined, so that they
+** are undone together.
+*/
+void DocumentWidget::commitEditGroup() {
 
-	// Trim off all subsequent entries
-	undo_.erase(it, undo_.end());
+	reportingGroup_ = true;
+	groupRecorded_  = false;
+	buffer_->BufEndEditGroup();
+	reportingGroup_ = false;
 }
 
 void DocumentWidget::Undo() {
@@ -1639,6 +1755,18 @@ void DocumentWidget::Undo() {
 			return;
 		}
 
+		/* joined records (made by one edit group, or one macro) are undone
+		   together, as a single edit group, which leaves joined records to
+		   redo them all. Undoing stops at one which restores the saved
+		   state though, so that the user can get back to it */
+		buffer_->BufBeginEditGroup();
+
+		while (undo_.size() > 1 && undo_.front().joined && !undo_.front().restoresToSaved) {
+			const UndoInfo &undo = undo_.front();
+			buffer_->BufReplaceEx(undo.startPos, undo.endPos, undo_.frontText());
+			removeUndoItem();
+		}
+
 		UndoInfo &undo = undo_.front();
 
 		/* BufReplaceEx will eventually call SaveUndoInformation.  This is mostly
@@ -1649,9 +1777,11 @@ void DocumentWidget::Undo() {
 		undo.inUndo = true;
 
 		// use the saved undo information to reverse changes
-		buffer_->BufReplaceEx(undo.startPos, undo.endPos, undo.oldText);
+		const view::string_view oldText = undo_.frontText();
+		buffer_->BufReplaceEx(undo.startPos, undo.endPos, oldText);
+		commitEditGroup();
 
-		const auto restoredTextLength = static_cast<int64_t>(undo.oldText.size());
+		const auto restoredTextLength = static_cast<int64_t>(oldText.size());
 		if (!buffer_->primary.selected || Preferences::GetPrefUndoModifiesSelection()) {
 			/* position the cursor in the focus pane after the changed text
 			   to show the user where the undo was done */
@@ -1694,6 +1824,15 @@ void DocumentWidget::Redo() {
 			return;
 		}
 
+		// joined records are redone together, the same way Undo undoes them
+		buffer_->BufBeginEditGroup();
+
+		while (redo_.size() > 1 && redo_.front().joined && !redo_.front().restoresToSaved) {
+			const UndoInfo &redo = redo_.front();
+			buffer_->BufReplaceEx(redo.startPos, redo.endPos, redo_.frontText());
+			removeRedoItem();
+		}
+
 		UndoInfo &redo = redo_.front();
 
 		/* BufReplaceEx will eventually call SaveUndoInformation.  To indicate
@@ -1702,9 +1841,11 @@ void DocumentWidget::Redo() {
 		redo.inUndo = true;
 
 		// use the saved redo information to reverse changes
-		buffer_->BufReplaceEx(redo.startPos, redo.endPos, redo.oldText);
+		const view::string_view oldText = redo_.frontText();
+		buffer_->BufReplaceEx(redo.startPos, redo.endPos, oldText);
+		commitEditGroup();
 
-		const auto restoredTextLength = static_cast<int64_t>(redo.oldText.size());
+		const auto restoredTextLength = static_cast<int64_t>(oldText.size());
 		if (!buffer_->primary.selected || Preferences::GetPrefUndoModifiesSelection()) {
 			/* position the cursor in the focus pane after the changed text
 			   to show the user where the undo was done */
@@ -1772,13 +1913,14 @@ void DocumentWidget::MakeSelectionVisible(TextArea *area) {
 /*
 ** Remove the backup file associated with this window
 */
-void DocumentWidget::RemoveBackupFile() const {
+void DocumentWidget::RemoveBackupFile() {
 
 	// Don't delete backup files when backups aren't activated.
 	if (!autoSave_) {
 		return;
 	}
 
+	journal_ = nullptr;
 	QFile::remove(backupFileNameEx());
 }
 
@@ -1811,7 +1953,9 @@ void DocumentWidget::checkForChangesToFile() {
 	static QPointer<DocumentWidget> lastCheckWindow;
 	static std::chrono::high_resolution_clock::time_point lastCheckTime;
 
-	if (!filenameSet_) {
+	/* a save running in the background is about to change the file, that
+	   is checked for when it has finished */
+	if (!filenameSet_ || saver_) {
 		return;
 	}
 
@@ -1945,6 +2089,7 @@ void DocumentWidget::checkForChangesToFile() {
 			if (Preferences::GetPrefWarnRealFileMods() && !compareDocumentToFile(fullname)) {
 				// Contents hasn't changed. Update the modification time.
 				lastModTime_ = statbuf.st_mtime;
+				fileHash_    = 0;
 				return;
 			}
 
@@ -2097,6 +2242,9 @@ bool DocumentWidget::compareDocumentToFile(const QString &fileName) const {
 
 void DocumentWidget::RevertToSaved() {
 
+	// re-read whatever a save in progress is writing
+	waitForSave();
+
 	if(auto win = MainWindow::fromDocument(this)) {
 		TextCursor insertPositions[MAX_PANES];
 		int        topLines[MAX_PANES];
@@ -2164,34 +2312,26 @@ void DocumentWidget::RevertToSaved() {
 }
 
 /*
-** Create a backup file for the current document.  The name for the backup file
-** is generated using the name and path stored in the window and adding a
-** tilde (~) on UNIX.
+** Have the backup journal for the current document written out.  The name
+** for the backup file is generated using the name and path stored in the
+** window and adding a tilde (~) on UNIX.  The writing happens in the
+** background, an error is reported the next time around.
 */
 bool DocumentWidget::WriteBackupFile() {
-	FILE *fp;
 
-	// Generate a name for the autoSave file
-	QString name = backupFileNameEx();
+	if (!journal_) {
+		return false;
+	}
 
-	// remove the old backup file. Well, this might fail - we'll notice later however.
-	QFile::remove(name);
-
-	/* open the file, set more restrictive permissions (using default
-	   permissions was somewhat of a security hole, because permissions were
-	   independent of those of the original file being edited */
-#ifdef Q_OS_WIN
-	int fd = QT_OPEN(name.toUtf8().data(), QT_OPEN_CREAT | O_EXCL | QT_OPEN_WRONLY, _S_IREAD | _S_IWRITE);
-#else
-	int fd = QT_OPEN(name.toUtf8().data(), QT_OPEN_CREAT | O_EXCL | QT_OPEN_WRONLY, S_IRUSR | S_IWUSR);
-#endif
-	if (fd < 0 || (fp = fdopen(fd, "w")) == nullptr) {
+	if (const int error = journal_->error()) {
 
 		QMessageBox::warning(
 					this,
 					tr("Error writing Backup"),
-					tr("Unable to save backup for %1:\n%2\nAutomatic backup is now off").arg(filename_, ErrorString(errno)));
+					tr("Unable to save backup for %1:\n%2\nAutomatic backup is now off").arg(filename_, ErrorString(error)));
 
+		journal_ = nullptr;
+		QFile::remove(backupFileNameEx());
 		autoSave_ = false;
 
 		if(auto win = MainWindow::fromDocument(this)) {
@@ -2200,39 +2340,123 @@ bool DocumentWidget::WriteBackupFile() {
 		return false;
 	}
 
-	// get the text buffer contents
-	std::string fileString = buffer_->BufGetAllEx();
+	journal_->flush();
+	return true;
+}
 
-	// add a terminating newline if the file doesn't already have one
-	if(Preferences::GetPrefAppendLF()) {
-		if (!fileString.empty() && fileString.back() != '\n') {
-			fileString.append("\n");
+/*
+** Add a modification of the buffer to the backup journal, starting a new
+** journal if there isn't one yet.  Journals which have grown larger than the
+** document are replaced by a snapshot of it.
+*/
+void DocumentWidget::journalModification(TextCursor pos, int64_t nInserted, int64_t nDeleted) {
+
+	// journals smaller than this are never worth compacting
+	constexpr int64_t JournalCompactLimit = 1024 * 1024;
+
+	const int64_t length = buffer_->BufGetLength();
+
+	if (!journal_) {
+		journal_ = std::make_unique<BackupJournal>(backupFileNameEx());
+
+		/* if the buffer held the text of the file before this change, the
+		   journal can start from the file instead of a copy of the text. Not
+		   while it is being saved though, the file still has the old text */
+		QT_STATBUF statbuf;
+		if (!fileChanged_ && filenameSet_ && !fileMissing_ && !saver_ && QT_STAT(fullPath().toUtf8().data(), &statbuf) == 0 && statbuf.st_mtime == lastModTime_) {
+			journal_->restart(statbuf.st_size, statbuf.st_mtime, fileHash_);
+		} else if (length - nInserted + nDeleted == 0) {
+			journal_->restart(std::string());
+		} else {
+			journal_->restart(buffer_->BufGetAllEx());
+			return;
 		}
 	}
 
-	auto _ = gsl::finally([fp] { ::fclose(fp); });
+	if (journal_->size() > std::max(JournalCompactLimit, length)) {
+		journal_->restart(buffer_->BufGetAllEx());
+		WriteBackupFile();
+		return;
+	}
 
-	// write out the file
-	::fwrite(fileString.data(), 1, fileString.size(), fp);
-	if (::ferror(fp)) {
-		QMessageBox::critical(
-					this,
-					tr("Error saving Backup"),
-					tr("Error while saving backup for %1:\n%2\nAutomatic backup is now off").arg(filename_, ErrorString(errno)));
+	journal_->append(to_integer(pos), nDeleted, buffer_->BufGetRangeEx(pos, pos + nInserted));
+}
+
+/*
+** Offer to recover the changes in a backup journal left behind by an earlier
+** session, after the file it was made for has been read.
+*/
+void DocumentWidget::recoverBackupFile(int64_t fileSize, time_t fileTime) {
+
+	const QString name   = backupFileNameEx();
+	const int64_t length = buffer_->BufGetLength();
 
+	journal_ = nullptr;
+
+	switch (BackupJournal::Replay(name, fileSize, fileTime, fileHash_, length, nullptr, nullptr)) {
+	case BackupJournal::Status::Missing:
+		return;
+	case BackupJournal::Status::Rejected:
+	{
+		/* it may still be the only copy of someone's work, so rather than
+		   let the next journal overwrite it, put it where it will be left
+		   alone */
+		const QString aside = name + QLatin1String(".rejected");
+		QFile::remove(aside);
+
+		if (QFile::rename(name, aside)) {
+			QMessageBox::warning(
+						this,
+						tr("Recover Backup"),
+						tr("The backup file %1 can't be used to recover %2, it is damaged or was made for a different version of the file.\nIt has been renamed to %3.").arg(name, filename_, aside));
+		} else {
+			QMessageBox::warning(
+						this,
+						tr("Recover Backup"),
+						tr("The backup file %1 can't be used to recover %2, it is damaged or was made for a different version of the file.\nIt could not be renamed, and will be replaced by the next backup.").arg(name, filename_));
+		}
+		return;
+	}
+	case BackupJournal::Status::Valid:
+		break;
+	}
+
+	const int resp = QMessageBox::question(
+				this,
+				tr("Recover Backup"),
+				tr("The backup file %1 holds changes to %2 which were never saved.\nRecover them? Otherwise the backup file is discarded.").arg(name, filename_),
+				QMessageBox::Yes | QMessageBox::No);
+
+	if (resp != QMessageBox::Yes) {
 		QFile::remove(name);
-		autoSave_ = false;
-		return false;
+		return;
 	}
 
-	return true;
+	ignoreModify_ = true;
+	BackupJournal::Replay(name, fileSize, fileTime, fileHash_, length, [this](view::string_view text) {
+		buffer_->BufSetAll(text);
+	}, [this](int64_t pos, int64_t nDeleted, view::string_view text) {
+		buffer_->BufReplaceEx(TextCursor(pos), TextCursor(pos + nDeleted), text);
+	});
+	ignoreModify_ = false;
+
+	SetWindowModified(true);
+
+	// keep adding to the same journal, it still describes the document
+	if (autoSave_) {
+		journal_ = std::make_unique<BackupJournal>(name);
+		journal_->resume();
+	}
 }
 
 /**
  * @brief DocumentWidget::saveDocument
  * @return
  */
-bool DocumentWidget::saveDocument() {
+bool DocumentWidget::saveDocument(bool background) {
+
+	// Let any save in progress finish first, it may have failed
+	waitForSave();
 
 	// Try to ensure our information is up-to-date
 	checkForChangesToFile();
@@ -2280,15 +2504,19 @@ bool DocumentWidget::saveDocument() {
 		return false;
 	}
 
-	const bool status = doSave();
-	if (status) {
-		RemoveBackupFile();
-	}
-
-	return status;
+	return doSave(background);
 }
 
-bool DocumentWidget::doSave() {
+/**
+ * @brief DocumentWidget::doSave
+ * @param background
+ * @return
+ *
+ * Write the document to its file. The text is written by a DocumentSaver
+ * from a snapshot, if "background" is true this returns as soon as it has
+ * started, and the outcome is dealt with when it finishes.
+ */
+bool DocumentWidget::doSave(bool background) {
 
 	QString fullname = fullPath();
 
@@ -2320,68 +2548,131 @@ bool DocumentWidget::doSave() {
 		buffer_->BufAppendEx('\n');
 	}
 
-	// open the file
-	QFile file(fullname);
-	if(!file.open(QIODevice::WriteOnly)) {
-		QMessageBox messageBox(this);
-		messageBox.setWindowTitle(tr("Error saving File"));
-		messageBox.setIcon(QMessageBox::Warning);
-		messageBox.setText(tr("Unable to save %1:\n%2\n\nSave as a new file?").arg(filename_, file.errorString()));
+	/* the document counts as saved from here on, edits made while the
+	   snapshot is being written mark it as modified again, and undoing them
+	   brings it back to the saved state */
+	saver_ = new DocumentSaver(fullname, buffer_->BufSnapshot(), fileFormat_, this);
+	SetWindowModified(false);
 
-		QPushButton *buttonSaveAs = messageBox.addButton(tr("Save As..."), QMessageBox::AcceptRole);
-		QPushButton *buttonCancel = messageBox.addButton(QMessageBox::Cancel);
-		Q_UNUSED(buttonCancel);
+	connect(saver_, &QThread::finished, this, [this]() {
+		saveFinished();
+	});
 
-		messageBox.exec();
-		if(messageBox.clickedButton() == buttonSaveAs) {
-			// empty string signals a prompt for filename
-			return saveDocumentAs(QString(), /*addWrap=*/false);
-		}
+	saver_->start();
 
-		return false;
+	if (background) {
+		return true;
 	}
 
-	// get the text buffer contents and its length
-	std::string text = buffer_->BufGetAllEx();
+	return waitForSave();
+}
 
-	// If the file is to be saved in DOS or Macintosh format, reconvert
-	switch(fileFormat_) {
-	case FileFormats::Dos:
-		ConvertToDos(text);
-		break;
-	case FileFormats::Mac:
-		ConvertToMac(text);
-		break;
-	default:
-		break;
+/**
+ * @brief DocumentWidget::waitForSave
+ * @return false if the save which was in progress failed
+ */
+bool DocumentWidget::waitForSave() {
+
+	if (!saver_) {
+		return true;
 	}
 
-	// write to the file
-	if(file.write(text.data(), static_cast<int64_t>(text.size())) == -1) {
-		QMessageBox::critical(this, tr("Error saving File"), tr("%1 not saved:\n%2").arg(filename_, file.errorString()));
-		file.close();
-		file.remove();
-		return false;
+	saver_->wait();
+	return saveFinished();
+}
+
+/**
+ * @brief DocumentWidget::saveFinished
+ * @return false if the save failed
+ *
+ * Deal with the outcome of a save, once its DocumentSaver has finished
+ */
+bool DocumentWidget::saveFinished() {
+
+	// may have been dealt with by waitForSave already
+	if (!saver_ || !saver_->isFinished()) {
+		return true;
 	}
 
-	// success, file was written
-	SetWindowModified(false);
+	DocumentSaver *const saver = saver_;
+	saver_ = nullptr;
+	saver->deleteLater();
+
+	const QString fullname = fullPath();
+
+	if (const int error = saver->error()) {
+
+		/* the snapshot never made it to disk, so there is no longer a point
+		   in the history where the document matches its file */
+		SetWindowModified(true);
+
+		for(UndoInfo &u : undo_) {
+			u.restoresToSaved = false;
+		}
+
+		for(UndoInfo &u : redo_) {
+			u.restoresToSaved = false;
+		}
+
+		/* the file may have been left partly written, so the backup can't
+		   rely on it any more */
+		if (autoSave_) {
+			journal_ = std::make_unique<BackupJournal>(backupFileNameEx());
+			journal_->restart(buffer_->BufGetAllEx());
+			WriteBackupFile();
+		}
+
+		if (!saver->opened()) {
+			QMessageBox messageBox(this);
+			messageBox.setWindowTitle(tr("Error saving File"));
+			messageBox.setIcon(QMessageBox::Warning);
+			messageBox.setText(tr("Unable to save %1:\n%2\n\nSave as a new file?").arg(filename_, ErrorString(error)));
+
+			QPushButton *buttonSaveAs = messageBox.addButton(tr("Save As..."), QMessageBox::AcceptRole);
+			QPushButton *buttonCancel = messageBox.addButton(QMessageBox::Cancel);
+			Q_UNUSED(buttonCancel);
+
+			messageBox.exec();
+			if(messageBox.clickedButton() == buttonSaveAs) {
+				// empty string signals a prompt for filename
+				return saveDocumentAs(QString(), /*addWrap=*/false);
+			}
+		} else {
+			QMessageBox::critical(this, tr("Error saving File"), tr("%1 not saved:\n%2").arg(filename_, ErrorString(error)));
+		}
+
+		return false;
+	}
 
 	// update the modification time
 	QT_STATBUF statbuf;
 	if (QT_STAT(fullname.toUtf8().data(), &statbuf) == 0) {
 		lastModTime_ = statbuf.st_mtime;
+		fileHash_    = saver->hash();
 		fileMissing_ = false;
 		dev_         = statbuf.st_dev;
 		ino_         = statbuf.st_ino;
 	} else {
 		// This needs to produce an error message -- the file can't be accessed!
 		lastModTime_ = 0;
+		fileHash_    = 0;
 		fileMissing_ = true;
 		dev_         = 0;
 		ino_         = 0;
 	}
 
+	/* the backup is only finished with once the file is safely written. If
+	   the document was edited while it was being saved, the backup has to
+	   go on recording those edits, but no longer from the old file */
+	if (fileChanged_) {
+		if (journal_) {
+			journal_->restart(buffer_->BufGetAllEx());
+			WriteBackupFile();
+		}
+	} else {
+		RemoveBackupFile();
+	}
+
 	return true;
 }
 
@@ -2393,6 +2684,9 @@ bool DocumentWidget::doSave() {
  */
 bool DocumentWidget::saveDocumentAs(const QString &newName, bool addWrap) {
 
+	// Let any save in progress finish first, it writes to the current name
+	waitForSave();
+
 	if(auto win = MainWindow::fromDocument(this)) {
 
 		QString fullname;
@@ -2686,6 +2980,9 @@ bool DocumentWidget::fileWasModifiedExternally() const {
 
 bool DocumentWidget::CloseFileAndWindow(CloseMode preResponse) {
 
+	// if a save is still being written, whether it worked decides what to do
+	waitForSave();
+
 	/* If the window is a normal & unmodified file or an empty new file,
 	   or if the user wants to ignore external modifications then
 	   just close it.  Otherwise ask for confirmation first. */
@@ -2780,6 +3077,7 @@ void DocumentWidget::closeDocument() {
 		uid_          = 0;
 		gid_          = 0;
 		lastModTime_  = 0;
+		fileHash_     = 0;
 		dev_          = 0;
 		ino_          = 0;
 		nMarks_       = 0;
@@ -3039,6 +3337,8 @@ bool DocumentWidget::doOpen(const QString &name, const QString &path, int flags)
 		file.open(fp, QIODevice::ReadOnly);
 
 		std::string text;
+		std::shared_ptr<const char> sharedText; // large files are handed to the buffer to keep as they are
+		uint64_t hash = BackupJournal::Hash(view::string_view());
 
 		if(file.size() != 0) {
 			uchar *memory = file.map(0, file.size());
@@ -3049,8 +3349,22 @@ bool DocumentWidget::doOpen(const QString &name, const QString &path, int flags)
 				return false;
 			}
 
-			text = std::string{reinterpret_cast<char *>(memory), static_cast<size_t>(file.size())};
+			/* the text is copied out of the mapping right away, as it would
+			   show whatever other programs do to the file afterwards */
+			const int mapThreshold = Preferences::GetPrefMapFileThreshold();
+			if(mapThreshold > 0 && file.size() >= mapThreshold) {
+				std::shared_ptr<char> block(new char[static_cast<size_t>(file.size())], std::default_delete<char[]>());
+				std::memcpy(block.get(), memory, static_cast<size_t>(file.size()));
+				sharedText = std::move(block);
+			} else {
+				text = std::string{reinterpret_cast<char *>(memory), static_cast<size_t>(file.size())};
+			}
+
 			file.unmap(memory);
+
+			/* a backup journal identifies the file by the bytes that were
+			   actually read, so hash the copy rather than the file */
+			hash = BackupJournal::Hash(sharedText ? view::string_view(sharedText.get(), static_cast<size_t>(file.size())) : view::string_view(text));
 		}
 
 		/* Any errors that happen after this point leave the window in a
@@ -3060,13 +3374,25 @@ bool DocumentWidget::doOpen(const QString &name, const QString &path, int flags)
 		uid_         = statbuf.st_uid;
 		gid_         = statbuf.st_gid;
 		lastModTime_ = statbuf.st_mtime;
+		fileHash_    = hash;
 		dev_         = statbuf.st_dev;
 		ino_         = statbuf.st_ino;
 		fileMissing_ = false;
 
 		// Detect and convert DOS and Macintosh format files
 		if (Preferences::GetPrefForceOSConversion()) {
-			fileFormat_ = FormatOfFile(text);
+			if(sharedText) {
+				fileFormat_ = FormatOfFile(view::string_view(sharedText.get(), static_cast<size_t>(file.size())));
+
+				// conversion needs a string after all
+				if(fileFormat_ != FileFormats::Unix) {
+					text = std::string{sharedText.get(), static_cast<size_t>(file.size())};
+					sharedText = nullptr;
+				}
+			} else {
+				fileFormat_ = FormatOfFile(text);
+			}
+
 			switch (fileFormat_) {
 			case FileFormats::Dos:
 				ConvertFromDos(text);
@@ -3081,7 +3407,11 @@ bool DocumentWidget::doOpen(const QString &name, const QString &path, int flags)
 
 		// Display the file contents in the text widget
 		ignoreModify_ = true;
-		buffer_->BufSetAll(text);
+		if(sharedText) {
+			buffer_->BufSetAll(std::move(sharedText), file.size());
+		} else {
+			buffer_->BufSetAll(text);
+		}
 		ignoreModify_ = false;
 
 		// Set window title and file changed flag
@@ -3099,6 +3429,8 @@ bool DocumentWidget::doOpen(const QString &name, const QString &path, int flags)
 			}
 		}
 
+		recoverBackupFile(file.size(), statbuf.st_mtime);
+
 		window->UpdateWindowReadOnly(this);
 		return true;
 	} catch(const std::bad_alloc &) {
@@ -3791,7 +4123,7 @@ void DocumentWidget::executeShellCommand(TextArea *area, const QString &command,
 					win,
 					area,
 					substitutedCommand,
-					QString(),
+					std::string(),
 					flags,
 					left,
 					right,
@@ -4341,28 +4673,31 @@ void DocumentWidget::unloadLanguageModeTipsFile() {
 ** directed either to text widget "textW" where it replaces the text between
 ** the positions "replaceLeft" and "replaceRight", to a separate pop-up dialog
 ** (OUTPUT_TO_DIALOG), or to a macro-language string (OUTPUT_TO_STRING).  If
-** "input" is nullptr, no input is fed to the process.  If an input string is
-** provided, it is freed when the command completes.  Flags:
+** "input" is empty, no input is fed to the process, otherwise it is handed to
+** the process a chunk at a time, as fast as the process takes it.  Flags:
 **
 **   ACCUMULATE         Causes output from the command to be saved up until
-**                      the command completes.
+**                      the command completes, rather than inserted in textW
+**                      (or the pop-up dialog) as it arrives.
 **   ERROR_DIALOGS      Presents stderr output separately in popup a dialog,
 **                      and also reports failed exit status as a popup dialog
-**                      including the command output.
+**                      including the command output.  If the user cancels,
+**                      output which was already inserted is undone.
 **   REPLACE_SELECTION  Causes output to replace the selection in textW.
 **   RELOAD_FILE_AFTER  Causes the file to be completely reloaded after the
 **                      command completes.
 **   OUTPUT_TO_DIALOG   Send output to a pop-up dialog instead of textW
 **   OUTPUT_TO_STRING   Output to a macro-language string instead of a text
 **                      widget or dialog.
+**   SELECT_OUTPUT      Selects the output in textW once the command completes.
 **
-** REPLACE_SELECTION, ERROR_DIALOGS, and OUTPUT_TO_STRING can only be used
-** along with ACCUMULATE (these operations can't be done incrementally).
+** REPLACE_SELECTION and OUTPUT_TO_STRING can only be used along with
+** ACCUMULATE (these operations can't be done incrementally).
 */
-void DocumentWidget::issueCommand(MainWindow *window, TextArea *area, const QString &command, const QString &input, int flags, TextCursor replaceLeft, TextCursor replaceRight, CommandSource source) {
+void DocumentWidget::issueCommand(MainWindow *window, TextArea *area, const QString &command, std::string input, int flags, TextCursor replaceLeft, TextCursor replaceRight, CommandSource source) {
 
 	// verify consistency of input parameters
-	if ((flags & ERROR_DIALOGS || flags & REPLACE_SELECTION || flags & OUTPUT_TO_STRING) && !(flags & ACCUMULATE)) {
+	if ((flags & REPLACE_SELECTION || flags & OUTPUT_TO_STRING) && !(flags & ACCUMULATE)) {
 		return;
 	}
 
@@ -4391,50 +4726,52 @@ void DocumentWidget::issueCommand(MainWindow *window, TextArea *area, const QStr
 
 	// support for merged output if we are not using ERROR_DIALOGS
 	if (flags & ERROR_DIALOGS) {
-		connect(process, &QProcess::readyReadStandardError, this, [this]() {
-			QByteArray data = shellCmdData_->process->readAllStandardError();
-			shellCmdData_->standardError.append(data);
+		connect(process, &QProcess::readyReadStandardError, document, [document]() {
+			QByteArray data = document->shellCmdData_->process->readAllStandardError();
+			document->shellCmdData_->standardError.append(data);
 		});
 
-		connect(process, &QProcess::readyReadStandardOutput, this, [this]() {
-			QByteArray data = shellCmdData_->process->readAllStandardOutput();
-			shellCmdData_->standardOutput.append(data);
-		});
+		connect(process, &QProcess::readyReadStandardOutput, document, &DocumentWidget::readShellOutput);
 	} else {
 		process->setProcessChannelMode(QProcess::MergedChannels);
+		connect(process, &QProcess::readyRead, document, &DocumentWidget::readShellOutput);
+	}
 
-		connect(process, &QProcess::readyRead, this, [this]() {
-			QByteArray data = shellCmdData_->process->readAll();
-			shellCmdData_->standardOutput.append(data);
-		});
+	connect(process, &QProcess::bytesWritten, document, &DocumentWidget::writeShellInput);
+
+	/* Create a data structure for passing process information around
+	   amongst the callback routines which will process i/o and completion */
+	auto cmdData = std::make_unique<ShellCommandData>();
+	cmdData->input          = std::move(input);
+	cmdData->inputOffset    = 0;
+	cmdData->decoder        = std::unique_ptr<QTextDecoder>(QTextCodec::codecForLocale()->makeDecoder());
+	cmdData->process        = process;
+	cmdData->flags          = flags;
+	cmdData->area           = area;
+	cmdData->target         = fromArea(area);
+	cmdData->bannerIsUp     = false;
+	cmdData->source         = source;
+	cmdData->leftPos        = replaceLeft;
+	cmdData->rightPos       = replaceRight;
+	cmdData->outputInserted = false;
+	cmdData->undoRecord     = 0;
+
+	// output inserted as it arrives has to stay in step with the user's edits
+	if (insertsOutputIncrementally(flags) && cmdData->target) {
+		cmdData->target->buffer_->BufAddModifyCB(shellOutputModifiedCB, cmdData.get());
 	}
 
+	document->shellCmdData_ = std::move(cmdData);
+
 	// start it off!
 	QStringList args;
 	args << QLatin1String("-c");
 	args << command;
 	process->start(Preferences::GetPrefShell(), args);
 
-	// if there's nothing to write to the process' stdin, close it now, otherwise
-	// write it to the process
-	if(!input.isEmpty()) {
-		process->write(input.toLocal8Bit());
-	}
-
-	process->closeWriteChannel();
-
-	/* Create a data structure for passing process information around
-	   amongst the callback routines which will process i/o and completion */
-	auto cmdData = std::make_unique<ShellCommandData>();
-	cmdData->process     = process;
-	cmdData->flags       = flags;
-	cmdData->area        = area;
-	cmdData->bannerIsUp  = false;
-	cmdData->source      = source;
-	cmdData->leftPos     = replaceLeft;
-	cmdData->rightPos    = replaceRight;
-
-	document->shellCmdData_ = std::move(cmdData);
+	/* write the first chunk of input, the rest follows as the process takes
+	   it. If there is no input, this closes the process' stdin right away */
+	document->writeShellInput();
 
 	// Set up timer proc for putting up banner when process takes too long
 	if (source == CommandSource::User) {
@@ -4450,6 +4787,114 @@ void DocumentWidget::issueCommand(MainWindow *window, TextArea *area, const QStr
 	}
 }
 
+/*
+** Hand the next chunk of the shell command's input to the process, once it
+** has taken all of the previous one, so that the process' write buffer never
+** holds more than a chunk of it. Closes the process' stdin after the last one.
+*/
+void DocumentWidget::writeShellInput() {
+
+	const std::unique_ptr<ShellCommandData> &cmdData = shellCmdData_;
+	if (!cmdData || cmdData->process->bytesToWrite() != 0) {
+		return;
+	}
+
+	const std::string &input = cmdData->input;
+	const size_t first = cmdData->inputOffset;
+	size_t last        = first + std::min(ShellInputChunkSize, input.size() - first);
+
+	// each chunk is converted on its own, so don't split a character between them
+	while (last != input.size() && last != first && (static_cast<uchar>(input[last]) & 0xc0) == 0x80) {
+		--last;
+	}
+
+	if (last == first) {
+		last = first + std::min(ShellInputChunkSize, input.size() - first);
+	}
+
+	if (last != first) {
+		cmdData->process->write(QString::fromUtf8(&input[first], static_cast<int>(last - first)).toLocal8Bit());
+		cmdData->inputOffset = last;
+	}
+
+	if (cmdData->inputOffset == input.size()) {
+		disconnect(cmdData->process, &QProcess::bytesWritten, this, &DocumentWidget::writeShellInput);
+		std::string().swap(cmdData->input);
+		cmdData->process->closeWriteChannel();
+	}
+}
+
+/*
+** Read the output the shell command has produced so far, and either save it
+** up (ACCUMULATE) or pass it on to where it is going
+*/
+void DocumentWidget::readShellOutput() {
+
+	const std::unique_ptr<ShellCommandData> &cmdData = shellCmdData_;
+	if (!cmdData) {
+		return;
+	}
+
+	const QByteArray data = (cmdData->flags & ERROR_DIALOGS) ? cmdData->process->readAllStandardOutput() : cmdData->process->readAll();
+	if (data.isEmpty()) {
+		return;
+	}
+
+	const std::string text = cmdData->decoder->toUnicode(data).toStdString();
+
+	if (cmdData->flags & ACCUMULATE) {
+		cmdData->standardOutput.append(text);
+	} else {
+		insertShellOutput(text);
+	}
+}
+
+/*
+** Put a piece of the shell command's output where it is going as soon as it
+** arrives: in the pop-up dialog, or in the text widget, where the first piece
+** replaces the text between leftPos and rightPos and each of the others goes
+** after the one before. The pieces are put in the same undo record as long as
+** nothing else has been recorded since, so the output is undone at once.
+*/
+void DocumentWidget::insertShellOutput(view::string_view text) {
+
+	const std::unique_ptr<ShellCommandData> &cmdData = shellCmdData_;
+	if (text.empty()) {
+		return;
+	}
+
+	if (cmdData->flags & OUTPUT_TO_DIALOG) {
+		if (!cmdData->dialog) {
+			cmdData->dialog = new DialogOutput(this);
+			cmdData->dialog->show();
+		}
+
+		cmdData->dialog->appendText(QString::fromUtf8(text.data(), static_cast<int>(text.size())));
+		return;
+	}
+
+	DocumentWidget *target = cmdData->target;
+	if (!target) {
+		return;
+	}
+
+	TextBuffer *buf = target->buffer_;
+
+	/* shellOutputModifiedCB moves leftPos and rightPos along with the change,
+	   so from here on they span the output */
+	target->outputRecord_ = &cmdData->undoRecord;
+
+	if (!cmdData->outputInserted) {
+		safeBufReplace(buf, &cmdData->leftPos, &cmdData->rightPos, text);
+		cmdData->leftPos        = cmdData->rightPos - static_cast<int64_t>(text.size());
+		cmdData->outputInserted = true;
+	} else {
+		safeBufReplace(buf, &cmdData->rightPos, &cmdData->rightPos, text);
+	}
+
+	target->outputRecord_ = nullptr;
+}
+
 /*
 ** Clean up after the execution of a shell command sub-process and present
 ** the output/errors to the user as requested in the initial issueCommand
@@ -4481,6 +4926,10 @@ void DocumentWidget::processFinished(int exitCode, QProcess::ExitStatus exitStat
 
 	// when this function ends, do some cleanup
 	auto _ = gsl::finally([this, &cmdData, fromMacro] {
+		if (insertsOutputIncrementally(cmdData->flags) && cmdData->target) {
+			cmdData->target->buffer_->BufRemoveModifyCB(shellOutputModifiedCB, cmdData.get());
+		}
+
 		delete cmdData->process;
 		shellCmdData_ = nullptr;
 
@@ -4490,7 +4939,6 @@ void DocumentWidget::processFinished(int exitCode, QProcess::ExitStatus exitStat
 	});
 
 	QString errText;
-	QString outText;
 
 	// If the process was killed or became inaccessable, give up
 	if (exitStatus != QProcess::NormalExit) {
@@ -4500,23 +4948,16 @@ void DocumentWidget::processFinished(int exitCode, QProcess::ExitStatus exitStat
 	// if we have terminated the process, let's be 100% sure we've gotten all input
 	cmdData->process->waitForReadyRead();
 
-	/* Assemble the output from the process' stderr and stdout streams into
-	   strings */
+	// collect the rest of the output from the process' stderr and stdout streams
 	if (cmdData->flags & ERROR_DIALOGS) {
-		// make sure we got the rest and convert it to a string
 		QByteArray dataErr = cmdData->process->readAllStandardError();
 		cmdData->standardError.append(dataErr);
 		errText = QString::fromLocal8Bit(cmdData->standardError);
+	}
 
-		QByteArray dataOut = cmdData->process->readAllStandardOutput();
-		cmdData->standardOutput.append(dataOut);
-		outText = QString::fromLocal8Bit(cmdData->standardOutput);
-	} else {
+	readShellOutput();
 
-		QByteArray data = cmdData->process->readAll();
-		cmdData->standardOutput.append(data);
-		outText = QString::fromLocal8Bit(cmdData->standardOutput);
-	}
+	const std::string &output = cmdData->standardOutput;
 
 	static const QRegularExpression trailingNewlines(QLatin1String("\\n+$"));
 
@@ -4546,11 +4987,17 @@ void DocumentWidget::processFinished(int exitCode, QProcess::ExitStatus exitStat
 			cancel = (msgBox.exec() == QMessageBox::Cancel);
 
 		} else if (failure) {
+			// output which was inserted as it arrived is already on display
+			QString outText = QString::fromStdString(output.substr(0, DF_MAX_MSG_LENGTH * 4));
 			outText.truncate(DF_MAX_MSG_LENGTH);
 
 			QMessageBox msgBox;
 			msgBox.setWindowTitle(tr("Command Failure"));
-			msgBox.setText(tr("Command reported failed exit status.\nOutput from command:\n%1").arg(outText));
+			if (cmdData->flags & ACCUMULATE) {
+				msgBox.setText(tr("Command reported failed exit status.\nOutput from command:\n%1").arg(outText));
+			} else {
+				msgBox.setText(tr("Command reported failed exit status."));
+			}
 			msgBox.setIcon(QMessageBox::Warning);
 			msgBox.setStandardButtons(QMessageBox::Cancel);
 			auto accept = new QPushButton(tr("Proceed"));
@@ -4575,6 +5022,13 @@ void DocumentWidget::processFinished(int exitCode, QProcess::ExitStatus exitStat
 		}
 
 		if (cancel) {
+			/* take back any output which was inserted as it arrived, as long
+			   as it is still the most recent edit */
+			if (DocumentWidget *target = cmdData->target) {
+				if (cmdData->undoRecord != 0 && !target->undo_.empty() && target->undo_.front().serial == cmdData->undoRecord) {
+					target->Undo();
+				}
+			}
 			return;
 		}
 	}
@@ -4584,34 +5038,47 @@ void DocumentWidget::processFinished(int exitCode, QProcess::ExitStatus exitStat
 		   (remaining) output in the text widget as requested, and move the
 		   insert point to the end */
 		if (cmdData->flags & OUTPUT_TO_DIALOG) {
-			outText.remove(trailingNewlines);
-
-			if (!outText.isEmpty()) {
-				auto dialog = new DialogOutput(this);
-				dialog->setText(outText);
-				dialog->show();
+			if (cmdData->flags & ACCUMULATE) {
+				QString outText = QString::fromStdString(output);
+				outText.remove(trailingNewlines);
+
+				if (!outText.isEmpty()) {
+					auto dialog = new DialogOutput(this);
+					dialog->setText(outText);
+					dialog->show();
+				}
 			}
 		} else if (cmdData->flags & OUTPUT_TO_STRING) {
-			returnShellCommandOutput(this, outText, exitCode);
-		} else {
+			returnShellCommandOutput(this, QString::fromStdString(output), exitCode);
+		} else if (TextArea *area = cmdData->area) {
 
-			std::string output_string = outText.toStdString();
-
-			auto area = cmdData->area;
 			TextBuffer *buf = area->TextGetBuffer();
 
-			if (cmdData->flags & REPLACE_SELECTION) {
+			if (!(cmdData->flags & ACCUMULATE)) {
+				// with no output at all, what it was to replace still has to go
+				if (!cmdData->outputInserted && cmdData->leftPos != cmdData->rightPos) {
+					safeBufReplace(buf, &cmdData->leftPos, &cmdData->rightPos, view::string_view());
+					area->TextSetCursorPos(cmdData->leftPos);
+				} else if (cmdData->outputInserted) {
+					// the output was inserted as it arrived, leave the cursor after it
+					area->TextSetCursorPos(cmdData->rightPos);
+				}
+
+				if ((cmdData->flags & SELECT_OUTPUT) && cmdData->leftPos != cmdData->rightPos) {
+					buf->BufSelect(cmdData->leftPos, cmdData->rightPos);
+				}
+			} else if (cmdData->flags & REPLACE_SELECTION) {
 				TextCursor reselectStart = buf->primary.rectangular ? TextCursor(-1) : buf->primary.start;
-				buf->BufReplaceSelectedEx(output_string);
+				buf->BufReplaceSelectedEx(output);
 
 				area->TextSetCursorPos(buf->BufCursorPosHint());
 
 				if (reselectStart != -1) {
-					buf->BufSelect(reselectStart, reselectStart + static_cast<int64_t>(output_string.size()));
+					buf->BufSelect(reselectStart, reselectStart + static_cast<int64_t>(output.size()));
 				}
 			} else {
-				safeBufReplace(buf, &cmdData->leftPos, &cmdData->rightPos, output_string);
-				area->TextSetCursorPos(cmdData->leftPos + outText.size());
+				safeBufReplace(buf, &cmdData->leftPos, &cmdData->rightPos, output);
+				area->TextSetCursorPos(cmdData->leftPos + static_cast<int64_t>(output.size()));
 			}
 		}
 
@@ -4697,7 +5164,7 @@ void DocumentWidget::execCursorLine(TextArea *area, CommandSource source) {
 				window,
 				area,
 				substitutedCommand,
-				QString(),
+				std::string(),
 				0,
 				insertPos + 1,
 				insertPos + 1,
@@ -4729,7 +5196,7 @@ void DocumentWidget::filterSelection(const QString &command, CommandSource sourc
 
 	/* Get the selection and the range in character positions that it
 	   occupies.  Beep and return if no selection */
-	const std::string text = buffer_->BufGetSelectionTextEx();
+	std::string text = buffer_->BufGetSelectionTextEx();
 	if (text.empty()) {
 		QApplication::beep();
 		return;
@@ -4738,12 +5205,17 @@ void DocumentWidget::filterSelection(const QString &command, CommandSource sourc
 	const TextCursor left  = buffer_->primary.start;
 	const TextCursor right = buffer_->primary.end;
 
+	/* the output of a filter can take as long to arrive as it takes to feed
+	   it a large selection, so it replaces the selection as it arrives.  A
+	   rectangular selection can only be replaced as a whole, though */
+	const int flags = buffer_->primary.rectangular ? ACCUMULATE | ERROR_DIALOGS | REPLACE_SELECTION : ERROR_DIALOGS | SELECT_OUTPUT;
+
 	issueCommand(
 				window,
 				window->lastFocus_,
 				command,
-				QString::fromStdString(text),
-				ACCUMULATE | ERROR_DIALOGS | REPLACE_SELECTION,
+				std::move(text),
+				flags,
 				left,
 				right,
 				source);
@@ -4891,7 +5363,7 @@ void DocumentWidget::doShellMenuCmd(MainWindow *inWindow, TextArea *area, const
 				inWindow,
 				outWidget,
 				substitutedCommand,
-				QString::fromStdString(text),
+				std::move(text),
 				flags,
 				left,
 				right,
@@ -4918,7 +5390,7 @@ void DocumentWidget::shellCmdToMacroString(const QString &command, const QString
 				MainWindow::fromDocument(this),
 				nullptr,
 				command,
-				input,
+				input.toStdString(),
 				ACCUMULATE | OUTPUT_TO_STRING,
 				TextCursor(),
 				TextCursor(),
@@ -5359,6 +5831,7 @@ void DocumentWidget::FreeHighlightingData() {
 		return;
 	}
 
+	stopBackgroundParse();
 	highlightData_ = nullptr;
 
 	/* The text display may make a last desperate attempt to access highlight
@@ -5398,8 +5871,14 @@ void DocumentWidget::UpdateHighlightStylesEx() {
 	/* Update highlight pattern data in the window data structure, but
 	   preserve all of the effort that went in to parsing the buffer
 	   by swapping it with the empty one in highlightData */
-	newHighlightData->styleBuffer = oldHighlightData->styleBuffer;
-
+	newHighlightData->styleBuffer      = oldHighlightData->styleBuffer;
+	newHighlightData->parsedTo         = oldHighlightData->parsedTo;
+	newHighlightData->provisionalStart = oldHighlightData->provisionalStart;
+	newHighlightData->provisionalEnd   = oldHighlightData->provisionalEnd;
+	newHighlightData->checkpoints      = oldHighlightData->checkpoints;
+
+	// the background parser has a copy of the old patterns
+	stopBackgroundParse();
 	highlightData_ = std::move(newHighlightData);
 
 	/* Attach new highlight information to text widgets in each pane
@@ -5407,6 +5886,9 @@ void DocumentWidget::UpdateHighlightStylesEx() {
 	for(TextArea *area : textPanes()) {
 		AttachHighlightToWidgetEx(area);
 	}
+
+	// a piece which was being parsed in the background has to be done again
+	ContinueHighlightingEx();
 }
 
 /*
@@ -5457,12 +5939,12 @@ Style DocumentWidget::GetHighlightInfoEx(TextCursor pos) {
 	}
 
 	// Be careful with signed/unsigned conversions. NO conversion here!
-	int style = highlightData->styleBuffer->BufGetCharacter(pos);
+	int style = highlightData->styleBuffer->at(pos);
 
 	// Beware of unparsed regions.
 	if (style == UNFINISHED_STYLE) {
 		handleUnparsedRegion(highlightData->styleBuffer, pos);
-		style = highlightData->styleBuffer->BufGetCharacter(pos);
+		style = highlightData->styleBuffer->at(pos);
 	}
 
 	if (highlightData->pass1Patterns) {
@@ -5490,9 +5972,9 @@ int64_t DocumentWidget::StyleLengthOfCodeFromPosEx(TextCursor pos) {
 	const TextCursor oldPos = pos;
 
 	if(const std::unique_ptr<WindowHighlightData> &highlightData = highlightData_) {
-		if (const std::shared_ptr<TextBuffer> &styleBuf = highlightData->styleBuffer) {
+		if (const std::shared_ptr<StyleBuffer> &styleBuf = highlightData->styleBuffer) {
 
-			auto hCode = static_cast<uint8_t>(styleBuf->BufGetCharacter(pos));
+			auto hCode = static_cast<uint8_t>(styleBuf->at(pos));
 			if (!hCode) {
 				return 0;
 			}
@@ -5500,7 +5982,7 @@ int64_t DocumentWidget::StyleLengthOfCodeFromPosEx(TextCursor pos) {
 			if (hCode == UNFINISHED_STYLE) {
 				// encountered "unfinished" style, trigger parsing
 				handleUnparsedRegion(highlightData->styleBuffer, pos);
-				hCode = static_cast<uint8_t>(styleBuf->BufGetCharacter(pos));
+				hCode = static_cast<uint8_t>(styleBuf->at(pos));
 			}
 
 			StyleTableEntry *entry = styleTableEntryOfCodeEx(hCode);
@@ -5514,10 +5996,11 @@ int64_t DocumentWidget::StyleLengthOfCodeFromPosEx(TextCursor pos) {
 				if (hCode == UNFINISHED_STYLE) {
 					// encountered "unfinished" style, trigger parsing, then loop
 					handleUnparsedRegion(highlightData->styleBuffer, pos);
-					hCode = static_cast<uint8_t>(styleBuf->BufGetCharacter(pos));
+					hCode = static_cast<uint8_t>(styleBuf->at(pos));
 				} else {
-					// advance the position and get the new code
-					hCode = static_cast<uint8_t>(styleBuf->BufGetCharacter(++pos));
+					// advance past the run and get the new code
+					pos   = styleBuf->runEnd(pos);
+					hCode = static_cast<uint8_t>(styleBuf->at(pos));
 				}
 			}
 		}
@@ -5579,13 +6062,13 @@ size_t DocumentWidget::HighlightCodeOfPosEx(TextCursor pos) {
 	size_t hCode = 0;
 	if(const std::unique_ptr<WindowHighlightData> &highlightData = highlightData_) {
 
-		if (const std::shared_ptr<TextBuffer> &styleBuf = highlightData->styleBuffer) {
+		if (const std::shared_ptr<StyleBuffer> &styleBuf = highlightData->styleBuffer) {
 
-			hCode = static_cast<uint8_t>(styleBuf->BufGetCharacter(pos));
+			hCode = static_cast<uint8_t>(styleBuf->at(pos));
 			if (hCode == UNFINISHED_STYLE) {
 				// encountered "unfinished" style, trigger parsing
 				handleUnparsedRegion(highlightData->styleBuffer, pos);
-				hCode = static_cast<uint8_t>(styleBuf->BufGetCharacter(pos));
+				hCode = static_cast<uint8_t>(styleBuf->at(pos));
 			}
 		}
 	}
@@ -5611,9 +6094,9 @@ int64_t DocumentWidget::HighlightLengthOfCodeFromPosEx(TextCursor pos, size_t ch
 
 	if(const std::unique_ptr<WindowHighlightData> &highlightData = highlightData_) {
 
-		if (const std::shared_ptr<TextBuffer> &styleBuf = highlightData->styleBuffer) {
+		if (const std::shared_ptr<StyleBuffer> &styleBuf = highlightData->styleBuffer) {
 
-			auto hCode = static_cast<uint8_t>(styleBuf->BufGetCharacter(pos));
+			auto hCode = static_cast<uint8_t>(styleBuf->at(pos));
 			if (!hCode) {
 				return 0;
 			}
@@ -5621,7 +6104,7 @@ int64_t DocumentWidget::HighlightLengthOfCodeFromPosEx(TextCursor pos, size_t ch
 			if (hCode == UNFINISHED_STYLE) {
 				// encountered "unfinished" style, trigger parsing
 				handleUnparsedRegion(highlightData->styleBuffer, pos);
-				hCode = static_cast<uint8_t>(styleBuf->BufGetCharacter(pos));
+				hCode = static_cast<uint8_t>(styleBuf->at(pos));
 			}
 
 			if (checkCode == 0) {
@@ -5632,10 +6115,11 @@ int64_t DocumentWidget::HighlightLengthOfCodeFromPosEx(TextCursor pos, size_t ch
 				if (hCode == UNFINISHED_STYLE) {
 					// encountered "unfinished" style, trigger parsing, then loop
 					handleUnparsedRegion(highlightData->styleBuffer, pos);
-					hCode = static_cast<uint8_t>(styleBuf->BufGetCharacter(pos));
+					hCode = static_cast<uint8_t>(styleBuf->at(pos));
 				} else {
-					// advance the position and get the new code
-					hCode = static_cast<uint8_t>(styleBuf->BufGetCharacter(++pos));
+					// advance past the run and get the new code
+					pos   = styleBuf->runEnd(pos);
+					hCode = static_cast<uint8_t>(styleBuf->at(pos));
 				}
 			}
 		}
@@ -5653,7 +6137,7 @@ int64_t DocumentWidget::HighlightLengthOfCodeFromPosEx(TextCursor pos, size_t ch
 ** needs re-parsing.  This routine applies pass 2 patterns to a chunk of
 ** the buffer of size PASS_2_REPARSE_CHUNK_SIZE beyond pos.
 */
-void DocumentWidget::handleUnparsedRegion(const std::shared_ptr<TextBuffer> &styleBuf, TextCursor pos) const {
+void DocumentWidget::handleUnparsedRegion(const std::shared_ptr<StyleBuffer> &styleBuf, TextCursor pos) const {
 
 	TextBuffer *buf = buffer_;
 	const std::unique_ptr<WindowHighlightData> &highlightData = highlightData_;
@@ -5677,7 +6161,7 @@ void DocumentWidget::handleUnparsedRegion(const std::shared_ptr<TextBuffer> &sty
 	TextCursor beginSafety = Highlight::backwardOneContext(buf, context, beginParse);
 
 	for (TextCursor p = beginParse; p >= beginSafety; --p) {
-		char ch = styleBuf->BufGetCharacter(p);
+		char ch = styleBuf->at(p);
 		if (ch != UNFINISHED_STYLE && ch != PLAIN_STYLE && static_cast<uint8_t>(ch) < firstPass2Style) {
 			beginSafety = p + 1;
 			break;
@@ -5692,7 +6176,7 @@ void DocumentWidget::handleUnparsedRegion(const std::shared_ptr<TextBuffer> &sty
 	TextCursor endSafety = Highlight::forwardOneContext(buf, context, endParse);
 
 	for (TextCursor p = pos; p < endSafety; ++p) {
-		char ch = styleBuf->BufGetCharacter(p);
+		char ch = styleBuf->at(p);
 		if (ch != UNFINISHED_STYLE && ch != PLAIN_STYLE && static_cast<uint8_t>(ch) < firstPass2Style) {
 			endParse  = std::min(endParse, p);
 			endSafety = p;
@@ -5713,7 +6197,7 @@ void DocumentWidget::handleUnparsedRegion(const std::shared_ptr<TextBuffer> &sty
 	const char *string          = &str[0];
 	const char *const match_to  = string + str.size();
 
-	std::string styleStr  = styleBuf->BufGetRangeEx(beginSafety, endSafety);
+	std::string styleStr  = styleBuf->range(beginSafety, endSafety);
 	char *styleString     = &styleStr[0];
 	char *stylePtr        = &styleStr[0];
 
@@ -5735,7 +6219,7 @@ void DocumentWidget::handleUnparsedRegion(const std::shared_ptr<TextBuffer> &sty
 	/* Update the style buffer the new style information, but only between
 	   beginParse and endParse.  Skip the safety region */
 	auto view = view::string_view(&styleString[beginParse - beginSafety], static_cast<size_t>(endParse - beginParse));
-	styleBuf->BufReplaceEx(beginParse, endParse, view);
+	styleBuf->replace(beginParse, endParse, view);
 }
 
 /*
@@ -5777,26 +6261,53 @@ void DocumentWidget::StartHighlightingEx(bool warn) {
 		}
 	} else {
 
-		view::string_view bufString = buffer_->BufAsStringEx();
+		/* Large documents only have enough parsed to fill the screen now, the
+		   remainder is parsed a piece at a time when idle (highlightInBackground) */
+		int64_t parseLength = bufLength;
+		if (bufLength > BACKGROUND_PARSE_THRESHOLD) {
+			TextCursor lastVisible = buffer_->BufStartOfBuffer();
+			for(TextArea *area : textPanes()) {
+				lastVisible = std::max(lastVisible, area->TextLastVisiblePos());
+			}
+
+			parseLength = std::min(bufLength, std::max<int64_t>(BACKGROUND_PARSE_CHUNK_SIZE, to_integer(lastVisible)));
+		}
+
+		/* only the part being parsed (and the context beyond it) needs to be
+		   contiguous, the rest of the buffer is left where it is */
+		const TextCursor endSafety  = Highlight::forwardOneContext(buffer_, highlightData->contextRequirements, TextCursor(parseLength));
+		view::string_view bufString = buffer_->BufAsStringEx(buffer_->BufStartOfBuffer(), endSafety);
 		const char *stringPtr       = bufString.data();
 		const char *const match_to  = bufString.data() + bufString.size();
 
+		std::vector<ParseCheckpoint> checkpoints;
+
 		Highlight::parseString(
 			&highlightData->pass1Patterns[0],
 			bufString.data(),
 			bufString.data() + bufString.size(),
 			stringPtr,
 			stylePtr,
-			bufLength,
+			parseLength,
 			&prevChar,
 		    documentDelimiters(),
 			stringPtr,
-			match_to);
+			match_to,
+			&checkpoints);
+
+		highlightData->checkpoints.assign(std::move(checkpoints));
+
+		// the rest is treated as plain text until it is reached
+		highlightData->parsedTo = TextCursor(stylePtr - styleBegin);
+		while (stylePtr - styleBegin < bufLength) {
+			*stylePtr++ = UNFINISHED_STYLE;
+		}
 	}
 
-	highlightData->styleBuffer->BufSetAll(view::string_view(styleBegin, static_cast<size_t>(stylePtr - styleBegin)));
+	highlightData->styleBuffer->setAll(view::string_view(styleBegin, static_cast<size_t>(stylePtr - styleBegin)));
 
 	// install highlight pattern data in the window data structure
+	stopBackgroundParse();
 	highlightData_ = std::move(highlightData);
 
 	// Attach highlight information to text widgets in each pane
@@ -5804,9 +6315,151 @@ void DocumentWidget::StartHighlightingEx(bool warn) {
 		AttachHighlightToWidgetEx(area);
 	}
 
+	ContinueHighlightingEx();
+
 	setCursor(prevCursor);
 }
 
+/*
+** Have the idle time parser finish whatever part of the document has not
+** been through the first pass yet, if any. While a piece is being parsed in
+** the background, that carries on when it is done (highlightPieceParsed)
+*/
+void DocumentWidget::ContinueHighlightingEx() {
+	const std::unique_ptr<WindowHighlightData> &highlightData = highlightData_;
+	if (highlightData && highlightData->pass1Patterns && highlightData->parsedTo < buffer_->BufEndOfBuffer() && !highlightTimer_->isActive()) {
+		if (!highlightParser_ || !highlightParser_->busy()) {
+			highlightTimer_->start();
+		}
+	}
+}
+
+/*
+** Continue the first pass parse of a large document, which was started by
+** StartHighlightingEx, one piece at a time. Text which is on screen but
+** hasn't been reached yet is parsed ahead of the rest, right away. That is
+** done as though nothing before it needs to be known, which may be wrong
+** (when it is inside of a long comment for example), but is corrected when
+** the parse gets there. The next piece is handed to a HighlightParser, which
+** works through it on another thread while the user carries on.
+*/
+void DocumentWidget::highlightInBackground() {
+
+	highlightTimer_->stop();
+
+	const std::unique_ptr<WindowHighlightData> &highlightData = highlightData_;
+	if (!highlightData || !highlightData->pass1Patterns || highlightData->parsedTo >= buffer_->BufEndOfBuffer()) {
+		return;
+	}
+
+	if (highlightParser_ && highlightParser_->busy()) {
+		return;
+	}
+
+	const std::shared_ptr<StyleBuffer> &styleBuffer = highlightData->styleBuffer;
+
+	/* The end of the changed area is collected in the style buffer's changed
+	   range, start with a clean slate so that only it gets redrawn */
+	styleBuffer->clearChanged();
+	TextCursor changedStart = buffer_->BufEndOfBuffer();
+
+	for(TextArea *area : textPanes()) {
+		const TextCursor first = std::max(highlightData->parsedTo, buffer_->BufStartOfLine(area->TextFirstVisiblePos()));
+		const TextCursor last  = area->TextLastVisiblePos();
+
+		if (first >= last || (first >= highlightData->provisionalStart && last <= highlightData->provisionalEnd)) {
+			continue;
+		}
+
+		Highlight::parseRange(highlightData, buffer_, first, last, documentDelimiters());
+		highlightData->provisionalStart = first;
+		highlightData->provisionalEnd   = last;
+		changedStart = std::min(changedStart, first);
+	}
+
+	/* The parser gets its own copy of the patterns, a compiled regex can
+	   only be used by one thread at a time */
+	if (!highlightParser_) {
+		if (PatternSet *patterns = findPatternsForWindowEx(/*warn=*/false)) {
+			if (std::unique_ptr<WindowHighlightData> parserPatterns = createHighlightDataEx(patterns)) {
+				highlightParser_ = new HighlightParser(std::move(parserPatterns), this);
+
+				connect(highlightParser_, &QThread::finished, highlightParser_, [this]() {
+					highlightPieceParsed();
+				});
+			}
+		}
+	}
+
+	// Then carry on from where the previous piece left off
+	const TextCursor endParse = std::min(buffer_->BufEndOfBuffer(), highlightData->parsedTo + BACKGROUND_PARSE_CHUNK_SIZE);
+
+	if (highlightParser_) {
+		highlightParser_->parse(highlightData, buffer_, endParse, documentDelimiters());
+	} else {
+		Highlight::parseRange(highlightData, buffer_, highlightData->parsedTo, endParse, documentDelimiters());
+		changedStart = std::min(changedStart, highlightData->parsedTo);
+		highlightData->parsedTo = endParse;
+	}
+
+	if (styleBuffer->changed()) {
+		const TextCursor changedEnd = styleBuffer->changedEnd();
+
+		for(TextArea *area : textPanes()) {
+			if (changedStart <= area->TextLastVisiblePos() && changedEnd >= area->TextFirstVisiblePos()) {
+				area->viewport()->update();
+			}
+		}
+
+		styleBuffer->clearChanged();
+	}
+
+	ContinueHighlightingEx();
+}
+
+/*
+** Store the result of the piece that the background parser has finished
+** with, unless the document was modified in the mean time, and start on the
+** next one
+*/
+void DocumentWidget::highlightPieceParsed() {
+
+	if (!highlightParser_ || !highlightParser_->busy()) {
+		return;
+	}
+
+	highlightParser_->wait();
+
+	const std::unique_ptr<WindowHighlightData> &highlightData = highlightData_;
+	const std::shared_ptr<StyleBuffer> &styleBuffer           = highlightData->styleBuffer;
+	const TextCursor parsedFrom                               = highlightData->parsedTo;
+
+	styleBuffer->clearChanged();
+
+	if (highlightParser_->store(highlightData) && styleBuffer->changed()) {
+		const TextCursor changedEnd = styleBuffer->changedEnd();
+
+		for(TextArea *area : textPanes()) {
+			if (parsedFrom <= area->TextLastVisiblePos() && changedEnd >= area->TextFirstVisiblePos()) {
+				area->viewport()->update();
+			}
+		}
+
+		styleBuffer->clearChanged();
+	}
+
+	ContinueHighlightingEx();
+}
+
+/*
+** Wait for the piece which the background parser is working on, if any, and
+** get rid of the parser, along with its copy of the highlight patterns
+*/
+void DocumentWidget::stopBackgroundParse() {
+	delete highlightParser_;
+	highlightParser_ = nullptr;
+}
+
 /*
 ** Attach style information from a window's highlight data to a
 ** text widget and redisplay.
@@ -6044,8 +6697,7 @@ std::unique_ptr<WindowHighlightData> DocumentWidget::createHighlightDataEx(Patte
 	}
 
 	// Create the style buffer
-	auto styleBuf = std::make_shared<TextBuffer>();
-	styleBuf->BufSetSyncXSelection(false);
+	auto styleBuf = std::make_shared<StyleBuffer>();
 
 	// Collect all of the highlighting information in a single structure
 	auto highlightData = std::make_unique<WindowHighlightData>();
@@ -6717,23 +7369,19 @@ void DocumentWidget::AddMarkEx(TextArea *area, QChar label) {
 }
 
 void DocumentWidget::SelectNumberedLineEx(TextArea *area, int64_t lineNum) {
-	int i;
-	TextCursor lineStart = {};
 
 	// count lines to find the start and end positions for the selection
 	if (lineNum < 1) {
 		lineNum = 1;
 	}
 
-	TextCursor lineEnd = TextCursor(-1);
-
-	for (i = 1; i <= lineNum && lineEnd < buffer_->BufGetLength(); i++) {
-		lineStart = lineEnd + 1;
-		lineEnd = buffer_->BufEndOfLine(lineStart);
-	}
+	// line "lineNum" exists as long as there are enough newlines before it
+	const bool lineFound     = buffer_->BufCountLines(buffer_->BufStartOfBuffer(), buffer_->BufEndOfBuffer()) >= lineNum - 1;
+	TextCursor lineStart     = buffer_->BufCountForwardNLines(buffer_->BufStartOfBuffer(), lineNum - 1);
+	const TextCursor lineEnd = buffer_->BufEndOfLine(lineStart);
 
 	// highlight the line
-	if (i > lineNum) {
+	if (lineFound) {
 		// Line was found
 		if (lineEnd < buffer_->BufGetLength()) {
 			buffer_->BufSelect(lineStart, lineEnd + 1);
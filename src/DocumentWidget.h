@@ -14,7 +14,7 @@
 #include "ShowMatchingStyle.h"
 #include "Tags.h"
 #include "TextBufferFwd.h"
-#include "UndoInfo.h"
+#include "UndoList.h"
 #include "WrapStyle.h"
 #include "Util/FileFormats.h"
 #include "Util/string_view.h"
@@ -33,13 +33,17 @@
 
 #include <sys/stat.h>
 
+class BackupJournal;
+class DocumentSaver;
 class HighlightData;
+class HighlightParser;
 class HighlightPattern;
 class MainWindow;
 class PatternSet;
 class RangesetTable;
 class Regex;
 class Style;
+class StyleBuffer;
 class StyleTableEntry;
 class TextArea;
 class UndoInfo;
@@ -140,11 +144,13 @@ public:
 	std::vector<TextArea *> textPanes() const;
 	void abortShellCommand();
 	void AddMarkEx(TextArea *area, QChar label);
+	void beginEditGroup();
 	void beginSmartIndent(bool warn);
 	void cancelMacroOrLearn();
 	void checkForChangesToFile();
 	void clearModeMessage();
 	void DoMacro(const QString &macro, const QString &errInName);
+	void endEditGroup(const std::shared_ptr<MacroCommandData> &macro);
 	void endSmartIndent();
 	void executeShellCommand(TextArea *area, const QString &command, CommandSource source);
 	void FindDefCalltip(TextArea *area, const QString &tipName);
@@ -180,6 +186,7 @@ public:
 	void shellCmdToMacroString(const QString &command, const QString &input);
 	void ShowStatsLine(bool state);
 	void StartHighlightingEx(bool warn);
+	void ContinueHighlightingEx();
 	void stopHighlighting();
 	void UpdateHighlightStylesEx();
 	void closePane();
@@ -189,7 +196,7 @@ public:
 	void finishMacroCmdExecution();
 	void gotoAP(TextArea *area, int lineNum, int column);
 	void gotoMark(TextArea *area, QChar label, bool extendSel);
-	void handleUnparsedRegion(const std::shared_ptr<TextBuffer> &styleBuf, TextCursor pos) const;
+	void handleUnparsedRegion(const std::shared_ptr<StyleBuffer> &styleBuf, TextCursor pos) const;
 	void macroBannerTimeoutProc();
 	void moveDocument(MainWindow *fromWindow);
 	void repeatMacro(const QString &macro, int how);
@@ -216,11 +223,13 @@ private:
 	bool WriteBackupFile();
 	bool compareDocumentToFile(const QString &fileName) const;
 	bool doOpen(const QString &name, const QString &path, int flags);
-	bool doSave();
+	bool doSave(bool background = false);
 	bool fileWasModifiedExternally() const;
 	bool includeFile(const QString &name);
-	bool saveDocument();
+	bool saveDocument(bool background = false);
 	bool saveDocumentAs(const QString &newName, bool addWrap);
+	bool saveFinished();
+	bool waitForSave();
 	bool writeBckVersion();
 	boost::optional<TextCursor> findMatchingCharEx(char toMatch, Style styleToMatch, TextCursor charPos, TextCursor startLimit, TextCursor endLimit);
 	int findAllMatchesEx(TextArea *area, const QString &string);
@@ -242,7 +251,7 @@ private:
 	void RefreshMenuToggleStates();
 	void RefreshTabState();
 	void refreshWindowStates();
-	void RemoveBackupFile() const;
+	void RemoveBackupFile();
 	void replay();
 	void RevertToSaved();
 	void saveUndoInformation(TextCursor pos, int64_t nInserted, int64_t nDeleted, view::string_view deletedText);
@@ -252,24 +261,34 @@ private:
 	void UpdateMarkTable(TextCursor pos, int64_t nInserted, int64_t nDeleted);
 	void updateStatsLine(TextArea *area);
 	void actionClose(CloseMode mode);
-	void addRedoItem(UndoInfo &&redo);
-	void addUndoItem(UndoInfo &&undo);
+	void addRedoItem(UndoInfo &&redo, view::string_view oldText);
+	void addUndoItem(UndoInfo &&undo, view::string_view oldText);
 	void addWrapNewlines();
-	void appendDeletedText(view::string_view deletedText, int64_t deletedLen, Direction direction);
+	void appendDeletedText(view::string_view deletedText, Direction direction);
 	void cancelLearning();
 	void createSelectMenuEx(TextArea *area, const QStringList &args);
 	void documentRaised();
 	void eraseFlash();
 	void filterSelection(const QString &command, CommandSource source);
-	void issueCommand(MainWindow *window, TextArea *area, const QString &command, const QString &input, int flags, TextCursor replaceLeft, TextCursor replaceRight, CommandSource source);
+	void highlightInBackground();
+	void highlightPieceParsed();
+	void stopBackgroundParse();
+	void journalModification(TextCursor pos, int64_t nInserted, int64_t nDeleted);
+	void insertShellOutput(view::string_view text);
+	void issueCommand(MainWindow *window, TextArea *area, const QString &command, std::string input, int flags, TextCursor replaceLeft, TextCursor replaceRight, CommandSource source);
 	void processFinished(int exitCode, QProcess::ExitStatus exitStatus);
+	void readShellOutput();
+	void recoverBackupFile(int64_t fileSize, time_t fileTime);
 	void reapplyLanguageMode(size_t mode, bool forceDefaults);
+	void scheduleUndoCompression();
+	void commitEditGroup();
 	void refreshMenuBar();
 	void removeRedoItem();
 	void removeUndoItem();
-	void trimUndoList(size_t maxLength);
+	void trimUndoList(size_t maxBytes);
 	void updateSelectionSensitiveMenu(QMenu *menu, const gsl::span<MenuData> &menuList, bool enabled);
 	void updateSelectionSensitiveMenus(bool enabled);
+	void writeShellInput();
 
 public:
 	bool replaceFailed_     = false;               // flags replacements failures during multi-file replacements
@@ -297,10 +316,13 @@ public:
 	std::shared_ptr<MacroCommandData>    macroCmdData_;    // same for macro commands
 	std::shared_ptr<RangesetTable>       rangesetTable_;   // current range sets
 	std::unique_ptr<WindowHighlightData> highlightData_;   // info for syntax highlighting
+	HighlightParser *highlightParser_ = nullptr;           // parses large documents for highlighting on another thread
 
 private:
 	QMenu *contextMenu_    = nullptr;
 	bool fileMissing_      = true;                      // is the window's file gone?
+	bool groupRecorded_    = false;                     // an undo or redo record has been made for the edit group being reported
+	bool reportingGroup_   = false;                     // the ranges changed by an edit group are being reported
 	bool ignoreModify_     = false;                     // ignore modifications to text area
 	dev_t dev_             = 0;                         // device where the file resides
 	ino_t ino_             = 0;                         // file's inode
@@ -308,6 +330,9 @@ private:
 	int autoSaveOpCount_   = 0;                         // count of editing operations
 	size_t nMarks_         = 0;                         // number of active bookmarks
 	time_t lastModTime_    = 0;                         // time of last modification to file
+	uint64_t fileHash_     = 0;                         // BackupJournal::Hash of the file's contents when it was last read or written, 0 if unknown
+	uint64_t *outputRecord_ = nullptr;                  // while shell command output is inserted, the serial of the undo record it goes in (0 for a new one)
+	uint64_t undoSerial_   = 0;                         // the serial of the most recent undo record made
 #ifdef Q_OS_UNIX
 	uid_t uid_             = 0;                         // last recorded user id of the file
 	gid_t gid_             = 0;                         // last recorded group id of the file
@@ -326,10 +351,16 @@ private:
 	QString backlightCharTypes_;                        // what backlighting to use
 	QString modeMessage_;                               // stats line banner content for learn and shell command executing modes
 	QTimer *flashTimer_;                                // timer for getting rid of highlighted matching paren.
+	QTimer *highlightTimer_;                            // timer for parsing the rest of a large document while idle
+	QTimer *undoCompressTimer_;                         // timer for compressing the undo and redo text once editing pauses
+	DocumentSaver *saver_ = nullptr;                    // writes the document out while a save is in progress
 	bool backlightChars_;                               // is char backlighting turned on?
 	std::array<Bookmark, MAX_MARKS> markTable_;         // marked locations in window
-	std::deque<UndoInfo> redo_;                         // info for redoing last undone op
-	std::deque<UndoInfo> undo_;                         // info for undoing last operation
+	UndoList redo_;                                     // info for redoing last undone op
+	UndoList undo_;                                     // info for undoing last operation
+	std::shared_ptr<MacroCommandData> editGroupMacro_;  // the macro whose edit group is being ended, if any
+	std::weak_ptr<MacroCommandData>   undoMacro_;       // the macro which made the most recent undo record, if any
+	std::unique_ptr<BackupJournal>    journal_;         // edits not yet saved, kept as the incremental backup
 	std::unique_ptr<ShellCommandData> shellCmdData_;    // when a shell command is executing, info. about it, otherwise, nullptr
 	std::unique_ptr<SmartIndentData>  smartIndentData_; // compiled macros for smart indent
 	Ui::DocumentWidget ui;
@@ -3,6 +3,7 @@
 #include "DocumentWidget.h"
 #include "FontType.h"
 #include "HighlightData.h"
+#include "HighlightParser.h"
 #include "HighlightPattern.h"
 #include "HighlightStyle.h"
 #include "MainWindow.h"
@@ -11,12 +12,14 @@
 #include "Regex.h"
 #include "ReparseContext.h"
 #include "Settings.h"
+#include "StyleBuffer.h"
 #include "StyleTableEntry.h"
 #include "TextArea.h"
 #include "TextBuffer.h"
 #include "WindowHighlightData.h"
 #include "X11Colors.h"
 #include "Util/Input.h"
+#include "Util/Kernels.h"
 #include "Util/Resource.h"
 
 #include <QSettings>
@@ -59,6 +62,10 @@ const auto NEDIT_DEFAULT_CURSOR_FG  = QLatin1String("black");
    This distance is increased by a factor of two for each subsequent step. */
 constexpr int REPARSE_CHUNK_SIZE = 80;
 
+/* Minimum distance between the parse state checkpoints recorded while parsing,
+   which bounds how far back a reparse has to start */
+constexpr int64_t PARSE_CHECKPOINT_INTERVAL = 0x1000;
+
 constexpr bool is_plain(int style) {
 	return (style == PLAIN_STYLE || style == UNFINISHED_STYLE);
 }
@@ -83,6 +90,54 @@ int parentStyleOf(const std::vector<uint8_t> &parentStyles, int style) {
 	return parentStyles[static_cast<uint8_t>(style) - UNFINISHED_STYLE];
 }
 
+/*
+** Where position "p" ends up after "nDeleted" characters at "pos" were
+** replaced by "nInserted" characters. A position at "pos" stays put, and one
+** within the replaced text, or at its end, goes back to "pos", since what is
+** known about it (how far the parse has got, for example) may not hold for
+** the new text
+*/
+TextCursor adjustedPosition(TextCursor p, TextCursor pos, int64_t nInserted, int64_t nDeleted) {
+	if (p <= pos) {
+		return p;
+	}
+
+	if (p <= pos + nDeleted) {
+		return pos;
+	}
+
+	return p + (nInserted - nDeleted);
+}
+
+/*
+** Note the first line start in [from, to] which is at least
+** PARSE_CHECKPOINT_INTERVAL characters past the previous checkpoint, the
+** parser is inside of the pattern with "style" there. Positions are recorded
+** relative to "base"
+*/
+void recordCheckpoint(std::vector<ParseCheckpoint> *checkpoints, const char *base, const char *from, const char *to, uint8_t style) {
+
+	if (!checkpoints) {
+		return;
+	}
+
+	if (!checkpoints->empty()) {
+		const int64_t next = to_integer(checkpoints->back().pos) + PARSE_CHECKPOINT_INTERVAL - 1;
+		if (to - base <= next) {
+			return;
+		}
+		from = std::max(from, base + next);
+	}
+
+	if (from >= to) {
+		return;
+	}
+
+	if (const char *newline = Kernels::FindCharacter(from, to, '\n')) {
+		checkpoints->push_back(ParseCheckpoint{TextCursor(newline + 1 - base), style});
+	}
+}
+
 bool isParentStyle(const std::vector<uint8_t> &parentStyles, int style1, int style2) {
 
 	for (int p = parentStyleOf(parentStyles, style2); p != 0; p = parentStyleOf(parentStyles, p)) {
@@ -132,29 +187,38 @@ void SyntaxHighlightModifyCBEx(TextCursor pos, int64_t nInserted, int64_t nDelet
 	   don't require any processing, but clear out the style buffer selection
 	   so the widget doesn't think it has to keep redrawing the old area */
 	if (nInserted == 0 && nDeleted == 0) {
-		highlightData->styleBuffer->BufUnselect();
+		highlightData->styleBuffer->clearChanged();
 		return;
 	}
 
 	/* First and foremost, the style buffer must track the text buffer
 	   accurately and correctly */
-	if (nInserted > 0) {
-		std::string insStyle(static_cast<size_t>(nInserted), UNFINISHED_STYLE);
-		highlightData->styleBuffer->BufReplaceEx(pos, pos + nDeleted, insStyle);
-	} else {
-		highlightData->styleBuffer->BufRemove(pos, pos + nDeleted);
-	}
+	highlightData->styleBuffer->replace(pos, pos + nDeleted, UNFINISHED_STYLE, nInserted);
 
 	/* Mark the changed region in the style buffer as requiring redraw.  This
 	   is not necessary for getting it redrawn, it will be redrawn anyhow by
-	   the text display callback, but it clears the previous selection and
+	   the text display callback, but it clears the previous changed range and
 	   saves the modifyStyleBuf routine from unnecessary work in tracking
 	   changes that are already scheduled for redraw */
-	highlightData->styleBuffer->BufSelect(pos, pos + nInserted);
+	highlightData->styleBuffer->markChanged(pos, pos + nInserted);
+
+	// Keep the progress of the idle time parser in step with the text
+	highlightData->parsedTo         = adjustedPosition(highlightData->parsedTo,         pos, nInserted, nDeleted);
+	highlightData->provisionalStart = adjustedPosition(highlightData->provisionalStart, pos, nInserted, nDeleted);
+	highlightData->provisionalEnd   = adjustedPosition(highlightData->provisionalEnd,   pos, nInserted, nDeleted);
+	highlightData->checkpoints.update(pos, nInserted, nDeleted);
+
+	// A piece of the text which is being parsed in the background may be out of date now
+	if (document->highlightParser_) {
+		document->highlightParser_->textModified(pos);
+	}
 
 	// Re-parse around the changed region
 	if (highlightData->pass1Patterns) {
 		Highlight::incrementalReparse(highlightData, document->buffer_, pos, nInserted, document->documentDelimiters());
+
+		// if the reparse was cut short, the rest is finished while idle
+		document->ContinueHighlightingEx();
 	}
 }
 
@@ -168,7 +232,7 @@ void SyntaxHighlightModifyCBEx(TextCursor pos, int64_t nInserted, int64_t nDelet
 */
 void Highlight::incrementalReparse(const std::unique_ptr<WindowHighlightData> &highlightData, TextBuffer *buf, TextCursor pos, int64_t nInserted, const QString &delimiters) {
 
-	const std::shared_ptr<TextBuffer> &styleBuf           = highlightData->styleBuffer;
+	const std::shared_ptr<StyleBuffer> &styleBuf          = highlightData->styleBuffer;
 	const std::unique_ptr<HighlightData[]> &pass1Patterns = highlightData->pass1Patterns;
 	const std::unique_ptr<HighlightData[]> &pass2Patterns = highlightData->pass2Patterns;
 	const ReparseContext &context                         = highlightData->contextRequirements;
@@ -209,7 +273,7 @@ void Highlight::incrementalReparse(const std::unique_ptr<WindowHighlightData> &h
 			startPattern = &pass1Patterns[0];
 		}
 
-		TextCursor endAt = parseBufferRange(startPattern, pass2Patterns, buf, styleBuf, context, beginParse, endParse, delimiters);
+		TextCursor endAt = parseBufferRange(startPattern, pass2Patterns, buf, styleBuf, context, beginParse, endParse, delimiters, &highlightData->checkpoints);
 
 		/* If parse completed at this level, move one style up in the
 		   hierarchy and start again from where the previous parse left off. */
@@ -230,17 +294,70 @@ void Highlight::incrementalReparse(const std::unique_ptr<WindowHighlightData> &h
 			   the end of the parse range by powers of 2 * REPARSE_CHUNK_SIZE and
 			   reparse until nothing changes */
 		} else {
+			/* Don't let a single modification (opening a comment, for
+			   example) reparse an unbounded amount of text. Everything up to
+			   endParse is correct, leave the rest to the idle time parser */
+			if (endParse - pos > BACKGROUND_PARSE_CHUNK_SIZE && endParse < buf->BufEndOfBuffer()) {
+				highlightData->parsedTo = std::min(highlightData->parsedTo, endParse);
+				highlightData->checkpoints.eraseFrom(endParse);
+				return;
+			}
+
 			lastMod = lastModified(styleBuf);
 			endParse = std::min(buf->BufEndOfBuffer(), forwardOneContext(buf, context, lastMod) + (REPARSE_CHUNK_SIZE << nPasses));
 		}
 	}
 }
 
+/*
+** Parse the text between "pos" and "endParse" from scratch, regardless of
+** whether the styles already there change or not. Unlike incrementalReparse,
+** the parse never extends beyond "endParse", which makes it suitable for
+** working through a large buffer a piece at a time. The areas which were
+** changed are marked by the changed range of the style buffer.
+*/
+void Highlight::parseRange(const std::unique_ptr<WindowHighlightData> &highlightData, TextBuffer *buf, TextCursor pos, TextCursor endParse, const QString &delimiters) {
+
+	const std::shared_ptr<StyleBuffer> &styleBuf          = highlightData->styleBuffer;
+	const std::unique_ptr<HighlightData[]> &pass1Patterns = highlightData->pass1Patterns;
+	const std::unique_ptr<HighlightData[]> &pass2Patterns = highlightData->pass2Patterns;
+	const ReparseContext &context                         = highlightData->contextRequirements;
+
+	const std::vector<uint8_t> &parentStyles = highlightData->parentStyles;
+
+	TextCursor beginParse = pos;
+	int parseInStyle = findSafeParseRestartPos(buf, highlightData, &beginParse);
+
+	while (beginParse < endParse) {
+
+		const HighlightData *startPattern = patternOfStyle(pass1Patterns, parseInStyle);
+		if (!startPattern) {
+			startPattern = &pass1Patterns[0];
+		}
+
+		const TextCursor endAt = parseBufferRange(startPattern, pass2Patterns, buf, styleBuf, context, beginParse, endParse, delimiters, &highlightData->checkpoints);
+
+		/* If the pattern we started in ended before endParse, continue with
+		   its parent from where it left off */
+		if (endAt >= endParse) {
+			return;
+		}
+
+		if (is_plain(parseInStyle)) {
+			qCritical("NEdit: internal error: range parse fell short");
+			return;
+		}
+
+		beginParse   = endAt;
+		parseInStyle = parentStyleOf(parentStyles, parseInStyle);
+	}
+}
+
 /*
 ** Parse text in buffer "buf" between positions "beginParse" and "endParse"
 ** using pass 1 patterns over the entire range and pass 2 patterns where needed
 ** to determine whether re-parsed areas have changed and need to be redrawn.
-** Deposits style information in "styleBuf" and expands the selection in
+** Deposits style information in "styleBuf" and expands the changed range of
 ** styleBuf to show the additional areas which have changed and need
 ** redrawing.  beginParse must be a position from which pass 1 parsing may
 ** safely be started using the pass1Patterns given.  Internally, adds a
@@ -251,7 +368,7 @@ void Highlight::incrementalReparse(const std::unique_ptr<WindowHighlightData> &h
 ** finished (this will normally be endParse, unless the pass1Patterns is a
 ** pattern which does end and the end is reached).
 */
-TextCursor Highlight::parseBufferRange(const HighlightData *pass1Patterns, const std::unique_ptr<HighlightData[]> &pass2Patterns, TextBuffer *buf, const std::shared_ptr<TextBuffer> &styleBuf, const ReparseContext &contextRequirements, TextCursor beginParse, TextCursor endParse, const QString &delimiters) {
+TextCursor Highlight::parseBufferRange(const HighlightData *pass1Patterns, const std::unique_ptr<HighlightData[]> &pass2Patterns, TextBuffer *buf, const std::shared_ptr<StyleBuffer> &styleBuf, const ReparseContext &contextRequirements, TextCursor beginParse, TextCursor endParse, const QString &delimiters, ParseCheckpoints *checkpoints) {
 
 	TextCursor endSafety;
 	TextCursor endPass2Safety;
@@ -268,7 +385,7 @@ TextCursor Highlight::parseBufferRange(const HighlightData *pass1Patterns, const
 	if (can_cross_line_boundaries(contextRequirements)) {
 		beginSafety = backwardOneContext(buf, contextRequirements, beginParse);
 		for (p = beginParse; p >= beginSafety; --p) {
-			style = styleBuf->BufGetCharacter(p - 1);
+			style = styleBuf->at(p - 1);
 			if (!equivalent_style(style, beginStyle, firstPass2Style)) {
 				beginSafety = p;
 				break;
@@ -276,7 +393,7 @@ TextCursor Highlight::parseBufferRange(const HighlightData *pass1Patterns, const
 		}
 	} else {
 		for (beginSafety = std::max(TextCursor(), beginParse - 1); beginSafety > 0; --beginSafety) {
-			style = styleBuf->BufGetCharacter(beginSafety);
+			style = styleBuf->at(beginSafety);
 			if (!equivalent_style(style, beginStyle, firstPass2Style) || buf->BufGetCharacter(beginSafety) == '\n') {
 				++beginSafety;
 				break;
@@ -299,12 +416,12 @@ TextCursor Highlight::parseBufferRange(const HighlightData *pass1Patterns, const
 		endSafety = std::min(buf->BufEndOfBuffer(), buf->BufEndOfLine(endParse) + 1);
 	}
 
-	// copy the buffer range into a string
+	/* view the buffer range in place, only the styles are copied, because
+	   they are parsed into */
+	const view::string_view str = buf->BufAsStringEx(beginSafety, endSafety);
+	std::string styleStr        = styleBuf->range(beginSafety, endSafety);
 
-	std::string str      = buf     ->BufGetRangeEx(beginSafety, endSafety);
-	std::string styleStr = styleBuf->BufGetRangeEx(beginSafety, endSafety);
-
-	const char *const string   = &str[0];
+	const char *const string   = str.data();
 	char *const styleString    = &styleStr[0];
 	const char *const match_to = string + str.size();
 
@@ -314,6 +431,8 @@ TextCursor Highlight::parseBufferRange(const HighlightData *pass1Patterns, const
 	const char *stringPtr = &string     [beginParse - beginSafety];
 	char *stylePtr        = &styleString[beginParse - beginSafety];
 
+	std::vector<ParseCheckpoint> found;
+
 	parseString(
 		&pass1Patterns[0],
 		string,
@@ -324,11 +443,16 @@ TextCursor Highlight::parseBufferRange(const HighlightData *pass1Patterns, const
 		&prevChar,
 		delimiters,
 		string,
-		match_to);
+		match_to,
+		&found);
 
 	// On non top-level patterns, parsing can end early
 	endParse = std::min(endParse, stringPtr - string + beginSafety);
 
+	if (checkpoints) {
+		checkpoints->replace(beginParse, endParse, found, beginSafety);
+	}
+
 	// If there are no pass 2 patterns, we're done
 	if (!pass2Patterns)
 		goto parseDone;
@@ -336,12 +460,12 @@ TextCursor Highlight::parseBufferRange(const HighlightData *pass1Patterns, const
 	/* Parsing of pass 2 patterns is done only as necessary for determining
 	   where styles have changed.  Find the area to avoid, which is already
 	   marked as changed (all inserted text and previously modified areas) */
-	if (styleBuf->primary.selected) {
-		modStart = styleBuf->primary.start;
-		modEnd   = styleBuf->primary.end;
+	if (styleBuf->changed()) {
+		modStart = styleBuf->changedStart();
+		modEnd   = styleBuf->changedEnd();
 	} else {
-		modStart = styleBuf->BufStartOfBuffer();
-		modEnd   = styleBuf->BufStartOfBuffer();
+		modStart = TextCursor();
+		modEnd   = TextCursor();
 	}
 
 	/* Re-parse the areas before the modification with pass 2 patterns, from
@@ -437,6 +561,22 @@ parseDone:
 	return endParse;
 }
 
+/*
+** Store the styles between "beginParse" and "endParse", which were parsed
+** from a snapshot of the text (see HighlightParser), along with the
+** checkpoints that were found there, whose positions are relative to
+** "offset". Like parseBufferRange, the areas which change are marked by the
+** changed range of the style buffer.
+*/
+void Highlight::storeParseResult(const std::unique_ptr<WindowHighlightData> &highlightData, char *styleString, TextCursor beginParse, TextCursor endParse, const std::vector<ParseCheckpoint> &found, TextCursor offset) {
+
+	const std::unique_ptr<HighlightData[]> &pass2Patterns = highlightData->pass2Patterns;
+	const int firstPass2Style = (pass2Patterns == nullptr) ? INT_MAX : pass2Patterns[1].style;
+
+	highlightData->checkpoints.replace(beginParse, endParse, found, offset);
+	modifyStyleBuf(highlightData->styleBuffer, styleString, beginParse, endParse, firstPass2Style);
+}
+
 /*
 ** Parses "string" according to compiled regular expressions in "pattern"
 ** until endRE is or errorRE are matched, or end of string is reached.
@@ -460,7 +600,7 @@ parseDone:
 ** the error pattern matched, if the end of the string was reached without
 ** matching the end expression, or in the unlikely event of an internal error.
 */
-bool Highlight::parseString(const HighlightData *pattern, const char *first, const char *last, const char *&string, char *&styleString, int64_t length, int *prevChar, const QString &delimiters, const char *look_behind_to, const char *match_to) {
+bool Highlight::parseString(const HighlightData *pattern, const char *first, const char *last, const char *&string, char *&styleString, int64_t length, int *prevChar, const QString &delimiters, const char *look_behind_to, const char *match_to, std::vector<ParseCheckpoint> *checkpoints) {
 
 	bool subExecuted;
 	const int succChar = (match_to && (match_to != last)) ? (*match_to) : -1;
@@ -499,6 +639,7 @@ bool Highlight::parseString(const HighlightData *pattern, const char *first, con
 
 		/* Fill in the pattern style for the text that was skipped over before
 		   the match, and advance the pointers to the start of the pattern */
+		recordCheckpoint(checkpoints, first, stringPtr, subPatternRE->startp[0], pattern->style);
 		fillStyleString(stringPtr, stylePtr, subPatternRE->startp[0], pattern->style, prevChar);
 
 		/* If the combined pattern matched this pattern's end pattern, we're
@@ -608,7 +749,8 @@ bool Highlight::parseString(const HighlightData *pattern, const char *first, con
 				prevChar,
 				delimiters,
 				look_behind_to,
-				match_to);
+				match_to,
+				checkpoints);
 
 		} else {
 			/* If the parent pattern is not a start/end pattern, the
@@ -674,6 +816,7 @@ bool Highlight::parseString(const HighlightData *pattern, const char *first, con
 	}
 
 	// Reached end of string, fill in the remaining text with pattern style
+	recordCheckpoint(checkpoints, first, stringPtr, string + length, pattern->style);
 	fillStyleString(stringPtr, stylePtr, string + length, pattern->style, prevChar);
 
 	// Advance the string and style pointers to the end of the parsed text
@@ -769,29 +912,31 @@ void Highlight::fillStyleString(const char *&stringPtr, char *&stylePtr, const c
 ** for distinguishing pass 2 styles which compare as equal to the unfinished
 ** style in the original buffer, from pass1 styles which signal a change.
 */
-void Highlight::modifyStyleBuf(const std::shared_ptr<TextBuffer> &styleBuf, char *styleString, TextCursor startPos, TextCursor endPos, int firstPass2Style) {
+void Highlight::modifyStyleBuf(const std::shared_ptr<StyleBuffer> &styleBuf, char *styleString, TextCursor startPos, TextCursor endPos, int firstPass2Style) {
 	char *ch;
 	TextCursor pos;
 	TextCursor modStart;
 	TextCursor modEnd;
 	TextCursor minPos = TextCursor(INT_MAX);
 	TextCursor maxPos = TextCursor();
-	const TextBuffer::Selection *sel = &styleBuf->primary;
 
 	// Skip the range already marked for redraw
-	if (sel->selected) {
-		modStart = sel->start;
-		modEnd   = sel->end;
+	if (styleBuf->changed()) {
+		modStart = styleBuf->changedStart();
+		modEnd   = styleBuf->changedEnd();
 	} else {
 		modStart = modEnd = startPos;
 	}
 
+	// the styles being replaced, expanded from their runs all at once
+	const std::string original = styleBuf->range(startPos, endPos);
+
 	/* Compare the original style buffer (outside of the modified range) with
 	   the new string with which it will be updated, to find the extent of
 	   the modifications.  Unfinished styles in the original match any
 	   pass 2 style */
 	for (ch = styleString, pos = startPos; pos < modStart && pos < endPos; ++ch, ++pos) {
-		char bufChar = styleBuf->BufGetCharacter(pos);
+		char bufChar = original[static_cast<size_t>(pos - startPos)];
 		if (*ch != bufChar && !(bufChar == UNFINISHED_STYLE && (*ch == PLAIN_STYLE || static_cast<uint8_t>(*ch) >= firstPass2Style))) {
 			minPos = std::min(minPos, pos);
 			maxPos = std::max(maxPos, pos);
@@ -799,7 +944,7 @@ void Highlight::modifyStyleBuf(const std::shared_ptr<TextBuffer> &styleBuf, char
 	}
 
 	for (ch = &styleString[std::max(0, modEnd - startPos)], pos = std::max(modEnd, startPos); pos < endPos; ++ch, ++pos) {
-		char bufChar = styleBuf->BufGetCharacter(pos);
+		char bufChar = original[static_cast<size_t>(pos - startPos)];
 		if (*ch != bufChar && !(bufChar == UNFINISHED_STYLE && (*ch == PLAIN_STYLE || static_cast<uint8_t>(*ch) >= firstPass2Style))) {
 
 			minPos = std::min(minPos, pos);
@@ -808,25 +953,23 @@ void Highlight::modifyStyleBuf(const std::shared_ptr<TextBuffer> &styleBuf, char
 	}
 
 	// Make the modification
-	styleBuf->BufReplaceEx(startPos, endPos, styleString);
+	styleBuf->replace(startPos, endPos, view::string_view(styleString, static_cast<size_t>(endPos - startPos)));
 
-	/* Mark or extend the range that needs to be redrawn.  Even if no
-	   change was made, it's important to re-establish the selection,
-	   because it can get damaged by the BufReplaceEx above */
-	styleBuf->BufSelect(std::min(modStart, minPos), std::max(modEnd, maxPos));
+	// Mark or extend the range that needs to be redrawn
+	styleBuf->markChanged(std::min(modStart, minPos), std::max(modEnd, maxPos));
 }
 
 /*
 ** Return the last modified position in buffer (as marked by modifyStyleBuf
 ** by the convention used for conveying modification information to the
-** text widget, which is selecting the text)
+** text widget, which is its changed range)
 */
-TextCursor Highlight::lastModified(const std::shared_ptr<TextBuffer> &buffer) {
-	if (buffer->primary.selected) {
-		return std::max(buffer->BufStartOfBuffer(), buffer->primary.end);
+TextCursor Highlight::lastModified(const std::shared_ptr<StyleBuffer> &buffer) {
+	if (buffer->changed()) {
+		return std::max(TextCursor(), buffer->changedEnd());
 	}
 
-	return buffer->BufStartOfBuffer();
+	return TextCursor();
 }
 
 /*
@@ -879,7 +1022,7 @@ int Highlight::findSafeParseRestartPos(TextBuffer *buf, const std::unique_ptr<Wi
 		return PLAIN_STYLE;
 	}
 
-	int startStyle = highlightData->styleBuffer->BufGetCharacter(*pos);
+	int startStyle = highlightData->styleBuffer->at(*pos);
 
 	if (is_plain(startStyle)) {
 		return PLAIN_STYLE;
@@ -909,6 +1052,11 @@ int Highlight::findSafeParseRestartPos(TextBuffer *buf, const std::unique_ptr<Wi
 		checkBackTo    = begin;
 	}
 
+	/* The closest checkpoint before the position bounds how far back we may
+	   have to look */
+	const boost::optional<ParseCheckpoint> checkpoint = highlightData->checkpoints.lastAtOrBefore(*pos);
+	const TextCursor checkpointPos                    = checkpoint ? checkpoint->pos : begin;
+
 	int runningStyle = startStyle;
 	for (TextCursor i = *pos - 1;; --i) {
 
@@ -918,9 +1066,15 @@ int Highlight::findSafeParseRestartPos(TextBuffer *buf, const std::unique_ptr<Wi
 			return PLAIN_STYLE;
 		}
 
+		// And so is a place where the parse state was recorded
+		if (i < checkpointPos) {
+			*pos = checkpointPos;
+			return checkpoint->style;
+		}
+
 		/* If the style is preceded by a parent style, it's safe to parse
 		 * with the parent style, provided that the parent is parsable. */
-		int style = highlightData->styleBuffer->BufGetCharacter(i);
+		int style = highlightData->styleBuffer->at(i);
 		if (isParentStyle(parentStyles, style, runningStyle)) {
 			if (patternIsParsable(patternOfStyle(pass1Patterns, style))) {
 				*pos = i + 1;
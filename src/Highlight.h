@@ -15,11 +15,14 @@
 class HighlightData;
 class HighlightPattern;
 class Input;
+class ParseCheckpoints;
 class PatternSet;
 class Regex;
 class Style;
+class StyleBuffer;
 class TextArea;
 struct HighlightStyle;
+struct ParseCheckpoint;
 struct ReparseContext;
 struct WindowHighlightData;
 
@@ -37,6 +40,11 @@ enum {
 // How much re-parsing to do when an unfinished style is encountered
 constexpr int PASS_2_REPARSE_CHUNK_SIZE = 1000;
 
+/* Documents larger than this only have the start parsed when highlighting is
+   turned on, the rest is parsed while idle, this many characters at a time */
+constexpr int64_t BACKGROUND_PARSE_THRESHOLD  = 0x100000;
+constexpr int64_t BACKGROUND_PARSE_CHUNK_SIZE = 0x10000;
+
 constexpr auto ASCII_A = static_cast<char>(65);
 
 // Meanings of style buffer characters (styles)
@@ -60,7 +68,7 @@ public:
 	static bool isDefaultPatternSet(const PatternSet &patternSet);
 	static bool LoadHighlightString(const QString &string);
 	static bool NamedStyleExists(const QString &styleName);
-	static bool parseString(const HighlightData *pattern, const char *first, const char *last, const char *&string, char *&styleString, int64_t length, int *prevChar, const QString &delimiters, const char *look_behind_to, const char *match_to);
+	static bool parseString(const HighlightData *pattern, const char *first, const char *last, const char *&string, char *&styleString, int64_t length, int *prevChar, const QString &delimiters, const char *look_behind_to, const char *match_to, std::vector<ParseCheckpoint> *checkpoints = nullptr);
 	static bool patternIsParsable(HighlightData *pattern);
 	static bool readHighlightPattern(Input &in, QString *errMsg, HighlightPattern *pattern);
 	static HighlightData *patternOfStyle(const std::unique_ptr<HighlightData[]> &patterns, int style);
@@ -80,14 +88,16 @@ public:
 	static boost::optional<std::vector<HighlightPattern>> readHighlightPatterns(Input &in, QString *errMsg);
 	static TextCursor backwardOneContext(TextBuffer *buf, const ReparseContext &context, TextCursor fromPos);
 	static TextCursor forwardOneContext(TextBuffer *buf, const ReparseContext &context, TextCursor fromPos);
-	static TextCursor lastModified(const std::shared_ptr<TextBuffer> &buffer);
-	static TextCursor parseBufferRange(const HighlightData *pass1Patterns, const std::unique_ptr<HighlightData[]> &pass2Patterns, TextBuffer *buf, const std::shared_ptr<TextBuffer> &styleBuf, const ReparseContext &contextRequirements, TextCursor beginParse, TextCursor endParse, const QString &delimiters);
+	static TextCursor lastModified(const std::shared_ptr<StyleBuffer> &buffer);
+	static TextCursor parseBufferRange(const HighlightData *pass1Patterns, const std::unique_ptr<HighlightData[]> &pass2Patterns, TextBuffer *buf, const std::shared_ptr<StyleBuffer> &styleBuf, const ReparseContext &contextRequirements, TextCursor beginParse, TextCursor endParse, const QString &delimiters, ParseCheckpoints *checkpoints);
 	static void fillStyleString(const char *&stringPtr, char *&stylePtr, const char *toPtr, uint8_t style, int *prevChar);
 	static void incrementalReparse(const std::unique_ptr<WindowHighlightData> &highlightData, TextBuffer *buf, TextCursor pos, int64_t nInserted, const QString &delimiters);
-	static void modifyStyleBuf(const std::shared_ptr<TextBuffer> &styleBuf, char *styleString, TextCursor startPos, TextCursor endPos, int firstPass2Style);
+	static void modifyStyleBuf(const std::shared_ptr<StyleBuffer> &styleBuf, char *styleString, TextCursor startPos, TextCursor endPos, int firstPass2Style);
+	static void parseRange(const std::unique_ptr<WindowHighlightData> &highlightData, TextBuffer *buf, TextCursor pos, TextCursor endParse, const QString &delimiters);
 	static void passTwoParseString(const HighlightData *pattern, const char *first, const char *last, const char *string, char *styleString, int64_t length, int *prevChar, const QString &delimiters, const char *lookBehindTo, const char *match_to);
 	static void recolorSubexpr(const std::unique_ptr<Regex> &re, size_t subexpr, uint8_t style, const char *string, char *styleString);
 	static void RenameHighlightPattern(const QString &oldName, const QString &newName);
+	static void storeParseResult(const std::unique_ptr<WindowHighlightData> &highlightData, char *styleString, TextCursor beginParse, TextCursor endParse, const std::vector<ParseCheckpoint> &found, TextCursor offset);
 
 public:
 	static std::vector<HighlightStyle> HighlightStyles;
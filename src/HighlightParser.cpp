@@ -0,0 +1,178 @@
+
+#include "HighlightParser.h"
+#include "Highlight.h"
+#include "HighlightData.h"
+#include "StyleBuffer.h"
+#include "TextBuffer.h"
+#include "WindowHighlightData.h"
+
+#include <QtDebug>
+
+/**
+ * @brief HighlightParser::HighlightParser
+ * @param patterns a compiled copy of the window's patterns, for this parser's use only
+ * @param parent
+ */
+HighlightParser::HighlightParser(std::unique_ptr<WindowHighlightData> patterns, QObject *parent) : QThread(parent), patterns_(std::move(patterns)) {
+}
+
+/**
+ * @brief HighlightParser::~HighlightParser
+ */
+HighlightParser::~HighlightParser() {
+	// a piece which is still being parsed uses our patterns and snapshot
+	wait();
+}
+
+/**
+ * @brief HighlightParser::busy
+ * @return true if a piece has been started and its result hasn't been
+ * stored (or thrown away) yet
+ */
+bool HighlightParser::busy() const {
+	return busy_;
+}
+
+/**
+ * @brief HighlightParser::parse
+ * @param highlightData
+ * @param buf
+ * @param endParse
+ * @param delimiters
+ *
+ * Start parsing the text from where the parse of "highlightData" has got to
+ * up to "endParse" in the background. The snapshot reaches one context
+ * distance beyond both ends, so that the pass 2 patterns can match properly
+ * at the start, and the end is parsed correctly in both passes.
+ */
+void HighlightParser::parse(const std::unique_ptr<WindowHighlightData> &highlightData, TextBuffer *buf, TextCursor endParse, const QString &delimiters) {
+
+	Q_ASSERT(!busy_);
+
+	const ReparseContext &context = highlightData->contextRequirements;
+
+	parsedTo_     = highlightData->parsedTo;
+	beginParse_   = parsedTo_;
+	parseInStyle_ = Highlight::findSafeParseRestartPos(buf, highlightData, &beginParse_);
+	endParse_     = endParse;
+	beginSafety_  = Highlight::backwardOneContext(buf, context, beginParse_);
+	endSafety_    = Highlight::forwardOneContext(buf, context, endParse);
+
+	text_   = buf->BufGetRangeEx(beginSafety_, endSafety_);
+	styles_ = highlightData->styleBuffer->range(beginSafety_, endSafety_);
+	found_.clear();
+
+	prevChar_       = Highlight::getPrevChar(buf, beginParse_);
+	prevSafetyChar_ = Highlight::getPrevChar(buf, beginSafety_);
+	delimiters_     = delimiters;
+	busy_           = true;
+	modified_       = false;
+
+	start();
+}
+
+/**
+ * @brief HighlightParser::textModified
+ * @param pos
+ *
+ * Note a modification of the text at "pos", the piece which is being parsed
+ * is out of date if it is within the snapshot.
+ */
+void HighlightParser::textModified(TextCursor pos) {
+	if (busy_ && pos < endSafety_) {
+		modified_ = true;
+	}
+}
+
+/**
+ * @brief HighlightParser::store
+ * @param highlightData
+ * @return true if the styles of the piece were stored in "highlightData",
+ * false if they were out of date
+ *
+ * Must only be called once the thread has finished.
+ */
+bool HighlightParser::store(const std::unique_ptr<WindowHighlightData> &highlightData) {
+
+	busy_ = false;
+
+	if (modified_ || !highlightData || highlightData->parsedTo != parsedTo_) {
+		return false;
+	}
+
+	Highlight::storeParseResult(highlightData, &styles_[beginParse_ - beginSafety_], beginParse_, endParse_, found_, beginSafety_);
+	highlightData->parsedTo = endParse_;
+	return true;
+}
+
+/**
+ * @brief HighlightParser::run
+ *
+ * The same as Highlight::parseRange followed by the pass 2 part of
+ * Highlight::parseBufferRange, but on the snapshot.
+ */
+void HighlightParser::run() {
+
+	const std::unique_ptr<HighlightData[]> &pass1Patterns = patterns_->pass1Patterns;
+	const std::unique_ptr<HighlightData[]> &pass2Patterns = patterns_->pass2Patterns;
+	const std::vector<uint8_t> &parentStyles              = patterns_->parentStyles;
+
+	const char *const string   = text_.data();
+	const char *const last     = string + text_.size();
+	const char *const parseEnd = &string[endParse_ - beginSafety_];
+
+	const char *stringPtr = &string [beginParse_ - beginSafety_];
+	char *stylePtr        = &styles_[beginParse_ - beginSafety_];
+	int prevChar          = prevChar_;
+	int parseInStyle      = parseInStyle_;
+
+	/* Parse with pass 1 patterns, if the pattern we started in ends before
+	   the end of the piece, continue with its parent from where it left off */
+	while (stringPtr < parseEnd) {
+
+		const HighlightData *startPattern = Highlight::patternOfStyle(pass1Patterns, parseInStyle);
+		if (!startPattern) {
+			startPattern = &pass1Patterns[0];
+		}
+
+		Highlight::parseString(
+			startPattern,
+			string,
+			last,
+			stringPtr,
+			stylePtr,
+			parseEnd - stringPtr,
+			&prevChar,
+			delimiters_,
+			string,
+			last,
+			&found_);
+
+		if (stringPtr >= parseEnd) {
+			break;
+		}
+
+		if (parseInStyle == PLAIN_STYLE || parseInStyle == UNFINISHED_STYLE) {
+			qCritical("NEdit: internal error: background parse fell short");
+			break;
+		}
+
+		parseInStyle = parentStyles[static_cast<uint8_t>(parseInStyle) - UNFINISHED_STYLE];
+	}
+
+	// Then over all of it with pass 2 patterns, starting in the safety region
+	if (pass2Patterns) {
+		prevChar = prevSafetyChar_;
+		Highlight::passTwoParseString(
+					&pass2Patterns[0],
+					string,
+					last,
+					string,
+					&styles_[0],
+					endParse_ - beginSafety_,
+					&prevChar,
+					delimiters_,
+					string,
+					last);
+	}
+}
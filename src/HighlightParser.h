@@ -0,0 +1,60 @@
+
+#ifndef HIGHLIGHT_PARSER_H_
+#define HIGHLIGHT_PARSER_H_
+
+#include "ParseCheckpoint.h"
+#include "TextBufferFwd.h"
+#include "TextCursor.h"
+
+#include <QString>
+#include <QThread>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+struct WindowHighlightData;
+
+/*
+** Does the first pass parse of the next piece of a large document for the
+** idle time highlighter on a thread of its own. Each piece is parsed from a
+** snapshot of its text and styles, taken when it is started, using a copy of
+** the window's patterns which belongs to the parser, because a compiled regex
+** can only be used by one thread at a time. The result is only stored if the
+** text it was parsed from hasn't been modified in the mean time.
+*/
+class HighlightParser : public QThread {
+	Q_OBJECT
+
+public:
+	HighlightParser(std::unique_ptr<WindowHighlightData> patterns, QObject *parent = nullptr);
+	~HighlightParser() override;
+
+public:
+	bool busy() const;
+	bool store(const std::unique_ptr<WindowHighlightData> &highlightData);
+	void parse(const std::unique_ptr<WindowHighlightData> &highlightData, TextBuffer *buf, TextCursor endParse, const QString &delimiters);
+	void textModified(TextCursor pos);
+
+protected:
+	void run() override;
+
+private:
+	std::unique_ptr<WindowHighlightData> patterns_;
+	std::vector<ParseCheckpoint> found_;
+	std::string text_;
+	std::string styles_;
+	QString delimiters_;
+	TextCursor parsedTo_;         // where the window's parse was, when this piece was started
+	TextCursor beginSafety_;      // the snapshot covers [beginSafety_, endSafety_)
+	TextCursor endSafety_;
+	TextCursor beginParse_;
+	TextCursor endParse_;         // where the parse ended (may be early, see Highlight::parseRange)
+	int parseInStyle_   = 0;
+	int prevChar_       = -1;     // the characters before beginParse_ and beginSafety_
+	int prevSafetyChar_ = -1;
+	bool busy_          = false;  // a piece has been started and not stored yet
+	bool modified_      = false;  // the text of the piece was modified while it was parsed
+};
+
+#endif
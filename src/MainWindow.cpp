@@ -4756,8 +4756,9 @@ void MainWindow::AllWindowsUnbusy() {
 /**
  * @brief MainWindow::action_Save
  * @param document
+ * @param background if true, don't wait for the file to be written
  */
-void MainWindow::action_Save(DocumentWidget *document) {
+void MainWindow::action_Save(DocumentWidget *document, bool background) {
 
 	emit_event("save");
 
@@ -4765,7 +4766,7 @@ void MainWindow::action_Save(DocumentWidget *document) {
 		return;
 	}
 
-	document->saveDocument();
+	document->saveDocument(background);
 }
 
 /**
@@ -4774,7 +4775,8 @@ void MainWindow::action_Save(DocumentWidget *document) {
 void MainWindow::on_action_Save_triggered() {
 
 	if(DocumentWidget *document = currentDocument()) {
-		action_Save(document);
+		// saving from the menu doesn't need to wait for the file to be written
+		action_Save(document, /*background=*/true);
 	}
 }
 
@@ -5953,9 +5955,6 @@ bool MainWindow::SearchWindowEx(DocumentWidget *document, const QString &searchS
 		return false;
 	}
 
-	// get the entire text buffer from the text area widget
-	view::string_view fileString = document->buffer_->BufAsStringEx();
-
 	/* If we're already outside the boundaries, we must consider wrapping
 	   immediately (Note: fileEnd+1 is a valid starting position. Consider
 	   searching for $ at the end of a file ending with \n.) */
@@ -5968,7 +5967,7 @@ bool MainWindow::SearchWindowEx(DocumentWidget *document, const QString &searchS
 	if (iSearchStartPos_ == -1) { // normal search
 
 		found = !outsideBounds && Search::SearchString(
-					fileString,
+					document->buffer_,
 					searchString,
 					direction,
 					searchType,
@@ -6012,7 +6011,7 @@ bool MainWindow::SearchWindowEx(DocumentWidget *document, const QString &searchS
 					}
 
 					found = Search::SearchString(
-								fileString,
+								document->buffer_,
 								searchString,
 								direction,
 								searchType,
@@ -6041,7 +6040,7 @@ bool MainWindow::SearchWindowEx(DocumentWidget *document, const QString &searchS
 					}
 
 					found = Search::SearchString(
-								fileString,
+								document->buffer_,
 								searchString,
 								direction,
 								searchType,
@@ -6071,7 +6070,7 @@ bool MainWindow::SearchWindowEx(DocumentWidget *document, const QString &searchS
 		}
 
 		found = !outsideBounds && Search::SearchString(
-					fileString,
+					document->buffer_,
 					searchString,
 					direction,
 					searchType,
@@ -6823,13 +6822,11 @@ bool MainWindow::ReplaceAllEx(DocumentWidget *document, TextArea *area, const QS
 	// save a copy of search and replace strings in the search history
 	Search::saveSearchHistory(searchString, replaceString, searchType, /*isIncremental=*/false);
 
-	// view the entire text buffer from the text area widget as a string
-	view::string_view fileString = document->buffer_->BufAsStringEx();
-
 	QString delimieters = document->GetWindowDelimitersEx();
 
+	// search the text buffer in place
 	boost::optional<std::string> newFileString = Search::ReplaceAllInString(
-				fileString,
+				document->buffer_,
 				searchString,
 				replaceString,
 				searchType,
@@ -197,7 +197,7 @@ public Q_SLOTS:
 	void action_Revert_to_Saved(DocumentWidget *document);
 	void action_Save_As(DocumentWidget *document);
 	void action_Save_As(DocumentWidget *document, const QString &filename, bool wrapped);
-	void action_Save(DocumentWidget *document);
+	void action_Save(DocumentWidget *document, bool background = false);
 	void action_Select_All(DocumentWidget *document);
 	void action_Shell_Menu_Command(DocumentWidget *document, const QString &name);
 	void action_Shift_Find_Again(DocumentWidget *document);
@@ -0,0 +1,16 @@
+
+#ifndef PARSE_CHECKPOINT_H_
+#define PARSE_CHECKPOINT_H_
+
+#include "TextCursor.h"
+
+#include <cstdint>
+
+// A line start at which the first pass parser was inside of the pattern with
+// the given style, parsing can be safely resumed from there with that pattern
+struct ParseCheckpoint {
+	TextCursor pos;
+	uint8_t    style;
+};
+
+#endif
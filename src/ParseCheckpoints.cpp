@@ -0,0 +1,184 @@
+
+#include "ParseCheckpoints.h"
+
+#include <algorithm>
+
+/**
+ * @brief ParseCheckpoints::lastAtOrBefore
+ * @param pos
+ * @return the checkpoint closest to "pos" which isn't after it, if any
+ */
+boost::optional<ParseCheckpoint> ParseCheckpoints::lastAtOrBefore(TextCursor pos) const noexcept {
+
+	const size_t count = countBefore(pos, true);
+	if (count == 0) {
+		return boost::none;
+	}
+
+	return at(count - 1);
+}
+
+/**
+ * @brief ParseCheckpoints::toVector
+ * @return all of the checkpoints, in order
+ */
+std::vector<ParseCheckpoint> ParseCheckpoints::toVector() const {
+
+	std::vector<ParseCheckpoint> result;
+	result.reserve(size());
+
+	for (size_t i = 0; i < size(); ++i) {
+		result.push_back(at(i));
+	}
+
+	return result;
+}
+
+/**
+ * @brief ParseCheckpoints::assign
+ * @param checkpoints
+ *
+ * Replace all of the checkpoints with "checkpoints", which must be sorted
+ */
+void ParseCheckpoints::assign(std::vector<ParseCheckpoint> checkpoints) {
+	entries_  = std::move(checkpoints);
+	gapStart_ = entries_.size();
+	gapEnd_   = entries_.size();
+	shift_    = 0;
+}
+
+/**
+ * @brief ParseCheckpoints::eraseFrom
+ * @param pos
+ *
+ * Drop the checkpoints at or after "pos"
+ */
+void ParseCheckpoints::eraseFrom(TextCursor pos) noexcept {
+	moveGap(countBefore(pos, false));
+	gapEnd_ = entries_.size();
+}
+
+/**
+ * @brief ParseCheckpoints::replace
+ * @param start
+ * @param end
+ * @param found
+ * @param offset
+ *
+ * Replace the checkpoints between "start" and "end" with the ones in "found"
+ * which are in that range, their positions are relative to "offset"
+ */
+void ParseCheckpoints::replace(TextCursor start, TextCursor end, const std::vector<ParseCheckpoint> &found, TextCursor offset) {
+
+	const size_t first = countBefore(start, false);
+	const size_t last  = countBefore(end, false);
+
+	moveGap(first);
+	gapEnd_ += last - first;
+
+	auto inRange = [start, end, offset](const ParseCheckpoint &checkpoint) {
+		const TextCursor pos = offset + to_integer(checkpoint.pos);
+		return pos >= start && pos < end;
+	};
+
+	const auto count = static_cast<size_t>(std::count_if(found.begin(), found.end(), inRange));
+
+	if (gapSize() < count) {
+		const size_t extra = std::max(count - gapSize(), size() / 2 + 16);
+		entries_.insert(entries_.begin() + static_cast<ptrdiff_t>(gapEnd_), extra, ParseCheckpoint());
+		gapEnd_ += extra;
+	}
+
+	for (const ParseCheckpoint &checkpoint : found) {
+		if (inRange(checkpoint)) {
+			entries_[gapStart_++] = ParseCheckpoint{offset + to_integer(checkpoint.pos), checkpoint.style};
+		}
+	}
+}
+
+/**
+ * @brief ParseCheckpoints::update
+ * @param pos
+ * @param nInserted
+ * @param nDeleted
+ *
+ * Keep the checkpoints in step with "nDeleted" characters at "pos" being
+ * replaced by "nInserted" characters. The parse state at "pos" itself is
+ * unaffected, so a checkpoint there stays. The ones within the replaced
+ * text are dropped, the ones after it are assumed to still be right, the
+ * reparse which follows the modification will correct them if they are not
+ */
+void ParseCheckpoints::update(TextCursor pos, int64_t nInserted, int64_t nDeleted) noexcept {
+
+	const size_t first = countBefore(pos, true);
+	const size_t last  = countBefore(pos + nDeleted, true);
+
+	moveGap(first);
+	gapEnd_ += last - first;
+	shift_  += nInserted - nDeleted;
+}
+
+/**
+ * @brief ParseCheckpoints::at
+ * @param index
+ * @return
+ */
+ParseCheckpoint ParseCheckpoints::at(size_t index) const noexcept {
+
+	if (index < gapStart_) {
+		return entries_[index];
+	}
+
+	ParseCheckpoint checkpoint = entries_[index + gapSize()];
+	checkpoint.pos += shift_;
+	return checkpoint;
+}
+
+/**
+ * @brief ParseCheckpoints::countBefore
+ * @param pos
+ * @param inclusive
+ * @return the number of checkpoints before "pos" (or at it, if "inclusive"
+ * is true)
+ */
+size_t ParseCheckpoints::countBefore(TextCursor pos, bool inclusive) const noexcept {
+
+	size_t first = 0;
+	size_t count = size();
+
+	while (count > 0) {
+		const size_t step       = count / 2;
+		const TextCursor middle = at(first + step).pos;
+
+		if (inclusive ? middle <= pos : middle < pos) {
+			first += step + 1;
+			count -= step + 1;
+		} else {
+			count = step;
+		}
+	}
+
+	return first;
+}
+
+/**
+ * @brief ParseCheckpoints::moveGap
+ * @param index
+ *
+ * Move the gap to just before checkpoint "index", converting the positions
+ * of the checkpoints which cross it
+ */
+void ParseCheckpoints::moveGap(size_t index) noexcept {
+
+	while (gapStart_ > index) {
+		ParseCheckpoint &checkpoint = entries_[--gapEnd_];
+		checkpoint = entries_[--gapStart_];
+		checkpoint.pos -= shift_;
+	}
+
+	while (gapStart_ < index) {
+		ParseCheckpoint &checkpoint = entries_[gapStart_++];
+		checkpoint = entries_[gapEnd_++];
+		checkpoint.pos += shift_;
+	}
+}
@@ -0,0 +1,53 @@
+
+#ifndef PARSE_CHECKPOINTS_H_
+#define PARSE_CHECKPOINTS_H_
+
+#include "ParseCheckpoint.h"
+#include "TextCursor.h"
+
+#include <boost/optional.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/*
+** The parse checkpoints of a document, sorted by position.
+**
+** Every edit of the text moves all of the checkpoints after it, and may drop
+** or add a few where it is. So the checkpoints are kept the way gap_buffer
+** keeps text, with a gap at the last place they were changed. The ones after
+** the gap are stored shift_ characters before where they really are, so an
+** edit only has to move the gap to where it is (which, when typing, is
+** where it already was) and then change shift_. Finding a checkpoint by
+** position is still a binary search.
+*/
+class ParseCheckpoints {
+public:
+	bool empty() const noexcept  { return size() == 0; }
+	size_t size() const noexcept { return entries_.size() - gapSize(); }
+
+public:
+	boost::optional<ParseCheckpoint> lastAtOrBefore(TextCursor pos) const noexcept;
+	std::vector<ParseCheckpoint> toVector() const;
+
+public:
+	void assign(std::vector<ParseCheckpoint> checkpoints);
+	void eraseFrom(TextCursor pos) noexcept;
+	void replace(TextCursor start, TextCursor end, const std::vector<ParseCheckpoint> &found, TextCursor offset);
+	void update(TextCursor pos, int64_t nInserted, int64_t nDeleted) noexcept;
+
+private:
+	ParseCheckpoint at(size_t index) const noexcept;
+	size_t gapSize() const noexcept { return gapEnd_ - gapStart_; }
+	size_t countBefore(TextCursor pos, bool inclusive) const noexcept;
+	void moveGap(size_t index) noexcept;
+
+private:
+	std::vector<ParseCheckpoint> entries_;
+	size_t  gapStart_ = 0;
+	size_t  gapEnd_   = 0;
+	int64_t shift_    = 0; // how far the entries after the gap are from where they are stored
+};
+
+#endif
@@ -675,6 +675,18 @@ int Preferences::GetPrefMaxPrevOpenFiles() {
 	return Settings::maxPrevOpenFiles;
 }
 
+int Preferences::GetPrefMapFileThreshold() {
+	return Settings::mapFileThreshold;
+}
+
+int Preferences::GetPrefUndoMemoryLimit() {
+	return Settings::undoMemoryLimit;
+}
+
+bool Preferences::GetPrefCompressUndo() {
+	return Settings::compressUndo;
+}
+
 bool Preferences::GetPrefTypingHidesPointer() {
 	return Settings::typingHidesPointer;
 }
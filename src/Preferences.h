@@ -64,6 +64,7 @@ public:
 	static int GetPrefISearchLine();
 	static int GetPrefLineNums();
 	static bool GetPrefMatchSyntaxBased();
+	static int GetPrefMapFileThreshold();
 	static int GetPrefMaxPrevOpenFiles();
 	static int GetPrefRows();
 	static int GetPrefShowPathInWindowsMenu();
@@ -75,6 +76,8 @@ public:
 	static int GetPrefTabDist(size_t langMode);
 	static bool GetPrefToolTips();
 	static bool GetPrefTypingHidesPointer();
+	static int GetPrefUndoMemoryLimit();
+	static bool GetPrefCompressUndo();
 	static bool GetPrefAutoWrapPastedText();
 	static bool GetPrefHeavyCursor();
 	static bool GetPrefWarnFileMods();
@@ -0,0 +1,351 @@
+
+#include "RangeBoundaries.h"
+
+#include <algorithm>
+
+/**
+ * @brief RangeBoundaries::at
+ * @param index
+ * @return the position of boundary "index", which must exist
+ */
+TextCursor RangeBoundaries::at(int64_t index) const noexcept {
+
+	int64_t local;
+	int64_t base;
+	const size_t block = findIndex(index, &local, &base);
+
+	return TextCursor(base + blocks_[block].offsets[static_cast<size_t>(local)]);
+}
+
+/**
+ * @brief RangeBoundaries::lowerBound
+ * @param pos
+ * @return the index of the first boundary at or after "pos", or size() if
+ * there is none
+ */
+int64_t RangeBoundaries::lowerBound(TextCursor pos) const noexcept {
+	return bound(pos, false);
+}
+
+/**
+ * @brief RangeBoundaries::upperBound
+ * @param pos
+ * @return the index of the first boundary after "pos", or size() if there is
+ * none
+ */
+int64_t RangeBoundaries::upperBound(TextCursor pos) const noexcept {
+	return bound(pos, true);
+}
+
+/**
+ * @brief RangeBoundaries::ranges
+ * @return all of the ranges, in order
+ */
+std::vector<Range> RangeBoundaries::ranges() const {
+
+	std::vector<Range> result;
+	result.reserve(static_cast<size_t>(size_ / 2));
+
+	int64_t base  = 0;
+	int64_t index = 0;
+
+	for (const Block &block : blocks_) {
+		for (int64_t offset : block.offsets) {
+			if (index++ % 2 == 0) {
+				result.push_back({TextCursor(base + offset), TextCursor()});
+			} else {
+				result.back().end = TextCursor(base + offset);
+			}
+		}
+
+		base += block.offsets.back();
+	}
+
+	return result;
+}
+
+/**
+ * @brief RangeBoundaries::assign
+ * @param ranges
+ *
+ * Replace all of the boundaries with those of "ranges", which must be sorted
+ */
+void RangeBoundaries::assign(const std::vector<Range> &ranges) {
+
+	std::vector<int64_t> positions;
+	positions.reserve(ranges.size() * 2);
+
+	for (const Range &range : ranges) {
+		positions.push_back(to_integer(range.start));
+		positions.push_back(to_integer(range.end));
+	}
+
+	blocks_ = makeBlocks(positions, 0);
+	size_   = static_cast<int64_t>(positions.size());
+	rebuildTree();
+}
+
+/**
+ * @brief RangeBoundaries::replace
+ * @param first
+ * @param last
+ * @param boundaries
+ * @param shift
+ *
+ * Replace the boundaries with indices "first" up to "last" with "boundaries",
+ * and move every boundary after them by "shift". The result must still be
+ * sorted. Only the blocks holding first..last are rebuilt, the ones after
+ * them move along with the last of those.
+ */
+void RangeBoundaries::replace(int64_t first, int64_t last, const std::vector<TextCursor> &boundaries, int64_t shift) {
+
+	if (blocks_.empty()) {
+		std::vector<int64_t> positions;
+		for (TextCursor boundary : boundaries) {
+			positions.push_back(to_integer(boundary));
+		}
+
+		blocks_ = makeBlocks(positions, 0);
+		size_   = static_cast<int64_t>(positions.size());
+		rebuildTree();
+		return;
+	}
+
+	// the blocks holding first..last, or the last one when adding to the end
+	int64_t local;
+	int64_t firstBase;
+	const int64_t firstIndex = std::min(first, size_ - 1);
+	const size_t firstBlock  = findIndex(firstIndex, &local, &firstBase);
+	const Sum before         = {firstBase, firstIndex - local};
+
+	size_t lastBlock = firstBlock + 1;
+	int64_t end      = before.count + blockSum(firstBlock).count;
+	int64_t oldLast  = before.span  + blockSum(firstBlock).span;
+
+	while (end < last) {
+		end     += blockSum(lastBlock).count;
+		oldLast += blockSum(lastBlock).span;
+		++lastBlock;
+	}
+
+	// the absolute positions those blocks will hold
+	std::vector<int64_t> positions;
+	positions.reserve(static_cast<size_t>(end - before.count) + boundaries.size());
+
+	int64_t base  = before.span;
+	int64_t index = before.count;
+	for (size_t i = firstBlock; i < lastBlock; ++i) {
+		for (int64_t offset : blocks_[i].offsets) {
+			if (index++ < first) {
+				positions.push_back(base + offset);
+			}
+		}
+		base += blocks_[i].offsets.back();
+	}
+
+	for (TextCursor boundary : boundaries) {
+		positions.push_back(to_integer(boundary));
+	}
+
+	base  = before.span;
+	index = before.count;
+	for (size_t i = firstBlock; i < lastBlock; ++i) {
+		for (int64_t offset : blocks_[i].offsets) {
+			if (index++ >= last) {
+				positions.push_back(base + offset + shift);
+			}
+		}
+		base += blocks_[i].offsets.back();
+	}
+
+	// don't let edits leave lots of nearly empty blocks behind
+	if (positions.size() < BlockSize / 4 && lastBlock < blocks_.size()) {
+		for (int64_t offset : blocks_[lastBlock].offsets) {
+			positions.push_back(oldLast + offset + shift);
+		}
+		oldLast += blocks_[lastBlock].offsets.back();
+		++lastBlock;
+	}
+
+	// the totals of the blocks which are about to change, for updating the tree
+	const size_t changedEnd = std::min(lastBlock + 1, blocks_.size());
+
+	std::vector<Sum> oldSums;
+	for (size_t i = firstBlock; i < changedEnd; ++i) {
+		oldSums.push_back(blockSum(i));
+	}
+
+	std::vector<Block> replacement = makeBlocks(positions, before.span);
+	const int64_t newLast          = positions.empty() ? before.span : positions.back();
+
+	/* the block after the rebuilt ones was relative to their old last
+	   boundary, and moves by "shift" along with everything after it */
+	if (lastBlock < blocks_.size()) {
+		for (int64_t &offset : blocks_[lastBlock].offsets) {
+			offset += oldLast + shift - newLast;
+		}
+	}
+
+	size_ += static_cast<int64_t>(boundaries.size()) - (last - first);
+
+	/* the blocks after these only have to be shifted along (and the tree
+	   rebuilt) when there are more or fewer of them than before */
+	if (replacement.size() != lastBlock - firstBlock) {
+		auto it = blocks_.erase(blocks_.begin() + static_cast<ptrdiff_t>(firstBlock), blocks_.begin() + static_cast<ptrdiff_t>(lastBlock));
+		blocks_.insert(it, std::make_move_iterator(replacement.begin()), std::make_move_iterator(replacement.end()));
+		rebuildTree();
+		return;
+	}
+
+	std::move(replacement.begin(), replacement.end(), blocks_.begin() + static_cast<ptrdiff_t>(firstBlock));
+
+	for (size_t i = 0; i < oldSums.size(); ++i) {
+		const Sum sum = blockSum(firstBlock + i);
+		add(firstBlock + i, Sum{sum.span - oldSums[i].span, sum.count - oldSums[i].count});
+	}
+}
+
+/**
+ * @brief RangeBoundaries::bound
+ * @param pos
+ * @param upper
+ * @return the index of the first boundary at or after "pos" (or after it, if
+ * "upper" is true)
+ */
+int64_t RangeBoundaries::bound(TextCursor pos, bool upper) const noexcept {
+
+	const int64_t p = to_integer(pos);
+
+	auto before = [p, upper](int64_t boundary) {
+		return upper ? boundary <= p : boundary < p;
+	};
+
+	size_t mask = 1;
+	while (mask * 2 < tree_.size()) {
+		mask *= 2;
+	}
+
+	// find the number of whole blocks which end before "pos"
+	size_t index = 0;
+	Sum sum      = {0, 0};
+	for (; mask != 0; mask /= 2) {
+		const size_t next = index + mask;
+		if (next < tree_.size() && before(sum.span + tree_[next].span)) {
+			index      = next;
+			sum.span  += tree_[next].span;
+			sum.count += tree_[next].count;
+		}
+	}
+
+	if (index == blocks_.size()) {
+		return size_;
+	}
+
+	const std::vector<int64_t> &offsets = blocks_[index].offsets;
+
+	auto it = upper ? std::upper_bound(offsets.begin(), offsets.end(), p - sum.span)
+	                : std::lower_bound(offsets.begin(), offsets.end(), p - sum.span);
+
+	return sum.count + (it - offsets.begin());
+}
+
+/**
+ * @brief RangeBoundaries::findIndex
+ * @param index
+ * @param localIndex
+ * @param blockBase
+ * @return the block holding boundary "index", "localIndex" is set to its index
+ * within the block, and "blockBase" to the position its offsets are from
+ */
+size_t RangeBoundaries::findIndex(int64_t index, int64_t *localIndex, int64_t *blockBase) const noexcept {
+
+	size_t mask = 1;
+	while (mask * 2 < tree_.size()) {
+		mask *= 2;
+	}
+
+	// find the number of whole blocks which hold boundaries before "index"
+	size_t block = 0;
+	Sum sum      = {0, 0};
+	for (; mask != 0; mask /= 2) {
+		const size_t next = block + mask;
+		if (next < tree_.size() && sum.count + tree_[next].count <= index) {
+			block      = next;
+			sum.span  += tree_[next].span;
+			sum.count += tree_[next].count;
+		}
+	}
+
+	*localIndex = index - sum.count;
+	*blockBase  = sum.span;
+	return block;
+}
+
+/**
+ * @brief RangeBoundaries::blockSum
+ * @param index
+ * @return
+ */
+auto RangeBoundaries::blockSum(size_t index) const noexcept -> Sum {
+	const std::vector<int64_t> &offsets = blocks_[index].offsets;
+	return Sum{offsets.back(), static_cast<int64_t>(offsets.size())};
+}
+
+/**
+ * @brief RangeBoundaries::add
+ * @param index
+ * @param delta
+ */
+void RangeBoundaries::add(size_t index, Sum delta) noexcept {
+	for (size_t i = index + 1; i < tree_.size(); i += i & (~i + 1)) {
+		tree_[i].span  += delta.span;
+		tree_[i].count += delta.count;
+	}
+}
+
+/**
+ * @brief RangeBoundaries::rebuildTree
+ */
+void RangeBoundaries::rebuildTree() {
+
+	tree_.assign(blocks_.size() + 1, Sum{0, 0});
+
+	for (size_t i = 1; i < tree_.size(); ++i) {
+		const Sum sum = blockSum(i - 1);
+		tree_[i].span  += sum.span;
+		tree_[i].count += sum.count;
+
+		const size_t parent = i + (i & (~i + 1));
+		if (parent < tree_.size()) {
+			tree_[parent].span  += tree_[i].span;
+			tree_[parent].count += tree_[i].count;
+		}
+	}
+}
+
+/**
+ * @brief RangeBoundaries::makeBlocks
+ * @param positions
+ * @param base
+ * @return "positions" split up into blocks, the first of which is relative to
+ * "base"
+ */
+auto RangeBoundaries::makeBlocks(const std::vector<int64_t> &positions, int64_t base) -> std::vector<Block> {
+
+	std::vector<Block> blocks;
+	const size_t perBlock = (positions.size() > BlockSize * 2) ? BlockSize : BlockSize * 2;
+
+	for (size_t i = 0; i < positions.size(); i += perBlock) {
+		Block block;
+		const size_t end = std::min(i + perBlock, positions.size());
+
+		for (size_t j = i; j < end; ++j) {
+			block.offsets.push_back(positions[j] - base);
+		}
+
+		base = positions[end - 1];
+		blocks.push_back(std::move(block));
+	}
+
+	return blocks;
+}
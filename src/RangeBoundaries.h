@@ -0,0 +1,74 @@
+
+#ifndef RANGE_BOUNDARIES_H_
+#define RANGE_BOUNDARIES_H_
+
+#include "Range.h"
+#include "TextCursor.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/*
+** The sorted start and end positions of a rangeset's ranges, as one list of
+** boundaries { s1,e1, s2,e2, ... }, so that even indices are starts and odd
+** ones are ends.
+**
+** Every edit of the text moves all of the boundaries after it, so rather than
+** absolute positions, the boundaries are kept in blocks of positions relative
+** to the last boundary of the block before. Moving everything after a
+** boundary then only touches the rest of its block, plus the sizes of the
+** blocks, which are summed up in a Fenwick tree (the same way line_index does
+** for lines). Finding a boundary by position or by index is O(log n), plus a
+** binary search within one block.
+**
+** Changing boundaries rewrites the blocks holding them in place and updates
+** the tree in O(log n). Only when that splits or merges blocks, which takes
+** about BlockSize added or removed boundaries, is the list of blocks moved
+** along and the tree rebuilt, in O(n / BlockSize).
+*/
+class RangeBoundaries {
+public:
+	static constexpr size_t BlockSize = 64;
+
+private:
+	struct Block {
+		std::vector<int64_t> offsets; // from the last boundary of the block before
+	};
+
+	struct Sum {
+		int64_t span;  // the last offset of the block
+		int64_t count; // how many boundaries are in the block
+	};
+
+public:
+	bool empty() const noexcept   { return size_ == 0; }
+	int64_t size() const noexcept { return size_; }
+
+public:
+	TextCursor at(int64_t index) const noexcept;
+	int64_t lowerBound(TextCursor pos) const noexcept;
+	int64_t upperBound(TextCursor pos) const noexcept;
+	std::vector<Range> ranges() const;
+
+public:
+	void assign(const std::vector<Range> &ranges);
+	void replace(int64_t first, int64_t last, const std::vector<TextCursor> &boundaries, int64_t shift);
+
+private:
+	int64_t bound(TextCursor pos, bool upper) const noexcept;
+	size_t findIndex(int64_t index, int64_t *localIndex, int64_t *blockBase) const noexcept;
+	Sum blockSum(size_t index) const noexcept;
+	void add(size_t index, Sum delta) noexcept;
+	void rebuildTree();
+
+private:
+	static std::vector<Block> makeBlocks(const std::vector<int64_t> &positions, int64_t base);
+
+private:
+	std::vector<Block> blocks_;
+	std::vector<Sum>   tree_;   // Fenwick tree over blocks_, 1-based
+	int64_t            size_ = 0;
+};
+
+#endif
@@ -60,188 +60,35 @@ bool is_end(int64_t i) {
 
 void rangesetRefreshAllRanges(TextBuffer *buffer, Rangeset *rangeset) {
 
-	for(Range &range : rangeset->ranges_) {
+	for(const Range &range : rangeset->boundaries_.ranges()) {
 		RangesetRefreshRange(buffer, range.start, range.end);
 	}
 }
 
-// --------------------------------------------------------------------------
-
 /*
-** Find the index of the first integer in table greater than or equal to pos.
-** Fails with len (the total number of entries). The start index base can be
-** chosen appropriately.
+** Finish off a modification for the maintain functions below: the boundaries
+** from i up to j have been passed over by the change and go, except that if
+** one of i and j indexes a start and the other an end, boundary i is kept, at
+** the position "moved". Every boundary from j on is adjusted by movement.
 */
+void rangesetReplaceBoundaries(Rangeset *rangeset, int64_t i, int64_t j, TextCursor moved, int64_t movement) {
 
-// NOTE(eteran): this just an implementation of std::lower_bound.
-//               though it is probably better to replace the fundamental
-//               data-structures instead of replacing a few random
-//               functions
-template <class T>
-int64_t at_or_before(const T *table, int64_t base, int64_t len, T val) {
-
-	int64_t mid = 0;
-
-	if (base >= len) {
-		return len;             /* not sure what this means! */
-	}
-
-	int64_t lo = base;          /* first valid index */
-	int64_t hi = len - 1;       /* last valid index */
-
-	while (lo <= hi) {
-		mid = (lo + hi) / 2;
-
-		if (val == table[mid]) {
-			return mid;
-		}
-
-		if (val < table[mid]) {
-			hi = mid - 1;
-		} else {
-			lo = mid + 1;
-		}
-	}
-
-	/* if we get here, we didn't find val itself */
-	if (val > table[mid]) {
-		mid++;
-	}
-
-	return mid;
-}
-
-template <class T>
-int64_t weighted_at_or_before(const T *table, int64_t base, int64_t len, T val) {
-
-	int64_t mid = 0;
-
-	if (base >= len) {
-		return len; /* not sure what this means! */
-	}
-
-	int64_t lo = base;          /* first valid index */
-	int64_t hi = len - 1;       /* last valid index */
-
-	TextCursor min = table[lo];    /* establish initial min/max */
-	TextCursor max = table[hi];
-
-	if (val <= min) {   /* initial range checks */
-		return lo;      /* needed to avoid out-of-range mid values */
-	} else if (val > max) {
-		return len;
-	} else if (val == max) {
-		return hi;
-	}
-
-	while (lo <= hi) {
-		/* Beware of integer overflow when multiplying large numbers! */
-		mid = lo + static_cast<int>((hi - lo) * static_cast<double>(val - min) / (max - min));
-		/* we won't worry about min == max - values should be unique */
-
-		if (val == table[mid]) {
-			return mid;
-		}
-
-		if (val < table[mid]) {
-			hi = mid - 1;
-			max = table[mid];
-		} else { /* val > table[mid] */
-			lo = mid + 1;
-			min = table[mid];
-		}
-	}
-
-	/* if we get here, we didn't find val itself */
-	if (val > table[mid]) {
-		return mid + 1;
+	std::vector<TextCursor> kept;
+	if (is_start(i) != is_start(j)) {
+		kept.push_back(moved);
 	}
 
-	return mid;
+	rangeset->boundaries_.replace(i, j, kept, movement);
 }
 
 // --------------------------------------------------------------------------
 
-/*
-** Find the index of the first entry in the range set's ranges table (viewed as
-** an int array) whose value is equal to or greater than pos. As a side effect,
-** update the last_index value of the range set. Return's the index value. This
-** will be twice p->n_ranges if pos is beyond the end.
-*/
-int64_t rangesetWeightedAtOrBefore(Rangeset *rangeset, TextCursor pos) {
-
-	int64_t i;
-	auto rangeTable = reinterpret_cast<TextCursor *>(rangeset->ranges_.data());
-
-	int64_t n = rangeset->ranges_.size();
-	if (n == 0) {
-		return 0;
-	}
-
-	int64_t last = rangeset->last_index_;
-
-	if (last >= n || last < 0) {
-		last = 0;
-	}
-
-	n *= 2;
-	last *= 2;
-
-	if (pos >= rangeTable[last]) {                           // ranges[last_index].start
-		i = weighted_at_or_before(rangeTable, last, n, pos); // search end only
-	} else {
-		i = weighted_at_or_before(rangeTable, 0, last, pos); // search front only
-	}
-
-	rangeset->last_index_ = i / 2;
-	return i;
-}
-
-/*
-** Adjusts values in tab[] by an amount delta, perhaps moving them meanwhile.
-*/
-template <class T>
-int64_t rangesetShuffleToFrom(T *table, int64_t to, int64_t from, int64_t n, int64_t delta) {
-	int64_t end;
-	int64_t diff = from - to;
-
-	if (n <= 0) {
-		return 0;
-	}
-
-	if (delta != 0) {
-		if (diff > 0) { /* shuffle entries down */
-			for (end = to + n; to < end; to++) {
-				table[to] = table[to + diff] + delta;
-			}
-		} else if (diff < 0) { /* shuffle entries up */
-			for (end = to, to += n; --to >= end;) {
-				table[to] = table[to + diff] + delta;
-			}
-		} else { /* diff == 0: just run through */
-			for (end = n; end--;) {
-				table[to++] += delta;
-			}
-		}
-	} else {
-		if (diff > 0) { /* shuffle entries down */
-			for (end = to + n; to < end; to++) {
-				table[to] = table[to + diff];
-			}
-		} else if (diff < 0) { /* shuffle entries up */
-			for (end = to, to += n; --to >= end;) {
-				table[to] = table[to + diff];
-			}
-		}
-		/* else diff == 0: nothing to do */
-	}
-
-	return n;
-}
-
 /*
 ** Functions to adjust a rangeset to include new text or remove old.
 ** *** NOTE: No redisplay: that's outside the responsability of these routines.
+**
+** The ranges are seen as one sorted list of boundaries { s1,e1, s2,e2, ... },
+** starts at even indices and ends at odd ones.
 */
 
 /* "Insert/Delete": if the start point is in or at the end of a range
@@ -250,12 +97,11 @@ int64_t rangesetShuffleToFrom(T *table, int64_t to, int64_t from, int64_t n, int
 */
 Rangeset *rangesetInsDelMaintain(Rangeset *rangeset, TextCursor pos, int64_t ins, int64_t del) {
 
-	auto rangeTable = reinterpret_cast<TextCursor *>(rangeset->ranges_.data());
-	int64_t n = 2 * rangeset->ranges_.size();
+	const RangeBoundaries &boundaries = rangeset->boundaries_;
 
-	int64_t i = rangesetWeightedAtOrBefore(rangeset, pos);
+	int64_t i = boundaries.lowerBound(pos);
 
-	if (i == n) {
+	if (i == boundaries.size()) {
 		return rangeset; /* all beyond the end */
 	}
 
@@ -264,32 +110,12 @@ Rangeset *rangesetInsDelMaintain(Rangeset *rangeset, TextCursor pos, int64_t ins
 
 	/* the idea now is to determine the first range not concerned with the
 	   movement: its index will be j. For indices j to n-1, we will adjust
-	   position by movement only. (They may need shuffling up or down, depending
-	   on whether ranges have been deleted or created by the change.) */
-	int64_t j = i;
-	while (j < n && rangeTable[j] <= end_del) { /* skip j to first ind beyond changes */
-		j++;
-	}
+	   position by movement only. */
+	int64_t j = std::max(i, boundaries.upperBound(end_del));
 
-	/* if j moved forward, we have deleted over rangeTable[i] - reduce it accordingly,
+	/* if j moved forward, we have deleted over boundary i - reduce it accordingly,
 	   accounting for inserts. */
-	if (j > i) {
-		rangeTable[i] = pos + ins;
-	}
-
-	/* If i and j both index starts or ends, just copy all the rangeTable[] values down
-	   by j - i spaces, adjusting on the way. Otherwise, move beyond rangeTable[i]
-	   before doing this. */
-
-	if (is_start(i) != is_start(j)) {
-		i++;
-	}
-
-	rangesetShuffleToFrom(rangeTable, i, j, n - j, movement);
-
-	n -= (j - i);
-
-	rangeset->ranges_.resize(n / 2);
+	rangesetReplaceBoundaries(rangeset, i, j, pos + ins, movement);
 	return rangeset;
 }
 
@@ -300,19 +126,18 @@ Rangeset *rangesetInsDelMaintain(Rangeset *rangeset, TextCursor pos, int64_t ins
 */
 Rangeset *rangesetInclMaintain(Rangeset *rangeset, TextCursor pos, int64_t ins, int64_t del) {
 
-	auto rangeTable = reinterpret_cast<TextCursor *>(rangeset->ranges_.data());
-	int64_t n = 2 * rangeset->ranges_.size();
+	const RangeBoundaries &boundaries = rangeset->boundaries_;
 
-	int64_t i = rangesetWeightedAtOrBefore(rangeset, pos);
+	int64_t i = boundaries.lowerBound(pos);
 
-	if (i == n) {
+	if (i == boundaries.size()) {
 		return rangeset; /* all beyond the end */
 	}
 
 	/* if the insert occurs at the start of a range, the following lines will
 	   extend the range, leaving the start of the range at pos. */
 
-	if (is_start(i) && rangeTable[i] == pos && ins > 0) {
+	if (is_start(i) && boundaries.at(i) == pos && ins > 0) {
 		i++;
 	}
 
@@ -321,32 +146,12 @@ Rangeset *rangesetInclMaintain(Rangeset *rangeset, TextCursor pos, int64_t ins,
 
 	/* the idea now is to determine the first range not concerned with the
 	   movement: its index will be j. For indices j to n-1, we will adjust
-	   position by movement only. (They may need shuffling up or down, depending
-	   on whether ranges have been deleted or created by the change.) */
-	int64_t j = i;
-	while (j < n && rangeTable[j] <= end_del) { /* skip j to first ind beyond changes */
-		j++;
-	}
+	   position by movement only. */
+	int64_t j = std::max(i, boundaries.upperBound(end_del));
 
-	/* if j moved forward, we have deleted over rangeTable[i] - reduce it accordingly,
+	/* if j moved forward, we have deleted over boundary i - reduce it accordingly,
 	   accounting for inserts. */
-	if (j > i) {
-		rangeTable[i] = pos + ins;
-	}
-
-	/* If i and j both index starts or ends, just copy all the rangeTable[] values down
-	   by j - i spaces, adjusting on the way. Otherwise, move beyond rangeTable[i]
-	   before doing this. */
-
-	if (is_start(i) != is_start(j)) {
-		i++;
-	}
-
-	rangesetShuffleToFrom(rangeTable, i, j, n - j, movement);
-
-	n -= (j - i);
-
-	rangeset->ranges_.resize(n / 2);
+	rangesetReplaceBoundaries(rangeset, i, j, pos + ins, movement);
 	return rangeset;
 }
 
@@ -358,48 +163,27 @@ Rangeset *rangesetInclMaintain(Rangeset *rangeset, TextCursor pos, int64_t ins,
 */
 Rangeset *rangesetDelInsMaintain(Rangeset *rangeset, TextCursor pos, int64_t ins, int64_t del) {
 
-	auto rangeTable = reinterpret_cast<TextCursor *>(rangeset->ranges_.data());
-	int64_t n = 2 * rangeset->ranges_.size();
+	const RangeBoundaries &boundaries = rangeset->boundaries_;
 
-	int64_t i = rangesetWeightedAtOrBefore(rangeset, pos);
+	int64_t i = boundaries.lowerBound(pos);
 
-	if (i == n) {
+	if (i == boundaries.size()) {
 		return rangeset; /* all beyond the end */
 	}
 
-	TextCursor end_del  = pos + del;
-	int64_t movement    = ins - del;
+	TextCursor end_del = pos + del;
+	int64_t movement   = ins - del;
 
 	/* the idea now is to determine the first range not concerned with the
 	   movement: its index will be j. For indices j to n-1, we will adjust
-	   position by movement only. (They may need shuffling up or down, depending
-	   on whether ranges have been deleted or created by the change.) */
-	int64_t j = i;
-	while (j < n && rangeTable[j] <= end_del) { /* skip j to first ind beyond changes */
-		j++;
-	}
+	   position by movement only. */
+	int64_t j = std::max(i, boundaries.upperBound(end_del));
 
-	/* if j moved forward, we have deleted over rangeTable[i] - reduce it accordingly,
-	   accounting for inserts. (Note: if rangeTable[j] is an end position, inserted
-	   text will belong to the range that rangeTable[j] closes; otherwise inserted
+	/* if j moved forward, we have deleted over boundary i - reduce it accordingly,
+	   accounting for inserts. (Note: if boundary j is an end position, inserted
+	   text will belong to the range that boundary j closes; otherwise inserted
 	   text does not belong to a range.) */
-	if (j > i) {
-		rangeTable[i] = (is_end(j)) ? pos + ins : pos;
-	}
-
-	/* If i and j both index starts or ends, just copy all the rangeTable[] values down
-	   by j - i spaces, adjusting on the way. Otherwise, move beyond rangeTable[i]
-	   before doing this. */
-
-	if (is_start(i) != is_start(j)) {
-		i++;
-	}
-
-	rangesetShuffleToFrom(rangeTable, i, j, n - j, movement);
-
-	n -= (j - i);
-
-	rangeset->ranges_.resize(n / 2);
+	rangesetReplaceBoundaries(rangeset, i, j, is_end(j) ? pos + ins : pos, movement);
 	return rangeset;
 }
 
@@ -411,19 +195,18 @@ Rangeset *rangesetDelInsMaintain(Rangeset *rangeset, TextCursor pos, int64_t ins
 */
 Rangeset *rangesetExclMaintain(Rangeset *rangeset, TextCursor pos, int64_t ins, int64_t del) {
 
-	auto rangeTable = reinterpret_cast<TextCursor *>(rangeset->ranges_.data());
-	int64_t n = 2 * rangeset->ranges_.size();
+	const RangeBoundaries &boundaries = rangeset->boundaries_;
 
-	int64_t i = rangesetWeightedAtOrBefore(rangeset, pos);
+	int64_t i = boundaries.lowerBound(pos);
 
-	if (i == n) {
+	if (i == boundaries.size()) {
 		return rangeset; /* all beyond the end */
 	}
 
 	/* if the insert occurs at the end of a range, the following lines will
 	   skip the range, leaving the end of the range at pos. */
 
-	if (is_end(i) && rangeTable[i] == pos && ins > 0) {
+	if (is_end(i) && boundaries.at(i) == pos && ins > 0) {
 		i++;
 	}
 
@@ -432,33 +215,14 @@ Rangeset *rangesetExclMaintain(Rangeset *rangeset, TextCursor pos, int64_t ins,
 
 	/* the idea now is to determine the first range not concerned with the
 	   movement: its index will be j. For indices j to n-1, we will adjust
-	   position by movement only. (They may need shuffling up or down, depending
-	   on whether ranges have been deleted or created by the change.) */
-	int64_t j = i;
-	while (j < n && rangeTable[j] <= end_del) { /* skip j to first ind beyond changes */
-		j++;
-	}
+	   position by movement only. */
+	int64_t j = std::max(i, boundaries.upperBound(end_del));
 
-	/* if j moved forward, we have deleted over rangeTable[i] - reduce it accordingly,
-	   accounting for inserts. (Note: if rangeTable[j] is an end position, inserted
-	   text will belong to the range that rangeTable[j] closes; otherwise inserted
+	/* if j moved forward, we have deleted over boundary i - reduce it accordingly,
+	   accounting for inserts. (Note: if boundary j is an end position, inserted
+	   text will belong to the range that boundary j closes; otherwise inserted
 	   text does not belong to a range.) */
-	if (j > i) {
-		rangeTable[i] = (is_end(j)) ? pos + ins : pos;
-	}
-
-	/* If i and j both index starts or ends, just copy all the rangeTable[] values down
-	   by j - i spaces, adjusting on the way. Otherwise, move beyond rangeTable[i]
-	   before doing this. */
-	if (is_start(i) != is_start(j)) {
-		i++;
-	}
-
-	rangesetShuffleToFrom(rangeTable, i, j, n - j, movement);
-
-	n -= (j - i);
-
-	rangeset->ranges_.resize(n / 2);
+	rangesetReplaceBoundaries(rangeset, i, j, is_end(j) ? pos + ins : pos, movement);
 	return rangeset;
 }
 
@@ -468,20 +232,18 @@ Rangeset *rangesetExclMaintain(Rangeset *rangeset, TextCursor pos, int64_t ins,
 */
 Rangeset *rangesetBreakMaintain(Rangeset *rangeset, TextCursor pos, int64_t ins, int64_t del) {
 
-	auto rangeTable = reinterpret_cast<TextCursor *>(rangeset->ranges_.data());
-
-	int64_t n = 2 * rangeset->ranges_.size();
+	RangeBoundaries &boundaries = rangeset->boundaries_;
 
-	int64_t i = rangesetWeightedAtOrBefore(rangeset, pos);
+	int64_t i = boundaries.lowerBound(pos);
 
-	if (i == n) {
+	if (i == boundaries.size()) {
 		return rangeset; /* all beyond the end */
 	}
 
 	/* if the insert occurs at the end of a range, the following lines will
 	   skip the range, leaving the end of the range at pos. */
 
-	if (is_end(i) && rangeTable[i] == pos && ins > 0) {
+	if (is_end(i) && boundaries.at(i) == pos && ins > 0) {
 		i++;
 	}
 
@@ -490,54 +252,32 @@ Rangeset *rangesetBreakMaintain(Rangeset *rangeset, TextCursor pos, int64_t ins,
 
 	/* the idea now is to determine the first range not concerned with the
 	   movement: its index will be j. For indices j to n-1, we will adjust
-	   position by movement only. (They may need shuffling up or down, depending
-	   on whether ranges have been deleted or created by the change.) */
-	int64_t j = i;
-	while (j < n && rangeTable[j] <= end_del) { /* skip j to first ind beyond changes */
-		j++;
-	}
+	   position by movement only. */
+	int64_t j = std::max(i, boundaries.upperBound(end_del));
+
+	std::vector<TextCursor> replacement;
 
-	if (j > i) {
-		rangeTable[i] = pos;
+	/* if we've got start-end or end-start, keep boundary i */
+	if (is_start(i) != is_start(j)) { /* one is start, other is end */
+		TextCursor moved = (j > i) ? pos : boundaries.at(i);
+		if (is_start(i) && moved == pos) {
+			moved = pos + ins; /* move the range start */
+		}
+		replacement.push_back(moved);
 	}
 
 	/* do we need to insert a gap? yes if pos is in a range and ins > 0 */
 
 	/* The logic for the next statement: if i and j are both range ends, range
 	   boundaries indicated by index values between i and j (if any) have been
-	   "skipped". This means that rangeTable[i-1],rangeTable[j] is the current range. We will
+	   "skipped". This means that boundaries i-1,j are the current range. We will
 	   be inserting in that range, splitting it. */
-
-	bool need_gap = (is_end(i) && is_end(j) && ins > 0);
-
-	/* if we've got start-end or end-start, skip rangeTable[i] */
-	if (is_start(i) != is_start(j)) { /* one is start, other is end */
-		if (is_start(i)) {
-			if (rangeTable[i] == pos) {
-				rangeTable[i] = pos + ins; /* move the range start */
-			}
-		}
-		i++; /* skip to next index */
-	}
-
-	/* values rangeTable[j] to rangeTable[n-1] must be adjusted by movement and placed in
-	   position. */
-
-	if (need_gap) {
-		i += 2; /* make space for the break */
-	}
-
-	/* adjust other position values: shuffle them up or down if necessary */
-	rangesetShuffleToFrom(rangeTable, i, j, n - j, movement);
-
-	if (need_gap) { /* add the gap informations */
-		rangeTable[i - 2] = pos;
-		rangeTable[i - 1] = pos + ins;
+	if (is_end(i) && is_end(j) && ins > 0) {
+		replacement.push_back(pos);
+		replacement.push_back(pos + ins);
 	}
 
-	n -= j - i;
-
-	rangeset->ranges_.resize(n / 2);
+	boundaries.replace(i, j, replacement, movement);
 	return rangeset;
 }
 
@@ -557,13 +297,13 @@ QString Rangeset::name() const {
  * @return
  */
 boost::optional<Range> Rangeset::RangesetSpan() const {
-	if(ranges_.empty()) {
+	if(boundaries_.empty()) {
 		return boost::none;
 	}
 
 	Range r;
-	r.start = ranges_.front().start;
-	r.end   = ranges_.back().end;
+	r.start = boundaries_.at(0);
+	r.end   = boundaries_.at(boundaries_.size() - 1);
 	return r;
 }
 
@@ -574,12 +314,11 @@ boost::optional<Range> Rangeset::RangesetSpan() const {
  */
 boost::optional<Range> Rangeset::RangesetFindRangeNo(int index) const {
 
-	const auto n = static_cast<size_t>(index);
-	if (index < 0 || ranges_.size() <= n) {
+	if (index < 0 || size() <= index) {
 		return boost::none;
 	}
 
-	return ranges_[n];
+	return Range{boundaries_.at(2 * index), boundaries_.at(2 * index + 1)};
 }
 
 /*
@@ -589,26 +328,19 @@ boost::optional<Range> Rangeset::RangesetFindRangeNo(int index) const {
 */
 int64_t Rangeset::RangesetFindRangeOfPos(TextCursor pos, bool incl_end) const {
 
-	if (ranges_.empty()) {
-		return -1;
-	}
+	/* the last boundary at or before pos: { s1,e1, s2,e2, s3,e3,... } */
+	const int64_t ind = boundaries_.upperBound(pos) - 1;
 
-	auto ranges = reinterpret_cast<const TextCursor *>(ranges_.data()); /* { s1,e1, s2,e2, s3,e3,... } */
-	const int64_t len = ranges_.size() * 2;
-	const int64_t ind = at_or_before(ranges, 0, len, pos);
+	if (ind < 0) {
+		return -1; /* before the first range */
+	}
 
-	if (ind == len) {
-		return -1; /* beyond end */
+	if (is_start(ind)) {
+		return ind / 2; /* pos is before the matching end: return the range index */
 	}
 
-	if (is_end(ind)) {
-		if (pos < ranges[ind] || (incl_end && pos == ranges[ind])) {
-			return ind / 2; /* return the range index */
-		}
-	} else { /* ind even: references start marker */
-		if (pos == ranges[ind]) {
-			return ind / 2; /* return the range index */
-		}
+	if (incl_end && pos == boundaries_.at(ind)) {
+		return ind / 2; /* return the range index */
 	}
 
 	return -1; /* not in any range */
@@ -618,7 +350,7 @@ int64_t Rangeset::RangesetFindRangeOfPos(TextCursor pos, bool incl_end) const {
 ** Get number of ranges in rangeset.
 */
 int64_t Rangeset::size() const {
-	return ranges_.size();
+	return boundaries_.size() / 2;
 }
 
 /*
@@ -630,40 +362,42 @@ int64_t Rangeset::RangesetInverse() {
 	const TextCursor first = buffer_->BufStartOfBuffer();
 	const TextCursor last  = buffer_->BufEndOfBuffer();
 
-	if (ranges_.empty()) {
-		ranges_.push_back({ first, last });
+	const std::vector<Range> ranges = boundaries_.ranges();
+
+	if (ranges.empty()) {
+		boundaries_.assign({{ first, last }});
 	} else {
 
 		// find out what we have
-		const bool has_zero = (ranges_.front().start == first);
-		const bool has_end  = (ranges_.back().end    == last);
+		const bool has_zero = (ranges.front().start == first);
+		const bool has_end  = (ranges.back().end    == last);
 
 		std::vector<Range> newRanges;
-		newRanges.reserve(ranges_.size() + 1);
+		newRanges.reserve(ranges.size() + 1);
 
 		if(!has_zero) {
 			// existing ranges don't extend to the begining, so add an element for it
-			newRanges.push_back({ first, ranges_.front().start });
+			newRanges.push_back({ first, ranges.front().start });
 		}
 
 		// create an entry for all of the between current ranges
-		for(auto curr = ranges_.begin(); curr != ranges_.end(); ++curr) {
+		for(auto curr = ranges.begin(); curr != ranges.end(); ++curr) {
 			auto next = std::next(curr);
-			if(next != ranges_.end()) {
+			if(next != ranges.end()) {
 				newRanges.push_back({ curr->end, next->start});
 			}
 		}
 
 		if(!has_end) {
 			// existing ranges don't extend to the end, so add an element for it
-			newRanges.push_back({ ranges_.back().end, last });
+			newRanges.push_back({ ranges.back().end, last });
 		}
 
-		ranges_ = std::move(newRanges);
+		boundaries_.assign(newRanges);
 	}
 
 	RangesetRefreshRange(buffer_, first, last);
-	return ranges_.size();
+	return size();
 }
 
 /*
@@ -711,69 +445,12 @@ bool Rangeset::setMode(const QString &mode) {
 /*
 ** Find out whether the position pos is included in one of the ranges of
 ** rangeset. Returns the containing range's index if true, -1 otherwise.
-** Essentially the same as the RangesetFindRangeOfPos() function, but uses the
-** last_index member of the rangeset and weighted_at_or_before() for speedy
-** lookup in refresh tasks. The rangeset is assumed to be valid, as is the
-** position. We also don't allow checking of the endpoint.
+** Essentially the same as the RangesetFindRangeOfPos() function, but used in
+** refresh tasks, which don't allow checking of the endpoint.
 ** Returns the including range index, or -1 if not found.
 */
-int64_t Rangeset::RangesetCheckRangeOfPos(TextCursor pos) {
-
-	int64_t index;
-
-	int64_t len = ranges_.size();
-	if (ranges_.empty()) {
-		return -1; /* no ranges */
-	}
-
-	auto ranges = reinterpret_cast<TextCursor *>(ranges_.data()); /* { s1,e1, s2,e2, s3,e3,... } */
-	int64_t last = last_index_;
-
-	/* try to profit from the last lookup by using its index */
-	if (last >= len || last < 0) {
-		last = (len > 0) ? len - 1 : 0; /* make sure last is in range */
-		last_index_ = last;
-	}
-
-	len *= 2;
-	last *= 2;
-
-	if (pos >= ranges[last]) {    /* last even: this is a start */
-		if (pos < ranges[last + 1]) { /* checking an end here */
-			return last / 2;          /* no need to change rangeset->last_index */
-		} else {
-			last += 2; /* not in this range: move on */
-		}
-
-		if (last == len) {
-			return -1; /* moved on too far */
-		}
-
-		/* find the entry in the upper portion of ranges */
-		index = weighted_at_or_before(ranges, last, len, pos); /* search end only */
-	} else if (last > 0) {
-		index = weighted_at_or_before(ranges, 0, last, pos); /* search front only */
-	} else {
-		index = 0;
-	}
-
-	last_index_ = index / 2;
-
-	if (index == len) {
-		return -1; /* beyond end */
-	}
-
-	if (is_end(index)) {
-		if (pos < ranges[index]) {
-			return index / 2; /* return the range index */
-		}
-	} else {              /* index even: references start marker */
-		if (pos == ranges[index]) {
-			return index / 2; /* return the range index */
-		}
-	}
-
-	return -1; /* not in any range */
+int64_t Rangeset::RangesetCheckRangeOfPos(TextCursor pos) const {
+	return RangesetFindRangeOfPos(pos, /*incl_end=*/false);
 }
 
 /*
@@ -781,28 +458,31 @@ int64_t Rangeset::RangesetCheckRangeOfPos(TextCursor pos) {
 */
 int64_t Rangeset::RangesetAdd(const Rangeset &other) {
 
-	if (other.ranges_.empty()) {
+	if (other.boundaries_.empty()) {
 		// no ranges in plusSet - nothing to do
-		return ranges_.size();
+		return size();
 	}
 
-	if (ranges_.empty()) {
+	const std::vector<Range> ranges      = boundaries_.ranges();
+	const std::vector<Range> otherRanges = other.boundaries_.ranges();
+
+	if (ranges.empty()) {
 		// no ranges in destination: just copy the ranges from the other set
-		ranges_ = other.ranges_;
+		boundaries_ = other.boundaries_;
 
-		for(Range &range: ranges_) {
+		for(const Range &range: otherRanges) {
 			RangesetRefreshRange(buffer_, range.start, range.end);
 		}
 
-		return ranges_.size();
+		return size();
 	}
 
 
-	auto origRanges     = ranges_.cbegin();
-	size_t nOrigRanges = ranges_.size();
+	auto origRanges     = ranges.cbegin();
+	size_t nOrigRanges = ranges.size();
 
-	auto plusRanges     = other.ranges_.cbegin();
-	size_t nPlusRanges = other.ranges_.size();
+	auto plusRanges     = otherRanges.cbegin();
+	size_t nPlusRanges = otherRanges.size();
 
 	std::vector<Range> newRanges;
 	newRanges.reserve(nOrigRanges + nPlusRanges);
@@ -854,8 +534,8 @@ int64_t Rangeset::RangesetAdd(const Rangeset &other) {
 	}
 
 	/* finally, forget the old rangeset values, and reallocate the new ones */
-	ranges_ = std::move(newRanges);
-	return ranges_.size();
+	boundaries_.assign(newRanges);
+	return size();
 }
 
 /*
@@ -863,20 +543,23 @@ int64_t Rangeset::RangesetAdd(const Rangeset &other) {
 */
 int64_t Rangeset::RangesetRemove(const Rangeset &other) {
 
-	if (ranges_.empty() || other.ranges_.empty()) {
+	if (boundaries_.empty() || other.boundaries_.empty()) {
 		// no ranges in origSet or minusSet - nothing to do
 		return 0;
 	}
 
-	auto origRanges     = ranges_.begin();
-	size_t nOrigRanges  = ranges_.size();
+	std::vector<Range> ranges            = boundaries_.ranges();
+	const std::vector<Range> otherRanges = other.boundaries_.ranges();
 
-	auto minusRanges    = other.ranges_.cbegin();
-	size_t nMinusRanges = other.ranges_.size();
+	auto origRanges     = ranges.begin();
+	size_t nOrigRanges  = ranges.size();
+
+	auto minusRanges    = otherRanges.cbegin();
+	size_t nMinusRanges = otherRanges.size();
 
 	// we must provide more space: each range in minusSet might split a range in origSet
 	std::vector<Range> newRanges;
-	newRanges.reserve(ranges_.size() + other.ranges_.size());
+	newRanges.reserve(ranges.size() + otherRanges.size());
 
 	auto newRangeOut = std::back_inserter(newRanges);
 
@@ -906,7 +589,7 @@ int64_t Rangeset::RangesetRemove(const Rangeset &other) {
 					--nOrigRanges;
 				}
 			}
-		} while (nMinusRanges > 0 && minusRanges->end <= origRanges->start); /* any more non-overlaps */
+		} while (nOrigRanges > 0 && nMinusRanges > 0 && minusRanges->end <= origRanges->start); /* any more non-overlaps */
 
 		// when we get here either we're done, or we have overlap
 		if (nOrigRanges > 0) {
@@ -944,8 +627,8 @@ int64_t Rangeset::RangesetRemove(const Rangeset &other) {
 	}
 
 	// finally, forget the old rangeset values, and reallocate the new ones
-	ranges_ = std::move(newRanges);
-	return ranges_.size();
+	boundaries_.assign(newRanges);
+	return size();
 }
 
 /*
@@ -959,50 +642,28 @@ int64_t Rangeset::RangesetAdd(Range r) {
 		std::swap(r.start, r.end);
 	} else if (r.start == r.end) {
 		// no-op - empty range == no range
-		return ranges_.size();
-	}
-
-	// if it's the first range, just insert it
-	if(ranges_.empty()) {
-		ranges_.push_back(r);
-		RangesetRefreshRange(buffer_, r.start, r.end);
-		return ranges_.size();
+		return size();
 	}
 
-	auto next = std::lower_bound(ranges_.begin(), ranges_.end(), r);
-	if(next != ranges_.end()) {
-		auto prev = (next != ranges_.begin()) ? std::prev(next) : next;
+	/* the boundaries from i up to j are swallowed by the new range. It starts
+	   a range of its own unless r.start is inside (or touches the end of) an
+	   existing one, and likewise for r.end */
+	const int64_t i = boundaries_.lowerBound(r.start);
+	const int64_t j = boundaries_.upperBound(r.end);
 
-		if(r.start <= next->end && next->start <= r.end) {
-			// new range overlaps with one to its right
-			next->start = r.start;
+	std::vector<TextCursor> replacement;
+	if (is_start(i)) {
+		replacement.push_back(r.start);
+	}
 
-			if(prev->start <= next->end && next->start <= prev->end) {
-				// adjusted range now overlaps with one to its left
-				prev->end = next->end;
-				ranges_.erase(next);
-			}
-		} else if(prev->start <= r.end && r.start <= prev->end) {
-			// new range overlaps with the one to its left
-			prev->end = r.end;
-		} else {
-			// no overlap, just insert it in the right place
-			ranges_.insert(next, r);
-		}
-	} else {
-		auto prev = std::prev(ranges_.end());
-
-		if(prev->start <= r.end && r.start <= prev->end) {
-			// new range overlaps with the one to its left (last element)
-			prev->end = r.end;
-		} else {
-			// no overlap, just insert it at the end
-			ranges_.push_back(r);
-		}
+	if (is_start(j)) {
+		replacement.push_back(r.end);
 	}
 
+	boundaries_.replace(i, j, replacement, 0);
+
 	RangesetRefreshRange(buffer_, r.start, r.end);
-	return ranges_.size();
+	return size();
 }
 
 /*
@@ -1016,38 +677,28 @@ int64_t Rangeset::RangesetRemove(Range r) {
 		std::swap(r.start, r.end);
 	} else if (r.start == r.end) {
 		// no-op - empty range == no range
-		return ranges_.size();
+		return size();
 	}
 
-	if(ranges_.empty()) {
-		return ranges_.size();
-	}
+	/* the boundaries from i up to j are inside the removed range and go. A
+	   range running into r.start now ends there, and one running out of r.end
+	   now starts there */
+	const int64_t i = boundaries_.lowerBound(r.start);
+	const int64_t j = boundaries_.upperBound(r.end);
 
-	auto next = std::lower_bound(ranges_.begin(), ranges_.end(), r);
-	if(next != ranges_.end()) {
-		auto prev = (next != ranges_.begin()) ? std::prev(next) : next;
-
-		if(*next == r) {
-			// exact match
-			ranges_.erase(next);
-		} else if(r.start <= next->end && next->start <= r.end) {
-			// range overlaps with one to its right
-			next->start = r.end;
-		} else if(prev->start <= r.end && r.start <= prev->end) {
-			// range overlaps with the one to its left
-			prev->end = r.start;
-		}
-	} else {
-		auto prev = std::prev(ranges_.end());
+	std::vector<TextCursor> replacement;
+	if (is_end(i)) {
+		replacement.push_back(r.start);
+	}
 
-		if(prev->start <= r.end && r.start <= prev->end) {
-			// range overlaps with the one to its left (last element)
-			prev->end = r.start;
-		}
+	if (is_end(j)) {
+		replacement.push_back(r.end);
 	}
 
+	boundaries_.replace(i, j, replacement, 0);
+
 	RangesetRefreshRange(buffer_, r.start, r.end);
-	return ranges_.size();
+	return size();
 }
 
 /**
@@ -1088,7 +739,7 @@ RangesetInfo Rangeset::RangesetGetInfo() const {
 	RangesetInfo info;
 	info.defined = true;
 	info.label   = static_cast<int>(label_);
-	info.count   = ranges_.size();
+	info.count   = size();
 	info.color   = color_name_;
 	info.name    = name_;
 	info.mode    = update_name_;
@@ -1108,7 +759,7 @@ Rangeset::Rangeset(TextBuffer *buffer, uint8_t label) : buffer_(buffer), label_(
  * @brief Rangeset::~Rangeset
  */
 Rangeset::~Rangeset() noexcept {
-	for(const Range &range : ranges_) {
+	for(const Range &range : boundaries_.ranges()) {
 		RangesetRefreshRange(buffer_, range.start, range.end);
 	}
 }
@@ -2,6 +2,8 @@
 #ifndef RANGESET_H_
 #define RANGESET_H_
 
+#include "Range.h"
+#include "RangeBoundaries.h"
 #include "TextBufferFwd.h"
 #include "TextCursor.h"
 #include <QColor>
@@ -13,11 +15,6 @@ constexpr int N_RANGESETS = 63;
 
 class Rangeset;
 
-struct Range {
-	TextCursor start;
-	TextCursor end; /* range from [start-]end */
-};
-
 struct RangesetInfo {
 	bool        defined = false;
 	int         label   = 0;
@@ -52,7 +49,7 @@ public:
 	boost::optional<Range> RangesetSpan() const;
 
 public:
-	int64_t RangesetCheckRangeOfPos(TextCursor pos);
+	int64_t RangesetCheckRangeOfPos(TextCursor pos) const;
 	int64_t RangesetFindRangeOfPos(TextCursor pos, bool incl_end) const;
 
 public:
@@ -74,14 +71,13 @@ public:
 public:
 	TextBuffer *buffer_;
 	RangesetUpdateFn *update_;  // modification update function
-	std::vector<Range> ranges_; // the ranges table (sorted array of ranges)
+	RangeBoundaries boundaries_; // the starts and ends of the ranges, in order
 
 	QColor color_;              // the value of a particular color
 	QString color_name_;        // the name of an assigned color
 	QString name_;              // name of rangeset
 	QString update_name_;       // update function name
 
-	int64_t last_index_ = 0;    // a place to start looking
 	int8_t color_set_   = 0;    // 0: unset; 1: set; -1: invalid
 	uint8_t label_;             // a number 1-63
 };
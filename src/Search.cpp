@@ -25,6 +25,9 @@ namespace {
 // Maximum length of search string history
 constexpr int MAX_SEARCH_HISTORY = 100;
 
+// Text read past the search position at first by a regex search, doubled as needed
+constexpr int64_t REGEX_SEARCH_WINDOW = 0x10000;
+
 // History mechanism for search and replace strings
 Search::HistoryEntry SearchReplaceHistory[MAX_SEARCH_HISTORY];
 int NHist = 0;
@@ -60,9 +63,120 @@ std::string to_lower(view::string_view s) {
 	return str;
 }
 
+/*
+** Read-only character access to a contiguous string for the search routines
+** below.
+*/
+class StringText {
+public:
+	explicit StringText(view::string_view string) : string_(string) {
+	}
+
+public:
+	int64_t size() const noexcept                                 { return static_cast<int64_t>(string_.size()); }
+	char operator[](int64_t n) const noexcept                     { return string_[static_cast<size_t>(n)]; }
+	view::string_view range(int64_t start, int64_t end) const     { return string_.substr(static_cast<size_t>(start), static_cast<size_t>(end - start)); }
+
+private:
+	view::string_view string_;
+};
+
+/*
+** Read-only character access to a text buffer for the search routines below.
+** Literal searches read characters in place, so they never rearrange the
+** buffer and only touch the text between the start position and the match.
+** The regular expression engine needs contiguous text, range() provides that
+** for just the range it asks for, which is only valid until the next call.
+*/
+class BufferText {
+public:
+	explicit BufferText(TextBuffer *buffer) : buffer_(buffer) {
+	}
+
+public:
+	int64_t size() const noexcept                                 { return buffer_->BufGetLength(); }
+	char operator[](int64_t n) const noexcept                     { return buffer_->BufGetCharacter(TextCursor(n)); }
+	view::string_view range(int64_t start, int64_t end) const     { return buffer_->BufAsStringEx(TextCursor(start), TextCursor(end)); }
+
+private:
+	TextBuffer *buffer_;
+};
+
+/**
+ * @brief makeRegexResult
+ * @param compiledRE
+ * @param string
+ * @param offset
+ * @return
+ *
+ * The positions of the last match of "compiledRE" against "string", which
+ * starts at "offset" in the text that was searched
+ */
+Search::Result makeRegexResult(const Regex &compiledRE, view::string_view string, int64_t offset) {
+	Search::Result result;
+	result.start    = offset + (compiledRE.startp[0] - string.data());
+	result.end      = offset + (compiledRE.endp[0]   - string.data());
+	result.extentFW = offset + (compiledRE.extentpFW - string.data());
+	result.extentBW = offset + (compiledRE.extentpBW - string.data());
+	return result;
+}
+
 /**
- * @brief forwardRegexSearch
+ * @brief executeRegex
+ * @param compiledRE
+ * @param text
+ * @param beginPos
+ * @param endPos
+ * @param reverse
+ * @param delimiters
  * @param string
+ * @param offset
+ * @return
+ *
+ * Match "compiledRE" against "text" with the match starting in [beginPos,
+ * endPos], the leftmost one or with "reverse" the rightmost one. The text is
+ * read in windows around that range which start small and double for as
+ * long as the match looked past their edges, so a match close to the search
+ * position only reads the text near it. The window the match was found in is
+ * returned in "string", which starts at "offset" in the text.
+ */
+template <class Text>
+bool executeRegex(Regex &compiledRE, const Text &text, int64_t beginPos, int64_t endPos, bool reverse, const char *delimiters, view::string_view *string, int64_t *offset) {
+
+	const int64_t last = text.size();
+
+	for (int64_t window = REGEX_SEARCH_WINDOW;; window *= 2) {
+
+		/* Matches start in [from, to] within this window. No match looks
+		   further back than look_behind from where it starts, so the text
+		   before that isn't needed */
+		const int64_t from  = reverse ? std::max(endPos - window, beginPos) : beginPos;
+		const int64_t to    = reverse ? endPos : std::min(endPos, from + window);
+		const int64_t first = std::max<int64_t>(from - static_cast<int64_t>(compiledRE.look_behind), 0);
+		const int64_t end   = std::min(to + window, last);
+
+		*string = text.range(first, end);
+		*offset = first;
+
+		const bool found = compiledRE.execute(
+					*string,
+					static_cast<size_t>(from - first),
+					static_cast<size_t>(to - first),
+					(from == 0) ? -1 : text[from - 1],
+					(end == last) ? -1 : text[end],
+					delimiters,
+					reverse);
+
+		// more text wouldn't change the result
+		if ((found || (from == beginPos && to == endPos)) && (!compiledRE.hit_end || end == last)) {
+			return found;
+		}
+	}
+}
+
+/**
+ * @brief forwardRegexSearch
+ * @param text
  * @param searchString
  * @param wrap
  * @param beginPos
@@ -70,20 +184,18 @@ std::string to_lower(view::string_view s) {
  * @param defaultFlags
  * @return
  */
-boost::optional<Search::Result> forwardRegexSearch(view::string_view string, view::string_view searchString, WrapMode wrap, int64_t beginPos, const char *delimiters, int defaultFlags) {
+template <class Text>
+boost::optional<Search::Result> forwardRegexSearch(const Text &text, view::string_view searchString, WrapMode wrap, int64_t beginPos, const char *delimiters, int defaultFlags) {
 
 	try {
 		Regex compiledRE(searchString, defaultFlags);
 
+		view::string_view string;
+		int64_t offset;
+
 		// search from beginPos to end of string
-		if (compiledRE.execute(string, static_cast<size_t>(beginPos), delimiters, false)) {
-
-			Search::Result result;
-			result.start    = compiledRE.startp[0] - &string[0];
-			result.end      = compiledRE.endp[0]   - &string[0];
-			result.extentFW = compiledRE.extentpFW - &string[0];
-			result.extentBW = compiledRE.extentpBW - &string[0];
-			return result;
+		if (executeRegex(compiledRE, text, beginPos, text.size(), false, delimiters, &string, &offset)) {
+			return makeRegexResult(compiledRE, string, offset);
 		}
 
 		// if wrap turned off, we're done
@@ -92,14 +204,8 @@ boost::optional<Search::Result> forwardRegexSearch(view::string_view string, vie
 		}
 
 		// search from the beginning of the string to beginPos
-		if (compiledRE.execute(string, 0, static_cast<size_t>(beginPos), delimiters, false)) {
-
-			Search::Result result;
-			result.start    = compiledRE.startp[0] - &string[0];
-			result.end      = compiledRE.endp[0]   - &string[0];
-			result.extentFW = compiledRE.extentpFW - &string[0];
-			result.extentBW = compiledRE.extentpBW - &string[0];
-			return result;
+		if (executeRegex(compiledRE, text, 0, beginPos, false, delimiters, &string, &offset)) {
+			return makeRegexResult(compiledRE, string, offset);
 		}
 
 		return boost::none;
@@ -114,7 +220,7 @@ boost::optional<Search::Result> forwardRegexSearch(view::string_view string, vie
 
 /**
  * @brief backwardRegexSearch
- * @param string
+ * @param text
  * @param searchString
  * @param wrap
  * @param beginPos
@@ -122,22 +228,20 @@ boost::optional<Search::Result> forwardRegexSearch(view::string_view string, vie
  * @param defaultFlags
  * @return
  */
-boost::optional<Search::Result> backwardRegexSearch(view::string_view string, view::string_view searchString, WrapMode wrap, int64_t beginPos, const char *delimiters, int defaultFlags) {
+template <class Text>
+boost::optional<Search::Result> backwardRegexSearch(const Text &text, view::string_view searchString, WrapMode wrap, int64_t beginPos, const char *delimiters, int defaultFlags) {
 
 	try {
 		Regex compiledRE(searchString, defaultFlags);
 
+		view::string_view string;
+		int64_t offset;
+
 		// search from beginPos to start of file.  A negative begin pos
 		// says begin searching from the far end of the file.
 		if (beginPos >= 0) {
-			if (compiledRE.execute(string, 0, static_cast<size_t>(beginPos), -1, -1, delimiters, true)) {
-
-				Search::Result result;
-				result.start    = compiledRE.startp[0] - &string[0];
-				result.end      = compiledRE.endp[0]   - &string[0];
-				result.extentFW = compiledRE.extentpFW - &string[0];
-				result.extentBW = compiledRE.extentpBW - &string[0];
-				return result;
+			if (executeRegex(compiledRE, text, 0, beginPos, true, delimiters, &string, &offset)) {
+				return makeRegexResult(compiledRE, string, offset);
 			}
 		}
 
@@ -151,13 +255,8 @@ boost::optional<Search::Result> backwardRegexSearch(view::string_view string, vi
 			beginPos = 0;
 		}
 
-		if (compiledRE.execute(string, static_cast<size_t>(beginPos), delimiters, true)) {
-			Search::Result result;
-			result.start    = compiledRE.startp[0] - &string[0];
-			result.end      = compiledRE.endp[0]   - &string[0];
-			result.extentFW = compiledRE.extentpFW - &string[0];
-			result.extentBW = compiledRE.extentpBW - &string[0];
-			return result;
+		if (executeRegex(compiledRE, text, beginPos, text.size(), true, delimiters, &string, &offset)) {
+			return makeRegexResult(compiledRE, string, offset);
 		}
 
 		return boost::none;
@@ -172,7 +271,7 @@ boost::optional<Search::Result> backwardRegexSearch(view::string_view string, vi
 
 /**
  * @brief searchRegex
- * @param string
+ * @param text
  * @param searchString
  * @param direction
  * @param wrap
@@ -181,13 +280,14 @@ boost::optional<Search::Result> backwardRegexSearch(view::string_view string, vi
  * @param defaultFlags
  * @return
  */
-boost::optional<Search::Result> searchRegex(view::string_view string, view::string_view searchString, Direction direction, WrapMode wrap, int64_t beginPos, const char *delimiters, int defaultFlags) {
+template <class Text>
+boost::optional<Search::Result> searchRegex(const Text &text, view::string_view searchString, Direction direction, WrapMode wrap, int64_t beginPos, const char *delimiters, int defaultFlags) {
 
 	switch(direction) {
 	case Direction::Forward:
-		return forwardRegexSearch(string, searchString, wrap, beginPos, delimiters, defaultFlags);
+		return forwardRegexSearch(text, searchString, wrap, beginPos, delimiters, defaultFlags);
 	case Direction::Backward:
-		return backwardRegexSearch(string, searchString, wrap, beginPos, delimiters, defaultFlags);
+		return backwardRegexSearch(text, searchString, wrap, beginPos, delimiters, defaultFlags);
 	}
 
 	Q_UNREACHABLE();
@@ -195,7 +295,7 @@ boost::optional<Search::Result> searchRegex(view::string_view string, view::stri
 
 /**
  * @brief searchLiteral
- * @param string
+ * @param text
  * @param searchString
  * @param caseSensitivity
  * @param direction
@@ -203,7 +303,8 @@ boost::optional<Search::Result> searchRegex(view::string_view string, view::stri
  * @param beginPos
  * @return
  */
-boost::optional<Search::Result> searchLiteral(view::string_view string, view::string_view searchString, Direction direction, WrapMode wrap, int64_t beginPos, Qt::CaseSensitivity caseSensitivity) {
+template <class Text>
+boost::optional<Search::Result> searchLiteral(const Text &text, view::string_view searchString, Direction direction, WrapMode wrap, int64_t beginPos, Qt::CaseSensitivity caseSensitivity) {
 
 	if(searchString.empty()) {
 		return boost::none;
@@ -220,27 +321,27 @@ boost::optional<Search::Result> searchLiteral(view::string_view string, view::st
 		lcString = to_lower(searchString);
 	}
 
-	const auto first = string.begin();
-	const auto mid   = first + beginPos;
-	const auto last  = string.end();
+	const int64_t mid  = beginPos;
+	const int64_t last = text.size();
 
-	auto do_search = [&](view::string_view::iterator it) -> boost::optional<Search::Result> {
-		if (*it == ucString[0] || *it == lcString[0]) {
+	auto do_search = [&](int64_t pos) -> boost::optional<Search::Result> {
+		const char ch = text[pos];
+		if (ch == ucString[0] || ch == lcString[0]) {
 			// matched first character
-			auto ucPtr   = ucString.begin();
-			auto lcPtr   = lcString.begin();
-			auto tempPtr = it;
+			auto ucPtr     = ucString.begin();
+			auto lcPtr     = lcString.begin();
+			int64_t tempPos = pos;
 
-			while (tempPtr != last && (*tempPtr == *ucPtr || *tempPtr == *lcPtr)) {
-				++tempPtr;
+			while (tempPos != last && (text[tempPos] == *ucPtr || text[tempPos] == *lcPtr)) {
+				++tempPos;
 				++ucPtr;
 				++lcPtr;
 
 				if (ucPtr == ucString.end()) {
 					// matched whole string
 					Search::Result result;
-					result.start    = it - string.begin();
-					result.end      = tempPtr - string.begin();
+					result.start    = pos;
+					result.end      = tempPos;
 					result.extentBW = result.start;
 					result.extentFW = result.end;
 					return result;
@@ -254,8 +355,8 @@ boost::optional<Search::Result> searchLiteral(view::string_view string, view::st
 	if (direction == Direction::Forward) {
 
 		// search from beginPos to end of string
-		for (auto it = mid; it != last; ++it) {
-			if(boost::optional<Search::Result> result = do_search(it)) {
+		for (int64_t pos = std::max<int64_t>(mid, 0); pos < last; ++pos) {
+			if(boost::optional<Search::Result> result = do_search(pos)) {
 				return result;
 			}
 		}
@@ -265,8 +366,8 @@ boost::optional<Search::Result> searchLiteral(view::string_view string, view::st
 		}
 
 		// search from start of file to beginPos
-		for (auto it = first; it != mid; ++it) {
-			if(boost::optional<Search::Result> result = do_search(it)) {
+		for (int64_t pos = 0; pos < mid; ++pos) {
+			if(boost::optional<Search::Result> result = do_search(pos)) {
 				return result;
 			}
 		}
@@ -278,8 +379,8 @@ boost::optional<Search::Result> searchLiteral(view::string_view string, view::st
 		// says begin searching from the far end of the file
 
 		if (beginPos >= 0) {
-			for (auto it = mid; it >= first; --it) {
-				if(boost::optional<Search::Result> result = do_search(it)) {
+			for (int64_t pos = std::min(mid, last - 1); pos >= 0; --pos) {
+				if(boost::optional<Search::Result> result = do_search(pos)) {
 					return result;
 				}
 			}
@@ -290,8 +391,8 @@ boost::optional<Search::Result> searchLiteral(view::string_view string, view::st
 		}
 
 		// search from end of file to beginPos
-		for (auto it = last; it >= mid; --it) {
-			if(boost::optional<Search::Result> result = do_search(it)) {
+		for (int64_t pos = last - 1; pos >= std::max<int64_t>(mid, 0); --pos) {
+			if(boost::optional<Search::Result> result = do_search(pos)) {
 				return result;
 			}
 		}
@@ -314,7 +415,8 @@ boost::optional<Search::Result> searchLiteral(view::string_view string, view::st
 **  will suffice in that case.
 **
 */
-boost::optional<Search::Result> searchLiteralWord(view::string_view string, view::string_view searchString, Direction direction, WrapMode wrap, int64_t beginPos, const char *delimiters, Qt::CaseSensitivity caseSensitivity) {
+template <class Text>
+boost::optional<Search::Result> searchLiteralWord(const Text &text, view::string_view searchString, Direction direction, WrapMode wrap, int64_t beginPos, const char *delimiters, Qt::CaseSensitivity caseSensitivity) {
 
 	if(searchString.empty()) {
 		return boost::none;
@@ -325,31 +427,34 @@ boost::optional<Search::Result> searchLiteralWord(view::string_view string, view
 	bool cignore_L = false;
 	bool cignore_R = false;
 
-	const auto first = string.begin();
-	const auto mid   = first + beginPos;
-	const auto last  = string.end();
+	const int64_t mid  = beginPos;
+	const int64_t last = text.size();
+
+	auto is_delimiter = [&](char ch) {
+		return safe_ctype<isspace>(ch) || ::strchr(delimiters, ch);
+	};
 
-	auto do_search_word = [&](const view::string_view::iterator it) -> boost::optional<Search::Result> {
-		if (*it == ucString[0] || *it == lcString[0]) {
+	auto do_search_word = [&](int64_t pos) -> boost::optional<Search::Result> {
+		const char ch = text[pos];
+		if (ch == ucString[0] || ch == lcString[0]) {
 
 			// matched first character
-			auto ucPtr   = ucString.begin();
-			auto lcPtr   = lcString.begin();
-			auto tempPtr = it;
+			auto ucPtr     = ucString.begin();
+			auto lcPtr     = lcString.begin();
+			int64_t tempPos = pos;
 
-			while (tempPtr != last && (*tempPtr == *ucPtr || *tempPtr == *lcPtr)) {
-				++tempPtr;
+			while (tempPos != last && (text[tempPos] == *ucPtr || text[tempPos] == *lcPtr)) {
+				++tempPos;
 				++ucPtr;
 				++lcPtr;
 
-				if (ucPtr == ucString.end() &&                                                         // matched whole string
-					(cignore_R || safe_ctype<isspace>(*tempPtr) || ::strchr(delimiters, *tempPtr)) &&  // next char right delimits word ?
-					(cignore_L || it == string.begin() ||                                              // border case
-					 safe_ctype<isspace>(it[-1]) || ::strchr(delimiters, it[-1]))) {                   // next char left delimits word ?
+				if (ucPtr == ucString.end() &&                                  // matched whole string
+					(cignore_R || tempPos == last || is_delimiter(text[tempPos])) && // next char right delimits word ?
+					(cignore_L || pos == 0 || is_delimiter(text[pos - 1]))) {        // next char left delimits word ?
 
 					Search::Result result;
-					result.start    = it - string.begin();
-					result.end      = tempPtr - string.begin();
+					result.start    = pos;
+					result.end      = tempPos;
 					result.extentBW = result.start;
 					result.extentFW = result.end;
 					return result;
@@ -372,11 +477,11 @@ boost::optional<Search::Result> searchLiteralWord(view::string_view string, view
 		delimiters = delimiterString.data();
 	}
 
-	if (safe_ctype<isspace>(searchString.front()) || ::strchr(delimiters, searchString.front())) {
+	if (is_delimiter(searchString.front())) {
 		cignore_L = true;
 	}
 
-	if (safe_ctype<isspace>(searchString.back()) || ::strchr(delimiters, searchString.back())) {
+	if (is_delimiter(searchString.back())) {
 		cignore_R = true;
 	}
 
@@ -391,8 +496,8 @@ boost::optional<Search::Result> searchLiteralWord(view::string_view string, view
 	if (direction == Direction::Forward) {
 
 		// search from beginPos to end of string
-		for (auto it = mid; it != last; ++it) {
-			if(boost::optional<Search::Result> result = do_search_word(it)) {
+		for (int64_t pos = std::max<int64_t>(mid, 0); pos < last; ++pos) {
+			if(boost::optional<Search::Result> result = do_search_word(pos)) {
 				return result;
 			}
 		}
@@ -402,8 +507,8 @@ boost::optional<Search::Result> searchLiteralWord(view::string_view string, view
 		}
 
 		// search from start of file to beginPos
-		for (auto it = first; it != mid; ++it) {
-			if(boost::optional<Search::Result> result = do_search_word(it)) {
+		for (int64_t pos = 0; pos < mid; ++pos) {
+			if(boost::optional<Search::Result> result = do_search_word(pos)) {
 				return result;
 			}
 		}
@@ -414,8 +519,8 @@ boost::optional<Search::Result> searchLiteralWord(view::string_view string, view
 		// says begin searching from the far end of the file
 
 		if (beginPos >= 0) {
-			for (auto it = mid; it >= first; --it) {
-				if(boost::optional<Search::Result> result = do_search_word(it)) {
+			for (int64_t pos = std::min(mid, last - 1); pos >= 0; --pos) {
+				if(boost::optional<Search::Result> result = do_search_word(pos)) {
 					return result;
 				}
 			}
@@ -426,8 +531,8 @@ boost::optional<Search::Result> searchLiteralWord(view::string_view string, view
 		}
 
 		// search from end of file to beginPos
-		for (auto it = last; it >= mid; --it) {
-			if(boost::optional<Search::Result> result = do_search_word(it)) {
+		for (int64_t pos = last - 1; pos >= std::max<int64_t>(mid, 0); --pos) {
+			if(boost::optional<Search::Result> result = do_search_word(pos)) {
 				return result;
 			}
 		}
@@ -436,25 +541,26 @@ boost::optional<Search::Result> searchLiteralWord(view::string_view string, view
 }
 
 /*
-** Search the string "string" for "searchString", beginning at "beginPos".
+** Search the text "text" for "searchString", beginning at "beginPos".
 ** "delimiters" may be used to provide an alternative set of word delimiters
 ** for regular expression "<" and ">" characters, or simply passed as nullptr
 ** for the default delimiter set.
 */
-boost::optional<Search::Result> SearchStringEx(view::string_view string, view::string_view searchString, Direction direction, SearchType searchType, WrapMode wrap, int64_t beginPos, const char *delimiters) {
+template <class Text>
+boost::optional<Search::Result> SearchStringEx(const Text &text, view::string_view searchString, Direction direction, SearchType searchType, WrapMode wrap, int64_t beginPos, const char *delimiters) {
 	switch (searchType) {
 	case SearchType::CaseSenseWord:
-		return searchLiteralWord(string, searchString, direction, wrap, beginPos, delimiters, Qt::CaseSensitive);
+		return searchLiteralWord(text, searchString, direction, wrap, beginPos, delimiters, Qt::CaseSensitive);
 	case SearchType::LiteralWord:
-		return searchLiteralWord(string, searchString, direction, wrap, beginPos, delimiters, Qt::CaseInsensitive);
+		return searchLiteralWord(text, searchString, direction, wrap, beginPos, delimiters, Qt::CaseInsensitive);
 	case SearchType::CaseSense:
-		return searchLiteral(string, searchString, direction, wrap, beginPos, Qt::CaseSensitive);
+		return searchLiteral(text, searchString, direction, wrap, beginPos, Qt::CaseSensitive);
 	case SearchType::Literal:
-		return searchLiteral(string, searchString, direction, wrap, beginPos, Qt::CaseInsensitive);
+		return searchLiteral(text, searchString, direction, wrap, beginPos, Qt::CaseInsensitive);
 	case SearchType::Regex:
-		return searchRegex(string, searchString, direction, wrap, beginPos, delimiters, REDFLT_STANDARD);
+		return searchRegex(text, searchString, direction, wrap, beginPos, delimiters, REDFLT_STANDARD);
 	case SearchType::RegexNoCase:
-		return searchRegex(string, searchString, direction, wrap, beginPos, delimiters, REDFLT_CASE_INSENSITIVE);
+		return searchRegex(text, searchString, direction, wrap, beginPos, delimiters, REDFLT_CASE_INSENSITIVE);
 	}
 
 	Q_UNREACHABLE();
@@ -480,142 +586,115 @@ bool replaceUsingRegex(view::string_view searchStr, view::string_view replaceStr
 	}
 }
 
+/*
+** Like the above, but for the match the search found at "beginPos" in "text",
+** reading only as much of the text as the match needs
+*/
+template <class Text>
+bool replaceUsingRegex(view::string_view searchStr, view::string_view replaceStr, const Text &text, int64_t beginPos, std::string &dest, const char *delimiters, int defaultFlags) {
+	try {
+		Regex compiledRE(searchStr, defaultFlags);
+
+		view::string_view string;
+		int64_t offset;
+		executeRegex(compiledRE, text, beginPos, text.size(), false, delimiters, &string, &offset);
+		return compiledRE.SubstituteRE(replaceStr, dest);
+	} catch(const RegexError &e) {
+		Q_UNUSED(e);
+		return false;
+	}
 }
 
 /*
-** Replace all occurences of "searchString" in "inString" with "replaceString"
+** Replace all occurences of "searchString" in "text" with "replaceString"
 ** and return a string covering the range between the start of the
 ** first replacement (returned in "copyStart", and the end of the last
 ** replacement (returned in "copyEnd")
 */
-boost::optional<std::string> Search::ReplaceAllInString(view::string_view inString, const QString &searchString, const QString &replaceString, SearchType searchType, int64_t *copyStart, int64_t *copyEnd, const QString &delimiters) {
-
-	Result searchResult;
-	int64_t lastEndPos;
+template <class Text>
+boost::optional<std::string> replaceAll(const Text &text, const QString &searchString, const QString &replaceString, SearchType searchType, int64_t *copyStart, int64_t *copyEnd, const QString &delimiters) {
 
 	// reject empty string
 	if (searchString.isNull()) {
 		return boost::none;
 	}
 
-	/* rehearse the search first to determine the size of the buffer needed
-	   to hold the substituted text.  No substitution done here yet */
-	bool found       = true;
-	int replaceLen   = replaceString.size();
-	int nFound       = 0;
-	int removeLen    = 0;
-	int addLen       = 0;
-	int64_t beginPos = 0;
-
-	*copyStart = -1;
-
-	while (found) {
-		found = SearchString(
-					inString,
-					searchString,
-					Direction::Forward,
-					searchType,
-					WrapMode::NoWrap,
-					beginPos,
-					&searchResult,
-					delimiters);
-
-		if (found) {
-			if (*copyStart < 0) {
-				*copyStart = searchResult.start;
-			}
+	const std::string searchStr      = searchString.toStdString();
+	const std::string replaceStr     = replaceString.toStdString();
+	const QByteArray delimiterString = delimiters.toLatin1();
+	const char *delims               = delimiters.isNull() ? nullptr : delimiterString.data();
 
-			*copyEnd = searchResult.end;
-			// start next after match unless match was empty, then endPos+1
-			beginPos = (searchResult.start == searchResult.end) ? searchResult.end + 1 : searchResult.end;
-			++nFound;
-			removeLen += searchResult.end - searchResult.start;
-			if (isRegexType(searchType)) {
-				std::string replaceResult;
-
-				replaceUsingRE(
-				            searchString,
-				            replaceString,
-				            inString.substr(static_cast<size_t>(searchResult.extentBW)),
-				            searchResult.start - searchResult.extentBW,
-				            replaceResult,
-				            searchResult.start == 0 ? -1 : inString[static_cast<size_t>(searchResult.start) - 1],
-				            delimiters,
-				            defaultRegexFlags(searchType));
-
-				addLen += replaceResult.size();
-			} else {
-				addLen += replaceLen;
-			}
+	const int64_t last = text.size();
 
-			if (searchResult.end == gsl::narrow<int64_t>(inString.size())) {
-				break;
-			}
+	/* Substitute the replace string for each match as it is found, copying
+	   the text between the matches over to the new string */
+	std::string outString;
+	int64_t beginPos   = 0;
+	int64_t lastEndPos = -1;
+
+	while (boost::optional<Search::Result> searchResult = SearchStringEx(text, searchStr, Direction::Forward, searchType, WrapMode::NoWrap, beginPos, delims)) {
+
+		if (lastEndPos < 0) {
+			*copyStart = searchResult->start;
+		} else {
+			const view::string_view between = text.range(lastEndPos, searchResult->start);
+			outString.append(between.data(), between.size());
+		}
+
+		if (Search::isRegexType(searchType)) {
+			std::string replaceResult;
+
+			replaceUsingRegex(
+						searchStr,
+						replaceStr,
+						text,
+						searchResult->start,
+						replaceResult,
+						delims,
+						Search::defaultRegexFlags(searchType));
+
+			outString.append(replaceResult);
+		} else {
+			outString.append(replaceStr);
+		}
+
+		lastEndPos = searchResult->end;
+		*copyEnd   = searchResult->end;
+
+		// start next after match unless match was empty, then endPos+1
+		beginPos = (searchResult->start == searchResult->end) ? searchResult->end + 1 : searchResult->end;
+		if (searchResult->end == last) {
+			break;
 		}
 	}
 
-	if (nFound == 0) {
+	if (lastEndPos < 0) {
 		return boost::none;
 	}
 
-	const int64_t copyLen = *copyEnd - *copyStart;
+	return outString;
+}
 
-	std::string outString;
-	outString.reserve(static_cast<size_t>(copyLen - removeLen + addLen));
-
-	/* Scan through the text buffer again, substituting the replace string
-	   and copying the part between replaced text to the new buffer  */
-	found      = true;
-	beginPos   = {};
-	lastEndPos = {};
-
-	while (found) {
-		found = SearchString(
-					inString,
-					searchString,
-					Direction::Forward,
-					searchType,
-					WrapMode::NoWrap,
-					beginPos,
-					&searchResult,
-					delimiters);
-
-		if (found) {
-			if (beginPos != 0) {
-				outString.append(
-							&inString[static_cast<size_t>(lastEndPos)],
-							&inString[static_cast<size_t>(lastEndPos + (searchResult.start - lastEndPos))]);
-			}
+}
 
-			if (isRegexType(searchType)) {
-				std::string replaceResult;
-
-				replaceUsingRE(
-				            searchString,
-				            replaceString,
-				            inString.substr(static_cast<size_t>(searchResult.extentBW)),
-				            searchResult.start - searchResult.extentBW,
-				            replaceResult,
-				            searchResult.start == 0 ? -1 : inString[static_cast<size_t>(searchResult.start) - 1],
-				            delimiters,
-				            defaultRegexFlags(searchType));
-
-				outString.append(replaceResult);
-			} else {
-				outString.append(replaceString.toStdString());
-			}
+/*
+** Replace all occurences of "searchString" in "inString" with "replaceString"
+** and return a string covering the range between the start of the
+** first replacement (returned in "copyStart", and the end of the last
+** replacement (returned in "copyEnd")
+*/
+boost::optional<std::string> Search::ReplaceAllInString(view::string_view inString, const QString &searchString, const QString &replaceString, SearchType searchType, int64_t *copyStart, int64_t *copyEnd, const QString &delimiters) {
+	return replaceAll(StringText(inString), searchString, replaceString, searchType, copyStart, copyEnd, delimiters);
+}
 
-			lastEndPos = searchResult.end;
+/*
+** Like the string version, but searches the buffer in place
+*/
+boost::optional<std::string> Search::ReplaceAllInString(TextBuffer *buffer, const QString &searchString, const QString &replaceString, SearchType searchType, int64_t *copyStart, int64_t *copyEnd, const QString &delimiters) {
 
-			// start next after match unless match was empty, then endPos+1
-			beginPos = (searchResult.start == searchResult.end) ? searchResult.end + 1 : searchResult.end;
-			if (searchResult.end == gsl::narrow<int64_t>(inString.size())) {
-				break;
-			}
-		}
-	}
+	assert(buffer);
 
-	return outString;
+	return replaceAll(BufferText(buffer), searchString, replaceString, searchType, copyStart, copyEnd, delimiters);
 }
 
 /**
@@ -634,7 +713,7 @@ bool Search::SearchString(view::string_view string, const QString &searchString,
 
 	assert(result);
 
-	if(boost::optional<Search::Result> r = SearchStringEx(string, searchString.toStdString(), direction, searchType, wrap, beginPos, delimiters.isNull() ? nullptr : delimiters.toLatin1().data())) {
+	if(boost::optional<Search::Result> r = SearchStringEx(StringText(string), searchString.toStdString(), direction, searchType, wrap, beginPos, delimiters.isNull() ? nullptr : delimiters.toLatin1().data())) {
 		*result = *r;
 		return true;
 	}
@@ -643,6 +722,34 @@ bool Search::SearchString(view::string_view string, const QString &searchString,
 
 }
 
+/**
+ * @brief Search::SearchString
+ * @param buffer
+ * @param searchString
+ * @param direction
+ * @param searchType
+ * @param wrap
+ * @param beginPos
+ * @param result
+ * @param delimiters
+ * @return
+ *
+ * Like the string version, but searches the buffer in place. Literal searches
+ * never compact the buffer and only examine the text up to the match.
+ */
+bool Search::SearchString(TextBuffer *buffer, const QString &searchString, Direction direction, SearchType searchType, WrapMode wrap, int64_t beginPos, Result *result, const QString &delimiters) {
+
+	assert(buffer);
+	assert(result);
+
+	if(boost::optional<Search::Result> r = SearchStringEx(BufferText(buffer), searchString.toStdString(), direction, searchType, wrap, beginPos, delimiters.isNull() ? nullptr : delimiters.toLatin1().data())) {
+		*result = *r;
+		return true;
+	}
+
+	return false;
+}
+
 bool Search::replaceUsingRE(const QString &searchStr, const QString &replaceStr, view::string_view sourceStr, int64_t beginPos, std::string &dest, int prevChar, const QString &delimiters, int defaultFlags) {
 	return replaceUsingRegex(
 				searchStr.toStdString(),
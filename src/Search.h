@@ -4,6 +4,7 @@
 
 #include "Direction.h"
 #include "SearchType.h"
+#include "TextBufferFwd.h"
 #include "WrapMode.h"
 #include "Util/string_view.h"
 
@@ -31,9 +32,11 @@ namespace Search {
 
 	bool isRegexType(SearchType searchType);
 	bool replaceUsingRE(const QString &searchStr, const QString &replaceStr, view::string_view sourceStr, int64_t beginPos, std::string &dest, int prevChar, const QString &delimiters, int defaultFlags);
+	bool SearchString(TextBuffer *buffer, const QString &searchString, Direction direction, SearchType searchType, WrapMode wrap, int64_t beginPos, Result *result, const QString &delimiters);
 	bool SearchString(view::string_view string, const QString &searchString, Direction direction, SearchType searchType, WrapMode wrap, int64_t beginPos, Result *result, const QString &delimiters);
 	int defaultRegexFlags(SearchType searchType);
 	int historyIndex(int nCycles);
+	boost::optional<std::string> ReplaceAllInString(TextBuffer *buffer, const QString &searchString, const QString &replaceString, SearchType searchType, int64_t *copyStart, int64_t *copyEnd, const QString &delimiters);
 	boost::optional<std::string> ReplaceAllInString(view::string_view inString, const QString &searchString, const QString &replaceString, SearchType searchType, int64_t *copyStart, int64_t *copyEnd, const QString &delimiters);
 	void saveSearchHistory(const QString &searchString, QString replaceString, SearchType searchType, bool isIncremental);
 	HistoryEntry *HistoryByIndex(int index);
@@ -0,0 +1,385 @@
+
+#include "StyleBuffer.h"
+
+#include <QtGlobal>
+
+#include <algorithm>
+
+namespace {
+
+// the longest run a Run can hold, longer ones are split
+constexpr int64_t MaxRunLength = (1 << 24) - 1;
+
+/* how many runs a chunk is given when the runs are split up, a chunk can
+   grow to twice that before being split again */
+constexpr size_t ChunkRuns    = 512;
+constexpr size_t MaxChunkRuns = 2 * ChunkRuns;
+
+// chunks left with fewer runs than this are merged with the next one
+constexpr size_t MinChunkRuns = ChunkRuns / 8;
+
+}
+
+/**
+ * @brief StyleBuffer::length
+ * @return the number of characters the buffer has styles for
+ */
+int64_t StyleBuffer::length() const noexcept {
+	return length_;
+}
+
+/**
+ * @brief StyleBuffer::at
+ * @param pos
+ * @return the style of the character at "pos", or '\0' if "pos" is outside of
+ * the buffer
+ */
+char StyleBuffer::at(TextCursor pos) const {
+
+	if (pos < 0 || pos >= length_) {
+		return '\0';
+	}
+
+	seek(pos);
+	return static_cast<char>(chunks_[cacheChunk_].runs[cacheRun_].style);
+}
+
+/**
+ * @brief StyleBuffer::runEnd
+ * @param pos
+ * @return the end of the run of characters with the same style as the one at
+ * "pos". The next character may still have the same style (runs are split
+ * up where chunks meet), but every character before the returned position
+ * does.
+ */
+TextCursor StyleBuffer::runEnd(TextCursor pos) const {
+
+	if (pos < 0 || pos >= length_) {
+		return pos + 1;
+	}
+
+	seek(pos);
+	return cacheRunStart_ + chunks_[cacheChunk_].runs[cacheRun_].length;
+}
+
+/**
+ * @brief StyleBuffer::range
+ * @param start
+ * @param end
+ * @return the styles of the characters from "start" up to "end"
+ */
+std::string StyleBuffer::range(TextCursor start, TextCursor end) const {
+
+	start = qBound(TextCursor(), start, TextCursor(length_));
+	end   = qBound(TextCursor(), end,   TextCursor(length_));
+
+	std::string styles;
+	if (start >= end) {
+		return styles;
+	}
+
+	styles.reserve(static_cast<size_t>(end - start));
+
+	seek(start);
+	size_t chunk   = cacheChunk_;
+	size_t run     = cacheRun_;
+	TextCursor pos = cacheRunStart_;
+
+	while (pos < end) {
+		const Run &r = chunks_[chunk].runs[run];
+		const TextCursor next = pos + r.length;
+
+		styles.append(static_cast<size_t>(std::min(next, end) - std::max(pos, start)), static_cast<char>(r.style));
+		pos = next;
+
+		if (++run == chunks_[chunk].runs.size()) {
+			++chunk;
+			run = 0;
+		}
+	}
+
+	return styles;
+}
+
+/**
+ * @brief StyleBuffer::replace
+ * @param start
+ * @param end
+ * @param styles
+ *
+ * Replace the styles from "start" up to "end" with "styles". The changed
+ * range is left as it is, callers mark what they changed themselves.
+ */
+void StyleBuffer::replace(TextCursor start, TextCursor end, view::string_view styles) {
+
+	std::vector<Run> runs;
+
+	auto it = styles.begin();
+	while (it != styles.end()) {
+		auto next = std::find_if(it, styles.end(), [style = *it](char ch) { return ch != style; });
+		appendRun(runs, *it, next - it);
+		it = next;
+	}
+
+	splice(start, end, runs);
+}
+
+/**
+ * @brief StyleBuffer::replace
+ * @param start
+ * @param end
+ * @param style
+ * @param count
+ *
+ * Replace the styles from "start" up to "end" with "count" characters of
+ * "style"
+ */
+void StyleBuffer::replace(TextCursor start, TextCursor end, char style, int64_t count) {
+
+	std::vector<Run> runs;
+	appendRun(runs, style, count);
+	splice(start, end, runs);
+}
+
+/**
+ * @brief StyleBuffer::remove
+ * @param start
+ * @param end
+ */
+void StyleBuffer::remove(TextCursor start, TextCursor end) {
+	splice(start, end, {});
+}
+
+/**
+ * @brief StyleBuffer::setAll
+ * @param styles
+ */
+void StyleBuffer::setAll(view::string_view styles) {
+
+	chunks_.clear();
+	length_ = 0;
+	clearChanged();
+
+	replace(TextCursor(), TextCursor(), styles);
+}
+
+/**
+ * @brief StyleBuffer::changed
+ * @return true if there are style changes which haven't been redrawn yet
+ */
+bool StyleBuffer::changed() const noexcept {
+	return changed_;
+}
+
+/**
+ * @brief StyleBuffer::changedStart
+ * @return
+ */
+TextCursor StyleBuffer::changedStart() const noexcept {
+	return changedStart_;
+}
+
+/**
+ * @brief StyleBuffer::changedEnd
+ * @return
+ */
+TextCursor StyleBuffer::changedEnd() const noexcept {
+	return changedEnd_;
+}
+
+/**
+ * @brief StyleBuffer::clearChanged
+ */
+void StyleBuffer::clearChanged() noexcept {
+	changed_ = false;
+}
+
+/**
+ * @brief StyleBuffer::markChanged
+ * @param start
+ * @param end
+ *
+ * Set the range of styles which need redrawing, an empty range marks nothing
+ */
+void StyleBuffer::markChanged(TextCursor start, TextCursor end) noexcept {
+	changed_      = (start != end);
+	changedStart_ = std::min(start, end);
+	changedEnd_   = std::max(start, end);
+}
+
+/**
+ * @brief StyleBuffer::appendRun
+ * @param runs
+ * @param style
+ * @param length
+ *
+ * Add "length" characters of "style" to the end of "runs", extending the
+ * last run if it has the same style
+ */
+void StyleBuffer::appendRun(std::vector<Run> &runs, char style, int64_t length) {
+
+	const auto code = static_cast<uint8_t>(style);
+
+	if (length > 0 && !runs.empty() && runs.back().style == code) {
+		const int64_t n = std::min<int64_t>(length, MaxRunLength - runs.back().length);
+		runs.back().length += static_cast<uint32_t>(n);
+		length -= n;
+	}
+
+	while (length > 0) {
+		const int64_t n = std::min(length, MaxRunLength);
+		runs.push_back(Run{static_cast<uint32_t>(n), code});
+		length -= n;
+	}
+}
+
+/**
+ * @brief StyleBuffer::seek
+ * @param pos
+ *
+ * Move the cached lookup position to the run holding "pos", which must be in
+ * the buffer
+ */
+void StyleBuffer::seek(TextCursor pos) const {
+
+	// a long way back is quicker to find from the beginning
+	if (pos < cacheChunkStart_ && pos < cacheChunkStart_ - pos) {
+		cacheChunk_      = 0;
+		cacheRun_        = 0;
+		cacheChunkStart_ = TextCursor();
+		cacheRunStart_   = TextCursor();
+	}
+
+	while (pos < cacheChunkStart_) {
+		--cacheChunk_;
+		const Chunk &chunk = chunks_[cacheChunk_];
+		cacheChunkStart_ -= chunk.length;
+		cacheRun_         = chunk.runs.size() - 1;
+		cacheRunStart_    = cacheChunkStart_ + (chunk.length - chunk.runs.back().length);
+	}
+
+	while (pos >= cacheChunkStart_ + chunks_[cacheChunk_].length) {
+		cacheChunkStart_ += chunks_[cacheChunk_].length;
+		++cacheChunk_;
+		cacheRun_      = 0;
+		cacheRunStart_ = cacheChunkStart_;
+	}
+
+	const std::vector<Run> &runs = chunks_[cacheChunk_].runs;
+
+	while (pos < cacheRunStart_) {
+		--cacheRun_;
+		cacheRunStart_ -= runs[cacheRun_].length;
+	}
+
+	while (pos >= cacheRunStart_ + runs[cacheRun_].length) {
+		cacheRunStart_ += runs[cacheRun_].length;
+		++cacheRun_;
+	}
+}
+
+/**
+ * @brief StyleBuffer::splice
+ * @param start
+ * @param end
+ * @param runs
+ *
+ * Replace the styles from "start" up to "end" with "runs". Only the chunks
+ * holding that range are rebuilt, from what is left of them and the new runs.
+ */
+void StyleBuffer::splice(TextCursor start, TextCursor end, const std::vector<Run> &runs) {
+
+	start = qBound(TextCursor(), start, TextCursor(length_));
+	end   = qBound(start,        end,   TextCursor(length_));
+
+	// the chunks holding start..end, or the last one when inserting at the end
+	size_t first          = 0;
+	TextCursor firstStart = {};
+
+	if (start < length_) {
+		seek(start);
+		first      = cacheChunk_;
+		firstStart = cacheChunkStart_;
+	} else if (!chunks_.empty()) {
+		first      = chunks_.size() - 1;
+		firstStart = TextCursor(length_ - chunks_.back().length);
+	}
+
+	size_t last        = first;
+	TextCursor lastEnd = firstStart;
+	while (last < chunks_.size() && (last == first || lastEnd < end)) {
+		lastEnd += chunks_[last].length;
+		++last;
+	}
+
+	// what is left before start, the new runs, then what is left after end
+	std::vector<Run> merged;
+	merged.reserve(runs.size() + ChunkRuns);
+
+	TextCursor pos = firstStart;
+	for (size_t i = first; i < last && pos < start; ++i) {
+		for (const Run &run : chunks_[i].runs) {
+			const TextCursor next = pos + run.length;
+			if (pos < start) {
+				appendRun(merged, static_cast<char>(run.style), std::min(next, start) - pos);
+			}
+			pos = next;
+		}
+	}
+
+	for (const Run &run : runs) {
+		appendRun(merged, static_cast<char>(run.style), run.length);
+	}
+
+	pos = firstStart;
+	for (size_t i = first; i < last; ++i) {
+		for (const Run &run : chunks_[i].runs) {
+			const TextCursor next = pos + run.length;
+			if (next > end) {
+				appendRun(merged, static_cast<char>(run.style), next - std::max(pos, end));
+			}
+			pos = next;
+		}
+	}
+
+	// don't let edits leave lots of nearly empty chunks behind
+	if (merged.size() < MinChunkRuns && last < chunks_.size()) {
+		for (const Run &run : chunks_[last].runs) {
+			appendRun(merged, static_cast<char>(run.style), run.length);
+		}
+		++last;
+	}
+
+	// and split up the runs again, if there are too many for one chunk
+	std::vector<Chunk> replacement;
+	const size_t perChunk = (merged.size() > MaxChunkRuns) ? ChunkRuns : MaxChunkRuns;
+
+	for (size_t i = 0; i < merged.size(); i += perChunk) {
+		Chunk chunk;
+		chunk.runs.assign(merged.begin() + static_cast<ptrdiff_t>(i), merged.begin() + static_cast<ptrdiff_t>(std::min(i + perChunk, merged.size())));
+		for (const Run &run : chunk.runs) {
+			chunk.length += run.length;
+		}
+		replacement.push_back(std::move(chunk));
+	}
+
+	auto it = chunks_.erase(chunks_.begin() + static_cast<ptrdiff_t>(first), chunks_.begin() + static_cast<ptrdiff_t>(last));
+	chunks_.insert(it, std::make_move_iterator(replacement.begin()), std::make_move_iterator(replacement.end()));
+
+	for (const Run &run : runs) {
+		length_ += run.length;
+	}
+	length_ -= (end - start);
+
+	// the rebuilt chunks start where the old ones did
+	if (first < chunks_.size()) {
+		cacheChunk_      = first;
+		cacheChunkStart_ = firstStart;
+	} else {
+		cacheChunk_      = 0;
+		cacheChunkStart_ = TextCursor();
+	}
+
+	cacheRun_      = 0;
+	cacheRunStart_ = cacheChunkStart_;
+}
@@ -0,0 +1,76 @@
+
+#ifndef STYLE_BUFFER_H_
+#define STYLE_BUFFER_H_
+
+#include "TextCursor.h"
+#include "Util/string_view.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/*
+** The highlight style of each character of a document. Highlighted text
+** mostly comes in long stretches of the same style (identifiers, comments,
+** strings), so rather than a style per character, the styles are kept as
+** runs of characters with the same style.
+**
+** The runs are kept in chunks of a few hundred, so that a modification only
+** has to rewrite the runs of the chunks it touches, no matter how large the
+** document is. Lookups start from the run of the previous lookup, as they
+** nearly always follow one another through the text (drawing a line,
+** following a run back to a safe place to parse from).
+**
+** Style changes which the text area still has to redraw are marked by a
+** "changed" range, see TextArea::extendRangeForStyleMods.
+*/
+class StyleBuffer {
+public:
+	int64_t length() const noexcept;
+	char at(TextCursor pos) const;
+	TextCursor runEnd(TextCursor pos) const;
+	std::string range(TextCursor start, TextCursor end) const;
+	void replace(TextCursor start, TextCursor end, view::string_view styles);
+	void replace(TextCursor start, TextCursor end, char style, int64_t count);
+	void remove(TextCursor start, TextCursor end);
+	void setAll(view::string_view styles);
+
+public:
+	bool changed() const noexcept;
+	TextCursor changedStart() const noexcept;
+	TextCursor changedEnd() const noexcept;
+	void clearChanged() noexcept;
+	void markChanged(TextCursor start, TextCursor end) noexcept;
+
+private:
+	struct Run {
+		uint32_t length : 24;
+		uint32_t style  : 8;
+	};
+
+	struct Chunk {
+		int64_t length = 0;
+		std::vector<Run> runs;
+	};
+
+private:
+	static void appendRun(std::vector<Run> &runs, char style, int64_t length);
+	void seek(TextCursor pos) const;
+	void splice(TextCursor start, TextCursor end, const std::vector<Run> &runs);
+
+private:
+	std::vector<Chunk> chunks_;
+	int64_t length_ = 0;
+
+	// where the previous lookup ended up
+	mutable size_t cacheChunk_ = 0;
+	mutable size_t cacheRun_   = 0;
+	mutable TextCursor cacheChunkStart_;
+	mutable TextCursor cacheRunStart_;
+
+	bool changed_ = false;
+	TextCursor changedStart_;
+	TextCursor changedEnd_;
+};
+
+#endif
@@ -5,6 +5,8 @@
 #include "MainWindow.h"
 #include "Preferences.h"
 #include "Search.h"
+#include "TagsDatabase.h"
+#include "TagsLoader.h"
 #include "TextArea.h"
 #include "TextBuffer.h"
 #include "Util/FileSystem.h"
@@ -120,6 +122,86 @@ int64_t moveAheadNLinesEx(view::string_view str, int64_t &pos, int64_t n) {
 	}
 }
 
+/*
+** The fields of one line of a ctags file:
+**   <name>\t<file>\t<line number or search expression>[;"\t<flags>]
+*/
+struct CTagsLine {
+	QString name;
+	QString file;
+	QString searchString;
+	int     pos;
+};
+
+/*
+** Parses one <line> from a ctags tags file, with or without its newline.
+** Returns false if it isn't a tag spec.
+*/
+bool parseCTagsLine(const QString &line, CTagsLine *tag) {
+
+	QRegExp regex(QLatin1String(R"(^([^\t]+)\t([^\t]+)\t([^\n]+)\n?$)"));
+	if(!regex.exactMatch(line)) {
+		return false;
+	}
+
+	if(regex.captureCount() != 3) {
+		return false;
+	}
+
+	tag->name            = regex.cap(1);
+	tag->file            = regex.cap(2);
+	QString searchString = regex.cap(3);
+
+	if (tag->name.startsWith(QLatin1Char('!'))) {
+		return false;
+	}
+
+	int pos;
+
+	/*
+	** Guess the end of searchString:
+	** Try to handle original ctags and exuberant ctags format:
+	*/
+	if (searchString.startsWith(QLatin1Char('/')) || searchString.startsWith(QLatin1Char('?'))) {
+
+		pos = -1; // "search expr without pos info"
+
+		/* Situations: /<ANY expr>/\0
+		**             ?<ANY expr>?\0          --> original ctags
+		**             /<ANY expr>/;"  <flags>
+		**             ?<ANY expr>?;"  <flags> --> exuberant ctags
+		*/
+
+		int posTagREEnd = searchString.lastIndexOf(QLatin1Char(';'));
+
+		if(posTagREEnd == -1 ||
+		   searchString.mid(posTagREEnd, 2) != QLatin1String(";\"") ||
+		   searchString.startsWith(searchString.right(1))) {
+			//  -> original ctags format = exuberant ctags format 1
+		} else {
+			// looks like exuberant ctags format 2
+			searchString = searchString.left(posTagREEnd);
+		}
+
+		/*
+		** Hide the last delimiter:
+		**   /<expression>/    becomes   /<expression>
+		**   ?<expression>?    becomes   ?<expression>
+		** This will save a little work in fakeRegExSearch.
+		*/
+		if(searchString.startsWith(searchString.right(1))) {
+			searchString.chop(1);
+		}
+	} else {
+		pos = searchString.toInt();
+		searchString.clear();
+	}
+
+	tag->searchString = searchString;
+	tag->pos          = pos;
+	return true;
+}
+
 }
 
 /*
@@ -161,6 +243,22 @@ int Tags::addTag(const QString &name, const QString &file, size_t lang, const QS
 
 	QMultiHash<QString, Tag> *const table = hashTableByType(searchMode);
 
+	if (hasTag(table->values(name), file, lang, search, posInf, path)) {
+		return 0;
+	}
+
+	Tag t = { name, file, search, path, lang, posInf, index };
+
+	table->insert(name, t);
+	return 1;
+}
+
+/*
+** Check if "tags" already has a spec for the definition of a tag in "file"
+** (relative to "path") described by lang, search and posInf.
+*/
+bool Tags::hasTag(const QList<Tag> &tags, const QString &file, size_t lang, const QString &search, int64_t posInf, const QString &path) {
+
 	QString newFile;
 	if (QFileInfo(file).isAbsolute()) {
 		newFile = file;
@@ -170,7 +268,6 @@ int Tags::addTag(const QString &name, const QString &file, size_t lang, const QS
 
 	newFile = NormalizePathname(newFile);
 
-	QList<Tag> tags = table->values(name);
 	for(const Tag &t : tags) {
 
 		if (lang != t.language) {
@@ -199,13 +296,10 @@ int Tags::addTag(const QString &name, const QString &file, size_t lang, const QS
 				continue;
 			}
 		}
-		return 0;
+		return true;
 	}
 
-	Tag t = { name, file, search, path, lang, posInf, index };
-
-	table->insert(name, t);
-	return 1;
+	return false;
 }
 
 /*
@@ -266,6 +360,12 @@ bool Tags::AddRelTagsFileEx(const QString &tagSpec, const QString &windowPath, S
 		};
 
 		FileList->push_front(tag);
+
+		// get a head start on opening it, before the first lookup
+		if (FileList == &TagsFileList) {
+			startLoading(FileList->front());
+		}
+
 		added = true;
 	}
 
@@ -337,6 +437,11 @@ bool Tags::AddTagsFileEx(const QString &tagSpec, SearchMode mode) {
 		};
 
 		FileList->push_front(tag);
+
+		// get a head start on opening it, before the first lookup
+		if (FileList == &TagsFileList) {
+			startLoading(FileList->front());
+		}
 	}
 
 	MainWindow::updateMenuItems();
@@ -415,71 +520,18 @@ bool Tags::DeleteTagsFileEx(const QString &tagSpec, SearchMode mode, bool force_
 */
 int Tags::scanCTagsLine(const QString &line, const QString &tagPath, int index) {
 
-	QRegExp regex(QLatin1String(R"(^([^\t]+)\t([^\t]+)\t([^\n]+)\n$)"));
-	if(!regex.exactMatch(line)) {
-		return 0;
-	}
-
-	if(regex.captureCount() != 3) {
-		return 0;
-	}
-
-	QString name         = regex.cap(1);
-	QString file         = regex.cap(2);
-	QString searchString = regex.cap(3);
-
-	if (name.startsWith(QLatin1Char('!'))) {
+	CTagsLine tag;
+	if (!parseCTagsLine(line, &tag)) {
 		return 0;
 	}
 
-	int pos;
-
-	/*
-	** Guess the end of searchString:
-	** Try to handle original ctags and exuberant ctags format:
-	*/
-	if (searchString.startsWith(QLatin1Char('/')) || searchString.startsWith(QLatin1Char('?'))) {
-
-		pos = -1; // "search expr without pos info"
-
-		/* Situations: /<ANY expr>/\0
-		**             ?<ANY expr>?\0          --> original ctags
-		**             /<ANY expr>/;"  <flags>
-		**             ?<ANY expr>?;"  <flags> --> exuberant ctags
-		*/
-
-		int posTagREEnd = searchString.lastIndexOf(QLatin1Char(';'));
-
-		if(posTagREEnd == -1 ||
-		   searchString.mid(posTagREEnd, 2) != QLatin1String(";\"") ||
-		   searchString.startsWith(searchString.right(1))) {
-			//  -> original ctags format = exuberant ctags format 1
-		} else {
-			// looks like exuberant ctags format 2
-			searchString = searchString.left(posTagREEnd);
-		}
-
-		/*
-		** Hide the last delimiter:
-		**   /<expression>/    becomes   /<expression>
-		**   ?<expression>?    becomes   ?<expression>
-		** This will save a little work in fakeRegExSearch.
-		*/
-		if(searchString.startsWith(searchString.right(1))) {
-			searchString.chop(1);
-		}
-	} else {
-		pos = searchString.toInt();
-		searchString.clear();
-	}
-
 	// No ability to read language mode right now
 	return addTag(
-				name,
-				file,
+				tag.name,
+				tag.file,
 				PLAIN_LANGUAGE_MODE,
-				searchString,
-				pos,
+				tag.searchString,
+				tag.pos,
 				tagPath,
 				index);
 }
@@ -642,6 +694,11 @@ QList<Tags::Tag> Tags::LookupTagFromList(std::deque<File> *FileList, const QStri
 	if (!name.isNull()) {
 		for(File &tf : *FileList) {
 
+			if (FileList == &TagsFileList) {
+				updateTagsFile(tf);
+				continue;
+			}
+
 			int load_status;
 
 			if (tf.loaded) {
@@ -663,11 +720,7 @@ QList<Tags::Tag> Tags::LookupTagFromList(std::deque<File> *FileList, const QStri
 			}
 
 			// If we get here we have to try to (re-) load the tags file
-			if (FileList == &TipsFileList) {
-				load_status = loadTipsFile(tf.filename, tf.index, 0);
-			} else {
-				load_status = loadTagsFile(tf.filename, tf.index, 0);
-			}
+			load_status = loadTipsFile(tf.filename, tf.index, 0);
 
 			if (load_status) {
 
@@ -1297,6 +1350,114 @@ bool Tags::delTag(int index) {
 	return del > 0;
 }
 
+/*
+** Bring the tags file tf up to date for a lookup. ctags files are opened again
+** in the background when they change, and lookups are answered from the
+** version which was open before until that is done, if it can still be
+** searched: the file was replaced by a new one, which leaves the old one
+** mapped as it was, or lines were only added to its end. Only if it was
+** rewritten in place (or the first time a file is opened, when there is
+** nothing to answer with yet) is the new version waited for.
+*/
+void Tags::updateTagsFile(File &tf) {
+
+	if (tf.loaded && !tf.loader) {
+
+		QFileInfo fileInfo(tf.filename);
+		QDateTime timestamp = fileInfo.lastModified();
+
+		if (timestamp.isNull()) {
+			qWarning("NEdit: Error getting status for tag file %s", qPrintable(tf.filename));
+		} else if (tf.date == timestamp) {
+			// current tags file tf is already loaded and up to date
+			return;
+		}
+
+		if (tf.database) {
+			startLoading(tf);
+		} else {
+			// an etags file has been modified, delete it's entries and reload it
+			delTag(tf.index);
+			tf.loaded = false;
+		}
+	}
+
+	if (tf.loaded && tf.database && tf.database->searchable()) {
+		return;
+	}
+
+	if (!tf.loader) {
+		startLoading(tf);
+	}
+
+	MainWindow::AllWindowsBusy(tr("Loading tags file..."));
+	tf.loader->wait();
+	MainWindow::AllWindowsUnbusy();
+
+	finishLoading(tf);
+}
+
+/*
+** Open the tags file tf on a TagsLoader thread, which picks up from the
+** version of it that is open now, if any
+*/
+void Tags::startLoading(File &tf) {
+
+	auto loader = new TagsLoader(tf.filename, tf.database);
+	tf.loader = loader;
+
+	QObject::connect(loader, &QThread::finished, loader, [loader]() {
+
+		// unless the file was removed from the list, or was waited for
+		auto it = std::find_if(TagsFileList.begin(), TagsFileList.end(), [loader](const File &tf) {
+			return tf.loader == loader;
+		});
+
+		if (it != TagsFileList.end()) {
+			finishLoading(*it);
+		}
+
+		loader->deleteLater();
+	});
+
+	loader->start();
+}
+
+/*
+** Take the database opened by the finished TagsLoader of tf. If it turned
+** out not to be a ctags file, it is loaded into the hash table instead.
+*/
+void Tags::finishLoading(File &tf) {
+
+	TagsLoader *const loader = tf.loader;
+	tf.loader = nullptr;
+
+	tf.database = loader->database();
+
+	if (tf.database) {
+		tf.date   = loader->timestamp();
+		tf.loaded = true;
+		return;
+	}
+
+	// the hash table used is picked by the current search mode
+	const SearchMode mode = searchMode;
+	searchMode = SearchMode::TAG;
+
+	if (tf.loaded) {
+		delTag(tf.index);
+	}
+
+	tf.loaded = loadTagsFile(tf.filename, tf.index, 0) != 0;
+
+	if (tf.loaded) {
+		QFileInfo fileInfo(tf.filename);
+		tf.date = fileInfo.lastModified();
+	}
+
+	searchMode = mode;
+}
+
 QMultiHash<QString, Tags::Tag> *Tags::hashTableByType(SearchMode mode) {
 	if (mode == SearchMode::TIP) {
 		return &LoadedTips;
@@ -1323,9 +1484,39 @@ QList<Tags::Tag> Tags::getTag(const QString &name, SearchMode mode) {
 
 	if (mode == SearchMode::TIP) {
 		return getTagFromTable(LoadedTips, name);
-	} else {
-		return getTagFromTable(LoadedTags, name);
 	}
+
+	QList<Tag> tags = getTagFromTable(LoadedTags, name);
+
+	// and the specs from the ctags files which are searched in place
+	const QByteArray key = name.toLocal8Bit();
+
+	for(const File &tf : TagsFileList) {
+		if (!tf.database) {
+			continue;
+		}
+
+		const std::vector<view::string_view> lines = tf.database->lookup(view::string_view(key.data(), static_cast<size_t>(key.size())));
+		if (lines.empty()) {
+			continue;
+		}
+
+		QString tagPath;
+		parseFilename(tf.database->filename(), nullptr, &tagPath);
+
+		for(view::string_view line : lines) {
+			CTagsLine tag;
+			if (!parseCTagsLine(QString::fromLocal8Bit(line.data(), static_cast<int>(line.size())), &tag)) {
+				continue;
+			}
+
+			if (!hasTag(tags, tag.file, PLAIN_LANGUAGE_MODE, tag.searchString, tag.pos, tagPath)) {
+				tags.push_back(Tag{ tag.name, tag.file, tag.searchString, tagPath, PLAIN_LANGUAGE_MODE, tag.pos, tf.index });
+			}
+		}
+	}
+
+	return tags;
 }
 
 /**
@@ -7,11 +7,14 @@
 
 #include <deque>
 #include <array>
+#include <memory>
 
 #include <QString>
 #include <QDateTime>
 #include <QCoreApplication>
 
+class TagsDatabase;
+class TagsLoader;
 class TextArea;
 
 class Tags {
@@ -38,6 +41,9 @@ public:
 		bool      loaded;
 		int       index;
 		int       refcount; // Only tips files are refcounted, not tags files
+
+		std::shared_ptr<TagsDatabase> database;           // set for ctags files, which are searched in place
+		TagsLoader                   *loader = nullptr; // set while a ctags file is being opened
 	};
 
 	struct Tag {
@@ -63,6 +69,7 @@ public:
 	static QList<Tag> LookupTagFromList(std::deque<File> *FileList, const QString &name, SearchMode mode);
 	static QList<Tag> getTag(const QString &name, SearchMode mode);
 	static int addTag(const QString &name, const QString &file, size_t lang, const QString &search, int64_t posInf, const QString &path, int index);
+	static bool hasTag(const QList<Tag> &tags, const QString &file, size_t lang, const QString &search, int64_t posInf, const QString &path);
 	static bool searchLine(const std::string &line, const std::string &regex);
 
 private:
@@ -74,6 +81,9 @@ private:
 	static std::deque<File> *tagListByType(SearchMode mode);
 	static int scanCTagsLine(const QString &line, const QString &tagPath, int index);
 	static bool delTag(int index);
+	static void startLoading(File &tf);
+	static void finishLoading(File &tf);
+	static void updateTagsFile(File &tf);
 
 public:
 	static std::deque<File> TagsFileList; // list of loaded tags files
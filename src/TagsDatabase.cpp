@@ -0,0 +1,598 @@
+
+#include "TagsDatabase.h"
+#include "Util/FileSystem.h"
+
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QStandardPaths>
+#include <qplatformdefs.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <iterator>
+
+namespace {
+
+const char SortedHeader[] = "!_TAG_FILE_SORTED\t";
+
+// how much of the end of a file is compared, to tell if it was only added to
+constexpr size_t TailSize = 4096;
+
+/* an index file is this header, followed by "count" line offsets. It may
+   cover less than the whole tags file, if lines were added to it since */
+struct IndexHeader {
+	char magic[8];
+	int64_t fileSize; // of the tags file the index is for
+	int64_t fileTime; // and its modification time, in ms since the epoch
+	uint64_t tailHash;
+	int64_t count;
+};
+
+constexpr char IndexMagic[8] = {'N', 'E', 'D', 'I', 'T', 'I', 'X', '2'};
+
+/**
+ * @brief foldCompare
+ * @param lhs
+ * @param rhs
+ * @return the order of "lhs" and "rhs", ignoring case the way ctags does when
+ * it sorts with --sort=foldcase
+ */
+int foldCompare(view::string_view lhs, view::string_view rhs) {
+
+	const size_t n = std::min(lhs.size(), rhs.size());
+	for (size_t i = 0; i < n; ++i) {
+		const int a = std::toupper(static_cast<unsigned char>(lhs[i]));
+		const int b = std::toupper(static_cast<unsigned char>(rhs[i]));
+		if (a != b) {
+			return a - b;
+		}
+	}
+
+	if (lhs.size() == rhs.size()) {
+		return 0;
+	}
+
+	return (lhs.size() < rhs.size()) ? -1 : 1;
+}
+
+/**
+ * @brief indexFilename
+ * @param filename
+ * @return where the index of the tags file "filename" is kept, or an empty
+ * string if there is no cache directory
+ */
+QString indexFilename(const QString &filename) {
+
+	const QString cachePath = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+	if (cachePath.isEmpty()) {
+		return QString();
+	}
+
+	const QByteArray hash = QCryptographicHash::hash(filename.toUtf8(), QCryptographicHash::Sha1).toHex();
+	return QString(QLatin1String("%1/tags/%2.idx")).arg(cachePath, QString::fromLatin1(hash));
+}
+
+/**
+ * @brief fileId
+ * @param filename
+ * @return the device and inode of the file "filename", or {0, 0} if it
+ * can't be found
+ */
+TagsDatabase::FileId fileId(const QString &filename) {
+
+	QT_STATBUF statbuf;
+	if (QT_STAT(QFile::encodeName(filename).constData(), &statbuf) != 0) {
+		return {0, 0};
+	}
+
+	return {static_cast<uint64_t>(statbuf.st_dev), static_cast<uint64_t>(statbuf.st_ino)};
+}
+
+/**
+ * @brief mapFile
+ * @param filename
+ * @param size
+ * @param fileTime
+ * @param id
+ * @return the contents of the file, or nullptr if it is empty or could not
+ * be mapped, along with its modification time, in ms since the epoch, and
+ * which file it is. The time is taken before the file is mapped, so a change
+ * made meanwhile shows as a different time when the database checks the file
+ * later. If the file was replaced meanwhile, it isn't known which one was
+ * mapped, and "id" is left as {0, 0}.
+ */
+std::shared_ptr<const char> mapFile(const QString &filename, size_t *size, int64_t *fileTime, TagsDatabase::FileId *id) {
+
+	*fileTime = QFileInfo(filename).lastModified().toMSecsSinceEpoch();
+
+	const TagsDatabase::FileId before = fileId(filename);
+
+	int64_t fileSize;
+	std::shared_ptr<const char> data = MapFile(filename, &fileSize);
+	if (!data) {
+		return nullptr;
+	}
+
+	const TagsDatabase::FileId after = fileId(filename);
+
+	*id   = (before.device == after.device && before.inode == after.inode) ? after : TagsDatabase::FileId{0, 0};
+	*size = static_cast<size_t>(fileSize);
+	return data;
+}
+
+}
+
+/**
+ * @brief TagsDatabase::open
+ * @param filename
+ * @return the ctags file "filename", ready to be searched, or nullptr if it
+ * can't be read or is an etags file
+ */
+std::shared_ptr<TagsDatabase> TagsDatabase::open(const QString &filename) {
+
+	const QFileInfo fileInfo(filename);
+	const QString resolved = fileInfo.canonicalFilePath();
+	if (resolved.isEmpty()) {
+		return nullptr;
+	}
+
+	size_t size;
+	int64_t fileTime;
+	FileId id;
+	std::shared_ptr<const char> data = mapFile(resolved, &size, &fileTime, &id);
+
+	// the first character in the file tells etags files from ctags ones
+	if (!data || data.get()[0] == '\014') {
+		return nullptr;
+	}
+
+	std::shared_ptr<TagsDatabase> database(new TagsDatabase);
+	database->filename_ = resolved;
+	database->data_     = data;
+	database->size_     = size;
+	database->fileTime_ = fileTime;
+	database->fileId_   = id;
+	database->baseSize_ = size;
+	database->tailHash_ = database->tailHash(size);
+
+	// the header lines come first, and say whether the tags are sorted
+	for (size_t offset = 0; offset < size && data.get()[offset] == '!'; offset = database->lineStart(offset + 1)) {
+
+		const view::string_view line = database->lineAt(offset);
+		const size_t length          = sizeof(SortedHeader) - 1;
+
+		if (line.size() > length && line.compare(0, length, SortedHeader) == 0) {
+			switch (line[length]) {
+			case '1':
+				database->order_ = Order::Sorted;
+				break;
+			case '2':
+				database->order_ = Order::FoldCase;
+				break;
+			default:
+				database->order_ = Order::Unsorted;
+				break;
+			}
+		}
+	}
+
+	if (database->order_ == Order::Unsorted) {
+
+		const QString indexFile = indexFilename(resolved);
+
+		if (!database->loadIndex(indexFile, fileTime)) {
+			auto index = std::make_shared<std::vector<uint64_t>>(database->indexLines(0, size));
+
+			database->index_     = std::shared_ptr<const uint64_t>(index, index->data());
+			database->indexSize_ = index->size();
+
+			// once written out, the index is mapped like the rest
+			database->saveIndex(indexFile, *index, fileTime);
+		}
+	}
+
+	return database;
+}
+
+/**
+ * @brief TagsDatabase::refresh
+ * @return the database for the tags file as it is now. If lines were only
+ * added to the end of the file since this database was opened, the new one
+ * shares what this one has sorted or indexed, and only the added lines are
+ * indexed. Otherwise the file is opened again from scratch.
+ */
+std::shared_ptr<TagsDatabase> TagsDatabase::refresh() const {
+
+	size_t size;
+	int64_t fileTime;
+	FileId id;
+	std::shared_ptr<const char> data = mapFile(filename_, &size, &fileTime, &id);
+	if (!data || size <= size_) {
+		return open(filename_);
+	}
+
+	std::shared_ptr<TagsDatabase> database(new TagsDatabase);
+	database->filename_ = filename_;
+	database->data_     = data;
+	database->size_     = size;
+	database->fileTime_ = fileTime;
+	database->fileId_   = id;
+
+	// the old end of the file has to still be there, and still end a line
+	if (!database->endsLine(size_) || database->tailHash(size_) != tailHash_) {
+		return open(filename_);
+	}
+
+	database->baseSize_  = baseSize_;
+	database->tailHash_  = database->tailHash(size);
+	database->order_     = order_;
+	database->index_     = index_;
+	database->indexSize_ = indexSize_;
+
+	std::vector<uint64_t> added = database->indexLines(size_, size);
+
+	if (appended_) {
+		auto appended = std::make_shared<std::vector<uint64_t>>();
+		appended->reserve(appended_->size() + added.size());
+
+		std::merge(appended_->begin(), appended_->end(), added.begin(), added.end(), std::back_inserter(*appended), [&database](uint64_t lhs, uint64_t rhs) {
+			return database->nameAt(lhs) < database->nameAt(rhs);
+		});
+
+		database->appended_ = appended;
+	} else {
+		database->appended_ = std::make_shared<const std::vector<uint64_t>>(std::move(added));
+	}
+
+	return database;
+}
+
+/**
+ * @brief TagsDatabase::filename
+ * @return the resolved name of the tags file
+ */
+QString TagsDatabase::filename() const {
+	return filename_;
+}
+
+/**
+ * @brief TagsDatabase::current
+ * @return true if the tags file is still the size it was, and has the same
+ * modification time, as when it was mapped
+ *
+ * Another program changing the file shows through the mapping, and would
+ * leave what was sorted or indexed pointing at the wrong lines.
+ */
+bool TagsDatabase::current() const {
+
+	const QFileInfo fileInfo(filename_);
+	return fileInfo.size() == static_cast<int64_t>(size_) && fileInfo.lastModified().toMSecsSinceEpoch() == fileTime_;
+}
+
+/**
+ * @brief TagsDatabase::searchable
+ * @return true if the part of the tags file this database covers is still
+ * there as it was: the file hasn't changed, it was replaced by another one
+ * (as when a new version is renamed over it, or it was removed), or lines
+ * were only added to the end of it (the same check refresh() makes before it
+ * shares this database's index with the next one)
+ */
+bool TagsDatabase::searchable() const {
+
+	if (current()) {
+		return true;
+	}
+
+	// the mapping keeps the file which was opened around, as it was
+	const FileId id = fileId(filename_);
+	if (fileId_.inode != 0 && (id.device != fileId_.device || id.inode != fileId_.inode)) {
+		return true;
+	}
+
+	// the mapping doesn't reach past the old end, but shows what is before it now
+	const QFileInfo fileInfo(filename_);
+	return fileInfo.size() > static_cast<int64_t>(size_) && endsLine(size_) && tailHash(size_) == tailHash_;
+}
+
+/**
+ * @brief TagsDatabase::lookup
+ * @param name
+ * @return the lines of the tags file for the tag "name", without their line
+ * endings. They point into the mapped file, and stay valid for as long as the
+ * database does. Nothing is found once the file has changed other than by
+ * having lines added to it, the database for the new version has to be
+ * opened to search it.
+ */
+std::vector<view::string_view> TagsDatabase::lookup(view::string_view name) const {
+
+	std::vector<view::string_view> lines;
+
+	if (name.empty() || !searchable()) {
+		return lines;
+	}
+
+	if (order_ == Order::Unsorted) {
+		findIndexed(index_.get(), indexSize_, name, &lines);
+	} else {
+		const bool foldCase = (order_ == Order::FoldCase);
+
+		auto before = [foldCase](view::string_view lhs, view::string_view rhs) {
+			return foldCase ? foldCompare(lhs, rhs) < 0 : lhs < rhs;
+		};
+
+		/* find the first line whose name doesn't sort before "name". Every
+		   byte of the file stands for the first line starting at or after it,
+		   which lets us binary search the bytes without knowing where the
+		   lines are */
+		size_t first = 0;
+		size_t last  = baseSize_;
+
+		while (first < last) {
+			const size_t middle = first + (last - first) / 2;
+			const size_t offset = lineStart(middle);
+
+			if (offset < baseSize_ && before(nameAt(offset), name)) {
+				first = middle + 1;
+			} else {
+				last = middle;
+			}
+		}
+
+		// a case folded file may have other spellings of the name mixed in
+		for (size_t offset = lineStart(first); offset < baseSize_; offset = lineStart(offset + 1)) {
+			const view::string_view tag = nameAt(offset);
+			if (before(name, tag)) {
+				break;
+			}
+
+			if (tag == name) {
+				lines.push_back(lineAt(offset));
+			}
+		}
+	}
+
+	if (appended_) {
+		findIndexed(appended_->data(), appended_->size(), name, &lines);
+	}
+
+	return lines;
+}
+
+/**
+ * @brief TagsDatabase::findIndexed
+ * @param offsets
+ * @param count
+ * @param name
+ * @param lines
+ *
+ * Add the lines for the tag "name" among the "count" line offsets at
+ * "offsets", which are sorted by name, to "lines"
+ */
+void TagsDatabase::findIndexed(const uint64_t *offsets, size_t count, view::string_view name, std::vector<view::string_view> *lines) const {
+
+	const uint64_t *last = offsets + count;
+
+	auto it = std::lower_bound(offsets, last, name, [this](uint64_t offset, view::string_view key) {
+		return nameAt(offset) < key;
+	});
+
+	for (; it != last && nameAt(*it) == name; ++it) {
+		lines->push_back(lineAt(*it));
+	}
+}
+
+/**
+ * @brief TagsDatabase::lineStart
+ * @param pos
+ * @return the offset of the first line starting at or after "pos", or the
+ * size of the file if there is none
+ */
+size_t TagsDatabase::lineStart(size_t pos) const {
+
+	if (pos == 0) {
+		return 0;
+	}
+
+	if (pos > size_) {
+		return size_;
+	}
+
+	const char *data = data_.get();
+	auto newline     = static_cast<const char *>(std::memchr(data + pos - 1, '\n', size_ - (pos - 1)));
+
+	return newline ? static_cast<size_t>(newline - data) + 1 : size_;
+}
+
+/**
+ * @brief TagsDatabase::lineAt
+ * @param offset
+ * @return the line starting at "offset", without its line ending
+ */
+view::string_view TagsDatabase::lineAt(size_t offset) const {
+
+	const char *first = data_.get() + offset;
+	auto newline      = static_cast<const char *>(std::memchr(first, '\n', size_ - offset));
+
+	size_t length = newline ? static_cast<size_t>(newline - first) : size_ - offset;
+	if (length != 0 && first[length - 1] == '\r') {
+		--length;
+	}
+
+	return view::string_view(first, length);
+}
+
+/**
+ * @brief TagsDatabase::nameAt
+ * @param offset
+ * @return the name of the tag on the line starting at "offset"
+ */
+view::string_view TagsDatabase::nameAt(size_t offset) const {
+
+	const view::string_view line = lineAt(offset);
+	return line.substr(0, line.find('\t'));
+}
+
+/**
+ * @brief TagsDatabase::endsLine
+ * @param end
+ * @return true if the first "end" bytes of the file are whole lines
+ */
+bool TagsDatabase::endsLine(size_t end) const {
+	return end != 0 && end <= size_ && data_.get()[end - 1] == '\n';
+}
+
+/**
+ * @brief TagsDatabase::tailHash
+ * @param end
+ * @return a hash of the bytes of the file up to "end", or of the last
+ * TailSize of them
+ */
+uint64_t TagsDatabase::tailHash(size_t end) const {
+
+	// FNV-1a
+	uint64_t hash = 14695981039346656037ull;
+
+	const char *data = data_.get();
+	for (size_t i = end - std::min(end, TailSize); i < end; ++i) {
+		hash ^= static_cast<unsigned char>(data[i]);
+		hash *= 1099511628211ull;
+	}
+
+	return hash;
+}
+
+/**
+ * @brief TagsDatabase::indexLines
+ * @param first
+ * @param last
+ * @return the offsets of the tag lines starting from "first" up to "last",
+ * sorted by tag name. Tags with the same name are kept in the order they
+ * appear in.
+ */
+std::vector<uint64_t> TagsDatabase::indexLines(size_t first, size_t last) const {
+
+	std::vector<uint64_t> offsets;
+
+	for (size_t offset = first; offset < last; offset = lineStart(offset + 1)) {
+		const view::string_view line = lineAt(offset);
+		if (line.empty() || line[0] == '!' || line.find('\t') == view::string_view::npos) {
+			continue;
+		}
+
+		offsets.push_back(offset);
+	}
+
+	std::stable_sort(offsets.begin(), offsets.end(), [this](uint64_t lhs, uint64_t rhs) {
+		return nameAt(lhs) < nameAt(rhs);
+	});
+
+	return offsets;
+}
+
+/**
+ * @brief TagsDatabase::loadIndex
+ * @param indexFile
+ * @param fileTime
+ * @return true if "indexFile" holds an index of the tags file as it is now,
+ * or of the file before lines were added to it, in which case it is mapped
+ * and used
+ */
+bool TagsDatabase::loadIndex(const QString &indexFile, int64_t fileTime) {
+
+	if (indexFile.isEmpty()) {
+		return false;
+	}
+
+	auto file = std::make_shared<QFile>(indexFile);
+	if (!file->open(QIODevice::ReadOnly) || file->size() < static_cast<int64_t>(sizeof(IndexHeader))) {
+		return false;
+	}
+
+	uchar *memory = file->map(0, file->size());
+	if (!memory) {
+		return false;
+	}
+
+	IndexHeader header;
+	std::memcpy(&header, memory, sizeof(header));
+
+	if (std::memcmp(header.magic, IndexMagic, sizeof(IndexMagic)) != 0 || header.fileSize <= 0 || header.count < 0) {
+		return false;
+	}
+
+	const auto indexedSize = static_cast<size_t>(header.fileSize);
+
+	if (indexedSize == size_) {
+		if (header.fileTime != fileTime) {
+			return false;
+		}
+	} else if (indexedSize > size_ || !endsLine(indexedSize) || tailHash(indexedSize) != header.tailHash) {
+		return false;
+	}
+
+	if (file->size() != static_cast<int64_t>(sizeof(IndexHeader) + static_cast<size_t>(header.count) * sizeof(uint64_t))) {
+		return false;
+	}
+
+	// the mapping is page aligned, so the offsets after the header are too
+	auto offsets     = reinterpret_cast<const uint64_t *>(memory + sizeof(IndexHeader));
+	const auto count = static_cast<size_t>(header.count);
+
+	if (!std::all_of(offsets, offsets + count, [indexedSize](uint64_t offset) { return offset < indexedSize; })) {
+		return false;
+	}
+
+	// the QFile owns the mapping, and unmaps it when it is destroyed
+	index_     = std::shared_ptr<const uint64_t>(file, offsets);
+	indexSize_ = count;
+	baseSize_  = indexedSize;
+
+	if (baseSize_ < size_) {
+		appended_ = std::make_shared<const std::vector<uint64_t>>(indexLines(baseSize_, size_));
+	}
+
+	return true;
+}
+
+/**
+ * @brief TagsDatabase::saveIndex
+ * @param indexFile
+ * @param index
+ * @param fileTime
+ *
+ * Write "index", the index of the whole file built in memory, to "indexFile",
+ * and use that instead if it could be written
+ */
+void TagsDatabase::saveIndex(const QString &indexFile, const std::vector<uint64_t> &index, int64_t fileTime) {
+
+	if (indexFile.isEmpty() || !QDir().mkpath(QFileInfo(indexFile).path())) {
+		return;
+	}
+
+	QSaveFile file(indexFile);
+	if (!file.open(QIODevice::WriteOnly)) {
+		return;
+	}
+
+	IndexHeader header;
+	std::memcpy(header.magic, IndexMagic, sizeof(IndexMagic));
+	header.fileSize = static_cast<int64_t>(size_);
+	header.fileTime = fileTime;
+	header.tailHash = tailHash(size_);
+	header.count    = static_cast<int64_t>(index.size());
+
+	const auto bytes = static_cast<int64_t>(index.size() * sizeof(uint64_t));
+
+	if (file.write(reinterpret_cast<const char *>(&header), sizeof(header)) != sizeof(header) ||
+	    file.write(reinterpret_cast<const char *>(index.data()), bytes) != bytes ||
+	    !file.commit()) {
+		return;
+	}
+
+	loadIndex(indexFile, fileTime);
+}
@@ -0,0 +1,97 @@
+
+#ifndef TAGS_DATABASE_H_
+#define TAGS_DATABASE_H_
+
+#include "Util/string_view.h"
+
+#include <QString>
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+/*
+** A ctags file, searched where it lies instead of being loaded into memory.
+**
+** The file is mapped copy-on-write, and if its header says that it is sorted, the lines for
+** a tag name are found by a binary search over the file itself. Otherwise the
+** offsets of its lines, sorted by tag name, are written to an index file in
+** the cache directory the first time the tags file is opened, and that index
+** is mapped and searched instead, until the tags file changes. (If the index
+** can't be written, it is only kept in memory.)
+**
+** When lines are only added to the end of the file (as "ctags -a" does), the
+** database for the new version shares the sorted part or the index of the
+** old one, and only the added lines are indexed, in memory.
+**
+** A database never changes once it is opened, so one generation can be
+** searched while the next is being opened on another thread, as long as the
+** file was only added to, or was replaced rather than rewritten in place
+** (see searchable()).
+**
+** etags files are made of sections with no order to them, and aren't handled
+** here.
+*/
+class TagsDatabase {
+public:
+	// which file was mapped, as the device and inode it is on
+	struct FileId {
+		uint64_t device;
+		uint64_t inode;
+	};
+
+public:
+	static std::shared_ptr<TagsDatabase> open(const QString &filename);
+
+public:
+	TagsDatabase(const TagsDatabase &)            = delete;
+	TagsDatabase &operator=(const TagsDatabase &) = delete;
+	~TagsDatabase()                               = default;
+
+public:
+	bool current() const;
+	bool searchable() const;
+	QString filename() const;
+	std::vector<view::string_view> lookup(view::string_view name) const;
+	std::shared_ptr<TagsDatabase> refresh() const;
+
+private:
+	enum class Order {
+		Unsorted,
+		Sorted,
+		FoldCase
+	};
+
+private:
+	TagsDatabase() = default;
+
+private:
+	size_t lineStart(size_t pos) const;
+	view::string_view lineAt(size_t offset) const;
+	view::string_view nameAt(size_t offset) const;
+	bool endsLine(size_t end) const;
+	uint64_t tailHash(size_t end) const;
+	std::vector<uint64_t> indexLines(size_t first, size_t last) const;
+	void findIndexed(const uint64_t *offsets, size_t count, view::string_view name, std::vector<view::string_view> *lines) const;
+	bool loadIndex(const QString &indexFile, int64_t fileTime);
+	void saveIndex(const QString &indexFile, const std::vector<uint64_t> &index, int64_t fileTime);
+
+private:
+	QString filename_;
+	std::shared_ptr<const char> data_;
+	size_t size_       = 0;
+	int64_t fileTime_  = 0; // of the file when it was mapped, in ms since the epoch
+	FileId fileId_     = {0, 0}; // of the file which was mapped, {0, 0} if that isn't known
+	size_t baseSize_   = 0; // how much of the file is sorted, or indexed
+	uint64_t tailHash_ = 0; // of the end of the file, to tell if it was only added to
+	Order order_       = Order::Unsorted;
+
+	// for unsorted files, the offsets of the tag lines before baseSize_, sorted by name
+	std::shared_ptr<const uint64_t> index_;
+	size_t indexSize_ = 0;
+
+	// the offsets of the tag lines after baseSize_, sorted by name
+	std::shared_ptr<const std::vector<uint64_t>> appended_;
+};
+
+#endif
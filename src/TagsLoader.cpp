@@ -0,0 +1,46 @@
+
+#include "TagsLoader.h"
+#include "TagsDatabase.h"
+
+#include <QFileInfo>
+
+/**
+ * @brief TagsLoader::TagsLoader
+ * @param filename
+ * @param previous
+ * @param parent
+ */
+TagsLoader::TagsLoader(const QString &filename, std::shared_ptr<TagsDatabase> previous, QObject *parent) : QThread(parent), filename_(filename), previous_(std::move(previous)) {
+}
+
+/**
+ * @brief TagsLoader::database
+ * @return the opened database, once the thread has finished
+ */
+std::shared_ptr<TagsDatabase> TagsLoader::database() const {
+	return database_;
+}
+
+/**
+ * @brief TagsLoader::timestamp
+ * @return the modification time of the file the database was opened from. It
+ * is taken before the file is opened, so a change made meanwhile is noticed
+ * the next time the file is checked.
+ */
+QDateTime TagsLoader::timestamp() const {
+	return timestamp_;
+}
+
+/**
+ * @brief TagsLoader::run
+ */
+void TagsLoader::run() {
+
+	timestamp_ = QFileInfo(filename_).lastModified();
+
+	if (previous_) {
+		database_ = previous_->refresh();
+	} else {
+		database_ = TagsDatabase::open(filename_);
+	}
+}
@@ -0,0 +1,41 @@
+
+#ifndef TAGS_LOADER_H_
+#define TAGS_LOADER_H_
+
+#include <QDateTime>
+#include <QString>
+#include <QThread>
+
+#include <memory>
+
+class TagsDatabase;
+
+/*
+** Opens a ctags file as a TagsDatabase on a thread of its own, so that
+** indexing a large unsorted tags file doesn't hold up the windows. Given the
+** database for an earlier version of the file, only what was added to the
+** file since is indexed, if that is all that changed. In that case the
+** earlier database can still be searched meanwhile.
+*/
+class TagsLoader : public QThread {
+	Q_OBJECT
+
+public:
+	TagsLoader(const QString &filename, std::shared_ptr<TagsDatabase> previous, QObject *parent = nullptr);
+	~TagsLoader() override = default;
+
+public:
+	std::shared_ptr<TagsDatabase> database() const;
+	QDateTime timestamp() const;
+
+protected:
+	void run() override;
+
+private:
+	QString filename_;
+	std::shared_ptr<TagsDatabase> previous_;
+	std::shared_ptr<TagsDatabase> database_; // nullptr if it isn't a ctags file
+	QDateTime timestamp_;                    // of the file, from before it was opened
+};
+
+#endif
@@ -12,7 +12,9 @@
 #include "MultiClickStates.h"
 #include "Preferences.h"
 #include "RangesetTable.h"
+#include "SignalBlocker.h"
 #include "SmartIndentEvent.h"
+#include "StyleBuffer.h"
 #include "TextBuffer.h"
 #include "TextEditEvent.h"
 #include "X11Colors.h"
@@ -32,6 +34,7 @@
 #include <QScrollBar>
 #include <QShortcut>
 #include <QTextCodec>
+#include <QTextLayout>
 #include <QTimer>
 #include <QtDebug>
 #include <QtGlobal>
@@ -121,6 +124,21 @@ constexpr uint32_t RANGESET_MASK     = (0x3f << RANGESET_SHIFT);
    stack in the redisplayLine routine for drawing strings */
 constexpr int MAX_DISP_LINE_LEN = 1000;
 
+/* How many characters worth of shaped text to keep around for redrawing,
+   several screens full even for text which changes style every few characters */
+constexpr int GLYPH_CACHE_SIZE = 64 * 1024;
+
+/* How many characters of text the wrap index counts the lines of at a time,
+   while idle */
+constexpr int64_t WRAP_INDEX_CHUNK = 256 * 1024;
+
+// variations of the text font, for a style
+enum FontVariant {
+	VARIANT_BOLD      = 1,
+	VARIANT_ITALIC    = 2,
+	VARIANT_UNDERLINE = 4
+};
+
 bool offscreenV(QDesktopWidget *desktop, int top, int height) {
 	return (top < CALLTIP_EDGE_GUARD || top + height >= desktop->height() - CALLTIP_EDGE_GUARD);
 }
@@ -479,10 +497,16 @@ TextArea::TextArea(DocumentWidget *document, TextBuffer *buffer, const QFont &fo
 	clickTimer_       = new QTimer(this);
 	lineNumberArea_   = new LineNumberArea(this);
 
+	glyphCache_.setMaxCost(GLYPH_CACHE_SIZE);
+
 	autoScrollTimer_->setSingleShot(true);
 	connect(autoScrollTimer_,  &QTimer::timeout, this, &TextArea::autoScrollTimerTimeout);
 	connect(cursorBlinkTimer_, &QTimer::timeout, this, &TextArea::cursorBlinkTimerTimeout);
 
+	wrapIndexTimer_ = new QTimer(this);
+	wrapIndexTimer_->setInterval(0);
+	connect(wrapIndexTimer_, &QTimer::timeout, this, &TextArea::updateWrapIndex);
+
 	clickTimer_->setSingleShot(true);
 	connect(clickTimer_, &QTimer::timeout, this, [this]() {
 		clickCount_ = 0;
@@ -518,9 +542,18 @@ TextArea::TextArea(DocumentWidget *document, TextBuffer *buffer, const QFont &fo
 		buffer->BufAddPreDeleteCB(bufPreDeleteCB, this);
 	}
 
-	// Update the display to reflect the contents of the buffer
+	/* Update the display to reflect the contents of the buffer. The text is
+	 * laid out unwrapped at first, as counting the wrapped lines of all of it
+	 * takes as long as the buffer is large, wrapping it then counts them in
+	 * the background */
 	if(buffer) {
+		const bool wrap = continuousWrap_;
+		continuousWrap_ = false;
 		bufModifiedCB(buffer_->BufStartOfBuffer(), buffer->BufGetLength(), 0, 0, {}, this);
+
+		if (wrap) {
+			TextDSetWrapMode(true, wrapMargin_);
+		}
 	}
 
 	// Decide if the horizontal scroll bar needs to be visible
@@ -882,11 +915,25 @@ void TextArea::verticalScrollBar_valueChanged(int value) {
 	updateVScrollBarRange();
 	updateHScrollBarRange();
 
-	// NOTE(eteran): the original code seemed to do some cleverness
-	//               involving copying the parts that were "moved"
-	//               to avoid doing some work. For now, we'll just repaint
-	//               the whole thing. It's not as fast/clever, but it'll work
-	viewport()->update();
+	/* Like the original NEdit, move the lines which are still visible rather
+	   than drawing them again, so only the lines which scrolled into view get
+	   painted. The window's backing store holds what was drawn last, so this
+	   is a copy within it. The bottom line is usually only partly visible,
+	   and so was never drawn in full, it is left out of the move and drawn
+	   again wherever it ends up */
+	const QRect viewRect = viewport()->contentsRect();
+	const int fontHeight = fixedFontHeight_;
+	const int fullLines  = viewRect.height() / fontHeight;
+
+	if (lineDelta != 0 && std::abs(lineDelta) < fullLines) {
+		const QRect fullRect(0, viewRect.top(), viewport()->width(), fullLines * fontHeight);
+		const int partialTop = fullRect.bottom() + 1;
+
+		viewport()->scroll(0, lineDelta * fontHeight, fullRect);
+		viewport()->update(QRect(0, partialTop, viewport()->width(), viewport()->height() - partialTop));
+	} else {
+		viewport()->update();
+	}
 
 	// Refresh line number/calltip display if its up and we've scrolled vertically
 	if (lineDelta != 0) {
@@ -1400,6 +1447,12 @@ void TextArea::bufModifiedCallback(TextCursor pos, int64_t nInserted, int64_t nD
 	// Update the line count for the whole buffer
 	nBufferLines_ = (nBufferLines_ + linesInserted - linesDeleted);
 
+	if (continuousWrap_ && (nInserted != 0 || nDeleted != 0)) {
+		if (wrapIndex_.modified(pos, nInserted, nDeleted, static_cast<int>(linesInserted - linesDeleted))) {
+			wrapIndexTimer_->start();
+		}
+	}
+
 	/* Update the scroll bar ranges (and value if the value changed).  Note
 	   that updating the horizontal scroll bar range requires scanning the
 	   entire displayed text, however, it doesn't seem to hurt performance
@@ -1415,7 +1468,8 @@ void TextArea::bufModifiedCallback(TextCursor pos, int64_t nInserted, int64_t nD
 		cursorToHint_ = NO_HINT;
 	} else if (cursorPos_ > pos) {
 		if (cursorPos_ < pos + nDeleted) {
-			cursorPos_ = pos;
+			// the edits of an edit group may all have missed the cursor
+			cursorPos_ = buffer_->BufMapEditGroupPosition(cursorPos_).get_value_or(pos);
 		} else {
 			cursorPos_ = (cursorPos_ + nInserted - nDeleted);
 		}
@@ -1425,8 +1479,7 @@ void TextArea::bufModifiedCallback(TextCursor pos, int64_t nInserted, int64_t nD
 	if (scrolled) {
 		TextDRedisplayRect(viewRect);
 		if (styleBuffer_) { // See comments in extendRangeForStyleMods
-			styleBuffer_->primary.selected  = false;
-			styleBuffer_->primary.zeroWidth = false;
+			styleBuffer_->clearChanged();
 		}
 		return;
 	}
@@ -2543,11 +2596,10 @@ bool TextArea::wrapUsesCharacter(TextCursor lineEndPos) const {
 ** contains auxiliary information for coloring or styling text).
 */
 void TextArea::extendRangeForStyleMods(TextCursor *start, TextCursor *end) {
-	const TextBuffer::Selection *sel = &styleBuffer_->primary;
-
 	/* The peculiar protocol used here is that modifications to the style
-	   buffer are marked by selecting them with the buffer's primary selection.
-	   The style buffer is usually modified in response to a modify callback on
+	   buffer are marked by the buffer's changed range (in place of the
+	   primary selection used when it was a text buffer of its own).  The
+	   style buffer is usually modified in response to a modify callback on
 	   the text buffer BEFORE TextArea's modify callback, so that it can keep
 	   the style buffer in step with the text buffer.  The style-update
 	   callback can't just call for a redraw, because TextArea hasn't processed
@@ -2555,13 +2607,13 @@ void TextArea::extendRangeForStyleMods(TextCursor *start, TextCursor *end) {
 	   avoid the complexity of scheduling redraws later, this simple protocol
 	   tells the text display's buffer modify callback to extend it's redraw
 	   range to show the text color/and font changes as well. */
-	if (sel->selected) {
-		if (sel->start < *start) {
-			*start = sel->start;
+	if (styleBuffer_->changed()) {
+		if (styleBuffer_->changedStart() < *start) {
+			*start = styleBuffer_->changedStart();
 		}
 
-		if (sel->end > *end) {
-			*end = sel->end;
+		if (styleBuffer_->changedEnd() > *end) {
+			*end = styleBuffer_->changedEnd();
 		}
 	}
 }
@@ -2897,11 +2949,11 @@ uint32_t TextArea::styleOfPos(TextCursor lineStartPos, int64_t lineLen, int64_t
 	if (lineIndex >= lineLen) {
 		style = FILL_MASK;
 	} else if (styleBuffer_) {
-		style = static_cast<uint8_t>(styleBuffer_->BufGetCharacter(pos));
+		style = static_cast<uint8_t>(styleBuffer_->at(pos));
 		if (style == unfinishedStyle_) {
 			// encountered "unfinished" style, trigger parsing
 			(unfinishedHighlightCB_)(this, pos, highlightCBArg_);
-			style = static_cast<uint8_t>(styleBuffer_->BufGetCharacter(pos));
+			style = static_cast<uint8_t>(styleBuffer_->at(pos));
 		}
 	}
 
@@ -2946,8 +2998,7 @@ void TextArea::drawString(QPainter *painter, uint32_t style, int x, int y, int t
 	const QPalette &pal  = palette();
 	QColor bground       = pal.color(QPalette::Base);
 	QColor fground       = pal.color(QPalette::Text);
-	QFont renderFont     = font_;
-	bool underlineStyle  = false;
+	int fontVariant      = 0;
 
 	enum DrawType {
 		DrawStyle,
@@ -2990,10 +3041,17 @@ void TextArea::drawString(QPainter *painter, uint32_t style, int x, int y, int t
 			   configured here, on the fly. */
 			if (style & STYLE_LOOKUP_MASK) {
 				styleRec = &styleTable_[(style & STYLE_LOOKUP_MASK) - ASCII_A];
-				underlineStyle = styleRec->isUnderlined;
+				if (styleRec->isBold) {
+					fontVariant |= VARIANT_BOLD;
+				}
+
+				if (styleRec->isItalic) {
+					fontVariant |= VARIANT_ITALIC;
+				}
 
-				renderFont.setBold(styleRec->isBold);
-				renderFont.setItalic(styleRec->isItalic);
+				if (styleRec->isUnderlined) {
+					fontVariant |= VARIANT_UNDERLINE;
+				}
 
 				fground = styleRec->color;
 				// here you could pick up specific select and highlight fground
@@ -3056,19 +3114,59 @@ void TextArea::drawString(QPainter *painter, uint32_t style, int x, int y, int t
 	}
 
 	// Underline if style is secondary selection
-	if ((style & SECONDARY_MASK) || underlineStyle) {
-		renderFont.setUnderline(true);
+	if (style & SECONDARY_MASK) {
+		fontVariant |= VARIANT_UNDERLINE;
 	}
 
-	const auto s = asciiToUnicode(string, nChars);
 	const QRect rect(x, y, toX - x, fixedFontHeight_);
-
-	painter->save();
-	painter->setFont(renderFont);
 	painter->fillRect(rect, bground);
+
+	if (nChars == 0) {
+		return;
+	}
+
+	/* the glyphs carry their own font, so all that the painter needs is the
+	   color. paintEvent restores the painter's state once the lines are done */
 	painter->setPen(fground);
-	painter->drawText(rect, Qt::TextSingleLine | Qt::TextDontClip | Qt::AlignVCenter | Qt::AlignLeft, s);
-	painter->restore();
+
+	for (const QGlyphRun &run : glyphRuns(asciiToUnicode(string, nChars), fontVariant)) {
+		painter->drawGlyphRun(QPointF(x, y), run);
+	}
+}
+
+/**
+ * @brief TextArea::glyphRuns
+ * @param text
+ * @param variant
+ * @return "text" shaped into glyphs in the given variation of the font. The
+ * result is only valid until the next call.
+ *
+ * Laying out text is by far the most expensive part of drawing it, and most
+ * of what is drawn was drawn just before, a line or so up or down, so the
+ * results are cached.
+ */
+const QList<QGlyphRun> &TextArea::glyphRuns(const QString &text, int variant) {
+
+	GlyphRunKey key{text, variant};
+
+	if (QList<QGlyphRun> *runs = glyphCache_.object(key)) {
+		return *runs;
+	}
+
+	QFont font = font_;
+	font.setBold((variant & VARIANT_BOLD) != 0);
+	font.setItalic((variant & VARIANT_ITALIC) != 0);
+	font.setUnderline((variant & VARIANT_UNDERLINE) != 0);
+
+	QTextLayout layout(text, font);
+	layout.setCacheEnabled(true);
+	layout.beginLayout();
+	layout.createLine().setNumColumns(text.size());
+	layout.endLayout();
+
+	auto runs = new QList<QGlyphRun>(layout.glyphRuns());
+	glyphCache_.insert(key, runs, std::max(1, text.size()));
+	return *runs;
 }
 
 /**
@@ -3194,10 +3292,15 @@ void TextArea::TextDResize(bool widthChanged) {
 	   lines in the buffer, and can leave the top line number incorrect, and
 	   the top character no longer pointing at a valid line start */
 	if (continuousWrap_ && wrapMargin_ == 0 && widthChanged) {
+		/* Counting the lines of the whole buffer takes as long as the buffer
+		   is large, so the counts from before the change stand in until they
+		   have been counted again, in the background */
 		const TextCursor oldFirstChar = firstChar_;
-		nBufferLines_ = TextDCountLines(buffer_->BufStartOfBuffer(), buffer_->BufEndOfBuffer(), /*startPosIsLineStart=*/true);
+		wrapIndex_.invalidate();
+		wrapIndexTimer_->start();
+		nBufferLines_ = wrapIndex_.totalLines();
 		firstChar_    = TextDStartOfLine(firstChar_);
-		topLineNum_   = TextDCountLines(buffer_->BufStartOfBuffer(), firstChar_, /*startPosIsLineStart=*/true) + 1;
+		topLineNum_   = wrappedLinesBefore(firstChar_) + 1;
 		redrawAll     = true;
 		offsetAbsLineNum(oldFirstChar);
 	}
@@ -3323,7 +3426,12 @@ void TextArea::offsetLineStarts(int newTopLineNum) {
 	   lineStarts array) */
 	const int lastLineNum = oldTopLineNum + nVisLines - 1;
 
-	if (newTopLineNum < oldTopLineNum && newTopLineNum < -lineDelta) {
+	if (continuousWrap_ && wrapIndex_.complete() && std::abs(lineDelta) >= nVisLines) {
+		// a jump rather than a scroll, count from the nearest block of the wrap index
+		int linesBefore;
+		const TextCursor blockStart = wrapIndex_.findLine(newTopLineNum - 1, &linesBefore);
+		firstChar_ = TextDCountForwardNLines(blockStart, newTopLineNum - 1 - linesBefore, true);
+	} else if (newTopLineNum < oldTopLineNum && newTopLineNum < -lineDelta) {
 		firstChar_ = TextDCountForwardNLines(buffer_->BufStartOfBuffer(), newTopLineNum - 1, true);
 	} else if (newTopLineNum < oldTopLineNum) {
 		firstChar_ = TextDCountBackwardNLines(firstChar_, -lineDelta);
@@ -6392,6 +6500,60 @@ int TextArea::lineNumberAreaWidth() const {
 	return lineNumberArea_->width();
 }
 
+/*
+** Count the display lines before "lineStartPos", which must be at the start
+** of one, from the beginning of the buffer. In continuous wrap mode only the
+** lines of the wrap index block which holds it have to be counted. Until the
+** index is complete the result is an estimate, and the lines in the block
+** aren't wrapped either, as the block may still be a very large one.
+*/
+int TextArea::wrappedLinesBefore(TextCursor lineStartPos) {
+
+	if (!continuousWrap_ || !wrapIndex_.enabled()) {
+		return TextDCountLines(buffer_->BufStartOfBuffer(), lineStartPos, /*startPosIsLineStart=*/true);
+	}
+
+	int linesBefore;
+	const TextCursor blockStart = wrapIndex_.findPosition(lineStartPos, &linesBefore);
+
+	if (!wrapIndex_.complete()) {
+		return linesBefore + static_cast<int>(buffer_->BufCountLines(blockStart, lineStartPos));
+	}
+
+	return linesBefore + TextDCountLines(blockStart, lineStartPos, /*startPosIsLineStart=*/true);
+}
+
+/*
+** Count the display lines of another chunk of the buffer for the wrap index,
+** while idle.  Once it is complete, the line counts which were estimated
+** from it are replaced with the real ones.
+*/
+void TextArea::updateWrapIndex() {
+
+	if (!continuousWrap_ || wrapIndex_.complete()) {
+		wrapIndexTimer_->stop();
+		return;
+	}
+
+	wrapIndex_.update(buffer_, WRAP_INDEX_CHUNK, [this](TextCursor startPos, TextCursor endPos) {
+		return TextDCountLines(startPos, endPos, /*startPosIsLineStart=*/true);
+	});
+
+	if (!wrapIndex_.complete()) {
+		return;
+	}
+
+	wrapIndexTimer_->stop();
+
+	nBufferLines_ = wrapIndex_.totalLines();
+	topLineNum_   = wrappedLinesBefore(firstChar_) + 1;
+
+	updateVScrollBarRange();
+	if (auto blocker = no_signals(verticalScrollBar())) {
+		blocker->setValue(topLineNum_);
+	}
+}
+
 /*
 ** Define area for drawing line numbers. A width of 0 disables line
 ** number drawing.
@@ -6407,14 +6569,24 @@ void TextArea::TextDSetWrapMode(bool wrap, int wrapMargin) {
 	continuousWrap_ = wrap;
 	wrapMargin_     = wrapMargin;
 
-	// wrapping can change change the total number of lines, re-count
-	nBufferLines_ = TextDCountLines(buffer_->BufStartOfBuffer(), buffer_->BufEndOfBuffer(), /*startPosIsLineStart=*/true);
+	/* wrapping can change change the total number of lines, re-count. When
+	 * wrapping, that is done in the background, starting with the number of
+	 * unwrapped lines as an estimate */
+	if (continuousWrap_) {
+		wrapIndex_.reset(buffer_->BufGetLength(), static_cast<int>(buffer_->BufCountLines(buffer_->BufStartOfBuffer(), buffer_->BufEndOfBuffer())));
+		wrapIndexTimer_->start();
+		nBufferLines_ = wrapIndex_.totalLines();
+	} else {
+		wrapIndex_.clear();
+		wrapIndexTimer_->stop();
+		nBufferLines_ = TextDCountLines(buffer_->BufStartOfBuffer(), buffer_->BufEndOfBuffer(), /*startPosIsLineStart=*/true);
+	}
 
 	/* changing wrap margins wrap or changing from wrapped mode to non-wrapped
 	 * can leave the character at the top no longer at a line start, and/or
 	 * change the line number */
 	firstChar_  = TextDStartOfLine(firstChar_);
-	topLineNum_ = TextDCountLines(buffer_->BufStartOfBuffer(), firstChar_, /*startPosIsLineStart=*/true) + 1;
+	topLineNum_ = wrappedLinesBefore(firstChar_) + 1;
 	resetAbsLineNum();
 
 	// update the line starts array
@@ -6732,8 +6904,12 @@ void TextArea::setFont(const QFont &font) {
 	font_ = font;
 	updateFontMetrics(font);
 
-	// force recalculation of font related parameters
-	TextDResize(false);
+	// everything has to be shaped again in the new font
+	glyphCache_.clear();
+
+	/* force recalculation of font related parameters, how many characters
+	   fit on a line changes too, so wrapped lines have to be counted again */
+	TextDResize(/*widthChanged=*/true);
 
 	// force a recalc of the line numbers
 	setLineNumCols(getLineNumCols());
@@ -7169,10 +7345,10 @@ int64_t TextArea::getBufferLinesCount() const {
 ** character - 65 (ASCII code for 'A')) into fonts and colors; and a callback
 ** mechanism for as-needed highlighting, triggered by a style buffer entry of
 ** "unfinishedStyle".  Style buffer can trigger additional redisplay during
-** a normal buffer modification if the buffer contains a primary selection
+** a normal buffer modification if the buffer has a changed range marked
 ** (see extendRangeForStyleMods for more information on this protocol).
 */
-void TextArea::TextDAttachHighlightData(const std::shared_ptr<TextBuffer> &styleBuffer, const std::vector<StyleTableEntry> &styleTable, uint32_t unfinishedStyle, unfinishedStyleCBProcEx unfinishedHighlightCB, void *user) {
+void TextArea::TextDAttachHighlightData(const std::shared_ptr<StyleBuffer> &styleBuffer, const std::vector<StyleTableEntry> &styleTable, uint32_t unfinishedStyle, unfinishedStyleCBProcEx unfinishedHighlightCB, void *user) {
 	styleBuffer_           = styleBuffer;
 	styleTable_            = styleTable;
 	unfinishedStyle_       = unfinishedStyle;
@@ -7193,7 +7369,7 @@ TextCursor TextArea::TextLastVisiblePos() const {
 	return lastChar_;
 }
 
-const std::shared_ptr<TextBuffer> &TextArea::getStyleBuffer() const {
+const std::shared_ptr<StyleBuffer> &TextArea::getStyleBuffer() const {
 	return styleBuffer_;
 }
 
@@ -7269,7 +7445,7 @@ std::string TextArea::TextGetWrapped(TextCursor startPos, TextCursor endPos) {
 	return outBuf.BufGetAllEx();
 }
 
-void TextArea::setStyleBuffer(const std::shared_ptr<TextBuffer> &buffer) {
+void TextArea::setStyleBuffer(const std::shared_ptr<StyleBuffer> &buffer) {
 	styleBuffer_ = buffer;
 }
 
@@ -9,12 +9,16 @@
 #include "StyleTableEntry.h"
 #include "TextBufferFwd.h"
 #include "TextCursor.h"
+#include "WrapIndex.h"
 #include "Util/string_view.h"
 
 #include <QAbstractScrollArea>
+#include <QCache>
 #include <QColor>
 #include <QFlags>
 #include <QFont>
+#include <QGlyphRun>
+#include <QList>
 #include <QPointer>
 #include <QRect>
 #include <QTime>
@@ -28,6 +32,7 @@
 class CallTipWidget;
 class TextArea;
 class DocumentWidget;
+class StyleBuffer;
 struct DragEndEvent;
 struct SmartIndentEvent;
 
@@ -44,6 +49,21 @@ using dragStartCBEx           = void (*)(TextArea *, void *);
 using dragEndCBEx             = void (*)(TextArea *, const DragEndEvent *, void *);
 using smartIndentCBEx         = void (*)(TextArea *, SmartIndentEvent *, void *);
 
+/* Identifies the glyphs which a run of text is shaped into, when it is drawn
+   in one of the variations (bold, italic, underlined) of a text area's font */
+struct GlyphRunKey {
+	QString text;
+	int     variant;
+};
+
+inline bool operator==(const GlyphRunKey &lhs, const GlyphRunKey &rhs) {
+	return lhs.variant == rhs.variant && lhs.text == rhs.text;
+}
+
+inline uint qHash(const GlyphRunKey &key, uint seed = 0) {
+	return qHash(key.text, seed) ^ static_cast<uint>(key.variant);
+}
+
 class TextArea final : public QAbstractScrollArea {
 	Q_OBJECT
 
@@ -206,7 +226,7 @@ public:
 	TextCursor TextGetCursorPos() const;
 	TextCursor TextLastVisiblePos() const;
 	bool TextDPosToLineAndCol(TextCursor pos, int *line, int *column);
-	const std::shared_ptr<TextBuffer> &getStyleBuffer() const;
+	const std::shared_ptr<StyleBuffer> &getStyleBuffer() const;
 	int TextDGetCalltipID(int id) const;
 	int TextDMaxFontWidth() const;
 	int TextDMinFontWidth() const;
@@ -223,7 +243,7 @@ public:
 	int64_t getBufferLinesCount() const;
 	std::string TextGetWrapped(TextCursor startPos, TextCursor endPos);
 	void RemoveWidgetHighlightEx();
-	void TextDAttachHighlightData(const std::shared_ptr<TextBuffer> &styleBuffer, const std::vector<StyleTableEntry> &styleTable, uint32_t unfinishedStyle, unfinishedStyleCBProcEx unfinishedHighlightCB, void *user);	
+	void TextDAttachHighlightData(const std::shared_ptr<StyleBuffer> &styleBuffer, const std::vector<StyleTableEntry> &styleTable, uint32_t unfinishedStyle, unfinishedStyleCBProcEx unfinishedHighlightCB, void *user);	
 	void TextDKillCalltip(int id);
 	void TextDMaintainAbsLineNum(bool state);
 	void TextDMakeSelectionVisible();
@@ -242,7 +262,7 @@ public:
 	void setOverstrike(bool value);
 	void setReadOnly(bool value);
 	void setSmartIndent(bool value);
-	void setStyleBuffer(const std::shared_ptr<TextBuffer> &buffer);
+	void setStyleBuffer(const std::shared_ptr<StyleBuffer> &buffer);
 	void setWordDelimiters(const std::string &delimiters);
 	void setWrapMargin(int value);
 	int lineNumberAreaWidth() const;
@@ -287,6 +307,7 @@ private:
 	int getLineNumWidth() const;	
 	int stringWidth(int length) const;
 	int TextDCountLines(TextCursor startPos, TextCursor endPos, bool startPosIsLineStart);
+	int wrappedLinesBefore(TextCursor lineStartPos);
 	int TextDOffsetWrappedColumn(int row, int column) const;
 	int TextDOffsetWrappedRow(int row) const;
 	int TextDPreferredColumn(int *visLineNum, TextCursor *lineStartPos);
@@ -336,6 +357,7 @@ private:
 	void checkMoveSelectionChange(EventFlags flags, TextCursor startPos);
 	void drawCursor(QPainter *painter, int x, int y);
 	void drawString(QPainter *painter, uint32_t style, int x, int y, int toX, const char *string, int nChars);
+	const QList<QGlyphRun> &glyphRuns(const QString &text, int variant);
 	void endDrag();
 	void extendRangeForStyleMods(TextCursor *start, TextCursor *end);
 	void findLineEnd(TextCursor startPos, bool startPosIsLineStart, TextCursor *lineEnd, TextCursor *nextLineStart);
@@ -357,6 +379,7 @@ private:
 	void updateFontMetrics(const QFont &font);
 	bool updateLineStarts(TextCursor pos, int64_t charsInserted, int64_t charsDeleted, int64_t linesInserted, int64_t linesDeleted);
 	void updateVScrollBarRange();
+	void updateWrapIndex();
 	void wrappedLineCounter(const TextBuffer *buf, TextCursor startPos, TextCursor maxPos, int maxLines, bool startPosIsLineStart, TextCursor *retPos, int *retLines, TextCursor *retLineStart, TextCursor *retLineEnd) const;
 	void xyToUnconstrainedPos(const QPoint &pos, int *row, int *column, PositionTypes posType) const;
 	void xyToUnconstrainedPos(int x, int y, int *row, int *column, PositionTypes posType) const;
@@ -374,6 +397,7 @@ private:
 	QTimer *clickTimer_             = nullptr;
 	QTimer *cursorBlinkTimer_       = nullptr;
 	QTimer *resizeTimer_            = nullptr;
+	QTimer *wrapIndexTimer_         = nullptr;        // counts the wrapped lines of the buffer again while idle, after the width changes
 	QWidget *lineNumberArea_        = nullptr;
 	QPoint cursor_                  = { -100, -100 }; // X pos. of last drawn cursor Note: these are used for *drawing* and are not generally reliable for finding the insert position's x/y coordinates!
 	QVector<TextCursor> lineStarts_ = { TextCursor() };
@@ -405,6 +429,7 @@ private:
 	QPoint btnDownCoord_;                           // Mark the position of last btn down action for deciding when to begin paying attention to motion actions, and where to paste columns
 	QPoint clickPos_;
 	QPoint mouseCoord_;                             // Last known mouse position in drag operation (for autoscroll)
+	QCache<GlyphRunKey, QList<QGlyphRun>> glyphCache_; // shaped runs of text recently drawn, so redrawing them needn't lay them out again
 	QPointer<CallTipWidget> calltipWidget_;
 	TextBuffer *buffer_;                            // Contains text to be displayed
 	TextCursor anchor_;                             // Anchor for drag operations
@@ -436,12 +461,13 @@ private:
 	int64_t dragRectStart_;
 	int64_t dragSourceDeleted_;                     // # of chars. deleted when move source text was deleted
 	int64_t dragSourceInserted_;                    // # of chars. inserted when move source text was inserted	
-	std::shared_ptr<TextBuffer> styleBuffer_;       // Optional parallel buffer containing color and font information
+	std::shared_ptr<StyleBuffer> styleBuffer_;      // Optional parallel buffer containing color and font information
 	std::string delimiters_;
 	std::unique_ptr<TextBuffer> dragOrigBuf_;       // backup buffer copy used during block dragging of selections
 	std::vector<QColor> bgClassColors_;             // table of colors for each BG class
 	std::vector<StyleTableEntry> styleTable_;       // Table of fonts and colors for coloring/syntax-highlighting
 	std::vector<uint8_t> bgClass_;                  // obtains index into bgClassColors_
+	WrapIndex wrapIndex_;                           // display lines per block of text, in continuous wrap mode
 	uint32_t unfinishedStyle_;                      // Style buffer entry which triggers on-the-fly reparsing of region
 	unfinishedStyleCBProcEx unfinishedHighlightCB_; // Callback to parse "unfinished" regions
 	void *highlightCBArg_;                          // Arg to unfinishedHighlightCB
@@ -3,14 +3,20 @@
 #define TEXT_BUFFER_H_
 
 #include "gap_buffer.h"
+#include "line_index.h"
+#include "piece_table.h"
+#include "text_snapshot.h"
 #include "TextBufferFwd.h"
 #include "TextCursor.h"
+#include "Util/Kernels.h"
 #include "Util/string_view.h"
 
 #include <gsl/gsl_util>
 
 #include <deque>
+#include <memory>
 #include <string>
+#include <vector>
 #include <cstdint>
 
 #include <boost/optional.hpp>
@@ -83,9 +89,10 @@ public:
 	bool BufSetSyncXSelection(bool sync);
 	boost::optional<TextCursor> BufSearchBackwardEx(TextCursor startPos, view_type searchChars) const noexcept;
 	boost::optional<TextCursor> BufSearchForwardEx(TextCursor startPos, view_type searchChars) const noexcept;
+	boost::optional<TextCursor> BufMapEditGroupPosition(TextCursor pos) const noexcept;
 	Ch BufGetCharacter(TextCursor pos) const noexcept;
 	int64_t BufCountDispChars(TextCursor lineStartPos, TextCursor targetPos) const noexcept;
-	int64_t BufCountLines(TextCursor startPos, TextCursor endPos) const noexcept;
+	int64_t BufCountLines(TextCursor startPos, TextCursor endPos) const;
 	int64_t BufGetLength() const noexcept;
 	int BufCmpEx(TextCursor pos, Ch ch) const noexcept;
 	int BufCmpEx(TextCursor pos, Ch *cmpText, int64_t size) const noexcept;
@@ -98,41 +105,44 @@ public:
 	string_type BufGetSecSelectTextEx() const;
 	string_type BufGetSelectionTextEx() const;
 	string_type BufGetTextInRectEx(TextCursor start, TextCursor end, int64_t rectStart, int64_t rectEnd) const;
-	TextCursor BufCountBackwardNLines(TextCursor startPos, int64_t nLines) const noexcept;
+	text_snapshot<Ch, Tr> BufSnapshot() const;
+	TextCursor BufCountBackwardNLines(TextCursor startPos, int64_t nLines) const;
 	TextCursor BufCountForwardDispChars(TextCursor lineStartPos, int64_t nChars) const noexcept;
-	TextCursor BufCountForwardNLines(TextCursor startPos, int64_t nLines) const noexcept;
+	TextCursor BufCountForwardNLines(TextCursor startPos, int64_t nLines) const;
 	TextCursor BufCursorPosHint() const noexcept;
 	TextCursor BufEndOfLine(TextCursor pos) const noexcept;
 	TextCursor BufStartOfLine(TextCursor pos) const noexcept;
 	TextCursor BufEndOfBuffer() const noexcept;
 	TextCursor BufStartOfBuffer() const noexcept;
-	view_type BufAsStringEx() noexcept;
+	view_type BufAsStringEx();
+	view_type BufAsStringEx(TextCursor start, TextCursor end);
 	void BufAddHighPriorityModifyCB(modify_callback_type bufModifiedCB, void *user);
 	void BufAddModifyCB(modify_callback_type bufModifiedCB, void *user);
 	void BufAddPreDeleteCB(pre_delete_callback_type bufPreDeleteCB, void *user);
-	void BufAppendEx(Ch ch) noexcept;
-	void BufAppendEx(view_type text) noexcept;
+	void BufAppendEx(Ch ch);
+	void BufAppendEx(view_type text);
+	void BufBeginEditGroup() noexcept;
 	void BufCheckDisplay(TextCursor start, TextCursor end) const noexcept;
-	void BufClearRect(TextCursor start, TextCursor end, int64_t rectStart, int64_t rectEnd) noexcept;
-	void BufCopyFromBuf(BasicTextBuffer *fromBuf, TextCursor fromStart, TextCursor fromEnd, TextCursor toPos) noexcept;
+	void BufClearRect(TextCursor start, TextCursor end, int64_t rectStart, int64_t rectEnd);
+	void BufCopyFromBuf(BasicTextBuffer *fromBuf, TextCursor fromStart, TextCursor fromEnd, TextCursor toPos);
 	void BufHighlight(TextCursor start, TextCursor end) noexcept;
 	void BufInsertColEx(int64_t column, TextCursor startPos, view_type text, int64_t *charsInserted, int64_t *charsDeleted) noexcept;
-	void BufInsertEx(TextCursor pos, Ch ch) noexcept;
-	void BufInsertEx(TextCursor pos, view_type text) noexcept;
-	void BufOverlayRectEx(TextCursor startPos, int64_t rectStart, int64_t rectEnd, view_type text, int64_t *charsInserted, int64_t *charsDeleted) noexcept;
+	void BufInsertEx(TextCursor pos, Ch ch);
+	void BufInsertEx(TextCursor pos, view_type text);
+	void BufOverlayRectEx(TextCursor startPos, int64_t rectStart, int64_t rectEnd, view_type text, int64_t *charsInserted, int64_t *charsDeleted);
 	void BufRectHighlight(TextCursor start, TextCursor end, int64_t rectStart, int64_t rectEnd) noexcept;
 	void BufRectSelect(TextCursor start, TextCursor end, int64_t rectStart, int64_t rectEnd) noexcept;
 	void BufRemoveModifyCB(modify_callback_type bufModifiedCB, void *user) noexcept;
 	void BufRemovePreDeleteCB(pre_delete_callback_type bufPreDeleteCB, void *user) noexcept;
-	void BufRemoveRect(TextCursor start, TextCursor end, int64_t rectStart, int64_t rectEnd) noexcept;
-	void BufRemoveSecSelect() noexcept;
-	void BufRemoveSelected() noexcept;
-	void BufRemove(TextCursor start, TextCursor end) noexcept;
-	void BufReplaceEx(TextCursor start, TextCursor end, Ch ch) noexcept;
-	void BufReplaceEx(TextCursor start, TextCursor end, view_type text) noexcept;
+	void BufRemoveRect(TextCursor start, TextCursor end, int64_t rectStart, int64_t rectEnd);
+	void BufRemoveSecSelect();
+	void BufRemoveSelected();
+	void BufRemove(TextCursor start, TextCursor end);
+	void BufReplaceEx(TextCursor start, TextCursor end, Ch ch);
+	void BufReplaceEx(TextCursor start, TextCursor end, view_type text);
 	void BufReplaceRectEx(TextCursor start, TextCursor end, int64_t rectStart, int64_t rectEnd, view_type text);
-	void BufReplaceSecSelectEx(view_type text) noexcept;
-	void BufReplaceSelectedEx(view_type text) noexcept;
+	void BufReplaceSecSelectEx(view_type text);
+	void BufReplaceSelectedEx(view_type text);
 	void BufSecondarySelect(TextCursor start, TextCursor end) noexcept;
 	void BufSecondaryUnselect() noexcept;
 	void BufSecRectSelect(TextCursor start, TextCursor end, int64_t rectStart, int64_t rectEnd) noexcept;
@@ -140,6 +150,8 @@ public:
 	void BufSelect(TextCursor start, TextCursor end) noexcept;	
 	void BufSelect(std::pair<TextCursor, TextCursor> range) noexcept;
 	void BufSetAll(view_type text);
+	void BufSetAll(std::shared_ptr<const Ch> text, int64_t length);
+	void BufEndEditGroup() noexcept;
 	void BufSetTabDistance(int distance, bool notify) noexcept;
 	void BufSetUseTabs(bool useTabs) noexcept;
 	void BufUnhighlight() noexcept;
@@ -151,22 +163,27 @@ public:
 private:
 	boost::optional<TextCursor> searchBackward(TextCursor startPos, Ch searchChar) const noexcept;
 	boost::optional<TextCursor> searchForward(TextCursor startPos, Ch searchChar) const noexcept;
-	int64_t insertEx(TextCursor pos, view_type text) noexcept;
-	int64_t insertEx(TextCursor pos, Ch ch) noexcept;
+	boost::optional<TextCursor> findFirstOf(TextCursor start, TextCursor end, view_type searchChars) const noexcept;
+	boost::optional<TextCursor> findLastOf(TextCursor start, TextCursor end, view_type searchChars) const noexcept;
+	int64_t insertEx(TextCursor pos, view_type text);
+	int64_t insertEx(TextCursor pos, Ch ch);
 	string_type getSelectionTextEx(const Selection *sel) const;
 	void callModifyCBs(TextCursor pos, int64_t nDeleted, int64_t nInserted, int64_t nRestyled, view_type deletedText) const noexcept;
 	void callPreDeleteCBs(TextCursor pos, int64_t nDeleted) const noexcept;
-	void deleteRange(TextCursor start, TextCursor end) noexcept;
+	void deleteRange(TextCursor start, TextCursor end);
+	void groupModification(TextCursor pos, int64_t nDeleted, int64_t nInserted, int64_t nRestyled, view_type deletedText) const noexcept;
+	string_type textBeforeEdit(TextCursor start, TextCursor end, TextCursor pos, int64_t nDeleted, int64_t nInserted, view_type deletedText) const;
 	void deleteRect(TextCursor start, TextCursor end, int64_t rectStart, int64_t rectEnd, int64_t *replaceLen, TextCursor *endPos);
 	void findRectSelBoundariesForCopy(TextCursor lineStartPos, int64_t rectStart, int64_t rectEnd, TextCursor *selStart, TextCursor *selEnd) const noexcept;
 	void insertColEx(int64_t column, TextCursor startPos, view_type insText, int64_t *nDeleted, int64_t *nInserted, TextCursor *endPos);
 	void overlayRectEx(TextCursor startPos, int64_t rectStart, int64_t rectEnd, view_type insText, int64_t *nDeleted, int64_t *nInserted, TextCursor *endPos);
 	void redisplaySelection(const Selection *oldSelection, Selection *newSelection) const noexcept;
-	void removeSelected(const Selection *sel) noexcept;
-	void replaceSelectedEx(Selection *sel, view_type text) noexcept;
+	void removeSelected(const Selection *sel);
+	void replaceSelectedEx(Selection *sel, view_type text);
 	void updateSelections(TextCursor pos, int64_t nDeleted, int64_t nInserted) noexcept;
 	void sanitizeRange(TextCursor &start, TextCursor &end) const noexcept;
 	void updatePrimarySelection() noexcept;
+	const line_index<Ch, Tr> &lineIndex() const;
 
 private:
 	static string_type unexpandTabs(view_type text, int64_t startIndent, int tabDist);
@@ -193,7 +210,42 @@ private:
 	bool syncXSelection_      = true;
 
 private:
-	gap_buffer<Ch> buffer_;
+#if defined(PIECE_TABLE)
+	piece_table<Ch, Tr> buffer_;
+#else
+	gap_buffer<Ch, Tr> buffer_;
+#endif
+	mutable line_index<Ch, Tr> lineIndex_; // built the first time a long range of lines is counted
+
+private:
+	struct GroupedEdit {
+		TextCursor pos;
+		int64_t nDeleted;
+		int64_t nInserted;
+	};
+
+	/* A range changed by one or more nearby edits of an edit group */
+	struct GroupedRange {
+		TextCursor start  = {};      // start of the changed range
+		int64_t oldLength = 0;       // length of the changed range before the group
+		int64_t newLength = 0;       // length of the changed range now
+		string_type head;            // original text of the changed range which came before "text", reversed
+		string_type text;            // original text of the rest of the changed range
+
+		TextCursor end() const noexcept { return start + newLength; }
+	};
+
+	/* Modifications made while an edit group is open. Edits which are close
+	 * together are merged into a single change of the range they fall into */
+	struct EditGroup {
+		int depth = 0;                                       // number of BufBeginEditGroup calls not yet ended
+		std::vector<GroupedRange> ranges;                    // the changed ranges, in order, in terms of the current text
+		std::vector<GroupedEdit> edits;                      // the individual edits, in order
+		const std::vector<GroupedEdit> *committed = nullptr; // edits of the group being reported to the modify callbacks
+		int64_t committedShift = 0;                          // how far the ranges already reported have moved the text after them
+	};
+
+	mutable EditGroup group_;
 
 private:
 	std::deque<std::pair<pre_delete_callback_type, void *>> preDeleteProcs_; // procedures to call before text is deleted from the buffer; at most one is supported.
@@ -209,5 +261,6 @@ public:
 
 extern template class BasicTextBuffer<char>;
 extern template class gap_buffer<char>;
+extern template class piece_table<char>;
 
 #endif
@@ -26,10 +26,20 @@ auto BasicTextBuffer<Ch, Tr>::BufGetAllEx() const -> string_type {
 ** contiguous characters
 */
 template <class Ch, class Tr>
-auto BasicTextBuffer<Ch, Tr>::BufAsStringEx() noexcept -> view_type {
+auto BasicTextBuffer<Ch, Tr>::BufAsStringEx() -> view_type {
 	return buffer_.to_view();
 }
 
+/*
+** Get the text between "start" and "end" as a read-only view of contiguous
+** characters. Only the storage of that range is rearranged to do so, and the
+** view is good until the buffer is next modified or viewed
+*/
+template <class Ch, class Tr>
+auto BasicTextBuffer<Ch, Tr>::BufAsStringEx(TextCursor start, TextCursor end) -> view_type {
+	return buffer_.to_view(to_integer(start), to_integer(end));
+}
+
 /*
 ** Replace the entire contents of the text buffer
 */
@@ -44,6 +54,7 @@ void BasicTextBuffer<Ch, Tr>::BufSetAll(view_type text) {
 	const string_type deletedText = BufGetAllEx();
 
 	buffer_.assign(text);
+	lineIndex_.invalidate();
 
 	// Zero all of the existing selections
 	updateSelections(BufStartOfBuffer(), static_cast<int64_t>(deletedText.size()), 0);
@@ -52,6 +63,45 @@ void BasicTextBuffer<Ch, Tr>::BufSetAll(view_type text) {
 	callModifyCBs(BufStartOfBuffer(), deletedText.size(), length, 0, deletedText);
 }
 
+/*
+** Replace the entire contents of the text buffer with "length" characters
+** which the buffer may go on referring to rather than copying (for example
+** the text of a large file, just read). The memory is never written to and is
+** released once the buffer no longer needs it.
+*/
+template <class Ch, class Tr>
+void BasicTextBuffer<Ch, Tr>::BufSetAll(std::shared_ptr<const Ch> text, int64_t length) {
+
+	callPreDeleteCBs(BufStartOfBuffer(), buffer_.size());
+
+	// Save information for redisplay, and get rid of the old buffer
+	const string_type deletedText = BufGetAllEx();
+
+	buffer_.assign_shared(std::move(text), length);
+	lineIndex_.invalidate();
+
+	// Zero all of the existing selections
+	updateSelections(BufStartOfBuffer(), static_cast<int64_t>(deletedText.size()), 0);
+
+	// Call the saved display routine(s) to update the screen
+	callModifyCBs(BufStartOfBuffer(), deletedText.size(), length, 0, deletedText);
+}
+
+/*
+** Get the entire contents of a text buffer as a snapshot, which stays valid
+** however the buffer changes afterwards and may be read by another thread.
+** A piece table shares its storage with the snapshot, a gap buffer can only
+** give it a copy.
+*/
+template <class Ch, class Tr>
+auto BasicTextBuffer<Ch, Tr>::BufSnapshot() const -> text_snapshot<Ch, Tr> {
+#if defined(PIECE_TABLE)
+	return buffer_.snapshot();
+#else
+	return text_snapshot<Ch, Tr>(buffer_.to_string());
+#endif
+}
+
 /*
 ** Return a copy of the text between "start" and "end" character positions
 ** from text buffer "buf".  Positions start at 0, and the range does not
@@ -81,7 +131,7 @@ Ch BasicTextBuffer<Ch, Tr>::BufGetCharacter(TextCursor pos) const noexcept {
 ** Insert null-terminated string "text" at position "pos" in "buf"
 */
 template <class Ch, class Tr>
-void BasicTextBuffer<Ch, Tr>::BufInsertEx(TextCursor pos, view_type text) noexcept {
+void BasicTextBuffer<Ch, Tr>::BufInsertEx(TextCursor pos, view_type text) {
 
 	// if pos is not contiguous to existing text, make it
 	if (pos > BufEndOfBuffer()) {
@@ -102,7 +152,7 @@ void BasicTextBuffer<Ch, Tr>::BufInsertEx(TextCursor pos, view_type text) noexce
 }
 
 template <class Ch, class Tr>
-void BasicTextBuffer<Ch, Tr>::BufInsertEx(TextCursor pos, Ch ch) noexcept {
+void BasicTextBuffer<Ch, Tr>::BufInsertEx(TextCursor pos, Ch ch) {
 
 	// if pos is not contiguous to existing text, make it
 	if (pos > BufEndOfBuffer()) {
@@ -127,14 +177,15 @@ void BasicTextBuffer<Ch, Tr>::BufInsertEx(TextCursor pos, Ch ch) noexcept {
 ** string "text" in their place in in "buf"
 */
 template <class Ch, class Tr>
-void BasicTextBuffer<Ch, Tr>::BufReplaceEx(TextCursor start, TextCursor end, view_type text) noexcept {
+void BasicTextBuffer<Ch, Tr>::BufReplaceEx(TextCursor start, TextCursor end, view_type text) {
 
 	sanitizeRange(start, end);
 
 	const auto nInserted = static_cast<int64_t>(text.size());
 
 	callPreDeleteCBs(start, end - start);
-	const string_type deletedText = BufGetRangeEx(start, end);
+	// a scratch buffer with no one listening has no use for the deleted text
+	const string_type deletedText = modifyProcs_.empty() ? string_type() : BufGetRangeEx(start, end);
 
 	deleteRange(start, end);
 	insertEx(start, text);
@@ -147,14 +198,14 @@ void BasicTextBuffer<Ch, Tr>::BufReplaceEx(TextCursor start, TextCursor end, vie
 ** character "ch in their place in in "buf"
 */
 template <class Ch, class Tr>
-void BasicTextBuffer<Ch, Tr>::BufReplaceEx(TextCursor start, TextCursor end, Ch ch) noexcept {
+void BasicTextBuffer<Ch, Tr>::BufReplaceEx(TextCursor start, TextCursor end, Ch ch) {
 
 	sanitizeRange(start, end);
 
 	const auto nInserted = 1;
 
 	callPreDeleteCBs(start, end - start);
-	const string_type deletedText = BufGetRangeEx(start, end);
+	const string_type deletedText = modifyProcs_.empty() ? string_type() : BufGetRangeEx(start, end);
 
 	deleteRange(start, end);
 	insertEx(start, ch);
@@ -163,14 +214,14 @@ void BasicTextBuffer<Ch, Tr>::BufReplaceEx(TextCursor start, TextCursor end, Ch
 }
 
 template <class Ch, class Tr>
-void BasicTextBuffer<Ch, Tr>::BufRemove(TextCursor start, TextCursor end) noexcept {
+void BasicTextBuffer<Ch, Tr>::BufRemove(TextCursor start, TextCursor end) {
 
 	sanitizeRange(start, end);
 
 	callPreDeleteCBs(start, end - start);
 
 	// Remove and redisplay
-	const string_type deletedText = BufGetRangeEx(start, end);
+	const string_type deletedText = modifyProcs_.empty() ? string_type() : BufGetRangeEx(start, end);
 
 	deleteRange(start, end);
 	cursorPosHint_ = start;
@@ -178,11 +229,12 @@ void BasicTextBuffer<Ch, Tr>::BufRemove(TextCursor start, TextCursor end) noexce
 }
 
 template <class Ch, class Tr>
-void BasicTextBuffer<Ch, Tr>::BufCopyFromBuf(BasicTextBuffer<Ch, Tr> *fromBuf, TextCursor fromStart, TextCursor fromEnd, TextCursor toPos) noexcept {
+void BasicTextBuffer<Ch, Tr>::BufCopyFromBuf(BasicTextBuffer<Ch, Tr> *fromBuf, TextCursor fromStart, TextCursor fromEnd, TextCursor toPos) {
 
 	const int64_t length = (fromEnd - fromStart);
 
 	buffer_.insert(to_integer(toPos), fromBuf->buffer_.to_view(to_integer(fromStart), to_integer(fromEnd)));
+	lineIndex_.insert(buffer_, to_integer(toPos), length);
 
 	updateSelections(toPos, 0, length);
 }
@@ -309,7 +361,7 @@ void BasicTextBuffer<Ch, Tr>::overlayRectEx(TextCursor startPos, int64_t rectSta
 ** If rectEnd equals -1, the width of the inserted text is measured first.
 */
 template <class Ch, class Tr>
-void BasicTextBuffer<Ch, Tr>::BufOverlayRectEx(TextCursor startPos, int64_t rectStart, int64_t rectEnd, view_type text, int64_t *charsInserted, int64_t *charsDeleted) noexcept {
+void BasicTextBuffer<Ch, Tr>::BufOverlayRectEx(TextCursor startPos, int64_t rectStart, int64_t rectEnd, view_type text, int64_t *charsInserted, int64_t *charsDeleted) {
 
 	int64_t insertDeleted;
 	int64_t nInserted;
@@ -412,7 +464,7 @@ void BasicTextBuffer<Ch, Tr>::BufReplaceRectEx(TextCursor start, TextCursor end,
 ** and end and horizontal displayed-character offsets rectStart and rectEnd.
 */
 template <class Ch, class Tr>
-void BasicTextBuffer<Ch, Tr>::BufRemoveRect(TextCursor start, TextCursor end, int64_t rectStart, int64_t rectEnd) noexcept {
+void BasicTextBuffer<Ch, Tr>::BufRemoveRect(TextCursor start, TextCursor end, int64_t rectStart, int64_t rectEnd) {
 
 	start = BufStartOfLine(start);
 	end   = BufEndOfLine(end);
@@ -433,7 +485,7 @@ void BasicTextBuffer<Ch, Tr>::BufRemoveRect(TextCursor start, TextCursor end, in
 ** rectEnd.
 */
 template <class Ch, class Tr>
-void BasicTextBuffer<Ch, Tr>::BufClearRect(TextCursor start, TextCursor end, int64_t rectStart, int64_t rectEnd) noexcept {
+void BasicTextBuffer<Ch, Tr>::BufClearRect(TextCursor start, TextCursor end, int64_t rectStart, int64_t rectEnd) {
 
 	const int64_t nLines = BufCountLines(start, end);
 	const string_type newlineString(static_cast<size_t>(nLines), Ch('\n'));
@@ -613,12 +665,12 @@ auto BasicTextBuffer<Ch, Tr>::BufGetSelectionTextEx() const -> string_type {
 }
 
 template <class Ch, class Tr>
-void BasicTextBuffer<Ch, Tr>::BufRemoveSelected() noexcept {
+void BasicTextBuffer<Ch, Tr>::BufRemoveSelected() {
 	removeSelected(&primary);
 }
 
 template <class Ch, class Tr>
-void BasicTextBuffer<Ch, Tr>::BufReplaceSelectedEx(view_type text) noexcept {
+void BasicTextBuffer<Ch, Tr>::BufReplaceSelectedEx(view_type text) {
 	replaceSelectedEx(&primary, text);
 }
 
@@ -653,12 +705,12 @@ auto BasicTextBuffer<Ch, Tr>::BufGetSecSelectTextEx() const -> string_type {
 }
 
 template <class Ch, class Tr>
-void BasicTextBuffer<Ch, Tr>::BufRemoveSecSelect() noexcept {
+void BasicTextBuffer<Ch, Tr>::BufRemoveSecSelect() {
 	removeSelected(&secondary);
 }
 
 template <class Ch, class Tr>
-void BasicTextBuffer<Ch, Tr>::BufReplaceSecSelectEx(view_type text) noexcept {
+void BasicTextBuffer<Ch, Tr>::BufReplaceSecSelectEx(view_type text) {
 	replaceSelectedEx(&secondary, text);
 }
 
@@ -743,6 +795,91 @@ void BasicTextBuffer<Ch, Tr>::BufRemovePreDeleteCB(pre_delete_callback_type bufP
 	qCritical("NEdit: Internal Error: Can't find pre-delete CB to remove");
 }
 
+/*
+** Open an edit group. Until the matching BufEndEditGroup, modifications are
+** made to the text right away, but rather than being reported to the modify
+** callbacks one at a time, edits which are close together are merged into a
+** single replacement of the range they fall into. These are reported, in
+** order, when the group ends. This makes a long run of small edits cost a
+** redisplay for each part of the text it changed, rather than for each edit,
+** without holding on to the text between edits which are far apart. Groups
+** may be nested, only the outermost one counts.
+**
+** Pre-delete callbacks are still called for each of the edits. While a group
+** is open, anything which follows the buffer through its modify callbacks
+** (the line starts and cursor of a text area, rangesets, syntax highlighting)
+** is out of step with the text, so groups must be ended before control goes
+** back to anything which might use them.
+*/
+template <class Ch, class Tr>
+void BasicTextBuffer<Ch, Tr>::BufBeginEditGroup() noexcept {
+	++group_.depth;
+}
+
+/*
+** End an edit group opened by BufBeginEditGroup, reporting what changed to
+** the modify callbacks if this ends the outermost group
+*/
+template <class Ch, class Tr>
+void BasicTextBuffer<Ch, Tr>::BufEndEditGroup() noexcept {
+
+	if (group_.depth == 0 || --group_.depth != 0 || group_.ranges.empty()) {
+		return;
+	}
+
+	std::vector<GroupedRange> ranges;
+	ranges.swap(group_.ranges);
+
+	std::vector<GroupedEdit> edits;
+	edits.swap(group_.edits);
+
+	/* the ranges are in terms of the final text, reporting them from the
+	   first one on means that the text before each of them is already what
+	   the callbacks have been told about */
+	group_.committed      = &edits;
+	group_.committedShift = 0;
+
+	for (const GroupedRange &range : ranges) {
+		string_type deletedText(range.head.rbegin(), range.head.rend());
+		deletedText.append(range.text);
+
+		callModifyCBs(range.start, range.oldLength, range.newLength, 0, deletedText);
+		group_.committedShift += range.newLength - range.oldLength;
+	}
+
+	group_.committed = nullptr;
+}
+
+/*
+** While the modify callbacks are being told about a range changed by an edit
+** group, map "pos" from before that range was changed to where it would be if
+** it had been moved along with each of the group's edits in turn (like a text
+** cursor, positions inside a deleted range move to its start). Otherwise,
+** returns boost::none.
+*/
+template <class Ch, class Tr>
+boost::optional<TextCursor> BasicTextBuffer<Ch, Tr>::BufMapEditGroupPosition(TextCursor pos) const noexcept {
+
+	if (!group_.committed) {
+		return boost::none;
+	}
+
+	// back to where it was before any of the group's edits
+	pos -= group_.committedShift;
+
+	for (const GroupedEdit &edit : *group_.committed) {
+		if (pos > edit.pos) {
+			if (pos < edit.pos + edit.nDeleted) {
+				pos = edit.pos;
+			} else {
+				pos += edit.nInserted - edit.nDeleted;
+			}
+		}
+	}
+
+	return pos;
+}
+
 /**
  * @brief BasicTextBuffer<Ch, Tr>::BufEndOfBuffer
  * @return
@@ -919,22 +1056,18 @@ TextCursor BasicTextBuffer<Ch, Tr>::BufCountForwardDispChars(TextCursor lineStar
 ** The character at position "endPos" is not counted.
 */
 template <class Ch, class Tr>
-int64_t BasicTextBuffer<Ch, Tr>::BufCountLines(TextCursor startPos, TextCursor endPos) const noexcept {
+int64_t BasicTextBuffer<Ch, Tr>::BufCountLines(TextCursor startPos, TextCursor endPos) const {
 
-	int64_t lineCount = 0;
-
-	TextCursor pos = startPos;
-
-	while (pos < BufEndOfBuffer()) {
-		if (pos == endPos) {
-			return lineCount;
-		}
+	// an end before the start means count to the end of the buffer
+	const int64_t start = to_integer(startPos);
+	const int64_t end   = (endPos < startPos) ? buffer_.size() : std::min<int64_t>(to_integer(endPos), buffer_.size());
 
-		if (buffer_[to_integer(pos++)] == Ch('\n')) {
-			lineCount++;
-		}
+	if (end - start <= line_index<Ch, Tr>::BlockSize) {
+		return line_index<Ch, Tr>::count_newlines(buffer_, start, end);
 	}
-	return lineCount;
+
+	const line_index<Ch, Tr> &index = lineIndex();
+	return index.count_lines(buffer_, end) - index.count_lines(buffer_, start);
 }
 
 /*
@@ -942,7 +1075,7 @@ int64_t BasicTextBuffer<Ch, Tr>::BufCountLines(TextCursor startPos, TextCursor e
 ** in "buf" and return its position
 */
 template <class Ch, class Tr>
-TextCursor BasicTextBuffer<Ch, Tr>::BufCountForwardNLines(TextCursor startPos, int64_t nLines) const noexcept {
+TextCursor BasicTextBuffer<Ch, Tr>::BufCountForwardNLines(TextCursor startPos, int64_t nLines) const {
 
 	int64_t lineCount = 0;
 
@@ -950,9 +1083,11 @@ TextCursor BasicTextBuffer<Ch, Tr>::BufCountForwardNLines(TextCursor startPos, i
 		return startPos;
 	}
 
-	TextCursor pos = startPos;
+	// nearby lines are quicker to find by just looking for them
+	TextCursor pos       = startPos;
+	const TextCursor end = std::min(BufEndOfBuffer(), startPos + line_index<Ch, Tr>::BlockSize);
 
-	while (pos < BufEndOfBuffer()) {
+	while (pos < end) {
 		if (buffer_[to_integer(pos++)] == Ch('\n')) {
 			lineCount++;
 			if (lineCount >= nLines) {
@@ -960,7 +1095,18 @@ TextCursor BasicTextBuffer<Ch, Tr>::BufCountForwardNLines(TextCursor startPos, i
 			}
 		}
 	}
-	return pos;
+
+	if (pos == BufEndOfBuffer()) {
+		return pos;
+	}
+
+	const line_index<Ch, Tr> &index = lineIndex();
+	const int64_t lineStart = index.line_start(buffer_, index.count_lines(buffer_, to_integer(startPos)) + nLines);
+	if (lineStart == -1) {
+		return BufEndOfBuffer();
+	}
+
+	return TextCursor(lineStart);
 }
 
 /*
@@ -970,26 +1116,38 @@ TextCursor BasicTextBuffer<Ch, Tr>::BufCountForwardNLines(TextCursor startPos, i
 ** the line
 */
 template <class Ch, class Tr>
-TextCursor BasicTextBuffer<Ch, Tr>::BufCountBackwardNLines(TextCursor startPos, int64_t nLines) const noexcept {
+TextCursor BasicTextBuffer<Ch, Tr>::BufCountBackwardNLines(TextCursor startPos, int64_t nLines) const {
 	if(startPos == BufStartOfBuffer()) {
 		return BufStartOfBuffer();
 	}
 
-	TextCursor pos    = startPos - 1;
-	int64_t lineCount = -1;
+	// nearby lines are quicker to find by just looking for them
+	TextCursor pos       = startPos - 1;
+	const TextCursor end = std::max(BufStartOfBuffer(), startPos - line_index<Ch, Tr>::BlockSize);
+	int64_t lineCount    = -1;
 
 	while (true) {
 		if (buffer_[to_integer(pos)] == Ch('\n')) {
 			if (++lineCount >= nLines)
 				return (pos + 1);
 		}
-		if(pos == BufStartOfBuffer()) {
+		if(pos == end) {
 			break;
 		}
 		--pos;
 	}
 
-	return BufStartOfBuffer();
+	if (end == BufStartOfBuffer()) {
+		return BufStartOfBuffer();
+	}
+
+	const line_index<Ch, Tr> &index = lineIndex();
+	const int64_t line = index.count_lines(buffer_, to_integer(startPos)) - nLines;
+	if (line < 1) {
+		return BufStartOfBuffer();
+	}
+
+	return TextCursor(index.line_start(buffer_, line));
 }
 
 /*
@@ -998,19 +1156,7 @@ TextCursor BasicTextBuffer<Ch, Tr>::BufCountBackwardNLines(TextCursor startPos,
 */
 template <class Ch, class Tr>
 boost::optional<TextCursor> BasicTextBuffer<Ch, Tr>::BufSearchForwardEx(TextCursor startPos, view_type searchChars) const noexcept {
-
-	TextCursor pos = startPos;
-
-	while (pos < BufEndOfBuffer()) {
-		for (Ch ch : searchChars) {
-			if (buffer_[to_integer(pos)] == ch) {
-				return pos;
-			}
-		}
-		++pos;
-	}
-
-	return boost::none;
+	return findFirstOf(startPos, BufEndOfBuffer(), searchChars);
 }
 
 /*
@@ -1019,26 +1165,7 @@ boost::optional<TextCursor> BasicTextBuffer<Ch, Tr>::BufSearchForwardEx(TextCurs
 */
 template <class Ch, class Tr>
 boost::optional<TextCursor> BasicTextBuffer<Ch, Tr>::BufSearchBackwardEx(TextCursor startPos, view_type searchChars) const noexcept {
-
-	if (startPos == BufStartOfBuffer()) {
-		return boost::none;
-	}
-
-	TextCursor pos = startPos - 1;
-
-	while (true) {
-		for (Ch ch : searchChars) {
-			if (buffer_[to_integer(pos)] == ch) {
-				return pos;
-			}
-		}
-		if(pos == BufStartOfBuffer()) {
-			break;
-		}
-		--pos;
-	}
-
-	return boost::none;
+	return findLastOf(BufStartOfBuffer(), startPos, searchChars);
 }
 
 /*
@@ -1069,10 +1196,11 @@ int BasicTextBuffer<Ch, Tr>::BufCmpEx(TextCursor pos, Ch ch) const noexcept {
 ** the buffer (i.e. not past the end).
 */
 template <class Ch, class Tr>
-int64_t BasicTextBuffer<Ch, Tr>::insertEx(TextCursor pos, view_type text) noexcept {
+int64_t BasicTextBuffer<Ch, Tr>::insertEx(TextCursor pos, view_type text) {
 	const auto length = static_cast<int64_t>(text.size());
 
 	buffer_.insert(to_integer(pos), text);
+	lineIndex_.insert(buffer_, to_integer(pos), length);
 
 	updateSelections(pos, 0, length);
 
@@ -1080,11 +1208,12 @@ int64_t BasicTextBuffer<Ch, Tr>::insertEx(TextCursor pos, view_type text) noexce
 }
 
 template <class Ch, class Tr>
-int64_t BasicTextBuffer<Ch, Tr>::insertEx(TextCursor pos, Ch ch) noexcept {
+int64_t BasicTextBuffer<Ch, Tr>::insertEx(TextCursor pos, Ch ch) {
 
 	const int64_t length = 1;
 
 	buffer_.insert(to_integer(pos), ch);
+	lineIndex_.insert(buffer_, to_integer(pos), length);
 
 	updateSelections(pos, 0, length);
 
@@ -1100,16 +1229,7 @@ int64_t BasicTextBuffer<Ch, Tr>::insertEx(TextCursor pos, Ch ch) noexcept {
 */
 template <class Ch, class Tr>
 boost::optional<TextCursor> BasicTextBuffer<Ch, Tr>::searchForward(TextCursor startPos, Ch searchChar) const noexcept {
-
-	TextCursor pos = startPos;
-	while (pos < BufEndOfBuffer()) {
-		if (buffer_[to_integer(pos)] == searchChar) {
-			return pos;
-		}
-		++pos;
-	}
-
-	return boost::none;
+	return findFirstOf(startPos, BufEndOfBuffer(), view_type(&searchChar, 1));
 }
 
 /*
@@ -1121,24 +1241,53 @@ boost::optional<TextCursor> BasicTextBuffer<Ch, Tr>::searchForward(TextCursor st
 */
 template <class Ch, class Tr>
 boost::optional<TextCursor> BasicTextBuffer<Ch, Tr>::searchBackward(TextCursor startPos, Ch searchChar) const noexcept {
+	return findLastOf(BufStartOfBuffer(), startPos, view_type(&searchChar, 1));
+}
 
-	if (startPos == BufStartOfBuffer()) {
-		return boost::none;
-	}
+/*
+** Find the first character between "start" and "end" which is one of
+** "searchChars", a span of the buffer at a time
+*/
+template <class Ch, class Tr>
+boost::optional<TextCursor> BasicTextBuffer<Ch, Tr>::findFirstOf(TextCursor start, TextCursor end, view_type searchChars) const noexcept {
 
-	TextCursor pos = startPos - 1;
-	while (true) {
-		if (buffer_[to_integer(pos)] == searchChar) {
-			return pos;
+	boost::optional<TextCursor> result;
+	TextCursor spanStart = start;
+
+	buffer_.for_each_span(to_integer(start), std::min<int64_t>(to_integer(end), buffer_.size()), [&](view_type span) {
+		if (const Ch *p = Kernels::FindFirstOf(span.data(), span.data() + span.size(), searchChars)) {
+			result = spanStart + (p - span.data());
+			return false;
 		}
 
-		if(pos == BufStartOfBuffer()) {
-			break;
+		spanStart += static_cast<int64_t>(span.size());
+		return true;
+	});
+
+	return result;
+}
+
+/*
+** Find the last character between "start" and "end" which is one of
+** "searchChars", a span of the buffer at a time
+*/
+template <class Ch, class Tr>
+boost::optional<TextCursor> BasicTextBuffer<Ch, Tr>::findLastOf(TextCursor start, TextCursor end, view_type searchChars) const noexcept {
+
+	boost::optional<TextCursor> result;
+	TextCursor spanEnd = std::min(end, BufEndOfBuffer());
+
+	buffer_.for_each_span_reverse(to_integer(start), to_integer(spanEnd), [&](view_type span) {
+		if (const Ch *p = Kernels::FindLastOf(span.data(), span.data() + span.size(), searchChars)) {
+			result = spanEnd - (span.data() + span.size() - p);
+			return false;
 		}
-		--pos;
-	}
 
-	return boost::none;
+		spanEnd -= static_cast<int64_t>(span.size());
+		return true;
+	});
+
+	return result;
 }
 
 template <class Ch, class Tr>
@@ -1164,11 +1313,141 @@ auto BasicTextBuffer<Ch, Tr>::getSelectionTextEx(const Selection *sel) const ->
 template <class Ch, class Tr>
 void BasicTextBuffer<Ch, Tr>::callModifyCBs(TextCursor pos, int64_t nDeleted, int64_t nInserted, int64_t nRestyled, view_type deletedText) const noexcept {
 
+	if (modifyProcs_.empty()) {
+		return;
+	}
+
+	if (group_.depth != 0) {
+		groupModification(pos, nDeleted, nInserted, nRestyled, deletedText);
+		return;
+	}
+
 	for (const auto &pair : modifyProcs_) {
 		(pair.first)(pos, nInserted, nDeleted, nRestyled, deletedText, pair.second);
 	}
 }
 
+/*
+** Merge a modification, which has already been made to the text, into the
+** open edit group. If it is close to one or more of the ranges the group has
+** changed so far, they are merged into one which grows to cover it, picking
+** up the original text of whatever it now covers that the group hadn't
+** changed before. Otherwise it starts a range of its own.
+*/
+template <class Ch, class Tr>
+void BasicTextBuffer<Ch, Tr>::groupModification(TextCursor pos, int64_t nDeleted, int64_t nInserted, int64_t nRestyled, view_type deletedText) const noexcept {
+
+	// edits closer together than this are reported as one
+	constexpr int64_t NearbyDistance = 256;
+
+	string_type restyledText;
+
+	if (nDeleted == 0 && nInserted == 0) {
+		if (nRestyled == 0) {
+			return;
+		}
+
+		// restyled text is treated as if it were replaced by itself
+		restyledText = buffer_.to_string(to_integer(pos), to_integer(pos) + nRestyled);
+		deletedText  = restyledText;
+		nDeleted     = nRestyled;
+		nInserted    = nRestyled;
+	} else {
+		group_.edits.push_back(GroupedEdit{pos, nDeleted, nInserted});
+	}
+
+	// the ranges and the edit are all in terms of the text as it was just before this edit
+	const TextCursor editEnd = pos + nDeleted;
+	std::vector<GroupedRange> &ranges = group_.ranges;
+
+	auto first = std::lower_bound(ranges.begin(), ranges.end(), pos, [](const GroupedRange &range, TextCursor p) {
+		return range.end() + NearbyDistance < p;
+	});
+
+	auto last = first;
+	while (last != ranges.end() && last->start - NearbyDistance <= editEnd) {
+		++last;
+	}
+
+	// the ranges after the edit just move along with it
+	for (auto it = last; it != ranges.end(); ++it) {
+		it->start += nInserted - nDeleted;
+	}
+
+	if (first == last) {
+		GroupedRange range;
+		range.start     = pos;
+		range.oldLength = nDeleted;
+		range.newLength = nInserted;
+		range.text.assign(deletedText.begin(), deletedText.end());
+		ranges.insert(first, std::move(range));
+		return;
+	}
+
+	GroupedRange &range = *first;
+
+	// the edit bridges the gaps between several ranges, they become one
+	for (auto it = std::next(first); it != last; ++it) {
+		range.text.append(textBeforeEdit(range.end(), it->start, pos, nDeleted, nInserted, deletedText));
+		range.text.append(it->head.rbegin(), it->head.rend());
+		range.text.append(it->text);
+		range.oldLength += (it->start - range.end()) + it->oldLength;
+		range.newLength  = it->end() - range.start;
+	}
+
+	const TextCursor rangeStart = range.start;
+	const TextCursor rangeEnd   = range.end();
+
+	/* extend the range in front. The original text there is the deleted text,
+	   and whatever was between it and the range, which is now further along */
+	if (pos < rangeStart) {
+		const string_type prefix = textBeforeEdit(pos, rangeStart, pos, nDeleted, nInserted, deletedText);
+		range.head.append(prefix.rbegin(), prefix.rend());
+		range.oldLength += rangeStart - pos;
+		range.start = pos;
+	}
+
+	// and behind, where the text between the range and the edit hasn't moved
+	if (editEnd > rangeEnd) {
+		range.text.append(textBeforeEdit(rangeEnd, editEnd, pos, nDeleted, nInserted, deletedText));
+		range.oldLength += editEnd - rangeEnd;
+	}
+
+	range.newLength = (std::max(rangeEnd, editEnd) - range.start) + nInserted - nDeleted;
+
+	ranges.erase(std::next(first), last);
+}
+
+/*
+** Get the text between "start" and "end" as it was before an edit which has
+** already been made, in which "nDeleted" characters at "pos", "deletedText",
+** were replaced by "nInserted" characters
+*/
+template <class Ch, class Tr>
+auto BasicTextBuffer<Ch, Tr>::textBeforeEdit(TextCursor start, TextCursor end, TextCursor pos, int64_t nDeleted, int64_t nInserted, view_type deletedText) const -> string_type {
+
+	const TextCursor editEnd = pos + nDeleted;
+
+	string_type text;
+
+	if (start < pos) {
+		text.append(buffer_.to_string(to_integer(start), to_integer(std::min(end, pos))));
+	}
+
+	if (start < editEnd && end > pos) {
+		const int64_t from = std::max(start, pos) - pos;
+		const int64_t to   = std::min(end, editEnd) - pos;
+		text.append(deletedText.data() + from, static_cast<size_t>(to - from));
+	}
+
+	if (end > editEnd) {
+		const int64_t shift = nInserted - nDeleted;
+		text.append(buffer_.to_string(to_integer(std::max(start, editEnd)) + shift, to_integer(end) + shift));
+	}
+
+	return text;
+}
+
 /*
 ** Call the stored pre-delete callback procedure(s) for this buffer to update
 ** the changed area(s) on the screen and any other listeners.
@@ -1187,8 +1466,9 @@ void BasicTextBuffer<Ch, Tr>::callPreDeleteCBs(TextCursor pos, int64_t nDeleted)
 ** the delete).
 */
 template <class Ch, class Tr>
-void BasicTextBuffer<Ch, Tr>::deleteRange(TextCursor start, TextCursor end) noexcept {
+void BasicTextBuffer<Ch, Tr>::deleteRange(TextCursor start, TextCursor end) {
 
+	lineIndex_.erase(buffer_, to_integer(start), to_integer(end));
 	buffer_.erase(to_integer(start), to_integer(end));
 
 	// fix up any selections which might be affected by the change
@@ -1482,7 +1762,7 @@ void BasicTextBuffer<Ch, Tr>::redisplaySelection(const Selection *oldSelection,
 }
 
 template <class Ch, class Tr>
-void BasicTextBuffer<Ch, Tr>::removeSelected(const Selection *sel) noexcept {
+void BasicTextBuffer<Ch, Tr>::removeSelected(const Selection *sel) {
 
 	assert(sel);
 
@@ -1498,7 +1778,7 @@ void BasicTextBuffer<Ch, Tr>::removeSelected(const Selection *sel) noexcept {
 }
 
 template <class Ch, class Tr>
-void BasicTextBuffer<Ch, Tr>::replaceSelectedEx(Selection *sel, view_type text) noexcept {
+void BasicTextBuffer<Ch, Tr>::replaceSelectedEx(Selection *sel, view_type text) {
 
 	assert(sel);
 
@@ -1540,12 +1820,12 @@ int64_t BasicTextBuffer<Ch, Tr>::BufGetLength() const noexcept {
 }
 
 template <class Ch, class Tr>
-void BasicTextBuffer<Ch, Tr>::BufAppendEx(view_type text) noexcept {
+void BasicTextBuffer<Ch, Tr>::BufAppendEx(view_type text) {
 	BufInsertEx(TextCursor(BufGetLength()), text);
 }
 
 template <class Ch, class Tr>
-void BasicTextBuffer<Ch, Tr>::BufAppendEx(Ch ch) noexcept {
+void BasicTextBuffer<Ch, Tr>::BufAppendEx(Ch ch) {
 	BufInsertEx(TextCursor(BufGetLength()), ch);
 }
 
@@ -2203,4 +2483,18 @@ void BasicTextBuffer<Ch, Tr>::sanitizeRange(TextCursor &start, TextCursor &end)
 	end   = qBound(BufStartOfBuffer(), end,   BufEndOfBuffer());
 }
 
+/*
+** Return the index of line starts, building it first if the buffer has been
+** replaced since it was last used
+*/
+template <class Ch, class Tr>
+const line_index<Ch, Tr> &BasicTextBuffer<Ch, Tr>::lineIndex() const {
+
+	if (!lineIndex_.valid()) {
+		lineIndex_.build(buffer_);
+	}
+
+	return lineIndex_;
+}
+
 #endif
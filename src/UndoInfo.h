@@ -3,16 +3,14 @@
 #define UNDO_INFO_H_
 
 #include "TextCursor.h"
-#include <string>
+#include <cstddef>
+#include <cstdint>
 
 /* The accumulated list of undo operations can potentially consume huge
-   amounts of memory.  These tuning parameters determine how much undo infor-
-   mation is retained.  Normally, the list is kept between UNDO_OP_LIMIT and
-   UNDO_OP_TRIMTO in length (when the list reaches UNDO_OP_LIMIT, it is
-   trimmed to UNDO_OP_TRIMTO then allowed to grow back to UNDO_OP_LIMIT). */
-
-constexpr auto UNDO_OP_LIMIT  = 400u;
-constexpr auto UNDO_OP_TRIMTO = 200u;
+   amounts of memory.  Rather than keeping a fixed number of operations, the
+   list is trimmed (oldest operations first) whenever the text it holds grows
+   past the nedit.undoMemoryLimit preference, in megabytes.  The most recent
+   operation is always kept, however large it is. */
 
 enum UndoTypes {
 	UNDO_NOOP,
@@ -35,12 +33,16 @@ public:
 	~UndoInfo() noexcept                  = default;
 
 public:
-	std::string oldText;
 	UndoTypes type;
 	TextCursor startPos;
 	TextCursor endPos;	
 	bool inUndo          = false; // flag to indicate undo command on this record in progress. Redirects SaveUndoInfo to save the next modifications on the redo list instead of the undo list.
 	bool restoresToSaved = false; // flag to indicate undoing this operation will restore file to last saved (unmodified) state
+	bool joined          = false; // undone along with the record after it, they were made by the same edit group or macro
+	bool compressed      = false; // the text to restore is stored compressed
+	size_t textOffset    = 0;     // where the text to restore is stored in the owning UndoList's log
+	size_t textLength    = 0;     // how many bytes it takes up there
+	uint64_t serial      = 0;     // identifies an undo record, so that it can be found again later
 };
 
 #endif
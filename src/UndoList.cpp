@@ -0,0 +1,304 @@
+
+#include "UndoList.h"
+
+#include <QByteArray>
+
+#include <algorithm>
+#include <climits>
+#include <cstdint>
+#include <cstring>
+
+namespace {
+
+// records with less text than this aren't worth compressing
+constexpr size_t CompressThreshold = 4096;
+
+// zlib level, speed matters more than size here
+constexpr int CompressionLevel = 1;
+
+// how much text compressPending compresses per call. Larger records are
+// stored as a series of blocks of up to this much text, compressed separately
+constexpr size_t CompressBlockSize = 256 * 1024;
+
+/*
+** Append the text of a compressed record to "text". It is stored as a series
+** of blocks, each being its size followed by what qCompress made of it.
+*/
+void uncompress(const char *data, size_t length, std::string *text) {
+
+	while (length != 0) {
+		uint32_t size;
+		std::memcpy(&size, data, sizeof(size));
+
+		const QByteArray block = qUncompress(reinterpret_cast<const uchar *>(data + sizeof(size)), static_cast<int>(size));
+		text->append(block.constData(), static_cast<size_t>(block.size()));
+
+		data   += sizeof(size) + size;
+		length -= sizeof(size) + size;
+	}
+}
+
+}
+
+/**
+ * @brief UndoList::memoryUsage
+ * @return roughly how many bytes the list takes up
+ */
+size_t UndoList::memoryUsage() const noexcept {
+	return (log_.size() - logStart_) + partial_.size() + records_.size() * sizeof(UndoInfo);
+}
+
+/**
+ * @brief UndoList::frontText
+ * @return the text restored by the most recent record. It remains valid
+ * until this list is modified.
+ */
+view::string_view UndoList::frontText() {
+
+	const UndoInfo &undo = records_.front();
+
+	if (undo.compressed) {
+		scratch_.clear();
+		uncompress(&log_[undo.textOffset], undo.textLength, &scratch_);
+		return view::string_view(scratch_.data(), scratch_.size());
+	}
+
+	return view::string_view(&log_[undo.textOffset], undo.textLength);
+}
+
+/**
+ * @brief UndoList::appendText
+ * @param text
+ * @param direction
+ *
+ * Add text to the end (Forward) or the beginning (Backward) of the text the
+ * most recent record restores, for continuing a string of one character
+ * deletes or replaces
+ */
+void UndoList::appendText(view::string_view text, Direction direction) {
+
+	UndoInfo &undo = records_.front();
+
+	if (undo.compressed) {
+		expand(undo);
+	}
+
+	if (direction == Direction::Forward) {
+		log_.append(text.begin(), text.end());
+	} else {
+		log_.insert(undo.textOffset, text.data(), text.size());
+	}
+
+	undo.textLength += text.size();
+}
+
+/**
+ * @brief UndoList::clear
+ */
+void UndoList::clear() {
+	records_.clear();
+	std::string().swap(log_);
+	logStart_ = 0;
+	pending_  = 0;
+	resetPartial();
+	scratch_.clear();
+}
+
+/**
+ * @brief UndoList::compressPending
+ * @return true if there is more to do
+ *
+ * Compress the text of the records which have been added since the last time
+ * this was called, other than the most recent one, which may still be
+ * extended. They are done oldest first, and only about CompressBlockSize
+ * bytes of text are compressed per call. The text after what was compressed
+ * is then moved down to fill the space which was saved, which is only the
+ * recent part of the log.
+ */
+bool UndoList::compressPending() {
+
+	size_t work  = 0;
+	size_t saved = 0; // how far the records done so far have moved down
+
+	while (pending_ != 0 && work < CompressBlockSize) {
+		UndoInfo &undo      = records_[pending_];
+		const size_t offset = undo.textOffset - saved;
+
+		if (!undo.compressed && undo.textLength >= CompressThreshold && undo.textLength <= INT_MAX / 2) {
+			const size_t length    = std::min(CompressBlockSize, undo.textLength - partialDone_);
+			const QByteArray block = qCompress(reinterpret_cast<const uchar *>(&log_[undo.textOffset + partialDone_]), static_cast<int>(length), CompressionLevel);
+			const auto size        = static_cast<uint32_t>(block.size());
+
+			partial_.append(reinterpret_cast<const char *>(&size), sizeof(size));
+			partial_.append(block.constData(), size);
+			partialDone_ += length;
+			work         += length;
+
+			// the rest of it is left for next time
+			if (partialDone_ != undo.textLength) {
+				break;
+			}
+
+			// not worth it unless it saves at least an eighth
+			if (partial_.size() <= undo.textLength - undo.textLength / 8) {
+				std::copy(partial_.begin(), partial_.end(), &log_[offset]);
+				saved += undo.textLength - partial_.size();
+				undo.textLength = partial_.size();
+				undo.compressed = true;
+			} else if (offset != undo.textOffset) {
+				std::copy_n(&log_[undo.textOffset], undo.textLength, &log_[offset]);
+			}
+
+			resetPartial();
+		} else if (offset != undo.textOffset) {
+			std::copy_n(&log_[undo.textOffset], undo.textLength, &log_[offset]);
+		}
+
+		undo.textOffset = offset;
+		--pending_;
+	}
+
+	if (saved != 0) {
+		// move down the text of the records which haven't been done yet
+		log_.erase(records_[pending_].textOffset - saved, saved);
+
+		for (size_t i = 0; i <= pending_; ++i) {
+			records_[i].textOffset -= saved;
+		}
+
+		releaseSpace();
+	}
+
+	return pending_ != 0;
+}
+
+/**
+ * @brief UndoList::pop_front
+ *
+ * Remove the most recent record
+ */
+void UndoList::pop_front() {
+
+	log_.resize(records_.front().textOffset);
+	records_.pop_front();
+
+	if (pending_ != 0) {
+		--pending_;
+	}
+
+	// what was compressed of it is no use now that it can be extended again
+	if (pending_ == 0) {
+		resetPartial();
+	}
+
+	if (records_.empty()) {
+		clear();
+		return;
+	}
+
+	scratch_.clear();
+	releaseSpace();
+}
+
+/**
+ * @brief UndoList::push_front
+ * @param undo
+ * @param text
+ *
+ * Add "undo" as the most recent record, restoring "text"
+ */
+void UndoList::push_front(UndoInfo &&undo, view::string_view text) {
+
+	// the previous record can't be extended any more
+	if (!records_.empty()) {
+		++pending_;
+	}
+
+	undo.compressed = false;
+	undo.textOffset = log_.size();
+	undo.textLength = text.size();
+
+	log_.append(text.begin(), text.end());
+	records_.emplace_front(std::move(undo));
+}
+
+/**
+ * @brief UndoList::trim
+ * @param maxBytes
+ *
+ * Remove the oldest records until the list takes up no more than "maxBytes",
+ * the most recent record is always kept
+ */
+void UndoList::trim(size_t maxBytes) {
+
+	if (memoryUsage() <= maxBytes) {
+		return;
+	}
+
+	while (records_.size() > 1 && memoryUsage() > maxBytes) {
+		const UndoInfo &oldest = records_.back();
+		logStart_ = oldest.textOffset + oldest.textLength;
+		records_.pop_back();
+	}
+
+	if (pending_ > records_.size() - 1) {
+		pending_ = records_.size() - 1;
+		resetPartial();
+	}
+
+	// forget the trimmed text once it makes up most of the log
+	if (logStart_ > log_.size() / 2) {
+		log_.erase(0, logStart_);
+
+		for (UndoInfo &undo : records_) {
+			undo.textOffset -= logStart_;
+		}
+
+		logStart_ = 0;
+	}
+
+	releaseSpace();
+}
+
+/**
+ * @brief UndoList::expand
+ * @param undo
+ *
+ * Decompress the text of "undo", which must be the most recent record
+ */
+void UndoList::expand(UndoInfo &undo) {
+
+	std::string text;
+	uncompress(&log_[undo.textOffset], undo.textLength, &text);
+
+	log_.resize(undo.textOffset);
+	log_.append(text);
+	undo.textLength = text.size();
+	undo.compressed = false;
+}
+
+/**
+ * @brief UndoList::releaseSpace
+ *
+ * Give back memory left over from records which were much larger than what
+ * is left
+ */
+void UndoList::releaseSpace() {
+
+	constexpr size_t Slack = 1024 * 1024;
+
+	if (log_.capacity() > log_.size() * 2 + Slack) {
+		log_.shrink_to_fit();
+	}
+}
+
+/**
+ * @brief UndoList::resetPartial
+ *
+ * Forget what has been compressed so far of a record which hasn't been
+ * finished
+ */
+void UndoList::resetPartial() {
+	std::string().swap(partial_);
+	partialDone_ = 0;
+}
@@ -0,0 +1,63 @@
+
+#ifndef UNDO_LIST_H_
+#define UNDO_LIST_H_
+
+#include "Direction.h"
+#include "UndoInfo.h"
+#include "Util/string_view.h"
+
+#include <deque>
+#include <string>
+
+/*
+** A document's list of undo (or redo) records, most recent first. Rather
+** than a string per record, the text the records restore is kept in a single
+** append-only log, oldest first. The most recent record's text is always at
+** the end of the log, so adding, extending and removing it, and trimming the
+** oldest records, never copy more than the text involved.
+**
+** Once a record can no longer be extended, its text may be compressed if it
+** is large enough for that to be worthwhile. That is left to the owner to ask
+** for with compressPending, when the user is idle, as it means rewriting the
+** part of the log which was added since the last time. Each call does a
+** bounded amount of that work, so large records are compressed a block at a
+** time over several calls rather than holding up the caller.
+*/
+class UndoList {
+public:
+	using iterator = std::deque<UndoInfo>::iterator;
+
+public:
+	bool empty() const noexcept   { return records_.empty(); }
+	size_t size() const noexcept  { return records_.size(); }
+	UndoInfo &front()             { return records_.front(); }
+	iterator begin() noexcept     { return records_.begin(); }
+	iterator end() noexcept       { return records_.end(); }
+	bool hasPending() const noexcept { return pending_ != 0; }
+
+public:
+	size_t memoryUsage() const noexcept;
+	view::string_view frontText();
+	void appendText(view::string_view text, Direction direction);
+	void clear();
+	bool compressPending();
+	void pop_front();
+	void push_front(UndoInfo &&undo, view::string_view text);
+	void trim(size_t maxBytes);
+
+private:
+	void expand(UndoInfo &undo);
+	void releaseSpace();
+	void resetPartial();
+
+private:
+	std::deque<UndoInfo> records_;
+	std::string log_;
+	size_t logStart_    = 0; // text before this belongs to records which were trimmed
+	size_t pending_     = 0; // how many records after the first haven't been considered for compression
+	std::string partial_;    // the blocks compressed so far of the oldest of those records
+	size_t partialDone_ = 0; // how much of its text they cover
+	std::string scratch_;    // the front record's text, when it is compressed
+};
+
+#endif
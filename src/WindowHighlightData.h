@@ -3,25 +3,34 @@
 #define WINDOW_HIGHLIGHT_DATA_H_
 
 #include "HighlightData.h"
+#include "ParseCheckpoints.h"
 #include "ReparseContext.h"
 #include "StyleTableEntry.h"
 #include "TextBufferFwd.h"
+#include "TextCursor.h"
 
 #include <memory>
 #include <vector>
 
 class PatternSet;
+class StyleBuffer;
 
 // Data structure attached to window to hold all syntax highlighting
 // information (for both drawing and incremental reparsing)
 struct WindowHighlightData {
 	std::vector<uint8_t>             parentStyles;
 	std::vector<StyleTableEntry>     styleTable;
-	std::shared_ptr<TextBuffer>      styleBuffer;
+	std::shared_ptr<StyleBuffer>     styleBuffer;
 	std::unique_ptr<HighlightData[]> pass1Patterns;
 	std::unique_ptr<HighlightData[]> pass2Patterns;
 	PatternSet*                      patternSetForWindow = nullptr;
 	ReparseContext                   contextRequirements = { 0, 0 };
+	ParseCheckpoints                 checkpoints;      // known parse states, sorted by position
+
+	// progress of the idle time parsing of large documents
+	TextCursor                       parsedTo;         // the first pass is complete up to here
+	TextCursor                       provisionalStart; // on screen text beyond parsedTo, which was parsed early
+	TextCursor                       provisionalEnd;
 };
 
 #endif
@@ -0,0 +1,236 @@
+
+#include "WrapIndex.h"
+#include "TextBuffer.h"
+
+#include <algorithm>
+
+namespace {
+
+// how much text a block covers, roughly, blocks always end at a line end
+constexpr int64_t BlockSize = 64 * 1024;
+
+/* a block which grew past this (by large insertions) is split up again the
+   next time its lines are counted */
+constexpr int64_t MaxBlockSize = 4 * BlockSize;
+
+}
+
+/**
+ * @brief WrapIndex::complete
+ * @return true if all of the counts are up to date
+ */
+bool WrapIndex::complete() const noexcept {
+	return nInvalid_ == 0;
+}
+
+/**
+ * @brief WrapIndex::enabled
+ * @return false if the index isn't being kept at all (the text isn't being
+ * wrapped)
+ */
+bool WrapIndex::enabled() const noexcept {
+	return !blocks_.empty();
+}
+
+/**
+ * @brief WrapIndex::totalLines
+ * @return the number of display lines in the buffer, an estimate unless the
+ * index is complete
+ */
+int WrapIndex::totalLines() const noexcept {
+
+	int lines = 0;
+	for (const Block &block : blocks_) {
+		lines += block.lines;
+	}
+
+	return lines;
+}
+
+/**
+ * @brief WrapIndex::findLine
+ * @param line
+ * @param linesBefore
+ * @return the start of the block holding display line "line" (counting from
+ * zero), "linesBefore" is set to the number of display lines before it. A
+ * line past the end is in the last block.
+ */
+TextCursor WrapIndex::findLine(int line, int *linesBefore) const noexcept {
+
+	TextCursor start = {};
+	int before       = 0;
+
+	for (size_t i = 0; i + 1 < blocks_.size() && before + blocks_[i].lines <= line; ++i) {
+		before += blocks_[i].lines;
+		start  += blocks_[i].length;
+	}
+
+	*linesBefore = before;
+	return start;
+}
+
+/**
+ * @brief WrapIndex::findPosition
+ * @param pos
+ * @param linesBefore
+ * @return the start of the block holding "pos", "linesBefore" is set to the
+ * number of display lines before it
+ */
+TextCursor WrapIndex::findPosition(TextCursor pos, int *linesBefore) const noexcept {
+
+	TextCursor start = {};
+	int before       = 0;
+
+	for (size_t i = 0; i + 1 < blocks_.size() && start + blocks_[i].length <= pos; ++i) {
+		before += blocks_[i].lines;
+		start  += blocks_[i].length;
+	}
+
+	*linesBefore = before;
+	return start;
+}
+
+/**
+ * @brief WrapIndex::modified
+ * @param pos
+ * @param nInserted
+ * @param nDeleted
+ * @param lineDelta the change in the number of display lines
+ * @return true if some counts are now out of date, and update() should be
+ * called
+ *
+ * Keep the index in step with a modification of the buffer. A block boundary
+ * whose newline was deleted no longer is one, those blocks are merged.
+ */
+bool WrapIndex::modified(TextCursor pos, int64_t nInserted, int64_t nDeleted, int lineDelta) {
+
+	if (blocks_.empty()) {
+		return false;
+	}
+
+	// the block holding pos, or the last one if pos is at the end
+	size_t first     = 0;
+	TextCursor start = {};
+	while (first + 1 < blocks_.size() && start + blocks_[first].length <= pos) {
+		start += blocks_[first].length;
+		++first;
+	}
+
+	// along with those whose first character is the newline before them
+	size_t last    = first;
+	TextCursor end = start + blocks_[first].length;
+	while (last + 1 < blocks_.size() && end <= pos + nDeleted) {
+		++last;
+		end += blocks_[last].length;
+	}
+
+	Block &block = blocks_[first];
+	for (size_t i = first + 1; i <= last; ++i) {
+		block.length += blocks_[i].length;
+		block.lines  += blocks_[i].lines;
+
+		if (!blocks_[i].valid) {
+			--nInvalid_;
+			if (block.valid) {
+				block.valid = false;
+				++nInvalid_;
+			}
+		}
+	}
+
+	blocks_.erase(blocks_.begin() + static_cast<ptrdiff_t>(first + 1), blocks_.begin() + static_cast<ptrdiff_t>(last + 1));
+
+	block.length += nInserted - nDeleted;
+	block.lines  += lineDelta;
+
+	// a huge block would make finding anything in it slow, it gets split up
+	if (block.length > MaxBlockSize && block.valid) {
+		block.valid = false;
+		++nInvalid_;
+	}
+
+	return nInvalid_ != 0;
+}
+
+/**
+ * @brief WrapIndex::clear
+ *
+ * Stop keeping the index
+ */
+void WrapIndex::clear() {
+	blocks_.clear();
+	nInvalid_ = 0;
+}
+
+/**
+ * @brief WrapIndex::invalidate
+ *
+ * Mark all of the counts out of date, keeping them as estimates
+ */
+void WrapIndex::invalidate() {
+
+	for (Block &block : blocks_) {
+		block.valid = false;
+	}
+
+	nInvalid_ = blocks_.size();
+}
+
+/**
+ * @brief WrapIndex::reset
+ * @param length
+ * @param lines an estimate of the number of display lines
+ *
+ * Start the index over for a buffer of "length" characters, as a single
+ * block which update() splits up as it counts
+ */
+void WrapIndex::reset(int64_t length, int lines) {
+	blocks_.assign(1, Block{length, lines, false});
+	nInvalid_ = 1;
+}
+
+/**
+ * @brief WrapIndex::update
+ * @param buffer
+ * @param budget roughly how many characters to count
+ * @param countLines
+ *
+ * Count the display lines of out of date blocks, front to back, splitting up
+ * blocks which are too large on the way
+ */
+void WrapIndex::update(const TextBuffer *buffer, int64_t budget, const LineCounter &countLines) {
+
+	TextCursor start = {};
+
+	for (size_t i = 0; i < blocks_.size() && nInvalid_ != 0 && budget > 0; ++i) {
+
+		if (!blocks_[i].valid) {
+
+			// split off the front of a block which is too large
+			if (blocks_[i].length > MaxBlockSize) {
+				const TextCursor end = std::min(buffer->BufEndOfLine(start + BlockSize) + 1, start + blocks_[i].length);
+				const int64_t length = end - start;
+
+				if (length < blocks_[i].length) {
+					Block &rest = blocks_[i];
+					const int lines = static_cast<int>(rest.lines * length / rest.length);
+
+					rest.length -= length;
+					rest.lines  -= lines;
+
+					blocks_.insert(blocks_.begin() + static_cast<ptrdiff_t>(i), Block{length, lines, false});
+					++nInvalid_;
+				}
+			}
+
+			Block &block = blocks_[i];
+			block.lines  = countLines(start, start + block.length);
+			block.valid  = true;
+			--nInvalid_;
+
+			budget -= block.length;
+		}
+
+		start += blocks_[i].length;
+	}
+}
@@ -0,0 +1,53 @@
+
+#ifndef WRAP_INDEX_H_
+#define WRAP_INDEX_H_
+
+#include "TextBufferFwd.h"
+#include "TextCursor.h"
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+/*
+** The number of display lines in a continuously wrapped buffer, kept per
+** block of whole lines of text, so that the line number of a position (or the
+** position of a line number) can be found by counting the lines of a single
+** block rather than everything before it.
+**
+** Edits only change the count of the block they fall in, by the number of
+** lines the text area worked out they added or removed anyway. When the wrap
+** width changes all of the counts go out of date, they are then counted again
+** a block at a time by update(), in the background, and until then the old
+** counts stand in as estimates.
+*/
+class WrapIndex {
+public:
+	// counts the display lines in startPos..endPos, startPos being a line start
+	using LineCounter = std::function<int(TextCursor startPos, TextCursor endPos)>;
+
+public:
+	bool complete() const noexcept;
+	bool enabled() const noexcept;
+	int totalLines() const noexcept;
+	TextCursor findLine(int line, int *linesBefore) const noexcept;
+	TextCursor findPosition(TextCursor pos, int *linesBefore) const noexcept;
+	bool modified(TextCursor pos, int64_t nInserted, int64_t nDeleted, int lineDelta);
+	void clear();
+	void invalidate();
+	void reset(int64_t length, int lines);
+	void update(const TextBuffer *buffer, int64_t budget, const LineCounter &countLines);
+
+private:
+	struct Block {
+		int64_t length; // ends just after a newline, or at the end of the buffer
+		int     lines;  // display lines in the block, an estimate unless valid
+		bool    valid;
+	};
+
+private:
+	std::vector<Block> blocks_;
+	size_t nInvalid_ = 0;
+};
+
+#endif
@@ -88,8 +88,17 @@ public:
 	void replace(size_type start, size_type end, view_type str);
 	void replace(size_type start, size_type end, Ch ch);
 	void assign(view_type str);
+	void assign_shared(std::shared_ptr<const Ch> str, size_type length);
+	void detach();
 	void clear() noexcept;
 
+public:
+	template <class Func>
+	void for_each_span(size_type start, size_type end, Func func) const;
+
+	template <class Func>
+	void for_each_span_reverse(size_type start, size_type end, Func func) const;
+
 private:
 	void move_gap(size_type pos) noexcept;
 	void reallocate_buffer(size_type new_gap_start, size_type new_gap_size);
@@ -309,20 +318,16 @@ auto gap_buffer<Ch, Tr>::to_view(size_type start, size_type end) noexcept -> vie
 	assert(end   <= size() && end   >= 0);
 	assert(start <= end);
 
-	const size_type bufLen   = size();
-	size_type leftLen        = gap_start_;
-	const size_type rightLen = bufLen - leftLen;
-
-	// find where best to put the gap to minimise memory movement
-	if (leftLen != 0 && rightLen != 0) {
-		leftLen = (leftLen < rightLen) ? 0 : bufLen;
-		move_gap(leftLen);
+	/* only the range has to be contiguous, so the gap need only move if it
+	   splits the range, and then just to the nearer end of it */
+	if (start < gap_start_ && gap_start_ < end) {
+		move_gap((gap_start_ - start < end - gap_start_) ? start : end);
 	}
 
 	// get the start position of the actual data
-	Ch *const text = &buf_[(leftLen == 0) ? gap_end_ : 0];
+	Ch *const text = &buf_[(start < gap_start_) ? start : start + gap_size()];
 
-	return view_type(text + start, static_cast<size_t>(end - start));
+	return view_type(text, static_cast<size_t>(end - start));
 }
 
 /**
@@ -438,6 +443,28 @@ void gap_buffer<Ch, Tr>::assign(view_type str) {
 	replace(0, size(), str);
 }
 
+/**
+ * @brief gap_buffer<Ch, Tr>::assign_shared
+ * @param str
+ * @param length
+ *
+ * Provided for interface compatibility with piece_table, a gap buffer always
+ * owns its text, so this simply copies it.
+ */
+template <class Ch, class Tr>
+void gap_buffer<Ch, Tr>::assign_shared(std::shared_ptr<const Ch> str, size_type length) {
+	assign(view_type(str.get(), static_cast<size_t>(length)));
+}
+
+/**
+ * @brief gap_buffer<Ch, Tr>::detach
+ *
+ * A gap buffer always owns its text, so there is nothing to do
+ */
+template <class Ch, class Tr>
+void gap_buffer<Ch, Tr>::detach() {
+}
+
 /**
  *
  */
@@ -446,6 +473,59 @@ void gap_buffer<Ch, Tr>::clear() noexcept {
 	erase(0, size());
 }
 
+/**
+ * @brief gap_buffer<Ch, Tr>::for_each_span
+ * @param start
+ * @param end
+ * @param func
+ *
+ * Calls func(view_type) for the text between start and end on each side of
+ * the gap, in order, without moving the gap. func returns false to stop the
+ * iteration early
+ */
+template <class Ch, class Tr>
+template <class Func>
+void gap_buffer<Ch, Tr>::for_each_span(size_type start, size_type end, Func func) const {
+
+	if (start < gap_start_ && start < end) {
+		const size_type last = std::min(end, gap_start_);
+		if (!func(view_type(&buf_[start], static_cast<size_t>(last - start)))) {
+			return;
+		}
+		start = last;
+	}
+
+	if (start < end) {
+		func(view_type(&buf_[start + gap_size()], static_cast<size_t>(end - start)));
+	}
+}
+
+/**
+ * @brief gap_buffer<Ch, Tr>::for_each_span_reverse
+ * @param start
+ * @param end
+ * @param func
+ *
+ * Like for_each_span, but visits the spans from the end of the range to the
+ * start
+ */
+template <class Ch, class Tr>
+template <class Func>
+void gap_buffer<Ch, Tr>::for_each_span_reverse(size_type start, size_type end, Func func) const {
+
+	if (end > gap_start_ && start < end) {
+		const size_type first = std::max(start, gap_start_);
+		if (!func(view_type(&buf_[first + gap_size()], static_cast<size_t>(end - first)))) {
+			return;
+		}
+		end = first;
+	}
+
+	if (start < end) {
+		func(view_type(&buf_[start], static_cast<size_t>(end - start)));
+	}
+}
+
 /**
  *
  */
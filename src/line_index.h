@@ -0,0 +1,566 @@
+
+#ifndef LINE_INDEX_H_
+#define LINE_INDEX_H_
+
+#include "Util/Kernels.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <vector>
+
+/*
+** An index of where the lines of a text buffer start. The text is divided into
+** consecutive blocks of roughly BlockSize characters, and the length and
+** number of newlines of each block is kept in a pair of Fenwick trees. This
+** lets the buffer convert between positions and line numbers in O(log n)
+** time, with only a short scan of a single block at the end.
+**
+** The trees can't have blocks inserted into or removed from the middle of
+** them without being rebuilt, so the blocks are laid out with empty ones
+** between them. Erasing text leaves the blocks it empties in place, and a
+** block which has grown too large is split into the empty ones next to it
+** (moving its neighbours along if need be). Only when there is no room
+** nearby are the blocks laid out afresh.
+**
+** The index does not hold any text itself, the owner passes its storage to
+** the routines which need to look at characters, and must report every edit
+** via insert() (after the text was inserted) and erase() (before the text is
+** removed).
+*/
+template <class Ch, class Tr>
+class line_index {
+public:
+	static constexpr int64_t BlockSize = 4096;
+
+	// How far from a block to look for an empty one to split it into
+	static constexpr size_t MoveDistance = 16;
+
+	using size_type = int64_t;
+
+private:
+	struct block {
+		size_type length;
+		size_type newlines;
+	};
+
+public:
+	bool valid() const noexcept { return valid_; }
+	void invalidate() noexcept;
+
+public:
+	template <class Buffer>
+	void build(const Buffer &buffer);
+
+	template <class Buffer>
+	void insert(const Buffer &buffer, size_type pos, size_type length);
+
+	template <class Buffer>
+	void erase(const Buffer &buffer, size_type start, size_type end);
+
+public:
+	template <class Buffer>
+	size_type count_lines(const Buffer &buffer, size_type pos) const noexcept;
+
+	template <class Buffer>
+	size_type line_start(const Buffer &buffer, size_type line) const noexcept;
+
+public:
+	template <class Buffer>
+	static size_type count_newlines(const Buffer &buffer, size_type start, size_type end) noexcept;
+
+private:
+	template <class Buffer>
+	void split_block(const Buffer &buffer, size_t index, size_type blockStart);
+
+	size_t find_block(size_type pos, size_type *blockStart) const noexcept;
+	size_t find_newline_block(size_type line, size_type *blockStart, size_type *blockLine) const noexcept;
+	block prefix(size_t count) const noexcept;
+	void add(size_t index, size_type length, size_type newlines) noexcept;
+	void move(size_t from, size_t to) noexcept;
+	size_t make_room(size_t index, size_t count);
+	size_t layout(size_t index, size_t count);
+	void rebuild_trees();
+
+private:
+	std::vector<block> blocks_;       // Including empty ones, which are room for splitting the others into
+	std::vector<block> tree_;         // Fenwick tree over blocks_, 1-based
+	size_type          length_ = 0;
+	size_t             filled_ = 0;   // Number of blocks which aren't empty
+	bool               valid_  = false;
+};
+
+/**
+ * @brief line_index::invalidate
+ *
+ * Forget the index, it will need to be rebuilt before it can be used again
+ */
+template <class Ch, class Tr>
+void line_index<Ch, Tr>::invalidate() noexcept {
+	blocks_.clear();
+	tree_.clear();
+	length_ = 0;
+	filled_ = 0;
+	valid_  = false;
+}
+
+/**
+ * @brief line_index::build
+ * @param buffer
+ *
+ * Index the whole of "buffer"
+ */
+template <class Ch, class Tr>
+template <class Buffer>
+void line_index<Ch, Tr>::build(const Buffer &buffer) {
+
+	blocks_.clear();
+
+	const size_type size = buffer.size();
+	for (size_type start = 0; start < size; start += BlockSize) {
+		const size_type end = std::min(start + BlockSize, size);
+		blocks_.push_back(block{end - start, count_newlines(buffer, start, end)});
+	}
+
+	length_ = size;
+	valid_  = true;
+	layout(blocks_.size(), 0);
+}
+
+/**
+ * @brief line_index::insert
+ * @param buffer
+ * @param pos
+ * @param length
+ *
+ * Account for "length" characters which have just been inserted at "pos"
+ */
+template <class Ch, class Tr>
+template <class Buffer>
+void line_index<Ch, Tr>::insert(const Buffer &buffer, size_type pos, size_type length) {
+
+	if (!valid_ || length == 0) {
+		return;
+	}
+
+	const size_type newlines = count_newlines(buffer, pos, pos + length);
+
+	if (length_ == 0) {
+		length_ = length;
+		blocks_.assign(1, block{length, newlines});
+		layout(blocks_.size(), 0);
+
+		if (length > BlockSize * 2) {
+			split_block(buffer, 0, 0);
+		}
+		return;
+	}
+
+	// an insertion at the very end of the text extends the last block
+	size_type blockStart;
+	const size_t index = find_block(std::min(pos, length_ - 1), &blockStart);
+
+	length_ += length;
+	add(index, length, newlines);
+
+	if (blocks_[index].length > BlockSize * 2) {
+		split_block(buffer, index, blockStart);
+	}
+}
+
+/**
+ * @brief line_index::erase
+ * @param buffer
+ * @param start
+ * @param end
+ *
+ * Account for the characters between "start" and "end" which are about to be
+ * removed
+ */
+template <class Ch, class Tr>
+template <class Buffer>
+void line_index<Ch, Tr>::erase(const Buffer &buffer, size_type start, size_type end) {
+
+	if (!valid_ || start >= end) {
+		return;
+	}
+
+	size_type blockStart;
+	size_t index = find_block(start, &blockStart);
+
+	length_ -= end - start;
+
+	// trim every block the range touches, the ones left empty stay where they are
+	for (; index < blocks_.size() && blockStart < end; ++index) {
+		const block b = blocks_[index];
+
+		const size_type blockEnd = blockStart + b.length;
+		const size_type first    = std::max(start, blockStart);
+		const size_type last     = std::min(end, blockEnd);
+
+		if (first == blockStart && last == blockEnd) {
+			add(index, -b.length, -b.newlines);
+		} else if (first < last) {
+			add(index, -(last - first), -count_newlines(buffer, first, last));
+		}
+
+		blockStart = blockEnd;
+	}
+
+	// once most of the blocks are empty, it's time to tidy up
+	if (blocks_.size() > filled_ * 4 + MoveDistance) {
+		layout(blocks_.size(), 0);
+	}
+}
+
+/**
+ * @brief line_index::count_lines
+ * @param buffer
+ * @param pos
+ * @return the number of newlines before "pos"
+ */
+template <class Ch, class Tr>
+template <class Buffer>
+auto line_index<Ch, Tr>::count_lines(const Buffer &buffer, size_type pos) const noexcept -> size_type {
+
+	assert(valid_);
+
+	if (pos <= 0 || blocks_.empty()) {
+		return 0;
+	}
+
+	if (pos >= length_) {
+		return prefix(blocks_.size()).newlines;
+	}
+
+	size_type blockStart;
+	const size_t index    = find_block(pos, &blockStart);
+	const size_type lines = prefix(index).newlines;
+
+	// scan from whichever end of the block is closer
+	const block &b = blocks_[index];
+	if (pos - blockStart <= b.length / 2) {
+		return lines + count_newlines(buffer, blockStart, pos);
+	}
+
+	return lines + b.newlines - count_newlines(buffer, pos, blockStart + b.length);
+}
+
+/**
+ * @brief line_index::line_start
+ * @param buffer
+ * @param line
+ * @return the position just after newline number "line" (counting from 1),
+ * or -1 if the text does not have that many newlines
+ */
+template <class Ch, class Tr>
+template <class Buffer>
+auto line_index<Ch, Tr>::line_start(const Buffer &buffer, size_type line) const noexcept -> size_type {
+
+	assert(valid_);
+
+	if (line <= 0) {
+		return 0;
+	}
+
+	size_type blockStart;
+	size_type blockLine;
+	const size_t index = find_newline_block(line, &blockStart, &blockLine);
+	if (index == blocks_.size()) {
+		return -1;
+	}
+
+	size_type result = -1;
+	size_type spanStart = blockStart;
+
+	buffer.for_each_span(blockStart, blockStart + blocks_[index].length, [&](typename Buffer::view_type span) {
+		const Ch *first = span.data();
+		const Ch *last  = span.data() + span.size();
+
+		while (const Ch *p = Kernels::FindCharacter(first, last, Ch('\n'))) {
+			if (++blockLine == line) {
+				result = spanStart + (p - span.data()) + 1;
+				return false;
+			}
+			first = p + 1;
+		}
+
+		spanStart += static_cast<size_type>(span.size());
+		return true;
+	});
+
+	return result;
+}
+
+/**
+ * @brief line_index::count_newlines
+ * @param buffer
+ * @param start
+ * @param end
+ * @return
+ */
+template <class Ch, class Tr>
+template <class Buffer>
+auto line_index<Ch, Tr>::count_newlines(const Buffer &buffer, size_type start, size_type end) noexcept -> size_type {
+	size_type count = 0;
+	buffer.for_each_span(start, end, [&count](typename Buffer::view_type span) {
+		count += static_cast<size_type>(Kernels::CountCharacter(span.data(), span.data() + span.size(), Ch('\n')));
+		return true;
+	});
+	return count;
+}
+
+/**
+ * @brief line_index::split_block
+ * @param buffer
+ * @param index
+ * @param blockStart
+ *
+ * Break an oversized block back up into blocks of BlockSize characters
+ */
+template <class Ch, class Tr>
+template <class Buffer>
+void line_index<Ch, Tr>::split_block(const Buffer &buffer, size_t index, size_type blockStart) {
+
+	const block b = blocks_[index];
+
+	// halves of a block which has just grown too big, BlockSize pieces of a big insertion
+	const auto pieces = static_cast<size_t>(std::max<size_type>(b.length / BlockSize, 2));
+
+	index = make_room(index, pieces - 1);
+
+	for (size_t i = 0; i < pieces; ++i) {
+		const size_type start    = blockStart + b.length * static_cast<size_type>(i)     / static_cast<size_type>(pieces);
+		const size_type end      = blockStart + b.length * static_cast<size_type>(i + 1) / static_cast<size_type>(pieces);
+		const size_type newlines = count_newlines(buffer, start, end);
+
+		if (i == 0) {
+			add(index, (end - start) - b.length, newlines - b.newlines);
+		} else {
+			add(index + i, end - start, newlines);
+		}
+	}
+}
+
+/**
+ * @brief line_index::find_block
+ * @param pos
+ * @param blockStart
+ * @return the index of the block containing "pos", which must be within the
+ * text
+ */
+template <class Ch, class Tr>
+size_t line_index<Ch, Tr>::find_block(size_type pos, size_type *blockStart) const noexcept {
+
+	size_t mask = 1;
+	while (mask * 2 < tree_.size()) {
+		mask *= 2;
+	}
+
+	// find the number of whole blocks which end at or before "pos"
+	size_t index     = 0;
+	size_type offset = 0;
+	for (; mask != 0; mask /= 2) {
+		const size_t next = index + mask;
+		if (next < tree_.size() && offset + tree_[next].length <= pos) {
+			index   = next;
+			offset += tree_[next].length;
+		}
+	}
+
+	*blockStart = offset;
+	return index;
+}
+
+/**
+ * @brief line_index::find_newline_block
+ * @param line
+ * @param blockStart
+ * @param blockLine
+ * @return the index of the block containing newline number "line" (counting
+ * from 1), or blocks_.size() if there is no such newline
+ */
+template <class Ch, class Tr>
+size_t line_index<Ch, Tr>::find_newline_block(size_type line, size_type *blockStart, size_type *blockLine) const noexcept {
+
+	size_t mask = 1;
+	while (mask * 2 < tree_.size()) {
+		mask *= 2;
+	}
+
+	// find the number of whole blocks which contain fewer than "line" newlines
+	size_t index    = 0;
+	size_type lines = 0;
+	for (; mask != 0; mask /= 2) {
+		const size_t next = index + mask;
+		if (next < tree_.size() && lines + tree_[next].newlines < line) {
+			index  = next;
+			lines += tree_[next].newlines;
+		}
+	}
+
+	*blockStart = prefix(index).length;
+	*blockLine  = lines;
+	return index;
+}
+
+/**
+ * @brief line_index::prefix
+ * @param count
+ * @return the total length and newlines of the first "count" blocks
+ */
+template <class Ch, class Tr>
+auto line_index<Ch, Tr>::prefix(size_t count) const noexcept -> block {
+	block sum = {0, 0};
+	for (size_t i = count; i > 0; i -= i & (~i + 1)) {
+		sum.length   += tree_[i].length;
+		sum.newlines += tree_[i].newlines;
+	}
+	return sum;
+}
+
+/**
+ * @brief line_index::add
+ * @param index
+ * @param length
+ * @param newlines
+ */
+template <class Ch, class Tr>
+void line_index<Ch, Tr>::add(size_t index, size_type length, size_type newlines) noexcept {
+
+	const bool wasEmpty = (blocks_[index].length == 0);
+
+	blocks_[index].length   += length;
+	blocks_[index].newlines += newlines;
+
+	const bool isEmpty = (blocks_[index].length == 0);
+	if (wasEmpty != isEmpty) {
+		filled_ = isEmpty ? filled_ - 1 : filled_ + 1;
+	}
+
+	for (size_t i = index + 1; i < tree_.size(); i += i & (~i + 1)) {
+		tree_[i].length   += length;
+		tree_[i].newlines += newlines;
+	}
+}
+
+/**
+ * @brief line_index::move
+ * @param from
+ * @param to
+ *
+ * Move the contents of a block into an empty one
+ */
+template <class Ch, class Tr>
+void line_index<Ch, Tr>::move(size_t from, size_t to) noexcept {
+
+	assert(blocks_[to].length == 0);
+
+	const block b = blocks_[from];
+	add(to, b.length, b.newlines);
+	add(from, -b.length, -b.newlines);
+}
+
+/**
+ * @brief line_index::make_room
+ * @param index
+ * @param count
+ * @return the index of the block, which may have moved
+ *
+ * Make sure that the "count" blocks after block "index" are empty
+ */
+template <class Ch, class Tr>
+size_t line_index<Ch, Tr>::make_room(size_t index, size_t count) {
+
+	size_t room = 0;
+	while (room < count && index + 1 + room < blocks_.size() && blocks_[index + 1 + room].length == 0) {
+		++room;
+	}
+
+	if (room == count) {
+		return index;
+	}
+
+	/* a block which has just grown too big needs only one, which can be made
+	   by moving the blocks between it and an empty one nearby along */
+	if (count == 1) {
+		for (size_t empty = index + 2; empty < blocks_.size() && empty <= index + MoveDistance; ++empty) {
+			if (blocks_[empty].length == 0) {
+				for (size_t i = empty; i > index + 1; --i) {
+					move(i - 1, i);
+				}
+				return index;
+			}
+		}
+
+		for (size_t empty = index; empty-- > 0 && index - empty <= MoveDistance;) {
+			if (blocks_[empty].length == 0) {
+				for (size_t i = empty; i < index; ++i) {
+					move(i + 1, i);
+				}
+				return index - 1;
+			}
+		}
+	}
+
+	return layout(index, count);
+}
+
+/**
+ * @brief line_index::layout
+ * @param index
+ * @param count
+ * @return the new index of block "index"
+ *
+ * Lay the blocks out afresh, with an empty block after each one, and "count"
+ * of them after block "index" (if it is one)
+ */
+template <class Ch, class Tr>
+size_t line_index<Ch, Tr>::layout(size_t index, size_t count) {
+
+	std::vector<block> blocks;
+	blocks.reserve(filled_ * 2 + count + 2);
+
+	size_t newIndex = index;
+	for (size_t i = 0; i < blocks_.size(); ++i) {
+		if (i == index) {
+			newIndex = blocks.size();
+			blocks.push_back(blocks_[i]);
+			blocks.insert(blocks.end(), std::max<size_t>(count, 1), block{0, 0});
+		} else if (blocks_[i].length != 0) {
+			blocks.push_back(blocks_[i]);
+			blocks.push_back(block{0, 0});
+		}
+	}
+
+	blocks_ = std::move(blocks);
+	rebuild_trees();
+	return newIndex;
+}
+
+/**
+ * @brief line_index::rebuild_trees
+ */
+template <class Ch, class Tr>
+void line_index<Ch, Tr>::rebuild_trees() {
+
+	tree_.assign(blocks_.size() + 1, block{0, 0});
+	filled_ = 0;
+
+	for (size_t i = 1; i < tree_.size(); ++i) {
+		if (blocks_[i - 1].length != 0) {
+			++filled_;
+		}
+
+		tree_[i].length   += blocks_[i - 1].length;
+		tree_[i].newlines += blocks_[i - 1].newlines;
+
+		const size_t parent = i + (i & (~i + 1));
+		if (parent < tree_.size()) {
+			tree_[parent].length   += tree_[i].length;
+			tree_[parent].newlines += tree_[i].newlines;
+		}
+	}
+}
+
+#endif
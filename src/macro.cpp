@@ -26,8 +26,10 @@
 #include "Util/version.h"
 
 #include <boost/optional.hpp>
-#include <stack>
+#include <algorithm>
 #include <fstream>
+#include <iterator>
+#include <stack>
 
 #include <QClipboard>
 #include <QDialogButtonBox>
@@ -2039,12 +2041,73 @@ static const char *ReturnGlobalNames[N_RETURN_GLOBALS] = {
 
 static Symbol *ReturnGlobals[N_RETURN_GLOBALS];
 
+/* A run of replace_range calls from a macro is made as one edit group, so
+   that a loop making thousands of small edits costs one redisplay and one
+   undo record per run, rather than one for every call. The group is ended
+   before any routine which might look at more than the text is called, and
+   whenever the interpreter stops executing */
+static DocumentWidget *EditGroupDocument = nullptr;
+static std::shared_ptr<MacroCommandData> EditGroupMacro;
+
+static void endMacroEditGroup() {
+
+	if (DocumentWidget *document = EditGroupDocument) {
+		EditGroupDocument = nullptr;
+		document->endEditGroup(EditGroupMacro);
+		EditGroupMacro = nullptr;
+	}
+}
+
+static void beginMacroEditGroup(DocumentWidget *document) {
+
+	if (EditGroupDocument == document) {
+		return;
+	}
+
+	endMacroEditGroup();
+
+	DocumentWidget *runDocument = MacroRunDocument();
+
+	EditGroupDocument = document;
+	EditGroupMacro    = runDocument ? runDocument->macroCmdData_ : nullptr;
+	document->beginEditGroup();
+}
+
+static void macroRoutineHook(LibraryRoutine routine) {
+
+	// routines which only read or replace text, or don't use a document at all
+	static const LibraryRoutine TextOnlyRoutines[] = {
+		replaceRangeMS,
+		getRangeMS,
+		getCharacterMS,
+		lengthMS,
+		lengthMV,
+		minMS,
+		maxMS,
+		substringMS,
+		replaceSubstringMS,
+		replaceInStringMS,
+		searchStringMS,
+		toupperMS,
+		tolowerMS,
+		stringCompareMS,
+		splitMS,
+		validNumberMS,
+	};
+
+	if (std::find(std::begin(TextOnlyRoutines), std::end(TextOnlyRoutines), routine) == std::end(TextOnlyRoutines)) {
+		endMacroEditGroup();
+	}
+}
+
 /*
 ** Install built-in macro subroutines and special variables for accessing
 ** editor information
 */
 void RegisterMacroSubroutines() {
 
+	SetLibraryRoutineHook(macroRoutineHook);
+
 	/* Install symbols for built-in routines and variables, with pointers
 	   to the appropriate c routines to do the work */
 	for(const SubRoutine &routine : MacroSubrs) {
@@ -2462,6 +2525,7 @@ static std::error_code replaceRangeMS(DocumentWidget *document, Arguments argume
 	}
 
 	// Do the replace
+	beginMacroEditGroup(document);
 	buf->BufReplaceEx(TextCursor(from), TextCursor(to), string);
 	*result = make_value();
 	return MacroErrorCode::Success;
@@ -2771,79 +2835,32 @@ static std::error_code writeOrAppendFile(bool append, DocumentWidget *document,
 }
 
 /*
-** Built-in macro subroutine for searching silently in a window without
-** dialogs, beeps, or changes to the selection.  Arguments are: $1: string to
-** search for, $2: starting position. Optional arguments may include the
-** strings: "wrap" to make the search wrap around the beginning or end of the
-** string, "backward" or "forward" to change the search direction ("forward" is
-** the default), "literal", "case" or "regex" to change the search type
-** (default is "literal").
-**
-** Returns the starting position of the match, or -1 if nothing matched.
-** also returns the ending position of the match in $searchEndPos
-*/
-static std::error_code searchMS(DocumentWidget *document, Arguments arguments, DataValue *result) {
-	DataValue newArgList[9];
-
-	/* Use the search string routine, by adding the buffer contents as the
-	 * string argument */
-	if (arguments.size() > 8)
-		return MacroErrorCode::WrongNumberOfArguments;
-
-	// NOTE(eteran): the original version of this code was copy-free
-	// in the interest of making the macro code simpler
-	// we just make a copy here. If we duplicate the code in searchStringMS
-	// here and thus don't have to pass things in a DataValue, we can once again
-	// make it copy free
-	newArgList[0] = make_value(document->buffer_->BufAsStringEx());
-
-	// copy other arguments to the new argument list
-	std::copy(arguments.begin(), arguments.end(), &newArgList[1]);
-
-	return searchStringMS(
-				document,
-				Arguments(newArgList, arguments.size() + 1),
-				result);
-}
-
-/*
-** Built-in macro subroutine for searching a string.  Arguments are $1:
-** string to search in, $2: string to search for, $3: starting position.
-** Optional arguments may include the strings: "wrap" to make the search
-** wrap around the beginning or end of the string, "backward" or "forward"
-** to change the search direction ("forward" is the default), "literal",
-** "case" or "regex" to change the search type (default is "literal").
-**
-** Returns the starting position of the match, or -1 if nothing matched.
-** also returns the ending position of the match in $searchEndPos
+** The part of the search and search_string macro subroutines after the text
+** to search in. "text" is either a string or the text buffer itself, of
+** length "length", and the arguments are $1: string to search for, $2:
+** starting position, followed by the optional ones.
 */
-static std::error_code searchStringMS(DocumentWidget *document, Arguments arguments, DataValue *result) {
+template <class Text>
+static std::error_code searchText(DocumentWidget *document, Text text, int64_t length, Arguments arguments, DataValue *result) {
 
-	int64_t     beginPos;
-	WrapMode    wrap;
-	SearchType  type;
-	QString     searchStr;
-	Direction   direction;
-	std::string string;
+	int64_t    beginPos;
+	WrapMode   wrap;
+	SearchType type;
+	QString    searchStr;
+	Direction  direction;
 
 	bool found      = false;
 	bool skipSearch = false;
 
-	// Validate arguments and convert to proper types
-	if (arguments.size() < 3) {
-		return MacroErrorCode::TooFewArguments;
-	}
-
-	if (std::error_code ec = readArguments(arguments, 0, &string, &searchStr, &beginPos)) {
+	if (std::error_code ec = readArguments(arguments, 0, &searchStr, &beginPos)) {
 		return ec;
 	}
 
-	if (std::error_code ec = readSearchArgs(arguments.subspan(3), &direction, &type, &wrap)) {
+	if (std::error_code ec = readSearchArgs(arguments.subspan(2), &direction, &type, &wrap)) {
 		return ec;
 	}
 
-	auto len = static_cast<int64_t>(to_string(arguments[0]).size());
-	if (beginPos > len) {
+	if (beginPos > length) {
 		if (direction == Direction::Forward) {
 			if (wrap == WrapMode::Wrap) {
 				beginPos = 0; // Wrap immediately
@@ -2852,12 +2869,12 @@ static std::error_code searchStringMS(DocumentWidget *document, Arguments argume
 				skipSearch = true;
 			}
 		} else {
-			beginPos = len;
+			beginPos = length;
 		}
 	} else if (beginPos < 0) {
 		if (direction == Direction::Backward) {
 			if (wrap == WrapMode::Wrap) {
-				beginPos = len; // Wrap immediately
+				beginPos = length; // Wrap immediately
 			} else {
 				found = false;
 				skipSearch = true;
@@ -2871,7 +2888,7 @@ static std::error_code searchStringMS(DocumentWidget *document, Arguments argume
 
 	if (!skipSearch) {
 		found = Search::SearchString(
-					string,
+					text,
 					searchStr,
 					direction,
 					type,
@@ -2887,6 +2904,70 @@ static std::error_code searchStringMS(DocumentWidget *document, Arguments argume
 	return MacroErrorCode::Success;
 }
 
+/*
+** Built-in macro subroutine for searching silently in a window without
+** dialogs, beeps, or changes to the selection.  Arguments are: $1: string to
+** search for, $2: starting position. Optional arguments may include the
+** strings: "wrap" to make the search wrap around the beginning or end of the
+** string, "backward" or "forward" to change the search direction ("forward" is
+** the default), "literal", "case" or "regex" to change the search type
+** (default is "literal").
+**
+** Returns the starting position of the match, or -1 if nothing matched.
+** also returns the ending position of the match in $searchEndPos
+*/
+static std::error_code searchMS(DocumentWidget *document, Arguments arguments, DataValue *result) {
+
+	if (arguments.size() > 8) {
+		return MacroErrorCode::WrongNumberOfArguments;
+	}
+
+	if (arguments.size() < 2) {
+		return MacroErrorCode::TooFewArguments;
+	}
+
+	/* Search the buffer in place rather than a copy of it, literal searches
+	 * then only touch the text between beginPos and the match */
+	return searchText(
+				document,
+				document->buffer_,
+				document->buffer_->BufGetLength(),
+				arguments,
+				result);
+}
+
+/*
+** Built-in macro subroutine for searching a string.  Arguments are $1:
+** string to search in, $2: string to search for, $3: starting position.
+** Optional arguments may include the strings: "wrap" to make the search
+** wrap around the beginning or end of the string, "backward" or "forward"
+** to change the search direction ("forward" is the default), "literal",
+** "case" or "regex" to change the search type (default is "literal").
+**
+** Returns the starting position of the match, or -1 if nothing matched.
+** also returns the ending position of the match in $searchEndPos
+*/
+static std::error_code searchStringMS(DocumentWidget *document, Arguments arguments, DataValue *result) {
+
+	std::string string;
+
+	// Validate arguments and convert to proper types
+	if (arguments.size() < 3) {
+		return MacroErrorCode::TooFewArguments;
+	}
+
+	if (std::error_code ec = readArgument(arguments[0], &string)) {
+		return ec;
+	}
+
+	return searchText(
+				document,
+				view::string_view(string),
+				static_cast<int64_t>(string.size()),
+				arguments.subspan(1),
+				result);
+}
+
 /*
 ** Built-in macro subroutine for replacing all occurences of a search string in
 ** a string with a replacement string.  Arguments are $1: string to search in,
@@ -0,0 +1,878 @@
+
+#ifndef PIECE_TABLE_H_
+#define PIECE_TABLE_H_
+
+#include "piece_table_fwd.h"
+#include "text_snapshot.h"
+#include "Util/Raise.h"
+#include "Util/string_view.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+/*
+** A piece table is an alternative to the gap_buffer which offers the same
+** interface. The text is described by a sequence of "pieces", each of which
+** refers to a run of characters in an append-only store. Inserting or deleting
+** text never moves existing characters, it only splits and joins pieces.
+**
+** The pieces are kept in a treap (a randomized balanced binary tree) ordered
+** by position, where each node also knows the length of its whole subtree.
+** This makes locating a position, inserting, and deleting all O(log n) in the
+** number of pieces regardless of where in the document the edit happens.
+*/
+template <class Ch, class Tr>
+class piece_table {
+public:
+	/* Size of the blocks which newly inserted text is appended to. Inserted
+	 * strings larger than half of this get a block of their own
+	 */
+	static constexpr int BlockSize = 16384;
+
+	using string_type = std::basic_string<Ch, Tr>;
+	using view_type   = view::basic_string_view<Ch, Tr>;
+
+public:
+	using value_type      = Ch;
+	using size_type       = int64_t;
+	using difference_type = int64_t;
+
+private:
+	struct node {
+		const Ch *data;
+		size_type length;
+		size_type total; // length of all of the text in this subtree
+		uint32_t priority;
+		std::unique_ptr<node> left;
+		std::unique_ptr<node> right;
+	};
+
+	using node_ptr = std::unique_ptr<node>;
+
+public:
+	piece_table();
+	explicit piece_table(size_type size);
+	piece_table(const piece_table&)            = delete;
+	piece_table& operator=(const piece_table&) = delete;
+	piece_table(piece_table&&)                 = delete;
+	piece_table& operator=(piece_table&&)      = delete;
+	~piece_table() noexcept                    = default;
+
+public:
+	size_type size() const noexcept { return size_; }
+	bool empty() const noexcept     { return size() == 0; }
+	void swap(piece_table &other) noexcept;
+
+public:
+	Ch operator[](size_type n) const noexcept;
+	Ch at(size_type n) const;
+
+public:
+	int compare(size_type pos, view_type str) const noexcept;
+	int compare(size_type pos, Ch ch) const noexcept;
+
+public:
+	string_type to_string() const;
+	string_type to_string(size_type start, size_type end) const;
+	view_type to_view();
+	view_type to_view(size_type start, size_type end);
+	text_snapshot<Ch, Tr> snapshot() const;
+
+public:
+	void append(view_type str);
+	void append(Ch ch);
+	void insert(size_type pos, view_type str);
+	void insert(size_type pos, Ch ch);
+	void erase(size_type start, size_type end);
+	void replace(size_type start, size_type end, view_type str);
+	void replace(size_type start, size_type end, Ch ch);
+	void assign(view_type str);
+	void assign_shared(std::shared_ptr<const Ch> str, size_type length);
+	void detach();
+	void clear() noexcept;
+
+public:
+	template <class Func>
+	void for_each_span(size_type start, size_type end, Func func) const;
+
+	template <class Func>
+	void for_each_span_reverse(size_type start, size_type end, Func func) const;
+
+private:
+	template <class Func>
+	static bool visit(const node *n, size_type offset, size_type start, size_type end, Func &func);
+
+	template <class Func>
+	static bool visit_reverse(const node *n, size_type offset, size_type start, size_type end, Func &func);
+
+	static size_type total(const node_ptr &n) noexcept { return n ? n->total : 0; }
+	static void update(node *n) noexcept;
+	static node_ptr merge(node_ptr l, node_ptr r) noexcept;
+	static void grow_last(node *n, size_type length) noexcept;
+	static const node *last(const node *n) noexcept;
+
+private:
+	static std::shared_ptr<Ch> allocate(size_type length);
+	node_ptr make_node(const Ch *data, size_type length);
+	static void split(node_ptr t, size_type pos, node_ptr &l, node_ptr &r, node_ptr &spare) noexcept;
+	const Ch *store(view_type str);
+	const node *find(size_type n, size_type *pieceStart) const noexcept;
+	void gather(size_type start, size_type end);
+	void flatten();
+
+private:
+	node_ptr                           root_;                 // the pieces, in document order
+	std::vector<std::shared_ptr<Ch>>   blocks_;               // storage for all text referenced by the pieces, shared with snapshots
+	std::shared_ptr<const Ch>          shared_;               // externally owned text, see assign_shared
+	Ch                                *block_      = nullptr; // the block which small insertions are appended to
+	size_type                          block_used_ = 0;
+	size_type                          block_size_ = 0;
+	const Ch                          *store_end_  = nullptr; // one past the most recent insertion into block_
+	size_type                          size_       = 0;       // length of the text in the table
+	size_type                          size_hint_  = 0;
+	uint32_t                           seed_       = 0x9e3779b9;
+
+private:
+	// the most recently located piece, sequential access is by far the most
+	// common pattern, so this avoids a tree walk for most reads
+	mutable const node *cache_node_  = nullptr;
+	mutable size_type   cache_start_ = 0;
+};
+
+/**
+ *
+ */
+template <class Ch, class Tr>
+piece_table<Ch, Tr>::piece_table() : piece_table(0) {
+}
+
+/**
+ *
+ */
+template <class Ch, class Tr>
+piece_table<Ch, Tr>::piece_table(size_type size) : size_hint_(size) {
+}
+
+/**
+ *
+ */
+template <class Ch, class Tr>
+Ch piece_table<Ch, Tr>::operator[](size_type n) const noexcept {
+
+	if (cache_node_ && n >= cache_start_ && n < cache_start_ + cache_node_->length) {
+		return cache_node_->data[n - cache_start_];
+	}
+
+	size_type pieceStart;
+	const node *piece = find(n, &pieceStart);
+	assert(piece);
+
+	cache_node_  = piece;
+	cache_start_ = pieceStart;
+	return piece->data[n - pieceStart];
+}
+
+/**
+ *
+ */
+template <class Ch, class Tr>
+Ch piece_table<Ch, Tr>::at(size_type n) const {
+
+	if (n >= size() || n < 0) {
+		Raise<std::out_of_range>("piece_table::at");
+	}
+
+	return (*this)[n];
+}
+
+/**
+ *
+ */
+template <class Ch, class Tr>
+int piece_table<Ch, Tr>::compare(size_type pos, view_type str) const noexcept {
+
+	auto posEnd = pos + static_cast<size_type>(str.size());
+	if (posEnd > size()) {
+		return 1;
+	}
+
+	if(pos < 0) {
+		return -1;
+	}
+
+	int result    = 0;
+	size_t offset = 0;
+
+	for_each_span(pos, posEnd, [&](view_type span) {
+		result = Tr::compare(span.data(), &str[offset], span.size());
+		offset += span.size();
+		return result == 0;
+	});
+
+	return result;
+}
+
+/**
+ *
+ */
+template <class Ch, class Tr>
+int piece_table<Ch, Tr>::compare(size_type pos, Ch ch) const noexcept {
+	if (pos >= size()) {
+		return 1;
+	}
+
+	if(pos < 0) {
+		return -1;
+	}
+
+	const Ch buffer_char = (*this)[pos];
+	return Tr::compare(&buffer_char, &ch, 1);
+}
+
+/**
+ *
+ */
+template <class Ch, class Tr>
+auto piece_table<Ch, Tr>::to_string() const -> string_type {
+	return to_string(0, size());
+}
+
+/**
+ *
+ */
+template <class Ch, class Tr>
+auto piece_table<Ch, Tr>::to_string(size_type start, size_type end) const -> string_type {
+
+	assert(start <= size() && start >= 0);
+	assert(end   <= size() && end   >= 0);
+	assert(start <= end);
+
+	string_type text;
+	text.reserve(static_cast<size_t>(end - start));
+
+	for_each_span(start, end, [&text](view_type span) {
+		text.append(span.data(), span.size());
+		return true;
+	});
+
+	return text;
+}
+
+/**
+ * @brief piece_table<Ch, Tr>::to_view
+ * @return a view of the entire text
+ *
+ * If the text is currently made of more than one piece, it is first gathered
+ * into a single piece, which is O(n). Prefer for_each_span, or a view of just
+ * the range needed.
+ */
+template <class Ch, class Tr>
+auto piece_table<Ch, Tr>::to_view() -> view_type {
+	return to_view(0, size());
+}
+
+/**
+ * @brief piece_table<Ch, Tr>::to_view
+ * @param start
+ * @param end
+ * @return a view of the text between start and end
+ *
+ * This is O(log n) if the range lies within one piece. Otherwise only the
+ * pieces covering the range are gathered into a new one, which is O(end -
+ * start), the rest of the text stays where it is. The view is valid until the
+ * table is modified.
+ */
+template <class Ch, class Tr>
+auto piece_table<Ch, Tr>::to_view(size_type start, size_type end) -> view_type {
+
+	assert(start <= size() && start >= 0);
+	assert(end   <= size() && end   >= 0);
+	assert(start <= end);
+
+	if (start == end) {
+		static const Ch empty = Ch();
+		return view_type(&empty, 0);
+	}
+
+	size_type pieceStart;
+	const node *piece = find(start, &pieceStart);
+	assert(piece);
+
+	if (end > pieceStart + piece->length) {
+		gather(start, end);
+		piece = find(start, &pieceStart);
+	}
+
+	return view_type(piece->data + (start - pieceStart), static_cast<size_t>(end - start));
+}
+
+/**
+ * @brief piece_table<Ch, Tr>::snapshot
+ * @return the current text, which stays readable after the table is modified
+ * or destroyed, and can be handed to another thread
+ *
+ * Text in the store is never overwritten, so this only copies the list of
+ * pieces and shares ownership of the storage they are in, it is O(number of
+ * pieces + number of blocks).
+ */
+template <class Ch, class Tr>
+auto piece_table<Ch, Tr>::snapshot() const -> text_snapshot<Ch, Tr> {
+
+	text_snapshot<Ch, Tr> result;
+
+	for_each_span(0, size_, [&result](view_type span) {
+		result.append(span);
+		return true;
+	});
+
+	for (const std::shared_ptr<Ch> &block : blocks_) {
+		result.keep(block);
+	}
+
+	if (shared_) {
+		result.keep(shared_);
+	}
+
+	return result;
+}
+
+/**
+ *
+ */
+template <class Ch, class Tr>
+void piece_table<Ch, Tr>::append(view_type str) {
+	insert(size(), str);
+}
+
+/**
+ *
+ */
+template <class Ch, class Tr>
+void piece_table<Ch, Tr>::append(Ch ch) {
+	insert(size(), ch);
+}
+
+/**
+ *
+ */
+template <class Ch, class Tr>
+void piece_table<Ch, Tr>::insert(size_type pos, view_type str) {
+
+	assert(pos <= size() && pos >= 0);
+
+	const auto length = static_cast<size_type>(str.size());
+	if (length == 0) {
+		return;
+	}
+
+	cache_node_ = nullptr;
+
+	// NOTE: allocate everything before splitting, so that a failed
+	// allocation leaves the table untouched
+	const Ch *const prevEnd = store_end_;
+	const Ch *const data    = store(str);
+	node_ptr piece          = make_node(data, length);
+	node_ptr spare          = make_node(nullptr, 0);
+
+	node_ptr l;
+	node_ptr r;
+	split(std::move(root_), pos, l, r, spare);
+
+	/* If the new text lands directly after the piece preceding it, both in the
+	   document and in the store (the usual case when typing) just grow that
+	   piece instead of adding a new one */
+	const node *prev = last(l.get());
+	if (prev && data == prevEnd && prev->data + prev->length == data) {
+		grow_last(l.get(), length);
+	} else {
+		l = merge(std::move(l), std::move(piece));
+	}
+
+	root_  = merge(std::move(l), std::move(r));
+	size_ += length;
+}
+
+/**
+ *
+ */
+template <class Ch, class Tr>
+void piece_table<Ch, Tr>::insert(size_type pos, Ch ch) {
+	insert(pos, view_type(&ch, 1));
+}
+
+/**
+ *
+ */
+template <class Ch, class Tr>
+void piece_table<Ch, Tr>::erase(size_type start, size_type end) {
+
+	assert(start <= size() && start >= 0);
+	assert(end   <= size() && end   >= 0);
+	assert(start <= end);
+
+	if (start == end) {
+		return;
+	}
+
+	cache_node_ = nullptr;
+
+	// NOTE: each split needs at most one new piece
+	node_ptr spare1 = make_node(nullptr, 0);
+	node_ptr spare2 = make_node(nullptr, 0);
+
+	node_ptr l;
+	node_ptr m;
+	node_ptr r;
+	split(std::move(root_), start, l, r, spare1);
+	split(std::move(r), end - start, m, r, spare2);
+
+	root_  = merge(std::move(l), std::move(r));
+	size_ -= (end - start);
+}
+
+/**
+ *
+ */
+template <class Ch, class Tr>
+void piece_table<Ch, Tr>::replace(size_type start, size_type end, view_type str) {
+
+	erase(start, end);
+	insert(start, str);
+}
+
+/**
+ *
+ */
+template <class Ch, class Tr>
+void piece_table<Ch, Tr>::replace(size_type start, size_type end, Ch ch) {
+
+	erase(start, end);
+	insert(start, ch);
+}
+
+/**
+ *
+ */
+template <class Ch, class Tr>
+void piece_table<Ch, Tr>::assign(view_type str) {
+	clear();
+	insert(0, str);
+}
+
+/**
+ * @brief piece_table<Ch, Tr>::assign_shared
+ * @param str
+ * @param length
+ *
+ * Replaces the contents with the "length" characters at "str" without
+ * copying them. The table shares ownership of that memory until it no longer
+ * refers to it, and never writes to it, so it may be read-only (for example a
+ * memory mapped file).
+ */
+template <class Ch, class Tr>
+void piece_table<Ch, Tr>::assign_shared(std::shared_ptr<const Ch> str, size_type length) {
+	clear();
+
+	if (length != 0) {
+		shared_ = std::move(str);
+		root_   = make_node(shared_.get(), length);
+		size_   = length;
+	}
+}
+
+/**
+ * @brief piece_table<Ch, Tr>::detach
+ *
+ * Copies any text still referenced from memory given to assign_shared into
+ * storage owned by the table, and releases that memory
+ */
+template <class Ch, class Tr>
+void piece_table<Ch, Tr>::detach() {
+	if (shared_) {
+		flatten();
+	}
+}
+
+/**
+ * @brief piece_table<Ch, Tr>::clear
+ *
+ * Unlike erase, this also releases the storage of all previously inserted text
+ */
+template <class Ch, class Tr>
+void piece_table<Ch, Tr>::clear() noexcept {
+	root_.reset();
+	blocks_.clear();
+	shared_.reset();
+	block_       = nullptr;
+	block_used_  = 0;
+	block_size_  = 0;
+	store_end_   = nullptr;
+	size_        = 0;
+	cache_node_  = nullptr;
+}
+
+/**
+ * @brief piece_table<Ch, Tr>::for_each_span
+ * @param start
+ * @param end
+ * @param func
+ *
+ * Calls func(view_type) for each contiguous run of text between start and
+ * end, in order. func returns false to stop the iteration early
+ */
+template <class Ch, class Tr>
+template <class Func>
+void piece_table<Ch, Tr>::for_each_span(size_type start, size_type end, Func func) const {
+	if (start < end) {
+		visit(root_.get(), 0, start, end, func);
+	}
+}
+
+/**
+ *
+ */
+template <class Ch, class Tr>
+template <class Func>
+bool piece_table<Ch, Tr>::visit(const node *n, size_type offset, size_type start, size_type end, Func &func) {
+
+	if (!n || start >= offset + n->total || end <= offset) {
+		return true;
+	}
+
+	if (!visit(n->left.get(), offset, start, end, func)) {
+		return false;
+	}
+
+	const size_type pieceStart = offset + total(n->left);
+	const size_type pieceEnd   = pieceStart + n->length;
+
+	if (start < pieceEnd && end > pieceStart) {
+		const size_type from = std::max(start, pieceStart);
+		const size_type to   = std::min(end, pieceEnd);
+		if (!func(view_type(n->data + (from - pieceStart), static_cast<size_t>(to - from)))) {
+			return false;
+		}
+	}
+
+	return visit(n->right.get(), pieceEnd, start, end, func);
+}
+
+/**
+ * @brief piece_table<Ch, Tr>::for_each_span_reverse
+ * @param start
+ * @param end
+ * @param func
+ *
+ * Like for_each_span, but visits the spans from the end of the range to the
+ * start
+ */
+template <class Ch, class Tr>
+template <class Func>
+void piece_table<Ch, Tr>::for_each_span_reverse(size_type start, size_type end, Func func) const {
+	if (start < end) {
+		visit_reverse(root_.get(), 0, start, end, func);
+	}
+}
+
+/**
+ *
+ */
+template <class Ch, class Tr>
+template <class Func>
+bool piece_table<Ch, Tr>::visit_reverse(const node *n, size_type offset, size_type start, size_type end, Func &func) {
+
+	if (!n || start >= offset + n->total || end <= offset) {
+		return true;
+	}
+
+	const size_type pieceStart = offset + total(n->left);
+	const size_type pieceEnd   = pieceStart + n->length;
+
+	if (!visit_reverse(n->right.get(), pieceEnd, start, end, func)) {
+		return false;
+	}
+
+	if (start < pieceEnd && end > pieceStart) {
+		const size_type from = std::max(start, pieceStart);
+		const size_type to   = std::min(end, pieceEnd);
+		if (!func(view_type(n->data + (from - pieceStart), static_cast<size_t>(to - from)))) {
+			return false;
+		}
+	}
+
+	return visit_reverse(n->left.get(), offset, start, end, func);
+}
+
+/**
+ *
+ */
+template <class Ch, class Tr>
+void piece_table<Ch, Tr>::update(node *n) noexcept {
+	n->total = n->length + total(n->left) + total(n->right);
+}
+
+/*
+** Join two trees where every position in "l" comes before every position in
+** "r", keeping the nodes heap ordered by priority
+*/
+template <class Ch, class Tr>
+auto piece_table<Ch, Tr>::merge(node_ptr l, node_ptr r) noexcept -> node_ptr {
+
+	if (!l) {
+		return r;
+	}
+
+	if (!r) {
+		return l;
+	}
+
+	if (l->priority > r->priority) {
+		l->right = merge(std::move(l->right), std::move(r));
+		update(l.get());
+		return l;
+	} else {
+		r->left = merge(std::move(l), std::move(r->left));
+		update(r.get());
+		return r;
+	}
+}
+
+/*
+** Split tree "t" into "l" holding the text before "pos" and "r" holding the
+** text from "pos" onward, dividing a piece in two if "pos" falls inside it.
+** The second half of a divided piece is put in "spare", which is left alone
+** otherwise
+*/
+template <class Ch, class Tr>
+void piece_table<Ch, Tr>::split(node_ptr t, size_type pos, node_ptr &l, node_ptr &r, node_ptr &spare) noexcept {
+
+	if (!t) {
+		l.reset();
+		r.reset();
+		return;
+	}
+
+	const size_type leftTotal = total(t->left);
+
+	if (pos <= leftTotal) {
+		split(std::move(t->left), pos, l, t->left, spare);
+		update(t.get());
+		r = std::move(t);
+	} else if (pos >= leftTotal + t->length) {
+		split(std::move(t->right), pos - leftTotal - t->length, t->right, r, spare);
+		update(t.get());
+		l = std::move(t);
+	} else {
+		const size_type offset = pos - leftTotal;
+		node_ptr tail = std::move(spare);
+		tail->data   = t->data + offset;
+		tail->length = t->length - offset;
+		tail->total  = tail->length;
+
+		node_ptr right = std::move(t->right);
+
+		t->length = offset;
+		update(t.get());
+
+		l = std::move(t);
+		r = merge(std::move(tail), std::move(right));
+	}
+}
+
+/*
+** Extend the last piece of the tree rooted at "n" by "length" characters
+*/
+template <class Ch, class Tr>
+void piece_table<Ch, Tr>::grow_last(node *n, size_type length) noexcept {
+	for (; n; n = n->right.get()) {
+		n->total += length;
+		if (!n->right) {
+			n->length += length;
+		}
+	}
+}
+
+/**
+ *
+ */
+template <class Ch, class Tr>
+auto piece_table<Ch, Tr>::last(const node *n) noexcept -> const node * {
+	if (n) {
+		while (n->right) {
+			n = n->right.get();
+		}
+	}
+	return n;
+}
+
+/**
+ *
+ */
+template <class Ch, class Tr>
+auto piece_table<Ch, Tr>::make_node(const Ch *data, size_type length) -> node_ptr {
+
+	// xorshift32, the priorities only need to be "random enough" to keep
+	// the tree balanced
+	seed_ ^= seed_ << 13;
+	seed_ ^= seed_ >> 17;
+	seed_ ^= seed_ << 5;
+
+	auto n = std::make_unique<node>();
+	n->data     = data;
+	n->length   = length;
+	n->total    = length;
+	n->priority = seed_;
+	return n;
+}
+
+/*
+** Allocate a zeroed block of storage for "length" characters
+*/
+template <class Ch, class Tr>
+std::shared_ptr<Ch> piece_table<Ch, Tr>::allocate(size_type length) {
+	return std::shared_ptr<Ch>(new Ch[static_cast<size_t>(length)](), std::default_delete<Ch[]>());
+}
+
+/*
+** Copy "str" into the append-only store and return where it was placed.
+** Small strings are packed into shared blocks so that consecutive insertions
+** are contiguous in memory and can share a piece.
+*/
+template <class Ch, class Tr>
+const Ch *piece_table<Ch, Tr>::store(view_type str) {
+
+	const auto length = static_cast<size_type>(str.size());
+
+	if (length > BlockSize / 2) {
+		auto block = allocate(length);
+		std::copy(str.begin(), str.end(), block.get());
+		blocks_.push_back(std::move(block));
+		return blocks_.back().get();
+	}
+
+	if (!block_ || block_size_ - block_used_ < length) {
+		// the first block honors the size hint given at construction
+		const size_type size = std::max<size_type>(BlockSize, blocks_.empty() ? size_hint_ : 0);
+		blocks_.push_back(allocate(size));
+
+		block_      = blocks_.back().get();
+		block_used_ = 0;
+		block_size_ = size;
+	}
+
+	Ch *const data = block_ + block_used_;
+	std::copy(str.begin(), str.end(), data);
+
+	block_used_ += length;
+	store_end_   = data + length;
+	return data;
+}
+
+/*
+** Find the piece containing position "n", and the position its text begins at
+*/
+template <class Ch, class Tr>
+auto piece_table<Ch, Tr>::find(size_type n, size_type *pieceStart) const noexcept -> const node * {
+
+	const node *p    = root_.get();
+	size_type offset = 0;
+
+	while (p) {
+		const size_type leftTotal = total(p->left);
+		if (n < offset + leftTotal) {
+			p = p->left.get();
+		} else if (n < offset + leftTotal + p->length) {
+			*pieceStart = offset + leftTotal;
+			return p;
+		} else {
+			offset += leftTotal + p->length;
+			p = p->right.get();
+		}
+	}
+
+	return nullptr;
+}
+
+/*
+** Replace the pieces covering the text between "start" and "end" with a
+** single piece holding a copy of that text. The storage of the old pieces is
+** kept, so views of them remain valid
+*/
+template <class Ch, class Tr>
+void piece_table<Ch, Tr>::gather(size_type start, size_type end) {
+
+	const size_type length = end - start;
+
+	auto block = allocate(length);
+
+	Ch *out = block.get();
+	for_each_span(start, end, [&out](view_type span) {
+		out = std::copy(span.begin(), span.end(), out);
+		return true;
+	});
+
+	node_ptr piece  = make_node(block.get(), length);
+	node_ptr spare1 = make_node(nullptr, 0);
+	node_ptr spare2 = make_node(nullptr, 0);
+	blocks_.push_back(std::move(block));
+
+	node_ptr l;
+	node_ptr m;
+	node_ptr r;
+	split(std::move(root_), start, l, r, spare1);
+	split(std::move(r), length, m, r, spare2);
+
+	root_ = merge(merge(std::move(l), std::move(piece)), std::move(r));
+	cache_node_ = nullptr;
+}
+
+/*
+** Gather the whole text into a single piece, releasing all other storage
+*/
+template <class Ch, class Tr>
+void piece_table<Ch, Tr>::flatten() {
+
+	auto block = allocate(size_);
+
+	Ch *out = block.get();
+	for_each_span(0, size_, [&out](view_type span) {
+		out = std::copy(span.begin(), span.end(), out);
+		return true;
+	});
+
+	const size_type length = size_;
+	clear();
+
+	blocks_.push_back(std::move(block));
+	root_ = make_node(blocks_.back().get(), length);
+	size_ = length;
+}
+
+/**
+ *
+ */
+template <class Ch, class Tr>
+void piece_table<Ch, Tr>::swap(piece_table &other) noexcept {
+	using std::swap;
+
+	swap(root_,        other.root_);
+	swap(blocks_,      other.blocks_);
+	swap(shared_,      other.shared_);
+	swap(block_,       other.block_);
+	swap(block_used_,  other.block_used_);
+	swap(block_size_,  other.block_size_);
+	swap(store_end_,   other.store_end_);
+	swap(size_,        other.size_);
+	swap(size_hint_,   other.size_hint_);
+	swap(seed_,        other.seed_);
+
+	cache_node_       = nullptr;
+	other.cache_node_ = nullptr;
+}
+
+#endif
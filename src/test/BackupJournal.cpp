@@ -0,0 +1,227 @@
+#include "BackupJournal.h"
+
+#include <QFile>
+#include <QTemporaryDir>
+
+#include <iostream>
+#include <string>
+
+namespace {
+
+using Status = BackupJournal::Status;
+
+/*
+** The text a journal describes, with its records applied to "base"
+*/
+struct Replayed {
+	Status status;
+	std::string text;
+	int records;
+};
+
+Replayed replay(const QString &name, int64_t fileSize, time_t fileTime, uint64_t fileHash, const std::string &base) {
+
+	Replayed r{Status::Missing, base, 0};
+
+	r.status = BackupJournal::Replay(name, fileSize, fileTime, fileHash, static_cast<int64_t>(base.size()), [&r](view::string_view text) {
+		r.text = text.to_string();
+		++r.records;
+	}, [&r](int64_t pos, int64_t nDeleted, view::string_view text) {
+		r.text.replace(static_cast<size_t>(pos), static_cast<size_t>(nDeleted), text.data(), text.size());
+		++r.records;
+	});
+
+	return r;
+}
+
+bool expect(const Replayed &r, Status status, const std::string &text, const char *what) {
+
+	if (r.status != status || (status == Status::Valid && r.text != text)) {
+		std::cerr << "ERROR    : " << what << ", got status " << static_cast<int>(r.status) << " and \"" << r.text << "\"\n";
+		return false;
+	}
+
+	return true;
+}
+
+std::string readFile(const QString &name) {
+	QFile file(name);
+	file.open(QIODevice::ReadOnly);
+	return file.readAll().toStdString();
+}
+
+void writeFile(const QString &name, const std::string &data) {
+	QFile file(name);
+	file.open(QIODevice::WriteOnly | QIODevice::Truncate);
+	file.write(data.data(), static_cast<qint64>(data.size()));
+}
+
+/*
+** A journal based on a file matches it by modification time, or failing that
+** by the hash of its contents
+*/
+bool testFileMatching(const QString &name) {
+
+	const std::string base = "hello world";
+	const uint64_t hash    = BackupJournal::Hash(base);
+	const uint64_t other   = BackupJournal::Hash("jello world");
+
+	{
+		BackupJournal journal(name);
+		journal.restart(11, 1000, hash);
+		journal.append(0, 5, "HELLO");
+	}
+
+	if (!expect(replay(name, 11, 1000, hash, base), Status::Valid, "HELLO world", "same time and hash") ||
+	    !expect(replay(name, 11, 1000, other, base), Status::Valid, "HELLO world", "same time, other hash") ||
+	    !expect(replay(name, 11, 2000, hash, base), Status::Valid, "HELLO world", "touched file") ||
+	    !expect(replay(name, 11, 2000, other, base), Status::Rejected, "", "changed file") ||
+	    !expect(replay(name, 12, 1000, hash, base), Status::Rejected, "", "other size")) {
+		return false;
+	}
+
+	// without a hash, only the modification time will do
+	{
+		BackupJournal journal(name);
+		journal.restart(11, 1000, 0);
+		journal.append(0, 5, "HELLO");
+	}
+
+	if (!expect(replay(name, 11, 1000, hash, base), Status::Valid, "HELLO world", "no hash, same time") ||
+	    !expect(replay(name, 11, 2000, hash, base), Status::Rejected, "", "no hash, touched file")) {
+		return false;
+	}
+
+	// a file journal with nothing recorded in it is as good as none
+	{
+		BackupJournal journal(name);
+		journal.restart(11, 1000, hash);
+	}
+
+	return expect(replay(name, 11, 1000, hash, base), Status::Missing, "", "empty journal");
+}
+
+/*
+** A journal which starts with a snapshot applies to any file, one which
+** claims to but doesn't is rejected
+*/
+bool testSnapshotFirst(const QString &name) {
+
+	{
+		BackupJournal journal(name);
+		journal.restart(std::string("abc"));
+		journal.append(1, 1, "XY");
+	}
+
+	if (!expect(replay(name, 5, 1000, 0, "other"), Status::Valid, "aXYc", "snapshot journal")) {
+		return false;
+	}
+
+	const std::string journal = readFile(name);
+	const std::string header  = journal.substr(0, journal.find('\n') + 1);
+
+	writeFile(name, header + "E 0 0 1\nx");
+	if (!expect(replay(name, 5, 1000, 0, "other"), Status::Rejected, "", "edit before the snapshot")) {
+		return false;
+	}
+
+	writeFile(name, header + "S 3\nabcE 3 0 1\nd");
+	return expect(replay(name, 5, 1000, 0, "other"), Status::Valid, "abcd", "hand written snapshot journal");
+}
+
+/*
+** Records which were only partly written are left out, along with anything
+** after them
+*/
+bool testTornRecord(const QString &name) {
+
+	{
+		BackupJournal journal(name);
+		journal.restart(std::string("abcdef"));
+		journal.append(0, 1, "Z");
+		journal.append(2, 0, "inserted");
+	}
+
+	const std::string journal = readFile(name);
+
+	if (!expect(replay(name, 0, 0, 0, ""), Status::Valid, "Zbinsertedcdef", "whole journal")) {
+		return false;
+	}
+
+	// cut off part way through the text of the last edit
+	writeFile(name, journal.substr(0, journal.size() - 3));
+	if (!expect(replay(name, 0, 0, 0, ""), Status::Valid, "Zbcdef", "torn text")) {
+		return false;
+	}
+
+	// and part way through its header line
+	writeFile(name, journal.substr(0, journal.rfind("E ") + 3));
+	if (!expect(replay(name, 0, 0, 0, ""), Status::Valid, "Zbcdef", "torn header")) {
+		return false;
+	}
+
+	// a torn snapshot leaves nothing to recover
+	writeFile(name, journal.substr(0, journal.find("abcdef") + 2));
+	return expect(replay(name, 0, 0, 0, ""), Status::Missing, "", "torn snapshot");
+}
+
+/*
+** An edit outside of the text it applies to means the journal doesn't belong
+** to this document
+*/
+bool testOutOfRange(const QString &name) {
+
+	const std::string base = "hello world";
+	const uint64_t hash    = BackupJournal::Hash(base);
+
+	{
+		BackupJournal journal(name);
+		journal.restart(11, 1000, hash);
+		journal.append(6, 6, "there");
+	}
+
+	if (!expect(replay(name, 11, 1000, hash, base), Status::Rejected, "", "deletion past the end")) {
+		return false;
+	}
+
+	{
+		BackupJournal journal(name);
+		journal.restart(11, 1000, hash);
+		journal.append(11, 0, "!");
+		journal.append(13, 0, "?");
+	}
+
+	if (!expect(replay(name, 11, 1000, hash, base), Status::Rejected, "", "insertion past the end")) {
+		return false;
+	}
+
+	const std::string journal = readFile(name);
+	const std::string header  = journal.substr(0, journal.find('\n') + 1);
+
+	writeFile(name, header + "E -1 0 1\nx");
+	return expect(replay(name, 11, 1000, hash, base), Status::Rejected, "", "negative position");
+}
+
+}
+
+int main() {
+
+	QTemporaryDir dir;
+	if (!dir.isValid()) {
+		std::cerr << "ERROR    : can't create a temporary directory\n";
+		return -1;
+	}
+
+	const QString name = dir.path() + QLatin1String("/journal~");
+
+	if (!expect(replay(name, 11, 1000, 0, ""), Status::Missing, "", "no journal")) {
+		return -1;
+	}
+
+	if (!testFileMatching(name) || !testSnapshotFirst(name) || !testTornRecord(name) || !testOutOfRange(name)) {
+		return -1;
+	}
+
+	std::cout << "SUCCESS\n";
+	return 0;
+}
@@ -0,0 +1,202 @@
+#include "Util/Kernels.h"
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <string>
+
+namespace {
+
+using Kernels::InstructionSet;
+
+uint32_t seed = 13579;
+
+uint32_t next() {
+	seed ^= seed << 13;
+	seed ^= seed >> 17;
+	seed ^= seed << 5;
+	return seed;
+}
+
+int64_t random(int64_t max) {
+	return max == 0 ? 0 : static_cast<int64_t>(next() % static_cast<uint32_t>(max + 1));
+}
+
+// a few letters in both cases, and characters which only differ from them by the case bit
+const char Alphabet[] = "aAbBzZ@`[{\n\x80\xe1\xff";
+
+char randomCharacter() {
+	return Alphabet[next() % (sizeof(Alphabet) - 1)];
+}
+
+std::string randomString(int64_t length) {
+	std::string s(static_cast<size_t>(length), ' ');
+	for (char &ch : s) {
+		ch = randomCharacter();
+	}
+	return s;
+}
+
+/*
+** Text which is mostly one character, so that the counts kept per vector
+** lane get as high as they can
+*/
+std::string repetitiveString(int64_t length) {
+	std::string s(static_cast<size_t>(length), 'a');
+	for (char &ch : s) {
+		if (next() % 64 == 0) {
+			ch = randomCharacter();
+		}
+	}
+	return s;
+}
+
+char foldCase(char ch) {
+	return (ch >= 'A' && ch <= 'Z') ? static_cast<char>(ch - 'A' + 'a') : ch;
+}
+
+/*
+** The plain loops the kernels have to agree with
+*/
+const char *findFirstOf(const char *first, const char *last, const std::string &chars) {
+	for (; first != last; ++first) {
+		if (chars.find(*first) != std::string::npos) {
+			return first;
+		}
+	}
+	return nullptr;
+}
+
+const char *findLastOf(const char *first, const char *last, const std::string &chars) {
+	while (last != first) {
+		--last;
+		if (chars.find(*last) != std::string::npos) {
+			return last;
+		}
+	}
+	return nullptr;
+}
+
+const char *findString(const char *first, const char *last, const std::string &needle, bool caseless) {
+	for (; last - first >= static_cast<ptrdiff_t>(needle.size()); ++first) {
+		if (std::equal(needle.begin(), needle.end(), first, [caseless](char n, char t) { return n == (caseless ? foldCase(t) : t); })) {
+			return first;
+		}
+	}
+	return nullptr;
+}
+
+/*
+** A range of "text" to search, starting at any alignment. Its length is
+** usually close to a multiple of the vector widths, so that the tails left
+** over after the vector loops are every length they can be.
+*/
+void randomRange(const std::string &text, const char **first, const char **last) {
+
+	const int64_t offset = random(63);
+
+	int64_t length;
+	switch (next() % 4) {
+	case 0:
+		length = random(8) * 16 + random(2) - 1;
+		break;
+	case 1:
+		length = random(8) * 32 + random(4) - 2;
+		break;
+	case 2:
+		length = random(300);
+		break;
+	default:
+		// long enough for the per lane counters of CountCharacter to be summed more than once
+		length = random(static_cast<int64_t>(text.size()) - 64);
+		break;
+	}
+
+	length = std::max<int64_t>(0, std::min(length, static_cast<int64_t>(text.size()) - offset));
+
+	*first = text.data() + offset;
+	*last  = *first + length;
+}
+
+template <class T>
+bool expect(T got, T expected, InstructionSet isa, const char *function, const char *first, const char *last) {
+	if (got != expected) {
+		std::cerr << "ERROR    : " << function << " with instruction set " << static_cast<int>(isa) << " on " << (last - first) << " bytes at alignment " << (reinterpret_cast<uintptr_t>(first) % 64) << '\n';
+		return false;
+	}
+	return true;
+}
+
+/*
+** Run every kernel over random ranges of random text, some with what is
+** searched for planted near the end of the range, where the scalar tail of a
+** vector kernel has to find it
+*/
+bool testKernels(InstructionSet isa) {
+
+	std::string text = randomString(20000);
+
+	for (int i = 0; i < 5000; ++i) {
+		const char *first;
+		const char *last;
+		randomRange(text, &first, &last);
+
+		const auto length = static_cast<int64_t>(last - first);
+
+		// often one which is in the range
+		const char ch = (length != 0 && next() % 2 == 0) ? first[random(length - 1)] : randomCharacter();
+
+		std::string chars = randomString(1 + random(5));
+
+		std::string needle;
+		if (length != 0 && next() % 2 == 0) {
+			// something which is there, often right at the end
+			const int64_t size  = 1 + random(std::min<int64_t>(length, 40) - 1);
+			const int64_t start = (next() % 2 == 0) ? length - size - random(std::min<int64_t>(length - size, 3)) : random(length - size);
+			needle.assign(first + start, static_cast<size_t>(size));
+		} else {
+			needle = randomString(1 + random(5));
+		}
+
+		std::string folded = needle;
+		std::transform(folded.begin(), folded.end(), folded.begin(), foldCase);
+
+		const std::string single(1, ch);
+
+		if (!expect(Kernels::CountCharacter(first, last, ch), static_cast<size_t>(std::count(first, last, ch)), isa, "CountCharacter", first, last) ||
+		    !expect(Kernels::FindCharacter(first, last, ch), findFirstOf(first, last, single), isa, "FindCharacter", first, last) ||
+		    !expect(Kernels::FindLastCharacter(first, last, ch), findLastOf(first, last, single), isa, "FindLastCharacter", first, last) ||
+		    !expect(Kernels::FindFirstOf(first, last, chars), findFirstOf(first, last, chars), isa, "FindFirstOf", first, last) ||
+		    !expect(Kernels::FindLastOf(first, last, chars), findLastOf(first, last, chars), isa, "FindLastOf", first, last) ||
+		    !expect(Kernels::FindString(first, last, needle), findString(first, last, needle, false), isa, "FindString", first, last) ||
+		    !expect(Kernels::FindStringCaseless(first, last, folded), findString(first, last, folded, true), isa, "FindStringCaseless", first, last)) {
+			return false;
+		}
+
+		// change the text now and then, so that matches turn up in new places
+		if (i % 100 == 0) {
+			text = (i % 300 == 0) ? repetitiveString(static_cast<int64_t>(text.size())) : randomString(static_cast<int64_t>(text.size()));
+		}
+	}
+
+	return true;
+}
+
+}
+
+int main() {
+
+	for (InstructionSet isa : {InstructionSet::Scalar, InstructionSet::SSE2, InstructionSet::AVX2}) {
+
+		// only what this CPU can run
+		if (!Kernels::SetInstructionSet(isa)) {
+			continue;
+		}
+
+		if (!testKernels(isa)) {
+			return -1;
+		}
+	}
+
+	std::cout << "SUCCESS\n";
+	return 0;
+}
@@ -0,0 +1,164 @@
+#include "gap_buffer.h"
+#include "line_index.h"
+#include <algorithm>
+#include <iostream>
+#include <string>
+
+namespace {
+
+using Index = line_index<char, std::char_traits<char>>;
+
+uint32_t seed = 67890;
+
+uint32_t next() {
+	seed ^= seed << 13;
+	seed ^= seed >> 17;
+	seed ^= seed << 5;
+	return seed;
+}
+
+int64_t random(int64_t max) {
+	return max == 0 ? 0 : static_cast<int64_t>(next() % static_cast<uint32_t>(max + 1));
+}
+
+std::string randomText(int64_t max) {
+	std::string text(static_cast<size_t>(random(max)), ' ');
+	for (char &ch : text) {
+		ch = (next() % 16 == 0) ? '\n' : static_cast<char>('a' + next() % 26);
+	}
+	return text;
+}
+
+/*
+** Compare what the index says about some positions and lines of the buffer
+** with a plain scan of the text
+*/
+bool check(const gap_buffer<char> &buffer, const Index &index, const char *operation) {
+
+	const std::string text = buffer.to_string();
+	const auto size        = static_cast<int64_t>(text.size());
+	const auto lines       = static_cast<int64_t>(std::count(text.begin(), text.end(), '\n'));
+
+	for (int i = 0; i < 8; ++i) {
+		const int64_t pos      = (i == 0) ? size : random(size);
+		const int64_t expected = std::count(text.begin(), text.begin() + pos, '\n');
+
+		if (index.count_lines(buffer, pos) != expected) {
+			std::cerr << "ERROR    : " << operation << ", count_lines(" << pos << ")\n";
+			return false;
+		}
+	}
+
+	for (int i = 0; i < 8; ++i) {
+		const int64_t line = (i == 0) ? lines + 1 : random(lines);
+
+		int64_t expected = (line == 0) ? 0 : -1;
+		int64_t seen     = 0;
+		for (int64_t pos = 0; pos < size && line != 0; ++pos) {
+			if (text[static_cast<size_t>(pos)] == '\n' && ++seen == line) {
+				expected = pos + 1;
+				break;
+			}
+		}
+
+		if (index.line_start(buffer, line) != expected) {
+			std::cerr << "ERROR    : " << operation << ", line_start(" << line << ")\n";
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/*
+** Random insertions and deletions of every size, including ones spanning
+** many blocks and ones which empty the buffer
+*/
+bool testRandomEdits() {
+
+	gap_buffer<char> buffer;
+	Index index;
+
+	buffer.assign(randomText(Index::BlockSize * 8));
+	index.build(buffer);
+
+	if (!check(buffer, index, "build")) {
+		return false;
+	}
+
+	for (int i = 0; i < 4000; ++i) {
+		const uint32_t op = next() % 10;
+
+		if (op < 5) {
+			// mostly short insertions, but sometimes several blocks' worth
+			const std::string text = randomText((next() % 20 == 0) ? Index::BlockSize * 5 : 40);
+			const int64_t pos      = random(buffer.size());
+
+			buffer.insert(pos, text);
+			index.insert(buffer, pos, static_cast<int64_t>(text.size()));
+
+			if (!check(buffer, index, "insert")) {
+				return false;
+			}
+		} else if (op < 9) {
+			const int64_t start = random(buffer.size());
+			const int64_t end   = start + random(std::min<int64_t>(buffer.size() - start, (next() % 10 == 0) ? Index::BlockSize * 3 : 60));
+
+			index.erase(buffer, start, end);
+			buffer.erase(start, end);
+
+			if (!check(buffer, index, "erase")) {
+				return false;
+			}
+		} else if (next() % 20 == 0) {
+			index.erase(buffer, 0, buffer.size());
+			buffer.erase(0, buffer.size());
+
+			if (!check(buffer, index, "erase all")) {
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+/*
+** Typing in one place splits the same part of the index over and over, which
+** has to move the neighbouring blocks along to make room
+*/
+bool testTyping() {
+
+	gap_buffer<char> buffer;
+	Index index;
+
+	buffer.assign(randomText(Index::BlockSize * 4));
+	index.build(buffer);
+
+	int64_t pos = buffer.size() / 2;
+	for (int i = 0; i < Index::BlockSize * 12; ++i) {
+		const char ch = (i % 50 == 0) ? '\n' : 'x';
+
+		buffer.insert(pos, ch);
+		index.insert(buffer, pos, 1);
+		++pos;
+
+		if (i % 1000 == 0 && !check(buffer, index, "typing")) {
+			return false;
+		}
+	}
+
+	return check(buffer, index, "typing");
+}
+
+}
+
+int main() {
+
+	if (!testRandomEdits() || !testTyping()) {
+		return -1;
+	}
+
+	std::cout << "SUCCESS\n";
+	return 0;
+}
@@ -0,0 +1,187 @@
+#include "ParseCheckpoints.h"
+#include <algorithm>
+#include <iostream>
+#include <vector>
+
+namespace {
+
+uint32_t seed = 13579;
+
+uint32_t next() {
+	seed ^= seed << 13;
+	seed ^= seed >> 17;
+	seed ^= seed << 5;
+	return seed;
+}
+
+int64_t random(int64_t max) {
+	return max == 0 ? 0 : static_cast<int64_t>(next() % static_cast<uint32_t>(max + 1));
+}
+
+/*
+** The checkpoints as a plain sorted vector, which is shifted in full for
+** every edit
+*/
+class Naive {
+public:
+	void update(TextCursor pos, int64_t nInserted, int64_t nDeleted) {
+		std::vector<ParseCheckpoint> result;
+		for (ParseCheckpoint checkpoint : entries) {
+			if (checkpoint.pos <= pos) {
+				result.push_back(checkpoint);
+			} else if (checkpoint.pos > pos + nDeleted) {
+				checkpoint.pos += nInserted - nDeleted;
+				result.push_back(checkpoint);
+			}
+		}
+		entries = result;
+	}
+
+	void replace(TextCursor start, TextCursor end, const std::vector<ParseCheckpoint> &found, TextCursor offset) {
+		std::vector<ParseCheckpoint> result;
+		for (const ParseCheckpoint &checkpoint : entries) {
+			if (checkpoint.pos < start) {
+				result.push_back(checkpoint);
+			}
+		}
+
+		for (const ParseCheckpoint &checkpoint : found) {
+			const TextCursor pos = offset + to_integer(checkpoint.pos);
+			if (pos >= start && pos < end) {
+				result.push_back(ParseCheckpoint{pos, checkpoint.style});
+			}
+		}
+
+		for (const ParseCheckpoint &checkpoint : entries) {
+			if (checkpoint.pos >= end) {
+				result.push_back(checkpoint);
+			}
+		}
+		entries = result;
+	}
+
+	void eraseFrom(TextCursor pos) {
+		entries.erase(std::remove_if(entries.begin(), entries.end(), [pos](const ParseCheckpoint &checkpoint) {
+			return checkpoint.pos >= pos;
+		}), entries.end());
+	}
+
+public:
+	std::vector<ParseCheckpoint> entries;
+};
+
+bool same(const ParseCheckpoints &checkpoints, const Naive &naive, int64_t length, const char *operation) {
+
+	const std::vector<ParseCheckpoint> entries = checkpoints.toVector();
+
+	bool equal = entries.size() == naive.entries.size();
+	for (size_t i = 0; equal && i < entries.size(); ++i) {
+		equal = entries[i].pos == naive.entries[i].pos && entries[i].style == naive.entries[i].style;
+	}
+
+	if (!equal) {
+		std::cerr << "ERROR    : " << operation << ", checkpoints differ\n";
+		return false;
+	}
+
+	for (int i = 0; i < 8; ++i) {
+		const TextCursor pos(random(length));
+		const boost::optional<ParseCheckpoint> found = checkpoints.lastAtOrBefore(pos);
+
+		auto it = std::upper_bound(entries.begin(), entries.end(), pos, [](TextCursor p, const ParseCheckpoint &checkpoint) {
+			return p < checkpoint.pos;
+		});
+
+		if (static_cast<bool>(found) != (it != entries.begin()) || (found && found->pos != std::prev(it)->pos)) {
+			std::cerr << "ERROR    : " << operation << ", lastAtOrBefore(" << to_integer(pos) << ")\n";
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/*
+** Random edits, reparses and truncations, mostly clustered around one place
+** as they are when typing, compared with shifting a plain vector
+*/
+bool testRandomEdits() {
+
+	ParseCheckpoints checkpoints;
+	Naive naive;
+	int64_t length = 100000;
+
+	std::vector<ParseCheckpoint> initial;
+	for (int64_t pos = 50; pos < length; pos += 50 + random(200)) {
+		initial.push_back(ParseCheckpoint{TextCursor(pos), static_cast<uint8_t>(next() % 8)});
+	}
+
+	checkpoints.assign(initial);
+	naive.entries = initial;
+
+	int64_t cursor = length / 2;
+
+	for (int i = 0; i < 20000; ++i) {
+		if (next() % 50 == 0) {
+			cursor = random(length);
+		}
+
+		const uint32_t op = next() % 20;
+
+		if (op < 12) {
+			// typing, deleting and pasting
+			const int64_t nDeleted  = std::min(length - cursor, (next() % 3 == 0) ? random(next() % 10 == 0 ? 2000 : 2) : 0);
+			const int64_t nInserted = (next() % 10 == 0) ? random(2000) : random(2);
+
+			checkpoints.update(TextCursor(cursor), nInserted, nDeleted);
+			naive.update(TextCursor(cursor), nInserted, nDeleted);
+
+			length += nInserted - nDeleted;
+			cursor += nInserted;
+
+			if (!same(checkpoints, naive, length, "update")) {
+				return false;
+			}
+		} else if (op < 19) {
+			// a reparse around the cursor finds new checkpoints
+			const TextCursor start(std::max<int64_t>(0, cursor - random(1000)));
+			const TextCursor end(std::min(length, cursor + random(3000)));
+			const TextCursor offset(std::max<int64_t>(0, to_integer(start) - random(100)));
+
+			std::vector<ParseCheckpoint> found;
+			for (int64_t pos = random(100); pos < end - offset + 100; pos += 1 + random(300)) {
+				found.push_back(ParseCheckpoint{TextCursor(pos), static_cast<uint8_t>(next() % 8)});
+			}
+
+			checkpoints.replace(start, end, found, offset);
+			naive.replace(start, end, found, offset);
+
+			if (!same(checkpoints, naive, length, "replace")) {
+				return false;
+			}
+		} else if (next() % 10 == 0) {
+			const TextCursor pos(random(length));
+
+			checkpoints.eraseFrom(pos);
+			naive.eraseFrom(pos);
+
+			if (!same(checkpoints, naive, length, "eraseFrom")) {
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+}
+
+int main() {
+
+	if (!testRandomEdits()) {
+		return -1;
+	}
+
+	std::cout << "SUCCESS\n";
+	return 0;
+}
@@ -0,0 +1,276 @@
+
+#include "piece_table.h"
+#include <iostream>
+#include <memory>
+#include <string>
+
+namespace {
+
+uint32_t seed = 12345;
+
+uint32_t next() {
+	seed ^= seed << 13;
+	seed ^= seed >> 17;
+	seed ^= seed << 5;
+	return seed;
+}
+
+int64_t random(int64_t max) {
+	return max == 0 ? 0 : static_cast<int64_t>(next() % static_cast<uint32_t>(max + 1));
+}
+
+std::string randomText(int64_t max) {
+	std::string text(static_cast<size_t>(random(max)), ' ');
+	for (char &ch : text) {
+		ch = static_cast<char>('a' + next() % 26);
+	}
+	return text;
+}
+
+/*
+** Compare the table with the string it should hold in every way it can be
+** read, without changing it
+*/
+bool check(const piece_table<char> &table, const std::string &expected, const char *operation) {
+
+	bool ok = (table.size() == static_cast<int64_t>(expected.size())) && (table.to_string() == expected);
+
+	for (int64_t i = 0; ok && i < table.size(); i += 1 + random(64)) {
+		ok = (table[i] == expected[static_cast<size_t>(i)]);
+	}
+
+	if (ok) {
+		const int64_t start = random(table.size());
+		const int64_t end   = start + random(table.size() - start);
+
+		ok = (table.to_string(start, end) == expected.substr(static_cast<size_t>(start), static_cast<size_t>(end - start)));
+
+		std::string forward;
+		table.for_each_span(start, end, [&forward](view::string_view span) {
+			forward.append(span.data(), span.size());
+			return true;
+		});
+
+		std::string reverse;
+		table.for_each_span_reverse(start, end, [&reverse](view::string_view span) {
+			reverse.insert(0, span.data(), span.size());
+			return true;
+		});
+
+		ok = ok && (forward == table.to_string(start, end)) && (reverse == forward);
+
+		const std::string probe = expected.substr(static_cast<size_t>(start), static_cast<size_t>(end - start));
+		ok = ok && (table.compare(start, probe) == 0);
+	}
+
+	if (!ok) {
+		std::cerr << "ERROR    : " << operation << '\n';
+		std::cerr << "EXPECTED : " << expected << '\n';
+		std::cerr << "GOT      : " << table.to_string() << '\n';
+	}
+
+	return ok;
+}
+
+/*
+** Make a long series of random edits, which exercises every way a split can
+** fall (between pieces, inside a piece, at either end) and merges of trees of
+** every shape
+*/
+bool testRandomEdits() {
+
+	piece_table<char> table;
+	std::string expected;
+
+	for (int i = 0; i < 20000; ++i) {
+
+		const char *operation = nullptr;
+
+		switch (next() % 8) {
+		case 0:
+		case 1:
+		case 2: {
+			const int64_t pos = random(table.size());
+			const std::string text = randomText(8);
+			table.insert(pos, text);
+			expected.insert(static_cast<size_t>(pos), text);
+			operation = "insert";
+			break;
+		}
+		case 3: {
+			// typing, which grows the last piece instead of adding one
+			const std::string text = randomText(3);
+			table.append(text);
+			expected.append(text);
+			operation = "append";
+			break;
+		}
+		case 4:
+		case 5: {
+			const int64_t start = random(table.size());
+			const int64_t end   = start + random(std::min<int64_t>(16, table.size() - start));
+			table.erase(start, end);
+			expected.erase(static_cast<size_t>(start), static_cast<size_t>(end - start));
+			operation = "erase";
+			break;
+		}
+		case 6: {
+			const int64_t start = random(table.size());
+			const int64_t end   = start + random(std::min<int64_t>(16, table.size() - start));
+			const std::string text = randomText(16);
+			table.replace(start, end, text);
+			expected.replace(static_cast<size_t>(start), static_cast<size_t>(end - start), text);
+			operation = "replace";
+			break;
+		}
+		case 7: {
+			// a view across pieces gathers only the pieces it covers
+			const int64_t start = random(table.size());
+			const int64_t end   = start + random(std::min<int64_t>(64, table.size() - start));
+			const view::string_view view = table.to_view(start, end);
+			if (view.to_string() != expected.substr(static_cast<size_t>(start), static_cast<size_t>(end - start))) {
+				std::cerr << "ERROR    : to_view(" << start << ", " << end << ")\n";
+				return false;
+			}
+			operation = "to_view";
+			break;
+		}
+		}
+
+		if (!check(table, expected, operation)) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/*
+** Large insertions get blocks of their own rather than sharing one
+*/
+bool testLargeInsertions() {
+
+	piece_table<char> table;
+	std::string expected;
+
+	for (int i = 0; i < 50; ++i) {
+		const int64_t pos = random(table.size());
+		const std::string text(piece_table<char>::BlockSize, static_cast<char>('a' + i % 26));
+		table.insert(pos, text);
+		expected.insert(static_cast<size_t>(pos), text);
+	}
+
+	return check(table, expected, "large insert");
+}
+
+/*
+** Text given to assign_shared is referred to, not copied, until detach
+*/
+bool testShared() {
+
+	const std::string original = "the quick brown fox jumps over the lazy dog";
+
+	std::shared_ptr<char> shared(new char[original.size()], std::default_delete<char[]>());
+	std::copy(original.begin(), original.end(), shared.get());
+
+	piece_table<char> table;
+	table.assign_shared(shared, static_cast<int64_t>(original.size()));
+
+	std::string expected = original;
+
+	if (table.to_view().data() != shared.get()) {
+		std::cerr << "ERROR    : assign_shared copied the text\n";
+		return false;
+	}
+
+	table.insert(4, "very ");
+	expected.insert(4, "very ");
+	table.erase(20, 26);
+	expected.erase(20, 6);
+
+	if (!check(table, expected, "edit shared")) {
+		return false;
+	}
+
+	// a view within one piece still points at the shared text, five
+	// characters were added before it and six removed
+	if (table.to_view(30, 35).data() != shared.get() + 31) {
+		std::cerr << "ERROR    : to_view gathered a single piece\n";
+		return false;
+	}
+
+	table.detach();
+	if (shared.use_count() != 1) {
+		std::cerr << "ERROR    : detach kept the shared text\n";
+		return false;
+	}
+
+	return check(table, expected, "detach");
+}
+
+/*
+** A snapshot keeps the text it was taken of, however the table is changed
+** (and flattened) or destroyed afterwards
+*/
+bool testSnapshot() {
+
+	auto table = std::make_unique<piece_table<char>>();
+	std::string expected = randomText(piece_table<char>::BlockSize * 2);
+	table->assign(expected);
+
+	for (int i = 0; i < 200; ++i) {
+		const std::string text = randomText(40);
+		const int64_t pos      = random(table->size());
+		table->insert(pos, text);
+		expected.insert(static_cast<size_t>(pos), text);
+	}
+
+	const text_snapshot<char> snapshot = table->snapshot();
+
+	table->erase(0, table->size() / 2);
+	table->insert(0, randomText(piece_table<char>::BlockSize));
+	table->to_view();
+	table = nullptr;
+
+	std::string text;
+	snapshot.for_each_span([&text](view::string_view span) {
+		text.append(span.data(), span.size());
+		return true;
+	});
+
+	if (snapshot.size() != static_cast<int64_t>(expected.size()) || text != expected) {
+		std::cerr << "ERROR    : snapshot changed with the table\n";
+		return false;
+	}
+
+	return true;
+}
+
+/*
+**
+*/
+bool testSwap() {
+
+	piece_table<char> a;
+	piece_table<char> b;
+	a.assign("first");
+	b.assign("second");
+	a.insert(0, "the ");
+	b.append(" one");
+
+	a.swap(b);
+
+	return check(a, "second one", "swap") && check(b, "the first", "swap");
+}
+
+}
+
+int main() {
+
+	if (!testRandomEdits() || !testLargeInsertions() || !testShared() || !testSnapshot() || !testSwap()) {
+		return -1;
+	}
+
+	std::cout << "SUCCESS\n";
+	return 0;
+}
@@ -0,0 +1,154 @@
+#include "RangeBoundaries.h"
+#include <algorithm>
+#include <iostream>
+#include <vector>
+
+namespace {
+
+uint32_t seed = 24680;
+
+uint32_t next() {
+	seed ^= seed << 13;
+	seed ^= seed >> 17;
+	seed ^= seed << 5;
+	return seed;
+}
+
+int64_t random(int64_t max) {
+	return max == 0 ? 0 : static_cast<int64_t>(next() % static_cast<uint32_t>(max + 1));
+}
+
+/*
+** "count" sorted positions in [lo, hi]
+*/
+std::vector<int64_t> randomPositions(int64_t count, int64_t lo, int64_t hi) {
+	std::vector<int64_t> positions;
+	for (int64_t i = 0; i < count; ++i) {
+		positions.push_back(lo + random(hi - lo));
+	}
+
+	std::sort(positions.begin(), positions.end());
+	return positions;
+}
+
+/*
+** Compare everything the boundaries can tell us with a plain sorted list
+*/
+bool check(const RangeBoundaries &boundaries, const std::vector<int64_t> &flat, const char *operation) {
+
+	if (boundaries.size() != static_cast<int64_t>(flat.size()) || boundaries.empty() != flat.empty()) {
+		std::cerr << "ERROR    : " << operation << ", size " << boundaries.size() << " instead of " << flat.size() << '\n';
+		return false;
+	}
+
+	for (size_t i = 0; i < flat.size(); ++i) {
+		if (to_integer(boundaries.at(static_cast<int64_t>(i))) != flat[i]) {
+			std::cerr << "ERROR    : " << operation << ", at(" << i << ")\n";
+			return false;
+		}
+	}
+
+	const int64_t end = flat.empty() ? 10 : flat.back() + 10;
+	for (int i = 0; i < 20; ++i) {
+		const int64_t pos = random(end);
+
+		const auto lower = std::lower_bound(flat.begin(), flat.end(), pos) - flat.begin();
+		const auto upper = std::upper_bound(flat.begin(), flat.end(), pos) - flat.begin();
+
+		if (boundaries.lowerBound(TextCursor(pos)) != lower || boundaries.upperBound(TextCursor(pos)) != upper) {
+			std::cerr << "ERROR    : " << operation << ", bounds of " << pos << '\n';
+			return false;
+		}
+	}
+
+	const std::vector<Range> ranges = boundaries.ranges();
+	for (size_t i = 0; i < ranges.size(); ++i) {
+		if (to_integer(ranges[i].start) != flat[i * 2] || to_integer(ranges[i].end) != flat[i * 2 + 1]) {
+			std::cerr << "ERROR    : " << operation << ", range " << i << '\n';
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/*
+** Replace random runs of boundaries, moving the rest along, the way edits of
+** the text and changes to the ranges do
+*/
+bool testRandomReplace() {
+
+	for (int round = 0; round < 20; ++round) {
+		RangeBoundaries boundaries;
+		std::vector<int64_t> flat = randomPositions(random(200) * 2, 0, 5000);
+
+		std::vector<Range> ranges;
+		for (size_t i = 0; i < flat.size(); i += 2) {
+			ranges.push_back({TextCursor(flat[i]), TextCursor(flat[i + 1])});
+		}
+
+		boundaries.assign(ranges);
+		if (!check(boundaries, flat, "assign")) {
+			return false;
+		}
+
+		for (int i = 0; i < 1000; ++i) {
+			const auto size     = static_cast<int64_t>(flat.size());
+			const int64_t first = random(size);
+
+			// mostly small changes, sometimes large ones
+			const int64_t removed = (next() % 10 == 0) ? random(size - first) : std::min(random(4), size - first);
+			const int64_t last    = first + removed;
+
+			int64_t added = (next() % 10 == 0) ? random(300) : random(4);
+			if ((added + removed) % 2 != 0) {
+				++added;
+			}
+
+			const int64_t lo = (first == 0) ? 0 : flat[static_cast<size_t>(first - 1)];
+
+			// the boundaries after the change can move back as far as "lo"
+			int64_t shift = random(200) - 100;
+			if (last < size) {
+				shift = std::max(shift, lo - flat[static_cast<size_t>(last)]);
+			}
+
+			const int64_t hi = (last < size) ? flat[static_cast<size_t>(last)] + shift : lo + 1000;
+
+			const std::vector<int64_t> positions = randomPositions(added, lo, hi);
+
+			std::vector<TextCursor> replacement;
+			for (int64_t position : positions) {
+				replacement.push_back(TextCursor(position));
+			}
+
+			boundaries.replace(first, last, replacement, shift);
+
+			std::vector<int64_t> result(flat.begin(), flat.begin() + first);
+			result.insert(result.end(), positions.begin(), positions.end());
+			for (auto it = flat.begin() + last; it != flat.end(); ++it) {
+				result.push_back(*it + shift);
+			}
+
+			flat = std::move(result);
+
+			if (!check(boundaries, flat, "replace")) {
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+}
+
+int main() {
+
+	if (!testRandomReplace()) {
+		return -1;
+	}
+
+	std::cout << "SUCCESS\n";
+	return 0;
+}
@@ -0,0 +1,239 @@
+#include "StyleBuffer.h"
+#include <algorithm>
+#include <iostream>
+#include <string>
+
+namespace {
+
+uint32_t seed = 97531;
+
+uint32_t next() {
+	seed ^= seed << 13;
+	seed ^= seed >> 17;
+	seed ^= seed << 5;
+	return seed;
+}
+
+int64_t random(int64_t max) {
+	return max == 0 ? 0 : static_cast<int64_t>(next() % static_cast<uint32_t>(max + 1));
+}
+
+char randomStyle() {
+	return static_cast<char>('A' + next() % 4);
+}
+
+/*
+** Styles in runs of random lengths, mostly short ones so that there are
+** enough runs to fill several chunks
+*/
+std::string randomStyles(int64_t max) {
+
+	std::string styles;
+	const int64_t length = random(max);
+
+	while (static_cast<int64_t>(styles.size()) < length) {
+		const int64_t run = (next() % 16 == 0) ? random(200) : 1 + random(4);
+		styles.append(static_cast<size_t>(std::min(run, length - static_cast<int64_t>(styles.size()))), randomStyle());
+	}
+
+	return styles;
+}
+
+/*
+** A position to edit or look up at, now and then outside of the buffer
+*/
+int64_t randomPosition(int64_t length) {
+	return (next() % 32 == 0) ? random(length + 20) - 10 : random(length);
+}
+
+/*
+** Compare everything the buffer can tell us with a plain string of styles
+*/
+bool check(const StyleBuffer &buffer, const std::string &flat, const char *operation) {
+
+	const auto length = static_cast<int64_t>(flat.size());
+
+	if (buffer.length() != length) {
+		std::cerr << "ERROR    : " << operation << ", length " << buffer.length() << " instead of " << length << '\n';
+		return false;
+	}
+
+	if (buffer.range(TextCursor(), TextCursor(length)) != flat) {
+		std::cerr << "ERROR    : " << operation << ", styles differ\n";
+		return false;
+	}
+
+	for (int i = 0; i < 50; ++i) {
+		const int64_t pos   = randomPosition(length);
+		const char expected = (pos >= 0 && pos < length) ? flat[static_cast<size_t>(pos)] : '\0';
+
+		if (buffer.at(TextCursor(pos)) != expected) {
+			std::cerr << "ERROR    : " << operation << ", style at " << pos << '\n';
+			return false;
+		}
+
+		// every character up to the end of the run has the same style
+		if (pos >= 0 && pos < length) {
+			const int64_t end = to_integer(buffer.runEnd(TextCursor(pos)));
+			if (end <= pos || end > length || std::any_of(flat.begin() + pos, flat.begin() + end, [expected](char ch) { return ch != expected; })) {
+				std::cerr << "ERROR    : " << operation << ", run at " << pos << " ends at " << end << '\n';
+				return false;
+			}
+		}
+
+		const int64_t start = randomPosition(length);
+		const int64_t end   = start + random(300);
+
+		const int64_t from = std::min(std::max<int64_t>(start, 0), length);
+		const int64_t to   = std::min(std::max<int64_t>(end, 0), length);
+
+		if (buffer.range(TextCursor(start), TextCursor(end)) != flat.substr(static_cast<size_t>(from), static_cast<size_t>(std::max<int64_t>(to - from, 0)))) {
+			std::cerr << "ERROR    : " << operation << ", range " << start << " to " << end << '\n';
+			return false;
+		}
+	}
+
+	return true;
+}
+
+/*
+** Replace, insert and remove random stretches of styles, which splits and
+** merges runs and chunks, checking the buffer against a flat string as it
+** goes
+*/
+bool testRandomEdits() {
+
+	for (int round = 0; round < 10; ++round) {
+		StyleBuffer buffer;
+		std::string flat = randomStyles(20000);
+
+		buffer.setAll(flat);
+		if (!check(buffer, flat, "setAll")) {
+			return false;
+		}
+
+		for (int i = 0; i < 1000; ++i) {
+			const auto length = static_cast<int64_t>(flat.size());
+
+			const int64_t start = randomPosition(length);
+			const int64_t end   = (next() % 4 == 0) ? randomPosition(length) : start + random(next() % 10 == 0 ? 5000 : 20);
+
+			// what the buffer is expected to do with positions outside of it
+			const int64_t from = std::min(std::max<int64_t>(start, 0), length);
+			const int64_t to   = std::min(std::max(end, from), length);
+
+			const char *operation;
+			std::string styles;
+
+			switch (next() % 3) {
+			case 0:
+				operation = "replace";
+				styles    = randomStyles(next() % 10 == 0 ? 5000 : 30);
+				buffer.replace(TextCursor(start), TextCursor(end), styles);
+				break;
+			case 1: {
+				operation           = "replace with one style";
+				const char style    = randomStyle();
+				const int64_t count = random(100);
+				styles.assign(static_cast<size_t>(count), style);
+				buffer.replace(TextCursor(start), TextCursor(end), style, count);
+				break;
+			}
+			default:
+				operation = "remove";
+				buffer.remove(TextCursor(start), TextCursor(end));
+				break;
+			}
+
+			flat.replace(static_cast<size_t>(from), static_cast<size_t>(to - from), styles);
+
+			if (!check(buffer, flat, operation)) {
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+/*
+** Runs longer than a Run can hold are split up, and stay correct when they
+** are cut into
+*/
+bool testLongRuns() {
+
+	constexpr int64_t Length = (1 << 24) + 1000;
+
+	StyleBuffer buffer;
+	buffer.replace(TextCursor(), TextCursor(), 'A', Length);
+
+	std::string flat(static_cast<size_t>(Length), 'A');
+	if (!check(buffer, flat, "long run")) {
+		return false;
+	}
+
+	buffer.replace(TextCursor(Length - 2000), TextCursor(Length - 1000), 'B', 10);
+	flat.replace(static_cast<size_t>(Length - 2000), 1000, 10, 'B');
+
+	return check(buffer, flat, "cut into a long run");
+}
+
+/*
+** The changed range is only what was last marked, and setAll clears it
+*/
+bool testChanged() {
+
+	StyleBuffer buffer;
+	buffer.setAll(randomStyles(1000));
+
+	bool changed  = false;
+	int64_t start = 0;
+	int64_t end   = 0;
+
+	for (int i = 0; i < 1000; ++i) {
+		switch (next() % 4) {
+		case 0:
+		case 1: {
+			const int64_t a = random(1000);
+			const int64_t b = random(1000);
+			buffer.markChanged(TextCursor(a), TextCursor(b));
+			changed = (a != b);
+			start   = std::min(a, b);
+			end     = std::max(a, b);
+			break;
+		}
+		case 2:
+			buffer.clearChanged();
+			changed = false;
+			break;
+		default:
+			// edits leave the changed range alone, setAll doesn't
+			if (next() % 2 == 0) {
+				buffer.replace(TextCursor(random(500)), TextCursor(random(500) + 500), randomStyles(100));
+			} else {
+				buffer.setAll(randomStyles(1000));
+				changed = false;
+			}
+			break;
+		}
+
+		if (buffer.changed() != changed || (changed && (buffer.changedStart() != start || buffer.changedEnd() != end))) {
+			std::cerr << "ERROR    : changed range\n";
+			return false;
+		}
+	}
+
+	return true;
+}
+
+}
+
+int main() {
+
+	if (!testRandomEdits() || !testLongRuns() || !testChanged()) {
+		return -1;
+	}
+
+	std::cout << "SUCCESS\n";
+	return 0;
+}
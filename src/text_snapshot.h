@@ -0,0 +1,76 @@
+
+#ifndef TEXT_SNAPSHOT_H_
+#define TEXT_SNAPSHOT_H_
+
+#include "Util/string_view.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+/*
+** The text of a buffer as it was at some moment, which stays valid however
+** the buffer is changed or destroyed afterwards, so it can be read by another
+** thread. The text is a sequence of spans, the snapshot shares ownership of
+** the storage they are in. A piece table can hand out a snapshot of its own
+** storage, which never changes once written, so taking one only costs a copy
+** of its list of pieces.
+*/
+template <class Ch, class Tr = std::char_traits<Ch>>
+class text_snapshot {
+public:
+	using string_type = std::basic_string<Ch, Tr>;
+	using view_type   = view::basic_string_view<Ch, Tr>;
+	using size_type   = int64_t;
+
+public:
+	text_snapshot() = default;
+
+	explicit text_snapshot(string_type text) {
+		auto storage = std::make_shared<const string_type>(std::move(text));
+		append(*storage);
+		keep(std::move(storage));
+	}
+
+public:
+	size_type size() const noexcept { return size_; }
+	bool empty() const noexcept     { return size_ == 0; }
+
+public:
+	void append(view_type span) {
+		if (!span.empty()) {
+			spans_.push_back(span);
+			size_ += static_cast<size_type>(span.size());
+		}
+	}
+
+	void keep(std::shared_ptr<const void> storage) {
+		storage_.push_back(std::move(storage));
+	}
+
+	void clear() noexcept {
+		spans_.clear();
+		storage_.clear();
+		size_ = 0;
+	}
+
+public:
+	/* Calls func(view_type) for each contiguous run of the text, in order.
+	 * func returns false to stop the iteration early */
+	template <class Func>
+	void for_each_span(Func func) const {
+		for (view_type span : spans_) {
+			if (!func(span)) {
+				break;
+			}
+		}
+	}
+
+private:
+	std::vector<view_type> spans_;
+	std::vector<std::shared_ptr<const void>> storage_; // whatever the spans point into
+	size_type size_ = 0;
+};
+
+#endif